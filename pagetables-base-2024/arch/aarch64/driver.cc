@@ -11,6 +11,8 @@ using namespace AArch64;
 
 #include <iostream>
 #include <cstring>
+#include <iomanip>
+#include <map>
 
 /*
  * Helper functions for page table management
@@ -33,18 +35,85 @@ getAddress(const SimpleTableEntry &entry)
   return entry.physicalPageNum << pageBits;
 }
 
+/* Occupancy of the tables at one level; the histogram counts tables by
+ * the power of two bucket of their number of valid entries.
+ */
+struct LevelOccupancy
+{
+  uint64_t nTables;
+  uint64_t nEntries;
+  uint64_t nValid;
+  std::map<int, uint64_t> histogram;
+
+  LevelOccupancy() : nTables(0), nEntries(0), nValid(0), histogram() { }
+};
+
+/* Bucket 0 holds empty tables, bucket b tables with [2^(b-1), 2^b) valid
+ * entries.
+ */
+static int
+getBucket(uint64_t count)
+{
+  int bucket = 0;
+  for (; count > 0; count >>= 1)
+    ++bucket;
+  return bucket;
+}
+
+/* Count the valid entries of table and the tables below it. A full L3
+ * table could be replaced by a block entry in L2, if its pages were also
+ * physically contiguous and aligned.
+ */
+static void
+analyzeTable(const SimpleTableEntry *table, const int level,
+             LevelOccupancy occupancy[4], uint64_t &nFull,
+             uint64_t &nContiguous)
+{
+  const uint64_t nEntries = level == 0 ? L0_ENTRIES : L1_ENTRIES;
+  uint64_t nValid = 0;
+  bool contiguous = table[0].valid &&
+                    (table[0].physicalPageNum & (L3_ENTRIES - 1)) == 0;
+
+  for (uint64_t i = 0; i < nEntries; ++i)
+    {
+      if (!table[i].valid)
+        continue;
+
+      ++nValid;
+      if (level < 3)
+        analyzeTable(reinterpret_cast<const SimpleTableEntry *>(getAddress(table[i])),
+                     level + 1, occupancy, nFull, nContiguous);
+      else if (table[i].physicalPageNum != table[0].physicalPageNum + i)
+        contiguous = false;
+    }
+
+  LevelOccupancy &stats = occupancy[level];
+  ++stats.nTables;
+  stats.nEntries += nEntries;
+  stats.nValid += nValid;
+  ++stats.histogram[getBucket(nValid)];
+
+  if (level == 3 && nValid == nEntries)
+    {
+      ++nFull;
+      if (contiguous)
+        ++nContiguous;
+    }
+}
+
 /*
  * AArch64MMUDriver implementation
  */
 
 AArch64MMUDriver::AArch64MMUDriver()
-  : pageTables(), bytesAllocated(0), kernel(nullptr)
+  : pageTables(), bytesAllocated(0), kernel(nullptr), sharedTables(),
+    sharedGlobal()
 {
 }
 
 AArch64MMUDriver::~AArch64MMUDriver()
 {
-  if (!pageTables.empty())
+  if (!pageTables.empty() || !sharedTables.empty())
     std::cerr << "AArch64MMUDriver: error: kernel did not release all page tables."
               << std::endl;
 }
@@ -96,13 +165,16 @@ AArch64MMUDriver::releasePageTableLevel(SimpleTableEntry *table, int level)
   
   tableSize = numEntries * sizeof(SimpleTableEntry);
   
-  /* For non-leaf levels, recursively release child tables */
+  /* For non-leaf levels, recursively release child tables; shared L3
+   * tables are released by releaseSharedTable.
+   */
   if (level < 3) {
     for (size_t i = 0; i < numEntries; ++i) {
       if (table[i].valid && table[i].type == 1) {
         SimpleTableEntry *childTable = reinterpret_cast<SimpleTableEntry *>
           (getAddress(table[i]));
-        releasePageTableLevel(childTable, level + 1);
+        if (!sharedGlobal.count(childTable))
+          releasePageTableLevel(childTable, level + 1);
       }
     }
   }
@@ -127,6 +199,20 @@ AArch64MMUDriver::getOrCreateTable(SimpleTableEntry *parent, uint64_t index)
   }
 }
 
+/* Return the L2 table covering vAddr in the page table of PID, creating
+ * the intermediate levels as needed.
+ */
+SimpleTableEntry*
+AArch64MMUDriver::getL2Table(const uint64_t PID, const uintptr_t vAddr)
+{
+  auto it = pageTables.find(PID);
+  if (it == pageTables.end())
+    throw std::runtime_error("Page table not found for PID");
+
+  SimpleTableEntry *l1_table = getOrCreateTable(it->second, L0_INDEX(vAddr));
+  return getOrCreateTable(l1_table, L1_INDEX(vAddr));
+}
+
 void
 AArch64MMUDriver::allocatePageTable(const uint64_t PID)
 {
@@ -172,24 +258,21 @@ AArch64MMUDriver::setMapping(const uint64_t PID,
   vAddr &= (1UL << addressSpaceBits) - 1;
   
   /* Extract indices for each level */
-  uint64_t l0_idx = L0_INDEX(vAddr);
-  uint64_t l1_idx = L1_INDEX(vAddr);
   uint64_t l2_idx = L2_INDEX(vAddr);
   uint64_t l3_idx = L3_INDEX(vAddr);
   
-  auto it = pageTables.find(PID);
-  if (it == pageTables.end())
-    throw std::runtime_error("Page table not found for PID");
-  
-  SimpleTableEntry *l0_table = it->second;
-  
-  /* Walk/create the page table hierarchy */
-  SimpleTableEntry *l1_table = getOrCreateTable(l0_table, l0_idx);
-  SimpleTableEntry *l2_table = getOrCreateTable(l1_table, l1_idx);
+  /* Walk/create the page table hierarchy; for a shared region, the
+   * shared L3 table has been linked by linkSharedTable.
+   */
+  SimpleTableEntry *l2_table = getL2Table(PID, vAddr);
   SimpleTableEntry *l3_table = getOrCreateTable(l2_table, l2_idx);
   
   /* Set the final page mapping in L3 table */
   initTableEntry(l3_table[l3_idx], pPage.addr, false);
+
+  auto shared = sharedGlobal.find(l3_table);
+  if (shared != sharedGlobal.end() && shared->second)
+    l3_table[l3_idx].global = 1;
   
   /* Store pointer to page table entry in PhysPage for quick access */
   pPage.driverData = &l3_table[l3_idx];
@@ -208,8 +291,134 @@ AArch64MMUDriver::setPageValid(PhysPage &pPage, bool setting)
   entry->valid = setting ? 1 : 0;
 }
 
+bool
+AArch64MMUDriver::getPageReferenced(const PhysPage &pPage) const
+{
+  return reinterpret_cast<SimpleTableEntry *>(pPage.driverData)->referenced;
+}
+
+void
+AArch64MMUDriver::setPageReferenced(PhysPage &pPage, bool setting)
+{
+  reinterpret_cast<SimpleTableEntry *>(pPage.driverData)->referenced = setting ? 1 : 0;
+}
+
+bool
+AArch64MMUDriver::getPageDirty(const PhysPage &pPage) const
+{
+  return reinterpret_cast<SimpleTableEntry *>(pPage.driverData)->dirty;
+}
+
+void
+AArch64MMUDriver::remapPage(PhysPage &pPage, const uintptr_t newAddr)
+{
+  SimpleTableEntry *entry = reinterpret_cast<SimpleTableEntry *>(pPage.driverData);
+  if (!entry)
+    throw std::runtime_error("Invalid page table entry pointer");
+
+  entry->physicalPageNum = newAddr >> pageBits;
+  pPage.addr = newAddr;
+}
+
 uint64_t
 AArch64MMUDriver::getBytesAllocated(void) const
 {
   return bytesAllocated;
-}
\ No newline at end of file
+}
+
+uint64_t
+AArch64MMUDriver::getSharedTableSpan(void) const
+{
+  return L3_ENTRIES * pageSize;
+}
+
+bool
+AArch64MMUDriver::linkSharedTable(const uint64_t PID, const uintptr_t vAddr,
+                                  const bool global)
+{
+  const uint64_t key = (vAddr & ((1UL << addressSpaceBits) - 1)) >> (L3_BITS + pageBits);
+  auto it = sharedTables.find(key);
+  if (it == sharedTables.end())
+    {
+      /* Counted once in bytesAllocated, however many page tables link it. */
+      it = sharedTables.emplace(key, allocatePageTableLevel()).first;
+      sharedGlobal.emplace(it->second, global);
+    }
+
+  SimpleTableEntry *l3_table = it->second;
+  SimpleTableEntry *l2_table = getL2Table(PID, vAddr);
+  const uint64_t l2_idx = L2_INDEX(vAddr);
+  if (!l2_table[l2_idx].valid)
+    initTableEntry(l2_table[l2_idx], reinterpret_cast<uintptr_t>(l3_table), true);
+  else if (getAddress(l2_table[l2_idx]) != reinterpret_cast<uintptr_t>(l3_table))
+    throw std::runtime_error("Shared region overlaps private page table");
+
+  return l3_table[L3_INDEX(vAddr)].valid;
+}
+
+void
+AArch64MMUDriver::releaseSharedTable(const uintptr_t vAddr)
+{
+  const uint64_t key = (vAddr & ((1UL << addressSpaceBits) - 1)) >> (L3_BITS + pageBits);
+  auto it = sharedTables.find(key);
+  if (it == sharedTables.end())
+    return;
+
+  sharedGlobal.erase(it->second);
+  releasePageTableLevel(it->second, 3);
+  sharedTables.erase(it);
+}
+
+void
+AArch64MMUDriver::reportPageTable(const uint64_t PID, std::ostream &os) const
+{
+  auto it = pageTables.find(PID);
+  if (it == pageTables.end())
+    return;
+
+  LevelOccupancy occupancy[4];
+  uint64_t nFull = 0, nContiguous = 0;
+  analyzeTable(it->second, 0, occupancy, nFull, nContiguous);
+
+  uint64_t nEntries = 0, nValid = 0;
+  os << std::dec << std::endl
+     << "Page Table Statistics (PID " << std::hex << std::showbase << PID
+     << std::dec << "):" << std::endl;
+  for (int level = 0; level < 4; ++level)
+    {
+      const LevelOccupancy &stats = occupancy[level];
+      const uint64_t tableEntries = level == 0 ? L0_ENTRIES : L1_ENTRIES;
+      nEntries += stats.nEntries;
+      nValid += stats.nValid;
+
+      os << "# level " << level << ": " << stats.nTables << " tables, "
+         << stats.nValid << " of " << stats.nEntries << " entries valid"
+         << std::endl << "#   valid entries per table:";
+      const char *separator = " ";
+      for (const auto &bucket : stats.histogram)
+        {
+          const uint64_t low = bucket.first == 0 ? 0 : 1UL << (bucket.first - 1);
+          const uint64_t high = bucket.first == 0 ? 0 :
+            std::min((1UL << bucket.first) - 1, tableEntries);
+          os << separator << low;
+          if (high > low)
+            os << "-" << high;
+          os << ": " << bucket.second;
+          separator = ", ";
+        }
+      os << std::endl;
+    }
+
+  /* Every L3 table maps one 32 MiB region. */
+  const uint64_t nRegions = occupancy[3].nTables;
+  os << std::setprecision(3)
+     << "# " << ((L3_ENTRIES * pageSize) >> 20) << " MiB regions: " << nRegions
+     << ", fully mapped: " << nFull
+     << " (" << (nRegions ? 100. * nFull / nRegions : 0.) << "%)"
+     << ", block mappable: " << nContiguous
+     << " (" << (nRegions ? 100. * nContiguous / nRegions : 0.) << "%)"
+     << std::endl
+     << "# wasted entries: " << nEntries - nValid << " of " << nEntries
+     << " (" << 100. * (nEntries - nValid) / nEntries << "%)" << std::endl
+     << std::setprecision(6);
+}
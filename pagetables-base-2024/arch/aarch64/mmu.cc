@@ -7,6 +7,7 @@
  */
 
 #include "aarch64.h"
+#include "settings.h"
 using namespace AArch64;
 
 #include <stdexcept>
@@ -19,8 +20,13 @@ using namespace AArch64;
 
 AArch64MMU::AArch64MMU()
 {
-  // Initialize TLB with configurable size (default 64 entries)
-  setTLB(std::make_unique<TLB>(64, *this));
+  /* TLB with a configurable number of entries, ways and organisation
+   * (-t); none if there are no entries
+   */
+  if (TLBEntries > 0)
+    setTLB(std::make_unique<TLB>(TLBEntries, *this, TLBAssoc, 1,
+                                 VictimTLBEntries,
+                                 TLB::parseOrganisation(TLBIndexing)));
 }
 
 AArch64MMU::~AArch64MMU()
@@ -45,10 +51,25 @@ AArch64MMU::performTranslation(const uint64_t vPage,
   uint64_t l2_idx = L2_INDEX(vAddr);
   uint64_t l3_idx = L3_INDEX(vAddr);
 
+  /* A block descriptor in L1 or L2 maps 64 GiB or 32 MiB at once */
+  auto translateBlock = [&](SimpleTableEntry &entry, const unsigned size)
+    {
+      pPage = entry.physicalPageNum + (vPage & ((1UL << pageSizeShifts[size]) - 1));
+      walkGlobal = entry.global;
+      walkSize = size;
+
+      entry.referenced = 1;
+      if (isWrite)
+        entry.dirty = 1;
+
+      return true;
+    };
+
   /* Start with L0 table (root) */
   SimpleTableEntry *l0_table = reinterpret_cast<SimpleTableEntry *>(root);
   
   /* L0 -> L1 translation */
+  tableAccess(&l0_table[l0_idx]);
   if (!l0_table[l0_idx].valid || l0_table[l0_idx].type != 1)
     return false;
   
@@ -56,25 +77,33 @@ AArch64MMU::performTranslation(const uint64_t vPage,
     (l0_table[l0_idx].physicalPageNum << pageBits);
   
   /* L1 -> L2 translation */
-  if (!l1_table[l1_idx].valid || l1_table[l1_idx].type != 1)
+  tableAccess(&l1_table[l1_idx]);
+  if (!l1_table[l1_idx].valid)
     return false;
+  if (l1_table[l1_idx].type != 1)
+    return translateBlock(l1_table[l1_idx], 2);
   
   SimpleTableEntry *l2_table = reinterpret_cast<SimpleTableEntry *>
     (l1_table[l1_idx].physicalPageNum << pageBits);
   
   /* L2 -> L3 translation */
-  if (!l2_table[l2_idx].valid || l2_table[l2_idx].type != 1)
+  tableAccess(&l2_table[l2_idx]);
+  if (!l2_table[l2_idx].valid)
     return false;
+  if (l2_table[l2_idx].type != 1)
+    return translateBlock(l2_table[l2_idx], 1);
   
   SimpleTableEntry *l3_table = reinterpret_cast<SimpleTableEntry *>
     (l2_table[l2_idx].physicalPageNum << pageBits);
   
   /* L3 -> final page translation */
+  tableAccess(&l3_table[l3_idx]);
   if (!l3_table[l3_idx].valid)
     return false;
 
   /* Set the physical page number */
   pPage = l3_table[l3_idx].physicalPageNum;
+  walkGlobal = l3_table[l3_idx].global;
   
   /* Set the referenced bit (access flag) */
   l3_table[l3_idx].referenced = 1;
@@ -84,4 +113,47 @@ AArch64MMU::performTranslation(const uint64_t vPage,
     l3_table[l3_idx].dirty = 1;
 
   return true;
+}
+
+/* Naive walk for checking, without side effects: descend through the
+ * table descriptors of levels 0 to 2 to the page descriptor at level 3,
+ * or to a block descriptor at level 1 or 2.
+ */
+bool
+AArch64MMU::referenceTranslation(const uint64_t vPage, uint64_t &pPage) const
+{
+  const uint64_t vAddr = vPage << pageBits;
+  const uint64_t indices[] =
+    { L0_INDEX(vAddr), L1_INDEX(vAddr), L2_INDEX(vAddr), L3_INDEX(vAddr) };
+
+  const SimpleTableEntry *table = reinterpret_cast<const SimpleTableEntry *>(root);
+  for (int level = 0; level < 4; ++level)
+    {
+      if (table == nullptr)
+        return false;
+
+      const SimpleTableEntry &entry = table[indices[level]];
+      if (not entry.valid)
+        return false;
+
+      if (level == 3)
+        {
+          pPage = entry.physicalPageNum;
+          return true;
+        }
+
+      if (entry.type != 1)
+        {
+          if (level == 0)
+            return false;
+
+          const uint64_t blockPages = 1UL << (level == 1 ? L2_BITS + L3_BITS : L3_BITS);
+          pPage = entry.physicalPageNum + (vPage & (blockPages - 1));
+          return true;
+        }
+      table = reinterpret_cast<const SimpleTableEntry *>
+        (entry.physicalPageNum << pageBits);
+    }
+
+  return false;
 }
\ No newline at end of file
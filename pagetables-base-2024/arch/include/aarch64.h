@@ -74,7 +74,8 @@ struct SimpleTableEntry
 {
   uint64_t valid : 1;
   uint64_t type : 1;        /* 0=invalid/page, 1=table */
-  uint64_t reserved : 10;
+  uint64_t global : 1;      /* Page is shared by all ASIDs (inverse of nG) */
+  uint64_t reserved : 9;
   uint64_t physicalPageNum : 34;  /* Physical page number */
   uint64_t referenced : 1;   /* Access flag */
   uint64_t dirty : 1;       /* Modified bit (software managed) */
@@ -112,6 +113,8 @@ class AArch64MMU : public MMU
     virtual bool performTranslation(const uint64_t vPage,
                                     uint64_t &pPage,
                                     bool isWrite) override;
+    virtual bool referenceTranslation(const uint64_t vPage,
+                                      uint64_t &pPage) const override;
 };
 
 /*
@@ -130,10 +133,17 @@ class AArch64MMUDriver : public MMUDriver
     /* Reference to kernel for memory allocation */
     OSKernel *kernel;  /* no ownership */
 
+    /* Shared L3 tables, by the range of virtual addresses these map, and
+     * whether their pages are global.
+     */
+    std::map<uint64_t, SimpleTableEntry *> sharedTables;
+    std::unordered_map<const SimpleTableEntry *, bool> sharedGlobal;
+
     /* Helper methods for page table management */
     SimpleTableEntry* allocatePageTableLevel(void);
     void releasePageTableLevel(SimpleTableEntry *table, int level);
     SimpleTableEntry* getOrCreateTable(SimpleTableEntry *parent, uint64_t index);
+    SimpleTableEntry* getL2Table(const uint64_t PID, const uintptr_t vAddr);
     
   public:
     AArch64MMUDriver();
@@ -153,8 +163,25 @@ class AArch64MMUDriver : public MMUDriver
     virtual void      setPageValid(PhysPage &pPage,
                                    bool setting) override;
 
+    virtual bool      getPageReferenced(const PhysPage &pPage) const override;
+    virtual void      setPageReferenced(PhysPage &pPage,
+                                        bool setting) override;
+    virtual bool      getPageDirty(const PhysPage &pPage) const override;
+
+    virtual void      remapPage(PhysPage &pPage,
+                                const uintptr_t newAddr) override;
+
     virtual uint64_t  getBytesAllocated(void) const override;
 
+    virtual uint64_t  getSharedTableSpan(void) const override;
+    virtual bool      linkSharedTable(const uint64_t PID,
+                                      const uintptr_t vAddr,
+                                      const bool global) override;
+    virtual void      releaseSharedTable(const uintptr_t vAddr) override;
+
+    virtual void      reportPageTable(const uint64_t PID,
+                                      std::ostream &os) const override;
+
     /* Disallow objects from being copied, since it has a pointer member. */
     AArch64MMUDriver(const AArch64MMUDriver &driver) = delete;
     void operator=(const AArch64MMUDriver &driver) = delete;
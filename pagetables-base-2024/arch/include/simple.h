@@ -79,6 +79,8 @@ class SimpleMMU : public MMU
     virtual bool performTranslation(const uint64_t vPage,
                                     uint64_t &pPage,
                                     bool isWrite) override;
+    virtual bool referenceTranslation(const uint64_t vPage,
+                                      uint64_t &pPage) const override;
 };
 
 
@@ -112,6 +114,14 @@ class SimpleMMUDriver : public MMUDriver
     virtual void      setPageValid(PhysPage &pPage,
                                    bool setting) override;
 
+    virtual bool      getPageReferenced(const PhysPage &pPage) const override;
+    virtual void      setPageReferenced(PhysPage &pPage,
+                                        bool setting) override;
+    virtual bool      getPageDirty(const PhysPage &pPage) const override;
+
+    virtual void      remapPage(PhysPage &pPage,
+                                const uintptr_t newAddr) override;
+
     virtual uint64_t  getBytesAllocated(void) const override;
 
     /* Disallow objects from being copied, since it has a pointer member. */
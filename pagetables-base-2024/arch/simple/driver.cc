@@ -23,6 +23,7 @@ initPageTableEntry(TableEntry &entry, const uintptr_t address)
   entry.read = 1;
   entry.valid = 1;
   entry.dirty = 0;
+  entry.referenced = 0;
 }
 
 static inline uintptr_t
@@ -125,3 +126,29 @@ SimpleMMUDriver::setPageValid(PhysPage &pPage, bool setting)
 
   entry->valid = setting;
 }
+
+bool
+SimpleMMUDriver::getPageReferenced(const PhysPage &pPage) const
+{
+  return reinterpret_cast<TableEntry *>(pPage.driverData)->referenced;
+}
+
+void
+SimpleMMUDriver::setPageReferenced(PhysPage &pPage, bool setting)
+{
+  reinterpret_cast<TableEntry *>(pPage.driverData)->referenced = setting;
+}
+
+bool
+SimpleMMUDriver::getPageDirty(const PhysPage &pPage) const
+{
+  return reinterpret_cast<TableEntry *>(pPage.driverData)->dirty;
+}
+
+void
+SimpleMMUDriver::remapPage(PhysPage &pPage, const uintptr_t newAddr)
+{
+  TableEntry *entry = reinterpret_cast<TableEntry *>(pPage.driverData);
+  entry->physicalPage = newAddr >> pageBits;
+  pPage.addr = newAddr;
+}
@@ -32,10 +32,26 @@ SimpleMMU::performTranslation(const uint64_t vPage,
     throw std::runtime_error("Unaligned page table access");
 
   TableEntry *table = reinterpret_cast<TableEntry *>(root);
+  tableAccess(&table[vPage]);
   if (not table[vPage].valid)
     return false;
 
   pPage = table[vPage].physicalPage;
 
+  table[vPage].referenced = 1;
+  if (isWrite)
+    table[vPage].dirty = 1;
+
+  return true;
+}
+
+bool
+SimpleMMU::referenceTranslation(const uint64_t vPage, uint64_t &pPage) const
+{
+  const TableEntry *table = reinterpret_cast<const TableEntry *>(root);
+  if (table == nullptr || not table[vPage].valid)
+    return false;
+
+  pPage = table[vPage].physicalPage;
   return true;
 }
@@ -0,0 +1,180 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    cache.cc - Physically indexed data cache model
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "cache.h"
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+
+static bool
+isPowerOfTwo(const uint64_t value)
+{
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+Cache::Cache(const uint64_t size, const uint64_t ways,
+             const uint64_t lineSize, const uint32_t sampling)
+  : lineSize(lineSize), nWays(ways),
+    nSets(ways && lineSize ? size / (ways * lineSize) : 0), lineBits(0),
+    tags(), lastUse(), clock(0),
+    shadowOrder(), shadowMap(), seen(), stats(), sampler(nullptr)
+{
+  if (not isPowerOfTwo(lineSize) || not isPowerOfTwo(nSets) ||
+      nSets * ways * lineSize != size)
+    throw std::runtime_error("cache: invalid geometry, the number of sets and line size must be powers of two.");
+
+  while ((1UL << lineBits) < lineSize)
+    ++lineBits;
+
+  tags.assign(nSets * nWays, ~0UL);
+  lastUse.assign(nSets * nWays, 0);
+
+  if (sampling > 1)
+    sampler = std::make_unique<SetSampler>(nSets, sampling, stats.size());
+}
+
+Cache::~Cache()
+{
+  std::cerr << std::dec << std::endl
+            << "Cache Statistics:" << std::endl
+            << "# geometry: " << (nSets * nWays * lineSize / 1024) << " KiB, "
+            << nWays << "-way, " << lineSize << " byte lines" << std::endl;
+  if (sampler)
+    std::cerr << "# sampled sets: " << sampler->getSets().size() << " of "
+              << nSets << ", statistics cover these" << std::endl;
+
+  const char *names[] = { "data", "page table" };
+  for (size_t i = 0; i < stats.size(); ++i)
+    {
+      const CacheStatistics &s = stats[i];
+      std::cerr << "# " << names[i] << " accesses: " << s.accesses
+                << ", misses: " << s.misses
+                << " (compulsory: " << s.compulsory
+                << ", capacity: " << s.capacity
+                << ", conflict: " << s.conflict << ")" << std::endl;
+
+      if (sampler)
+        {
+          const SetSampler::Estimate e = sampler->estimate(i);
+          std::cerr << "# " << names[i] << " miss rate: "
+                    << std::fixed << std::setprecision(3)
+                    << 100. * e.missRate << "% +- " << 100. * e.error
+                    << "% (estimated from " << e.sampled << " of "
+                    << e.accesses << " accesses)" << std::endl;
+          std::cerr.unsetf(std::ios_base::floatfield);
+          std::cerr << std::setprecision(6);
+        }
+    }
+}
+
+/* Access the fully associative shadow cache; returns true on a hit. */
+bool
+Cache::accessShadow(const uint64_t line)
+{
+  auto it = shadowMap.find(line);
+  if (it != shadowMap.end())
+    {
+      shadowOrder.splice(shadowOrder.begin(), shadowOrder, it->second);
+      return true;
+    }
+
+  const uint64_t nSampledLines =
+    (sampler ? sampler->getSets().size() : nSets) * nWays;
+  if (shadowOrder.size() == nSampledLines)
+    {
+      shadowMap.erase(shadowOrder.back());
+      shadowOrder.pop_back();
+    }
+  shadowOrder.push_front(line);
+  shadowMap[line] = shadowOrder.begin();
+
+  return false;
+}
+
+/* Mark line as referenced; returns true on its first reference. */
+bool
+Cache::markSeen(const uint64_t line)
+{
+  uint64_t &chunk = seen[line >> 6];
+  const uint64_t bit = 1UL << (line & 63);
+  if (chunk & bit)
+    return false;
+
+  chunk |= bit;
+  return true;
+}
+
+bool
+Cache::access(const uint64_t pAddr, const CacheAccess kind)
+{
+  const size_t k = static_cast<size_t>(kind);
+  CacheStatistics &s = stats[k];
+  const uint64_t line = pAddr >> lineBits;
+  const uint64_t set = line & (nSets - 1);
+  const uint64_t base = set * nWays;
+
+  if (sampler && not sampler->isSampled(set))
+    {
+      sampler->skip(k);
+      return false;
+    }
+
+  ++s.accesses;
+  ++clock;
+
+  const bool shadowHit = accessShadow(line);
+
+  size_t victim = base;
+  for (size_t i = base; i < base + nWays; ++i)
+    {
+      if (tags[i] == line)
+        {
+          lastUse[i] = clock;
+          if (sampler)
+            sampler->record(set, k, false);
+          return true;
+        }
+      if (lastUse[i] < lastUse[victim])
+        victim = i;
+    }
+
+  tags[victim] = line;
+  lastUse[victim] = clock;
+
+  ++s.misses;
+  if (sampler)
+    sampler->record(set, k, true);
+  if (markSeen(line))
+    ++s.compulsory;
+  else if (shadowHit)
+    ++s.conflict;
+  else
+    ++s.capacity;
+
+  return false;
+}
+
+uint64_t
+Cache::getNColours(const uint64_t pageSize) const
+{
+  const uint64_t waySize = nSets * lineSize;
+  return waySize > pageSize ? waySize / pageSize : 1;
+}
+
+const CacheStatistics &
+Cache::getStatistics(const CacheAccess kind) const
+{
+  return stats[static_cast<size_t>(kind)];
+}
+
+const SetSampler *
+Cache::getSampler(void) const
+{
+  return sampler.get();
+}
@@ -0,0 +1,437 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    checker.cc - Differential checking of translations
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "checker.h"
+#include "mmu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+
+/*
+ * ReferenceTLB
+ */
+
+ReferenceTLB::ReferenceTLB(const size_t nEntries, const size_t ways,
+                           const size_t nVictims)
+  : entries(nEntries), victims(nVictims), nWays(ways ? ways : nEntries),
+    clock(0)
+{
+}
+
+ReferenceTLB::Entry *
+ReferenceTLB::begin(const uint64_t vPage)
+{
+  const size_t nSets = entries.size() / nWays;
+  return entries.data() + (vPage % nSets) * nWays;
+}
+
+ReferenceTLB::Entry *
+ReferenceTLB::end(const uint64_t vPage)
+{
+  return begin(vPage) + nWays;
+}
+
+ReferenceTLB::Entry *
+ReferenceTLB::replace(Entry *begin, Entry *end)
+{
+  Entry *victim = nullptr;
+  for (Entry *entry = begin; entry != end; ++entry)
+    if (not entry->valid)
+      return entry;
+    else if (victim == nullptr || entry->lastUse < victim->lastUse)
+      victim = entry;
+
+  return victim;
+}
+
+bool
+ReferenceTLB::lookup(const uint64_t vPage, const uint64_t asid,
+                     const bool isWrite, uint64_t &pPage)
+{
+  for (Entry *entry = begin(vPage); entry != end(vPage); ++entry)
+    if (entry->matches(vPage, asid))
+      {
+        if (isWrite && not entry->dirty)
+          return false;
+
+        entry->lastUse = ++clock;
+        pPage = entry->pPage;
+        return true;
+      }
+
+  for (Entry &entry : victims)
+    if (entry.matches(vPage, asid))
+      {
+        if (isWrite && not entry.dirty)
+          return false;
+
+        pPage = entry.pPage;
+        Entry *slot = replace(begin(vPage), end(vPage));
+        std::swap(*slot, entry);
+        slot->lastUse = ++clock;
+        entry.lastUse = ++clock;
+        return true;
+      }
+
+  return false;
+}
+
+void
+ReferenceTLB::add(const uint64_t vPage, const uint64_t asid,
+                  const uint64_t pPage, const bool dirty, const bool global)
+{
+  for (Entry *entry = begin(vPage); entry != end(vPage); ++entry)
+    if (entry->matches(vPage, asid))
+      {
+        entry->pPage = pPage;
+        entry->dirty = dirty;
+        entry->global = global;
+        return;
+      }
+  for (Entry &entry : victims)
+    if (entry.matches(vPage, asid))
+      {
+        entry.pPage = pPage;
+        entry.dirty = dirty;
+        entry.global = global;
+        return;
+      }
+
+  Entry *victim = replace(begin(vPage), end(vPage));
+  if (victim == nullptr)
+    return;
+
+  if (victim->valid && not victims.empty())
+    {
+      Entry *slot = replace(victims.data(), victims.data() + victims.size());
+      *slot = *victim;
+      slot->lastUse = ++clock;
+    }
+
+  victim->vPage = vPage;
+  victim->pPage = pPage;
+  victim->asid = asid;
+  victim->lastUse = ++clock;
+  victim->valid = true;
+  victim->dirty = dirty;
+  victim->global = global;
+}
+
+void
+ReferenceTLB::invalidate(const uint64_t vPage, const uint64_t asid)
+{
+  for (Entry *entry = begin(vPage); entry != end(vPage); ++entry)
+    if (entry->matches(vPage, asid))
+      {
+        entry->valid = false;
+        return;
+      }
+  for (Entry &entry : victims)
+    if (entry.matches(vPage, asid))
+      {
+        entry.valid = false;
+        return;
+      }
+}
+
+void
+ReferenceTLB::flush(const bool keepGlobal)
+{
+  for (Entry &entry : entries)
+    if (not (keepGlobal && entry.global))
+      entry.valid = false;
+  for (Entry &entry : victims)
+    if (not (keepGlobal && entry.global))
+      entry.valid = false;
+}
+
+void
+ReferenceTLB::dump(const uint64_t vPage, std::ostream &os) const
+{
+  bool found = false;
+  for (size_t i = 0; i < entries.size() + victims.size(); ++i)
+    {
+      const bool isVictim = i >= entries.size();
+      const Entry &entry = isVictim ? victims[i - entries.size()] : entries[i];
+      if (not entry.valid || entry.vPage != vPage)
+        continue;
+
+      os << "#     " << (isVictim ? "victim " : "entry ") << std::dec
+         << (isVictim ? i - entries.size() : i) << ": ASID " << entry.asid
+         << ", physical page " << std::hex << std::showbase << entry.pPage
+         << std::dec << std::noshowbase
+         << (entry.dirty ? ", dirty" : "") << (entry.global ? ", global" : "")
+         << std::endl;
+      found = true;
+    }
+
+  if (not found)
+    os << "#     no entries" << std::endl;
+}
+
+
+/*
+ * TranslationChecker
+ */
+
+TranslationChecker::TranslationChecker(const MMU &mmu, const double rate)
+  : mmu(mmu), period(rate > 0. ? std::max(1L, std::lround(1. / rate)) : 0),
+    lockstep(period == 1), cores(), nAccesses(0), sampled(false),
+    nLookupChecks(0), nWalkChecks(0), nDivergences(0)
+{
+  if (rate <= 0. || rate > 1.)
+    throw std::runtime_error("checker: the sampling rate must be in (0, 1].");
+}
+
+TranslationChecker::~TranslationChecker()
+{
+  std::cerr << std::dec << std::endl
+            << "Translation Check Statistics:" << std::endl
+            << "# checked: 1 in " << period << " translations"
+            << (checksTLB() ? ", TLB in lockstep" :
+                lockstep && mmu.getTLB() != nullptr
+                  ? ", TLB not checked (not set-associative)" : "")
+            << std::endl
+            << "# TLB lookups checked: " << nLookupChecks << std::endl
+            << "# walks checked: " << nWalkChecks << std::endl
+            << "# divergences: " << nDivergences << std::endl;
+}
+
+TranslationChecker::Core &
+TranslationChecker::getCore(void)
+{
+  const unsigned core = mmu.getSelectedCore();
+  if (core >= cores.size())
+    cores.resize(core + 1);
+
+  return cores[core];
+}
+
+/* The reference TLB only models set-associative TLBs. */
+bool
+TranslationChecker::checksTLB(void) const
+{
+  return lockstep && mmu.getTLB() != nullptr &&
+    mmu.getTLB()->getOrganisation() == TLBOrganisation::SetAssociative;
+}
+
+ReferenceTLB *
+TranslationChecker::getReferenceTLB(void)
+{
+  if (not checksTLB())
+    return nullptr;
+
+  Core &core = getCore();
+  if (core.tlb.empty())
+    core.tlb.emplace_back(mmu.getTLB()->getNEntries(), mmu.getTLB()->getNWays(),
+                          mmu.getTLB()->getNVictimEntries());
+
+  return &core.tlb.front();
+}
+
+void
+TranslationChecker::record(const Op op, const uint64_t vPage,
+                           const uint64_t pPage, const uint64_t asid,
+                           const bool flag)
+{
+  Core &core = getCore();
+  core.history[core.nEvents++ % historySize] = Event{ op, vPage, pPage, asid, flag };
+}
+
+void
+TranslationChecker::diverge(const char *what, const MemAccess &access,
+                            const uint64_t vPage, const uint64_t asid,
+                            const bool found, const uint64_t pPage,
+                            const bool refFound, const uint64_t refPPage)
+{
+  if (nDivergences++ > 0)
+    return;
+
+  std::cerr << std::dec << std::endl
+            << "CHECK: first divergence, in " << what << ":" << std::endl
+            << "#   access " << nAccesses << ": " << access
+            << std::hex << std::showbase << " (PC " << mmu.getPC() << ")"
+            << std::endl
+            << "#   core " << std::dec << mmu.getSelectedCore()
+            << ", ASID " << asid
+            << ", virtual page " << std::hex << std::showbase << vPage
+            << std::endl;
+
+  std::cerr << "#   result: ";
+  if (found)
+    std::cerr << "physical page " << pPage << std::endl;
+  else
+    std::cerr << "not found" << std::endl;
+  std::cerr << "#   reference: ";
+  if (refFound)
+    std::cerr << "physical page " << refPPage << std::endl;
+  else
+    std::cerr << "not found" << std::endl;
+
+  uint64_t walkPPage = 0;
+  const bool walkFound = mmu.referenceTranslation(vPage, walkPPage);
+  std::cerr << "#   page table: ";
+  if (walkFound)
+    std::cerr << "physical page " << walkPPage << std::endl;
+  else
+    std::cerr << "not mapped" << std::endl;
+  std::cerr << std::dec << std::noshowbase;
+
+  if (ReferenceTLB *reference = getReferenceTLB())
+    {
+      std::cerr << "#   reference TLB entries for the page:" << std::endl;
+      reference->dump(vPage, std::cerr);
+    }
+
+  static const char *opNames[] = { "lookup", "add", "invalidate", "flush", "set ASID" };
+  const Core &core = getCore();
+  const size_t first = core.nEvents > historySize ? core.nEvents - historySize : 0;
+  if (first < core.nEvents)
+    std::cerr << "#   last TLB operations on this core:" << std::endl;
+  for (size_t i = first; i < core.nEvents; ++i)
+    {
+      const Event &event = core.history[i % historySize];
+      std::cerr << "#     " << opNames[static_cast<int>(event.op)];
+      switch (event.op)
+        {
+          case Op::Lookup:
+            std::cerr << std::hex << std::showbase << " " << event.vPage
+                      << std::dec << std::noshowbase << " ASID " << event.asid
+                      << (event.flag ? ": hit" : ": miss");
+            break;
+
+          case Op::Add:
+            std::cerr << std::hex << std::showbase << " " << event.vPage
+                      << " -> " << event.pPage << std::dec << std::noshowbase
+                      << " ASID " << event.asid
+                      << (event.flag ? ", dirty" : "");
+            break;
+
+          case Op::Invalidate:
+            std::cerr << std::hex << std::showbase << " " << event.vPage
+                      << std::dec << std::noshowbase << " ASID " << event.asid;
+            break;
+
+          case Op::Flush:
+            std::cerr << (event.flag ? " (keep global)" : "");
+            break;
+
+          case Op::SetASID:
+            std::cerr << " " << event.asid;
+            break;
+        }
+      std::cerr << std::endl;
+    }
+}
+
+void
+TranslationChecker::checkLookup(const MemAccess &access, const uint64_t vPage,
+                                const uint64_t asid, const bool isWrite,
+                                const bool hit, const uint64_t pPage)
+{
+  ++nAccesses;
+  sampled = (nAccesses % period == 0);
+  if (lockstep)
+    record(Op::Lookup, vPage, pPage, asid, hit);
+
+  if (ReferenceTLB *reference = getReferenceTLB())
+    {
+      uint64_t refPPage = 0;
+      const bool refHit = reference->lookup(vPage, asid, isWrite, refPPage);
+      ++nLookupChecks;
+      if (hit != refHit || (hit && pPage != refPPage))
+        diverge("TLB lookup", access, vPage, asid, hit, pPage, refHit, refPPage);
+    }
+
+  /* A hit must agree with the page table, or an invalidation was missed. */
+  if (hit && sampled)
+    {
+      uint64_t refPPage = 0;
+      const bool refFound = mmu.referenceTranslation(vPage, refPPage);
+      ++nWalkChecks;
+      if (not refFound || pPage != refPPage)
+        diverge("TLB hit against page table", access, vPage, asid,
+                hit, pPage, refFound, refPPage);
+    }
+}
+
+void
+TranslationChecker::checkWalk(const MemAccess &access, const uint64_t vPage,
+                              const uint64_t asid, const bool found,
+                              const uint64_t pPage)
+{
+  if (not sampled)
+    return;
+
+  uint64_t refPPage = 0;
+  const bool refFound = mmu.referenceTranslation(vPage, refPPage);
+  ++nWalkChecks;
+  if (found != refFound || (found && pPage != refPPage))
+    diverge("page table walk", access, vPage, asid, found, pPage,
+            refFound, refPPage);
+}
+
+void
+TranslationChecker::add(const uint64_t vPage, const uint64_t asid,
+                        const uint64_t pPage, const bool dirty,
+                        const bool global)
+{
+  if (ReferenceTLB *reference = getReferenceTLB())
+    {
+      reference->add(vPage, asid, pPage, dirty, global);
+      record(Op::Add, vPage, pPage, asid, dirty);
+    }
+}
+
+void
+TranslationChecker::invalidate(const uint64_t vPage, const uint64_t asid)
+{
+  if (ReferenceTLB *reference = getReferenceTLB())
+    {
+      reference->invalidate(vPage, asid);
+      record(Op::Invalidate, vPage, 0, asid, false);
+    }
+}
+
+void
+TranslationChecker::flush(const bool keepGlobal)
+{
+  if (ReferenceTLB *reference = getReferenceTLB())
+    {
+      reference->flush(keepGlobal);
+      record(Op::Flush, 0, 0, 0, keepGlobal);
+    }
+}
+
+void
+TranslationChecker::setASID(const uint64_t asid)
+{
+  if (lockstep)
+    record(Op::SetASID, 0, 0, asid, false);
+}
+
+void
+TranslationChecker::reset(void)
+{
+  for (Core &core : cores)
+    core.tlb.clear();
+}
+
+uint64_t
+TranslationChecker::getNChecks(void) const
+{
+  return nLookupChecks + nWalkChecks;
+}
+
+uint64_t
+TranslationChecker::getNDivergences(void) const
+{
+  return nDivergences;
+}
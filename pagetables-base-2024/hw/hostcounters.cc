@@ -0,0 +1,224 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    hostcounters.cc - Host performance counters of the simulator itself
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "hostcounters.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+struct HostEvent
+{
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+};
+
+/* Index 0 is the time, which is not a perf event. */
+static const HostEvent hostEvents[HostCounters::maxEvents] =
+{
+  { "ns", 0, 0 },
+  { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { "dTLB misses", PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) }
+};
+
+static const char *phaseNames[] =
+{
+  "decode", "translate", "fault", "interrupt"
+};
+
+
+HostCounters::HostCounters(const uint32_t period)
+  : period(period), untilSample(period), leader(-1), fds(), eventIndex(),
+    nCounters(0), available(), unavailableReason(), excluded(), nCalls(),
+    nMeasured(), totals()
+{
+  fds.fill(-1);
+  available[0] = true;
+  openCounters();
+}
+
+HostCounters::~HostCounters()
+{
+  std::cerr << std::dec << std::fixed << std::endl
+            << "Host Counters Statistics:" << std::endl
+            << "# sample period: " << period << " accesses" << std::endl;
+
+  if (hasCounters())
+    {
+      std::cerr << "# counters:";
+      for (int e = 1; e < maxEvents; ++e)
+        std::cerr << " " << hostEvents[e].name
+                  << (available[e] ? "" : " (unavailable)")
+                  << (e + 1 < maxEvents ? "," : "");
+      std::cerr << std::endl;
+    }
+  else
+    std::cerr << "# counters: unavailable (" << unavailableReason
+              << "), time only" << std::endl;
+
+  for (int p = 0; p < nPhases; ++p)
+    {
+      if (nCalls[p] == 0)
+        continue;
+
+      const double calls = nCalls[p];
+      std::cerr << "# " << phaseNames[p] << ": " << nCalls[p] << " calls ("
+                << nMeasured[p] << " measured):" << std::setprecision(1);
+      for (int e = 0; e < maxEvents; ++e)
+        {
+          if (not available[e])
+            continue;
+
+          std::cerr << (e ? ", " : " ") << totals[p][e] / calls << " "
+                    << hostEvents[e].name;
+          if (e == 2 && available[1] && totals[p][1] > 0)
+            std::cerr << " (IPC " << std::setprecision(2)
+                      << (double)totals[p][2] / totals[p][1]
+                      << std::setprecision(1) << ")";
+        }
+      std::cerr << " per call" << std::endl;
+    }
+
+  std::cerr.unsetf(std::ios_base::floatfield);
+  std::cerr << std::setprecision(6);
+
+  for (int fd : fds)
+    if (fd >= 0)
+      close(fd);
+}
+
+void
+HostCounters::openCounters(void)
+{
+  for (int e = 1; e < maxEvents; ++e)
+    {
+      struct perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = hostEvents[e].type;
+      attr.config = hostEvents[e].config;
+      attr.disabled = leader < 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+
+      const int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader,
+                             PERF_FLAG_FD_CLOEXEC);
+      if (fd < 0)
+        {
+          if (unavailableReason.empty())
+            unavailableReason = std::strerror(errno);
+          continue;
+        }
+
+      if (leader < 0)
+        leader = fd;
+      fds[e] = fd;
+      eventIndex[nCounters++] = e;
+      available[e] = true;
+    }
+
+  if (leader < 0)
+    {
+      std::cerr << "Host counters: perf_event_open is unavailable ("
+                << unavailableReason << "), measuring time only." << std::endl;
+      return;
+    }
+
+  ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void
+HostCounters::read(std::array<uint64_t, maxEvents> &values) const
+{
+  values[0] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+
+  if (leader < 0)
+    return;
+
+  /* With PERF_FORMAT_GROUP: the number of counters, then their values
+   * in the order these were added to the group.
+   */
+  uint64_t buffer[1 + maxEvents];
+  const ssize_t size = ::read(leader, buffer, sizeof(buffer));
+  if (size < (ssize_t)sizeof(uint64_t))
+    return;
+
+  for (uint64_t i = 0; i < buffer[0] && (int)i < nCounters; ++i)
+    values[eventIndex[i]] = buffer[1 + i];
+}
+
+uint32_t
+HostCounters::getPeriod(void) const
+{
+  return period;
+}
+
+bool
+HostCounters::hasCounters(void) const
+{
+  return leader >= 0;
+}
+
+void
+HostCounters::start(Reading &reading) const
+{
+  reading.values.fill(0);
+  read(reading.values);
+  reading.excluded = excluded;
+}
+
+void
+HostCounters::stop(const HostPhase phase, const Reading &start,
+                   const uint32_t weight)
+{
+  std::array<uint64_t, maxEvents> now{};
+  read(now);
+
+  const int p = static_cast<int>(phase);
+  for (int e = 0; e < maxEvents; ++e)
+    {
+      const uint64_t raw = now[e] - start.values[e];
+      const uint64_t nested = excluded[e] - start.excluded[e];
+      totals[p][e] += (raw > nested ? raw - nested : 0) * weight;
+
+      /* An enclosing phase excludes this one as a whole, including the
+       * phases nested in it, which were added to excluded meanwhile.
+       */
+      excluded[e] = start.excluded[e] + raw;
+    }
+
+  nCalls[p] += weight;
+  ++nMeasured[p];
+}
+
+uint64_t
+HostCounters::getCalls(const HostPhase phase) const
+{
+  return nCalls[static_cast<int>(phase)];
+}
+
+uint64_t
+HostCounters::getTotal(const HostPhase phase, const int event) const
+{
+  return totals[static_cast<int>(phase)][event];
+}
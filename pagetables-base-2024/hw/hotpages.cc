@@ -0,0 +1,316 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    hotpages.cc - Hot page and miss heatmap profiling
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "hotpages.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+
+/*
+ * CountMinSketch
+ */
+
+CountMinSketch::CountMinSketch(const size_t width, const size_t depth)
+  : width(width), depth(depth), counters(width * depth, 0)
+{
+}
+
+size_t
+CountMinSketch::getIndex(const uint64_t key, const size_t row) const
+{
+  /* splitmix64 finalizer, seeded per row */
+  uint64_t z = key + (row + 1) * 0x9e3779b97f4a7c15UL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+  z ^= z >> 31;
+
+  return row * width + z % width;
+}
+
+void
+CountMinSketch::add(const uint64_t key, const uint32_t count)
+{
+  for (size_t row = 0; row < depth; ++row)
+    counters[getIndex(key, row)] += count;
+}
+
+uint64_t
+CountMinSketch::estimate(const uint64_t key) const
+{
+  uint64_t count = ~0UL;
+  for (size_t row = 0; row < depth; ++row)
+    count = std::min<uint64_t>(count, counters[getIndex(key, row)]);
+
+  return count;
+}
+
+void
+CountMinSketch::merge(const CountMinSketch &other)
+{
+  if (other.width != width || other.depth != depth)
+    throw std::runtime_error("cannot merge count-min sketches of different dimensions.");
+
+  for (size_t i = 0; i < counters.size(); ++i)
+    counters[i] += other.counters[i];
+}
+
+
+/*
+ * SpaceSaving
+ */
+
+SpaceSaving::SpaceSaving(const size_t k)
+  : k(k), counters(), index()
+{
+  counters.reserve(k);
+}
+
+void
+SpaceSaving::swapCounters(const size_t a, const size_t b)
+{
+  std::swap(counters[a], counters[b]);
+  index[counters[a].key] = a;
+  index[counters[b].key] = b;
+}
+
+void
+SpaceSaving::siftUp(size_t i)
+{
+  while (i > 0 && counters[i].count < counters[(i - 1) / 2].count)
+    {
+      swapCounters(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+}
+
+void
+SpaceSaving::siftDown(size_t i)
+{
+  for (;;)
+    {
+      size_t smallest = i;
+      for (size_t child = 2 * i + 1; child <= 2 * i + 2; ++child)
+        if (child < counters.size() &&
+            counters[child].count < counters[smallest].count)
+          smallest = child;
+
+      if (smallest == i)
+        return;
+
+      swapCounters(i, smallest);
+      i = smallest;
+    }
+}
+
+/* The counters form a min-heap, such that the smallest one is replaced
+ * in O(log k) rather than found by a scan of all k.
+ */
+void
+SpaceSaving::add(const uint64_t key)
+{
+  auto it = index.find(key);
+  if (it != index.end())
+    {
+      ++counters[it->second].count;
+      siftDown(it->second);
+      return;
+    }
+
+  if (counters.size() < k)
+    {
+      index[key] = counters.size();
+      counters.emplace_back(key, 1, 0);
+      siftUp(counters.size() - 1);
+      return;
+    }
+
+  /* Replace the smallest counter */
+  Counter &smallest = counters.front();
+  index.erase(smallest.key);
+  index[key] = 0;
+  smallest = Counter(key, smallest.count + 1, smallest.count);
+  siftDown(0);
+}
+
+std::vector<SpaceSaving::Counter>
+SpaceSaving::getTop(void) const
+{
+  std::vector<Counter> top(counters);
+  std::sort(top.begin(), top.end(),
+            [](const Counter &a, const Counter &b)
+              { return a.count > b.count || (a.count == b.count && a.key < b.key); });
+  return top;
+}
+
+
+/*
+ * HotPages
+ */
+
+HotPages::HotPages(const size_t k)
+  : k(k), clock(0), interval(firstInterval), nEventsTotal{},
+    pageCounts(nEvents, CountMinSketch(sketchWidth, sketchDepth)),
+    topPages(), topRegions(heatmapRows), heatmap()
+{
+  if (k == 0)
+    throw std::runtime_error("HotPages: the number of hot pages must be positive.");
+}
+
+HotPages::~HotPages()
+{
+  report(std::cerr);
+}
+
+uint64_t
+HotPages::makeKey(const uint64_t asid, const uint64_t value)
+{
+  return (asid << 48) | (value & ((1UL << 48) - 1));
+}
+
+void
+HotPages::record(const PageEvent event, const uint64_t asid,
+                 const uint64_t vAddr, const uint8_t pageBits)
+{
+  const int e = static_cast<int>(event);
+  const uint64_t vPage = (vAddr & ((1UL << 48) - 1)) >> pageBits;
+
+  ++nEventsTotal[e];
+  pageCounts[e].add(makeKey(asid, vPage));
+  topPages[e].emplace(asid, k).first->second.add(vPage);
+
+  if (event != PageEvent::TLBMiss)
+    return;
+
+  /* Merge pairs of intervals until the current one fits. */
+  while (clock / interval >= maxIntervals)
+    {
+      for (size_t i = 0; i < heatmap.size(); i += 2)
+        {
+          if (i + 1 < heatmap.size())
+            heatmap[i].merge(heatmap[i + 1]);
+          heatmap[i / 2] = heatmap[i];
+        }
+      heatmap.resize((heatmap.size() + 1) / 2, CountMinSketch(heatmapWidth, sketchDepth));
+      interval *= 2;
+    }
+
+  const size_t column = clock / interval;
+  if (column >= heatmap.size())
+    heatmap.resize(column + 1, CountMinSketch(heatmapWidth, sketchDepth));
+
+  const uint64_t region = makeKey(asid, (vAddr & ((1UL << 48) - 1)) >> regionBits);
+  heatmap[column].add(region);
+  topRegions.add(region);
+}
+
+uint64_t
+HotPages::estimate(const PageEvent event, const uint64_t asid,
+                   const uint64_t vAddr, const uint8_t pageBits) const
+{
+  const uint64_t vPage = (vAddr & ((1UL << 48) - 1)) >> pageBits;
+  return pageCounts[static_cast<int>(event)].estimate(makeKey(asid, vPage));
+}
+
+std::vector<SpaceSaving::Counter>
+HotPages::getTop(const PageEvent event, const uint64_t asid) const
+{
+  const auto &summaries = topPages[static_cast<int>(event)];
+  auto it = summaries.find(asid);
+  if (it == summaries.end())
+    return {};
+
+  return it->second.getTop();
+}
+
+void
+HotPages::printHeatmap(std::ostream &os) const
+{
+  static const char shades[] = " .:-=+*#%@";
+  const int nShades = sizeof(shades) - 1;
+
+  std::vector<SpaceSaving::Counter> regions = topRegions.getTop();
+  std::sort(regions.begin(), regions.end(),
+            [](const SpaceSaving::Counter &a, const SpaceSaving::Counter &b)
+              { return a.key < b.key; });
+
+  std::vector<std::vector<uint64_t>> cells;
+  uint64_t maxCount = 0;
+  for (const auto &region : regions)
+    {
+      cells.emplace_back();
+      for (const CountMinSketch &column : heatmap)
+        {
+          /* Bounded by the total count of the region */
+          const uint64_t count = std::min(column.estimate(region.key),
+                                          region.count);
+          cells.back().push_back(count);
+          maxCount = std::max(maxCount, count);
+        }
+    }
+
+  os << "# TLB miss heatmap (" << (1UL << (regionBits - 20)) << " MiB regions, "
+     << interval << " accesses per column, " << shades[1] << " to "
+     << shades[nShades - 1] << ": 1 to " << maxCount << " misses):" << std::endl;
+  for (size_t i = 0; i < regions.size(); ++i)
+    {
+      os << "#   ASID " << std::setw(3) << (regions[i].key >> 48) << " "
+         << std::hex << std::setw(12) << std::setfill('0')
+         << ((regions[i].key & ((1UL << 48) - 1)) << regionBits)
+         << std::dec << std::setfill(' ') << " |";
+      for (const uint64_t count : cells[i])
+        {
+          int shade = 0;
+          if (count > 0)
+            shade = 1 + (count * (nShades - 1) - 1) / maxCount;
+          os << shades[std::min(shade, nShades - 1)];
+        }
+      os << "|" << std::endl;
+    }
+}
+
+void
+HotPages::report(std::ostream &os) const
+{
+  static const char *eventNames[nEvents] = { "TLB misses", "walks", "faults" };
+
+  os << std::dec << std::endl
+     << "Hot Page Statistics:" << std::endl;
+  for (int e = 0; e < nEvents; ++e)
+    {
+      os << "# " << eventNames[e] << ": " << nEventsTotal[e] << std::endl;
+      for (const auto &kv : topPages[e])
+        {
+          os << "#   ASID " << kv.first << ", top " << k
+             << " (vpage:count, ~ if approximate):";
+          /* Both the summary and the sketch overestimate. */
+          std::vector<SpaceSaving::Counter> top = kv.second.getTop();
+          for (auto &counter : top)
+            counter.count =
+              std::min(counter.count,
+                       pageCounts[e].estimate(makeKey(kv.first, counter.key)));
+          std::stable_sort(top.begin(), top.end(),
+                           [](const SpaceSaving::Counter &a,
+                              const SpaceSaving::Counter &b)
+                             { return a.count > b.count; });
+
+          for (const auto &counter : top)
+            {
+              os << " " << std::hex << std::showbase << counter.key
+                 << std::dec << std::noshowbase << ":" << counter.count;
+              if (counter.error > 0)
+                os << "~";
+            }
+          os << std::endl;
+        }
+    }
+
+  if (not heatmap.empty())
+    printHeatmap(os);
+}
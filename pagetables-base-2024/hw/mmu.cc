@@ -8,131 +8,414 @@
 #include "mmu.h"
 #include "settings.h"
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
-#include <list>
-#include <unordered_map>
 
-TLB::TLB(const size_t nEntries, const MMU &mmu)
-  : nEntries(nEntries), mmu(mmu), nLookups(0), nHits(0), nEvictions(0), nFlush(0), nFlushEvictions(0), currentASID(0)
+const char *pageSizeNames[nPageSizes] = { "16 KiB", "32 MiB", "64 GiB" };
+
+static bool
+isPowerOfTwo(const uint64_t value)
 {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+/* Hash functions of the ways of a skewed TLB, one per seed */
+static inline uint64_t
+skewHash(uint64_t x, const uint64_t seed)
+{
+  x += (seed + 1) * 0x9e3779b97f4a7c15UL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+  return x ^ (x >> 31);
+}
+
+TLB::TLB(const size_t nEntries, const MMU &mmu, const size_t ways,
+         const uint32_t sampling, const size_t victimEntries,
+         const TLBOrganisation organisation)
+  : nEntries(nEntries), nWays(ways ? ways : nEntries),
+    nSets(nWays ? nEntries / nWays : 0), organisation(organisation),
+    nBlockWays(std::max<size_t>(1, nWays / 4)), mmu(mmu), nLookups(0),
+    nHits(0), nEvictions(0), nFlush(0), nFlushEvictions(0), nGlobalHits(0),
+    nVictimHits(0), nSizeHits(), nSizeEntries(), nUtilisationSamples(0),
+    currentASID(0), tlbEntries(nEntries), lastUse(nEntries, 0), clock(0),
+    victims(), victimLastUse(), nASIDEntries(), sampler(nullptr)
+{
+  if (not isPowerOfTwo(nSets) || nSets * nWays != nEntries)
+    throw std::runtime_error("TLB: invalid geometry, the number of sets must be a power of two.");
+  if (organisation != TLBOrganisation::SetAssociative && nWays < nPageSizes)
+    throw std::runtime_error("TLB: a split or skewed TLB needs at least three ways.");
+
+  /* Only the evictions of the sampled sets reach the victim TLB, so it
+   * is scaled down alike.
+   */
+  size_t nVictims = victimEntries;
+  if (sampling > 1 && organisation == TLBOrganisation::SetAssociative)
+    {
+      sampler = std::make_unique<SetSampler>(nSets, sampling);
+      if (nVictims > 0)
+        nVictims = std::max<size_t>(1, nVictims / sampling);
+    }
+
+  victims.resize(nVictims);
+  victimLastUse.resize(nVictims, 0);
 }
 
 TLB::~TLB()
 {
 }
 
-struct TLBEntry
+TLBOrganisation
+TLB::parseOrganisation(const std::string &name)
 {
-  uint64_t vPage;
-  uint64_t pPage;
-  uint64_t asid;
-  bool valid;
-  
-  TLBEntry() : vPage(0), pPage(0), asid(0), valid(false) {}
-  TLBEntry(uint64_t vp, uint64_t pp, uint64_t as) : vPage(vp), pPage(pp), asid(as), valid(true) {}
-};
+  if (name.empty() || name == "set")
+    return TLBOrganisation::SetAssociative;
+  if (name == "split")
+    return TLBOrganisation::Split;
+  if (name == "skewed")
+    return TLBOrganisation::Skewed;
+
+  throw std::runtime_error("TLB: unknown organisation: " + name);
+}
+
+void
+TLB::getRotation(const uint64_t vPage, size_t &r1, size_t &r2) const
+{
+  r1 = r2 = 0;
+  if (organisation != TLBOrganisation::Skewed)
+    return;
+
+  r2 = skewHash(vPage >> pageSizeShifts[2], nWays) % nWays;
+  r1 = skewHash(vPage >> pageSizeShifts[1], nWays + 1) % (nWays - nBlockWays);
+}
 
-static std::vector<TLBEntry> tlbEntries;
-static std::list<size_t> lruOrder;
-static std::unordered_map<uint64_t, std::list<size_t>::iterator> lruMap;
-static bool tlbInitialized = false;
-static uint64_t currentASID = 0;
+/* Starting at way r2, nBlockWays ways hold the largest page size; of the
+ * other ways, nBlockWays starting at the r1-th hold the middle size. As
+ * r2 only depends on the bits above the largest page size and r1 on those
+ * above the middle size, every page of a block finds its entry in the
+ * same ways.
+ */
+unsigned
+TLB::getWaySize(const size_t way, const size_t r1, const size_t r2) const
+{
+  const size_t d = (way + nWays - r2) % nWays;
+  if (d < nBlockWays)
+    return 2;
+
+  const size_t rest = nWays - nBlockWays;
+  return (d - nBlockWays + rest - r1) % rest < nBlockWays ? 1 : 0;
+}
+
+size_t
+TLB::getSlot(const size_t way, const uint64_t vPage, const unsigned size) const
+{
+  const uint64_t tag = vPage >> pageSizeShifts[size];
+  const uint64_t set = organisation == TLBOrganisation::Skewed
+      ? skewHash(tag * nPageSizes + size, way) : tag;
+
+  return (set & (nSets - 1)) * nWays + way;
+}
+
+size_t
+TLB::findEntry(const uint64_t vPage, const uint64_t asid) const
+{
+  if (organisation == TLBOrganisation::SetAssociative) {
+    const size_t base = getSetBase(vPage);
+    for (size_t i = base; i < base + nWays; ++i)
+      if (tlbEntries[i].matches(vPage, asid))
+        return i;
+
+    return nEntries;
+  }
+
+  size_t r1, r2;
+  getRotation(vPage, r1, r2);
+  for (size_t way = 0; way < nWays; ++way) {
+    const size_t i = getSlot(way, vPage, getWaySize(way, r1, r2));
+    if (tlbEntries[i].matches(vPage, asid))
+      return i;
+  }
+
+  return nEntries;
+}
+
+size_t
+TLB::findReplacement(const uint64_t vPage, const unsigned size,
+                     bool &evict) const
+{
+  // First try to find an empty slot, otherwise replace the LRU entry
+  size_t replaceIndex = nEntries;
+  auto consider = [&](const size_t i)
+    {
+      if (!tlbEntries[i].valid)
+        return true;
+      if (replaceIndex == nEntries || lastUse[i] < lastUse[replaceIndex])
+        replaceIndex = i;
+      return false;
+    };
+
+  evict = false;
+  if (organisation == TLBOrganisation::SetAssociative) {
+    const size_t base = getSetBase(vPage);
+    for (size_t i = base; i < base + nWays; ++i)
+      if (consider(i))
+        return i;
+  }
+  else {
+    size_t r1, r2;
+    getRotation(vPage, r1, r2);
+    for (size_t way = 0; way < nWays; ++way) {
+      if (getWaySize(way, r1, r2) != size)
+        continue;
+
+      const size_t i = getSlot(way, vPage, size);
+      if (consider(i))
+        return i;
+    }
+  }
+
+  evict = true;
+  return replaceIndex;
+}
 
 bool
-TLB::lookup(const uint64_t vPage, uint64_t &pPage)
+TLB::lookup(const uint64_t vPage, uint64_t &pPage, bool isWrite, bool *global,
+            unsigned *size)
 {
+  const size_t base = sampler ? getSetBase(vPage) : 0;
+  if (sampler && not sampler->isSampled(base / nWays))
+    {
+      sampler->skip(0);
+      return false;
+    }
+
   nLookups++;
-  
-  if (!tlbInitialized) {
-    tlbEntries.resize(nEntries);
-    tlbInitialized = true;
-    return false;
-  }
-  
-  for (size_t i = 0; i < nEntries; ++i) {
-    if (tlbEntries[i].valid && tlbEntries[i].vPage == vPage && 
-        tlbEntries[i].asid == currentASID) {
-      pPage = tlbEntries[i].pPage;
+  if (nLookups % utilisationPeriod == 0)
+    sampleUtilisation();
+
+  bool hit = false;
+  const size_t i = findEntry(vPage, currentASID);
+  if (i < nEntries) {
+    const TLBEntry &entry = tlbEntries[i];
+    if (!isWrite || entry.dirty) {
+      pPage = entry.pPage + (vPage - entry.vPage);
       nHits++;
-      
-      // Update LRU: move to front
-      auto it = lruMap.find(i);
-      if (it != lruMap.end()) {
-        lruOrder.erase(it->second);
-      }
-      lruOrder.push_front(i);
-      lruMap[i] = lruOrder.begin();
-      
-      return true;
+      nSizeHits[entry.size]++;
+      if (entry.global)
+        nGlobalHits++;
+      if (global)
+        *global = entry.global;
+      if (size)
+        *size = entry.size;
+
+      lastUse[i] = ++clock;
+      hit = true;
     }
   }
-  
-  return false;
+  else if (not victims.empty())
+    hit = lookupVictim(vPage, pPage, isWrite, global, size);
+
+  if (sampler)
+    sampler->record(base / nWays, 0, not hit);
+
+  return hit;
+}
+
+bool
+TLB::lookupVictim(const uint64_t vPage, uint64_t &pPage, bool isWrite,
+                  bool *global, unsigned *size)
+{
+  const size_t v = findVictim(vPage, currentASID);
+  if (v == victims.size() || (isWrite && !victims[v].dirty))
+    return false;
+
+  const TLBEntry &entry = victims[v];
+  pPage = entry.pPage + (vPage - entry.vPage);
+  nVictimHits++;
+  if (entry.global)
+    nGlobalHits++;
+  if (global)
+    *global = entry.global;
+  if (size)
+    *size = entry.size;
+
+  // Swap with a free or else the LRU entry that may hold the entry
+  bool evict;
+  const size_t slot = findReplacement(entry.vPage, entry.size, evict);
+  std::swap(tlbEntries[slot], victims[v]);
+  lastUse[slot] = ++clock;
+  victimLastUse[v] = ++clock;
+  return true;
+}
+
+size_t
+TLB::findVictim(const uint64_t vPage, const uint64_t asid) const
+{
+  for (size_t v = 0; v < victims.size(); ++v)
+    if (victims[v].matches(vPage, asid))
+      return v;
+
+  return victims.size();
 }
 
 void
-TLB::add(const uint64_t vPage, const uint64_t pPage)
+TLB::addVictim(const TLBEntry &entry)
 {
-  if (!tlbInitialized) {
-    tlbEntries.resize(nEntries);
-    tlbInitialized = true;
-  }
-  
-  size_t replaceIndex = 0;
-  bool foundEmpty = false;
-  
-  // First try to find an empty slot
-  for (size_t i = 0; i < nEntries; ++i) {
-    if (!tlbEntries[i].valid) {
-      replaceIndex = i;
-      foundEmpty = true;
+  size_t v = 0;
+  for (size_t i = 0; i < victims.size(); ++i) {
+    if (!victims[i].valid) {
+      v = i;
       break;
     }
+    if (victimLastUse[i] < victimLastUse[v])
+      v = i;
   }
-  
-  // If no empty slot, use LRU replacement
-  if (!foundEmpty) {
-    if (!lruOrder.empty()) {
-      replaceIndex = lruOrder.back();
-      lruOrder.pop_back();
-      lruMap.erase(replaceIndex);
-    }
+
+  countEntry(victims[v], -1);
+  victims[v] = entry;
+  countEntry(victims[v], 1);
+  victimLastUse[v] = ++clock;
+}
+
+void
+TLB::add(const uint64_t vPage, const uint64_t pPage, bool dirty, bool global,
+         unsigned size)
+{
+  if (sampler && not sampler->isSampled(getSetBase(vPage) / nWays))
+    return;
+
+  /* A set-associative TLB holds the pages of a block separately. */
+  const uint8_t shift = organisation == TLBOrganisation::SetAssociative
+      ? 0 : pageSizeShifts[size];
+  const uint64_t offset = vPage & ((1UL << shift) - 1);
+  const TLBEntry entry(vPage - offset, pPage - offset, currentASID, dirty,
+                       global, size, shift);
+
+  // Update the entry in place if the page is already present with the
+  // same page size
+  auto update = [&](TLBEntry &present)
+    {
+      countEntry(present, -1);
+      if (present.size != size) {
+        present.valid = false;
+        return false;
+      }
+      present.pPage = entry.pPage;
+      present.dirty = dirty;
+      present.global = global;
+      countEntry(present, 1);
+      return true;
+    };
+
+  const size_t i = findEntry(vPage, currentASID);
+  if (i < nEntries && update(tlbEntries[i]))
+    return;
+
+  const size_t v = findVictim(vPage, currentASID);
+  if (v < victims.size() && update(victims[v]))
+    return;
+
+  bool evict;
+  const size_t replaceIndex = findReplacement(entry.vPage, size, evict);
+  if (evict) {
     nEvictions++;
+    if (not victims.empty())
+      addVictim(tlbEntries[replaceIndex]);
   }
-  
-  // Add new entry
-  tlbEntries[replaceIndex] = TLBEntry(vPage, pPage, currentASID);
-  
-  // Update LRU: add to front
-  lruOrder.push_front(replaceIndex);
-  lruMap[replaceIndex] = lruOrder.begin();
+
+  countEntry(tlbEntries[replaceIndex], -1);
+  tlbEntries[replaceIndex] = entry;
+  countEntry(entry, 1);
+  lastUse[replaceIndex] = ++clock;
 }
 
 void
-TLB::flush(void)
+TLB::flush(bool keepGlobal)
 {
   nFlush++;
-  
-  if (!tlbInitialized) {
-    return;
-  }
-  
-  // Count valid entries before flush for statistics
-  int validCount = 0;
-  for (size_t i = 0; i < nEntries; ++i) {
-    if (tlbEntries[i].valid) {
-      validCount++;
+  nASIDEntries.clear();
+
+  // Clear all (non-global) entries, counting these for statistics
+  auto flushSet = [&](const size_t base)
+    {
+      for (size_t i = base; i < base + nWays; ++i) {
+        if (tlbEntries[i].valid && !(keepGlobal && tlbEntries[i].global)) {
+          tlbEntries[i].valid = false;
+          nFlushEvictions++;
+        }
+      }
+    };
+
+  if (sampler)
+    for (uint64_t set : sampler->getSets())
+      flushSet(set * nWays);
+  else
+    for (size_t set = 0; set < nSets; ++set)
+      flushSet(set * nWays);
+
+  for (TLBEntry &entry : victims) {
+    if (entry.valid && !(keepGlobal && entry.global)) {
+      entry.valid = false;
+      nFlushEvictions++;
     }
   }
-  nFlushEvictions += validCount;
-  
-  // Clear all entries
-  for (size_t i = 0; i < nEntries; ++i) {
+}
+
+void
+TLB::invalidate(const uint64_t vPage)
+{
+  invalidate(vPage, currentASID);
+}
+
+void
+TLB::invalidate(const uint64_t vPage, const uint64_t asid)
+{
+  const size_t i = findEntry(vPage, asid);
+  if (i < nEntries) {
+    countEntry(tlbEntries[i], -1);
     tlbEntries[i].valid = false;
+    return;
   }
-  
-  lruOrder.clear();
-  lruMap.clear();
+
+  const size_t v = findVictim(vPage, asid);
+  if (v < victims.size()) {
+    countEntry(victims[v], -1);
+    victims[v].valid = false;
+  }
+}
+
+void
+TLB::countEntry(const TLBEntry &entry, const int delta)
+{
+  if (!entry.valid || entry.global)
+    return;
+
+  size_t &count = nASIDEntries[entry.asid];
+  count += delta;
+  if (count == 0)
+    nASIDEntries.erase(entry.asid);
+}
+
+size_t
+TLB::countEntries(const uint64_t asid) const
+{
+  auto it = nASIDEntries.find(asid);
+  return it == nASIDEntries.end() ? 0 : it->second;
+}
+
+void
+TLB::sampleUtilisation(void)
+{
+  ++nUtilisationSamples;
+  for (const TLBEntry &entry : tlbEntries)
+    if (entry.valid)
+      ++nSizeEntries[entry.size];
+}
+
+void
+TLB::setASID(const uint64_t asid)
+{
+  currentASID = asid;
 }
 
 void
@@ -144,11 +427,17 @@ TLB::clear(void)
   nEvictions = 0;
   nFlush = 0;
   nFlushEvictions = 0;
+  nGlobalHits = 0;
+  nVictimHits = 0;
+  std::fill_n(nSizeHits, nPageSizes, 0);
+  std::fill_n(nSizeEntries, nPageSizes, 0);
+  nUtilisationSamples = 0;
 }
 
 void
-TLB::getStatistics(int &nLookups, int &nHits, int &nEvictions,
-                   int &nFlush, int &nFlushEvictions) const
+TLB::getStatistics(uint64_t &nLookups, uint64_t &nHits,
+                   uint64_t &nEvictions, uint64_t &nFlush,
+                   uint64_t &nFlushEvictions) const
 {
   nLookups = this->nLookups;
   nHits = this->nHits;
@@ -157,24 +446,167 @@ TLB::getStatistics(int &nLookups, int &nHits, int &nEvictions,
   nFlushEvictions = this->nFlushEvictions;
 }
 
+uint64_t
+TLB::getNGlobalHits(void) const
+{
+  return nGlobalHits;
+}
+
+size_t
+TLB::getNEntries(void) const
+{
+  return nEntries;
+}
+
+size_t
+TLB::getNWays(void) const
+{
+  return nWays;
+}
+
+TLBOrganisation
+TLB::getOrganisation(void) const
+{
+  return organisation;
+}
+
+uint64_t
+TLB::getNVictimHits(void) const
+{
+  return nVictimHits;
+}
+
+size_t
+TLB::getNVictimEntries(void) const
+{
+  return victims.size();
+}
+
+uint64_t
+TLB::getNSizeHits(const unsigned size) const
+{
+  return nSizeHits[size];
+}
+
+double
+TLB::getMeanSizeEntries(const unsigned size) const
+{
+  return nUtilisationSamples ? (double)nSizeEntries[size] / nUtilisationSamples : 0.;
+}
+
+size_t
+TLB::getSplitEntries(const unsigned size) const
+{
+  if (nWays < nPageSizes)
+    return size == 0 ? nEntries : 0;
+
+  return (size == 0 ? nWays - 2 * nBlockWays : nBlockWays) * nSets;
+}
+
+void
+TLB::reportPageSizes(const std::vector<const TLB *> &tlbs, const char *prefix,
+                     std::ostream &os)
+{
+  const TLB &first = *tlbs.front();
+  for (unsigned size = 0; size < nPageSizes; ++size)
+    {
+      uint64_t hits = 0;
+      double entries = 0.;
+      for (const TLB *tlb : tlbs)
+        {
+          hits += tlb->getNSizeHits(size);
+          entries += tlb->getMeanSizeEntries(size) / tlbs.size();
+        }
+
+      const bool split = first.organisation == TLBOrganisation::Split;
+      const size_t capacity = split ? first.getSplitEntries(size) : first.nEntries;
+      os << prefix << pageSizeNames[size] << ": " << hits << " hits, "
+         << std::fixed << std::setprecision(1) << entries
+         << " entries in use of " << capacity << " ("
+         << (capacity ? 100. * entries / capacity : 0.) << "%)";
+      if (not split)
+        os << ", split TLB: " << first.getSplitEntries(size);
+      os << std::endl;
+    }
+
+  os.unsetf(std::ios_base::floatfield);
+  os << std::setprecision(6);
+}
+
+const SetSampler *
+TLB::getSampler(void) const
+{
+  return sampler.get();
+}
+
 MMU::MMU()
-  : root(0x0), pageFaultHandler(), tlb(nullptr), currentASID(0)
+  : root(0x0), pageFaultHandler(), tlb(nullptr), cache(nullptr),
+    hotPages(nullptr), pcProfile(nullptr), checker(nullptr),
+    hostCounters(nullptr), observers(nullptr), currentPC(0),
+    currentASID(0), walkGlobal(false), walkSize(0), dirtyTracking(true),
+    cores(1), selectedCore(0)
 {
+  if (CacheSize > 0)
+    cache = std::make_unique<Cache>(CacheSize << 10, CacheAssoc,
+                                    CacheLineSize, SetSampling);
+  if (HotPagesTop > 0)
+    hotPages = std::make_unique<HotPages>(HotPagesTop);
+  if (not PCProfileFile.empty())
+    pcProfile = std::make_unique<PCProfile>(PCProfileFile);
+  if (CheckRate > 0.)
+    checker = std::make_unique<TranslationChecker>(*this, CheckRate);
+  if (not ObserverTLBs.empty())
+    observers = std::make_unique<TLBObservers>(*this, ObserverTLBs,
+                                               SetSampling);
 }
 
 MMU::~MMU()
 {
-  int nLookups{}, nHits{}, nEvictions{}, nFlush{}, nFlushEvictions{};
-  getTLBStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+  /* Statistics are summed over the TLBs of all cores. */
+  uint64_t nLookups{}, nHits{}, nEvictions{}, nFlush{}, nFlushEvictions{};
+  uint64_t nGlobalHits{}, nVictimHits{}, nBlockHits{};
+  std::vector<const TLB *> tlbs;
+  for (unsigned core = 0; core < getNCores(); ++core)
+    {
+      selectCore(core);
+
+      uint64_t lookups{}, hits{}, evictions{}, flush{}, flushEvictions{};
+      getTLBStatistics(lookups, hits, evictions, flush, flushEvictions);
+      nLookups += lookups;
+      nHits += hits;
+      nEvictions += evictions;
+      nFlush += flush;
+      nFlushEvictions += flushEvictions;
+      if (tlb)
+        {
+          nGlobalHits += tlb->getNGlobalHits();
+          nVictimHits += tlb->getNVictimHits();
+          for (unsigned size = 1; size < nPageSizes; ++size)
+            nBlockHits += tlb->getNSizeHits(size);
+          tlbs.push_back(tlb.get());
+        }
+    }
 
   std::cerr << std::dec << std::endl
-            << "TLB Statistics (since last reset):" << std::endl
-            << "# lookups: " << nLookups << std::endl
+            << "TLB Statistics (since last reset):" << std::endl;
+  if (getNCores() > 1)
+    std::cerr << "# cores: " << getNCores() << std::endl;
+  std::cerr << "# lookups: " << nLookups << std::endl
             << "# hits: " << nHits
-            << " (" << (((float)nHits/nLookups)*100.) << "%)" << std::endl
+            << " (" << (((float)nHits/nLookups)*100.) << "%)" << std::endl;
+  if (tlb && tlb->getNVictimEntries() > 0)
+    std::cerr << "# victim TLB hits: " << nVictimHits
+              << " (" << (((float)nVictimHits/nLookups)*100.) << "%)" << std::endl;
+  std::cerr
             << "# line evictions: " << nEvictions << std::endl
             << "# flushes: " << nFlush << std::endl
             << "# line evictions due to flush: " << nFlushEvictions << std::endl;
+  if (nGlobalHits > 0)
+    std::cerr << "# hits on global entries: " << nGlobalHits << std::endl;
+  if (not tlbs.empty() &&
+      (nBlockHits > 0 ||
+       tlbs.front()->getOrganisation() != TLBOrganisation::SetAssociative))
+    TLB::reportPageSizes(tlbs, "# ", std::cerr);
 }
 
 void
@@ -198,16 +630,30 @@ MMU::processMemAccess(const MemAccess &access)
   if (LogMemoryAccesses)
     std::cerr << "MMU: memory access: " << access << std::endl;
 
+  if (hotPages)
+    hotPages->tick();
+
   uint64_t pAddr = 0x0;
   while (not getTranslation(access, pAddr))
     {
-      pageFaultHandler(access.addr);
+      if (hostCounters)
+        {
+          HostCounters::Reading reading;
+          hostCounters->start(reading);
+          pageFaultHandler(access.addr);
+          hostCounters->stop(HostPhase::Fault, reading);
+        }
+      else
+        pageFaultHandler(access.addr);
     }
 
   if (LogMemoryAccesses)
     std::cerr << "MMU: translated virtual "
         << std::hex << std::showbase << access.addr
         << " to physical " << pAddr << std::endl;
+
+  if (cache)
+    cache->access(pAddr, CacheAccess::Data);
 }
 
 uint64_t
@@ -229,19 +675,50 @@ MMU::getTranslation(const MemAccess &access, uint64_t &pAddr)
   uint64_t pPage = 0;
   bool isWrite = (access.type == MemAccessType::Store ||
                   access.type == MemAccessType::Modify);
+  const bool needDirty = isWrite && dirtyTracking;
 
   // Check TLB first if available
-  if (tlb && tlb->lookup(vPage, pPage)) {
+  bool hitGlobal = false;
+  unsigned hitSize = 0;
+  const bool hit = tlb && tlb->lookup(vPage, pPage, needDirty, &hitGlobal,
+                                      &hitSize);
+  if (checker)
+    checker->checkLookup(access, vPage, currentASID, needDirty, hit, pPage);
+  if (hit) {
+    if (observers)
+      observers->translate(vPage, needDirty, true, pPage, hitGlobal,
+                           hitSize);
     pAddr = makePhysicalAddr(access, pPage);
     return true;
   }
   
   // TLB miss - perform page table walk
-  if (performTranslation(vPage, pPage, isWrite))
+  if (hotPages && tlb)
+    hotPages->record(PageEvent::TLBMiss, currentASID, vAddr, getPageBits());
+  const bool isData = access.type != MemAccessType::Instr;
+  if (pcProfile && tlb && isData)
+    pcProfile->record(PageEvent::TLBMiss, currentASID, currentPC);
+
+  walkGlobal = false;
+  walkSize = 0;
+  const bool found = performTranslation(vPage, pPage, isWrite);
+  if (checker)
+    checker->checkWalk(access, vPage, currentASID, found, pPage);
+  if (observers)
+    observers->translate(vPage, needDirty, found, pPage, walkGlobal,
+                         walkSize);
+  if (found)
     {
+      if (hotPages)
+        hotPages->record(PageEvent::Walk, currentASID, vAddr, getPageBits());
+      if (pcProfile && isData)
+        pcProfile->record(PageEvent::Walk, currentASID, currentPC);
+
       // Add to TLB if available
       if (tlb) {
-        tlb->add(vPage, pPage);
+        tlb->add(vPage, pPage, isWrite, walkGlobal, walkSize);
+        if (checker)
+          checker->add(vPage, currentASID, pPage, isWrite, walkGlobal);
       }
       
       pAddr = makePhysicalAddr(access, pPage);
@@ -255,26 +732,186 @@ void
 MMU::setTLB(std::unique_ptr<TLB> tlb_ptr)
 {
   tlb = std::move(tlb_ptr);
+  if (checker)
+    checker->reset();
+}
+
+TLB *
+MMU::getTLB(void) const
+{
+  return tlb.get();
 }
 
 void
 MMU::setCurrentASID(uint64_t asid)
 {
   currentASID = asid;
-  ::currentASID = asid;
+  if (observers)
+    observers->setASID(asid);
+  if (tlb) {
+    tlb->setASID(asid);
+    if (checker)
+      checker->setASID(asid);
+  }
+}
+
+void
+MMU::flushTLB(bool keepGlobal)
+{
+  if (observers)
+    observers->flush(keepGlobal);
+  if (tlb) {
+    tlb->flush(keepGlobal);
+    if (checker)
+      checker->flush(keepGlobal);
+  }
 }
 
 void
-MMU::flushTLB(void)
+MMU::invalidateTLB(const uint64_t vAddr)
 {
+  const uint64_t vPage =
+    (vAddr & ((1UL << getAddressSpaceBits()) - 1)) >> getPageBits();
+  if (observers)
+    observers->invalidate(vPage, currentASID);
   if (tlb) {
-    tlb->flush();
+    tlb->invalidate(vPage);
+    if (checker)
+      checker->invalidate(vPage, currentASID);
   }
 }
 
 void
-MMU::getTLBStatistics(int &nLookups, int &nHits, int &nEvictions,
-                      int &nFlush, int &nFlushEvictions)
+MMU::invalidateTLB(const uint64_t vAddr, const uint64_t asid)
+{
+  const uint64_t vPage =
+    (vAddr & ((1UL << getAddressSpaceBits()) - 1)) >> getPageBits();
+  if (observers)
+    observers->invalidate(vPage, asid);
+  if (tlb) {
+    tlb->invalidate(vPage, asid);
+    if (checker)
+      checker->invalidate(vPage, asid);
+  }
+}
+
+void
+MMU::setDirtyTracking(const bool enable)
+{
+  dirtyTracking = enable;
+}
+
+size_t
+MMU::getTLBFootprint(const uint64_t asid) const
+{
+  return tlb ? tlb->countEntries(asid) : 0;
+}
+
+void
+MMU::setNCores(const unsigned nCores)
+{
+  while (cores.size() < nCores)
+    {
+      CoreState state;
+      if (tlb)
+        {
+          state.tlb = std::make_unique<TLB>(tlb->getNEntries(), *this,
+                                            tlb->getNWays(), 1,
+                                            tlb->getNVictimEntries(),
+                                            tlb->getOrganisation());
+          state.tlb->setASID(0);
+        }
+      cores.push_back(std::move(state));
+    }
+
+  if (observers)
+    observers->setNCores(nCores);
+}
+
+unsigned
+MMU::getNCores(void) const
+{
+  return cores.size();
+}
+
+void
+MMU::selectCore(const unsigned core)
+{
+  if (core >= cores.size())
+    throw std::runtime_error("MMU: no such core.");
+  if (core == selectedCore)
+    return;
+
+  CoreState &current = cores[selectedCore];
+  current.root = root;
+  current.asid = currentASID;
+  current.tlb = std::move(tlb);
+
+  CoreState &next = cores[core];
+  root = next.root;
+  currentASID = next.asid;
+  tlb = std::move(next.tlb);
+  selectedCore = core;
+}
+
+unsigned
+MMU::getSelectedCore(void) const
+{
+  return selectedCore;
+}
+
+void
+MMU::setCache(std::unique_ptr<Cache> cache_ptr)
+{
+  cache = std::move(cache_ptr);
+}
+
+Cache *
+MMU::getCache(void) const
+{
+  return cache.get();
+}
+
+HotPages *
+MMU::getHotPages(void) const
+{
+  return hotPages.get();
+}
+
+uint64_t
+MMU::getPC(void) const
+{
+  return currentPC;
+}
+
+PCProfile *
+MMU::getPCProfile(void) const
+{
+  return pcProfile.get();
+}
+
+TranslationChecker *
+MMU::getChecker(void) const
+{
+  return checker.get();
+}
+
+TLBObservers *
+MMU::getObservers(void) const
+{
+  return observers.get();
+}
+
+void
+MMU::setHostCounters(HostCounters *counters)
+{
+  hostCounters = counters;
+}
+
+void
+MMU::getTLBStatistics(uint64_t &nLookups, uint64_t &nHits,
+                      uint64_t &nEvictions, uint64_t &nFlush,
+                      uint64_t &nFlushEvictions)
 {
   if (tlb) {
     tlb->getStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
@@ -286,3 +923,21 @@ MMU::getTLBStatistics(int &nLookups, int &nHits, int &nEvictions,
     nFlushEvictions = 0;
   }
 }
+
+void
+MMU::getTotalTLBStatistics(uint64_t &nLookups, uint64_t &nHits) const
+{
+  nLookups = 0;
+  nHits = 0;
+  for (unsigned core = 0; core < cores.size(); ++core)
+    {
+      const TLB *coreTLB = core == selectedCore ? tlb.get() : cores[core].tlb.get();
+      if (not coreTLB)
+        continue;
+
+      uint64_t lookups{}, hits{}, evictions{}, flush{}, flushEvictions{};
+      coreTLB->getStatistics(lookups, hits, evictions, flush, flushEvictions);
+      nLookups += lookups;
+      nHits += hits + coreTLB->getNVictimHits();
+    }
+}
@@ -0,0 +1,78 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    pcprofile.cc - Attribution of translation overhead to instructions
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "pcprofile.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+
+PCProfile::PCProfile(const std::string &filename)
+  : filename(filename), file(filename), counts(), nEventsTotal{}
+{
+  if (not file)
+    throw std::runtime_error("Could not open PC profile file " + filename);
+}
+
+PCProfile::~PCProfile()
+{
+  write(file);
+
+  std::cerr << std::dec << std::endl
+            << "PC Profile Statistics:" << std::endl
+            << "# data TLB misses: " << nEventsTotal[0] << std::endl
+            << "# data walks: " << nEventsTotal[1] << std::endl
+            << "# page faults: " << nEventsTotal[2] << std::endl
+            << "# instructions attributed: " << counts.size() << std::endl
+            << "# folded stacks written to: " << filename << std::endl;
+}
+
+uint64_t
+PCProfile::makeKey(const uint64_t asid, const uint64_t pc)
+{
+  /* Virtual addresses use at most 48 bits. */
+  return (asid << 48) | (pc & ((1UL << 48) - 1));
+}
+
+uint64_t
+PCProfile::getCount(const PageEvent event, const uint64_t asid,
+                    const uint64_t pc) const
+{
+  auto it = counts.find(makeKey(asid, pc));
+  if (it == counts.end())
+    return 0;
+
+  return it->second[static_cast<int>(event)];
+}
+
+void
+PCProfile::write(std::ostream &os) const
+{
+  static const char *eventNames[nEvents] = { "tlb_miss", "walk", "fault" };
+
+  /* Sorted, such that profiles of different runs can be compared. */
+  std::vector<uint64_t> keys;
+  keys.reserve(counts.size());
+  for (const auto &kv : counts)
+    keys.push_back(kv.first);
+  std::sort(keys.begin(), keys.end());
+
+  for (int e = 0; e < nEvents; ++e)
+    for (const uint64_t key : keys)
+      {
+        const uint64_t count = counts.at(key)[e];
+        if (count == 0)
+          continue;
+
+        os << eventNames[e] << ";ASID " << std::dec << (key >> 48) << ";"
+           << std::hex << std::showbase << (key & ((1UL << 48) - 1))
+           << std::dec << std::noshowbase << " " << count << "\n";
+      }
+  os.flush();
+}
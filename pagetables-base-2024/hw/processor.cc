@@ -6,24 +6,68 @@
  */
 
 #include "processor.h"
+#include "settings.h"
 
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 Processor::Processor(MMU &mmu)
-  : mmu(mmu), current(nullptr), interruptHandler(nullptr), timerInterval(0)
-{ }
+  : mmu(mmu), cores(1, Core{ nullptr, 0, 0 }), currentCore(0),
+    interruptHandler(nullptr), nAccesses(0), hostCounters(nullptr)
+{
+  if (HostCountersPeriod > 0)
+    {
+      hostCounters = std::make_unique<HostCounters>(HostCountersPeriod);
+      mmu.setHostCounters(hostCounters.get());
+    }
+}
+
+Processor::~Processor()
+{
+  if (hostCounters)
+    mmu.setHostCounters(nullptr);
+}
 
 
+void
+Processor::setNCores(const unsigned nCores)
+{
+  while (cores.size() < nCores)
+    cores.push_back(Core{ nullptr, cores[0].timerInterval, 0 });
+
+  mmu.setNCores(nCores);
+}
+
+unsigned
+Processor::getNCores(void) const noexcept
+{
+  return cores.size();
+}
+
+void
+Processor::selectCore(const unsigned core)
+{
+  mmu.selectCore(core);
+  currentCore = core;
+}
+
+unsigned
+Processor::getCurrentCore(void) const noexcept
+{
+  return currentCore;
+}
+
 void
 Processor::setProcess(std::shared_ptr<Process> process) noexcept
 {
-  current = process;
+  cores[currentCore].process = process;
 }
 
 void
 Processor::setTimerInterval(const int interval) noexcept
 {
-  this->timerInterval = interval;
+  cores[currentCore].timerInterval = interval;
 }
 
 void
@@ -35,39 +79,130 @@ Processor::setInterruptHandler(InterruptHandler handler) noexcept
 void
 Processor::run(void)
 {
-  if (timerInterval == 0)
-    throw std::runtime_error("no timer interval (time quantum) configured by OS kernel.");
+  for (const Core &core : cores)
+    if (core.timerInterval == 0)
+      throw std::runtime_error("no timer interval (time quantum) configured by OS kernel.");
 
-  if (!current)
-    /* No current process is active, so generate timer interrupt.
-     * (Note that the Exit syscall interrupt can never be triggered in
-     * case no process is active.)
-     */
-    interruptHandler(InterruptRequest::Timer);
+  /* No current process is active, so generate timer interrupt.
+   * (Note that the Exit syscall interrupt can never be triggered in
+   * case no process is active.)
+   */
+  for (unsigned i = 0; i < cores.size(); ++i)
+    if (!cores[i].process)
+      {
+        selectCore(i);
+        interrupt(InterruptRequest::Timer);
+      }
 
-  while (current)
+  auto active = [this]()
     {
-      int accesses = 0;
+      for (const Core &core : cores)
+        if (core.process)
+          return true;
+      return false;
+    };
 
-      /* We continue to process this trace until we have reached the end or
-       * have reached the timer interval for the timer controller.  Since we do
-       * not count instructions or time, we approximate the time passed by
-       * counting the number of performed memory references.
-       */
-      while (not current->finished() && accesses < timerInterval)
+  while (active())
+    {
+      int longest = 0;
+
+      for (unsigned i = 0; i < cores.size(); ++i)
         {
-          MemAccess access;
+          if (!cores[i].process)
+            continue;
+
+          selectCore(i);
+          Core &core = cores[i];
+          int accesses = 0;
+
+          /* We continue to process this trace until we have reached the end or
+           * have reached the timer interval for the timer controller.  Since we do
+           * not count instructions or time, we approximate the time passed by
+           * counting the number of performed memory references.
+           */
+          while (not core.process->finished() && accesses < core.timerInterval)
+            {
+              if (hostCounters && hostCounters->sample())
+                measuredAccess(core);
+              else
+                {
+                  MemAccess access;
 
-          current->getMemoryAccess(access);
-          mmu.processMemAccess(access);
-          ++accesses;
+                  core.process->getMemoryAccess(access);
+                  mmu.setPC(core.process->getPC());
+                  mmu.processMemAccess(access);
+                }
+              ++accesses;
+            }
+
+          core.nAccesses += accesses;
+          longest = std::max(longest, accesses);
         }
 
-      /* Generate interrupt. */
-      if (current->finished())
-        /* Process is finished and "has called exit" to request termination */
-        interruptHandler(InterruptRequest::SyscallExit);
-      else
-        interruptHandler(InterruptRequest::Timer);
+      nAccesses += longest;
+
+      /* Generate interrupts, on idle cores as well such that these can
+       * pick up work.
+       */
+      for (unsigned i = 0; i < cores.size(); ++i)
+        {
+          selectCore(i);
+          if (cores[i].process && cores[i].process->finished())
+            /* Process is finished and "has called exit" to request termination */
+            interrupt(InterruptRequest::SyscallExit);
+          else
+            interrupt(InterruptRequest::Timer);
+        }
     }
 }
+
+void
+Processor::measuredAccess(Core &core)
+{
+  const uint32_t weight = hostCounters->getPeriod();
+  HostCounters::Reading decode, translate;
+  MemAccess access;
+
+  hostCounters->start(decode);
+  core.process->getMemoryAccess(access);
+  hostCounters->stop(HostPhase::Decode, decode, weight);
+
+  /* Page faults are measured by the MMU, and excluded here. */
+  hostCounters->start(translate);
+  mmu.setPC(core.process->getPC());
+  mmu.processMemAccess(access);
+  hostCounters->stop(HostPhase::Translate, translate, weight);
+}
+
+void
+Processor::interrupt(const InterruptRequest request)
+{
+  if (not hostCounters)
+    {
+      interruptHandler(request);
+      return;
+    }
+
+  HostCounters::Reading reading;
+  hostCounters->start(reading);
+  interruptHandler(request);
+  hostCounters->stop(HostPhase::Interrupt, reading);
+}
+
+uint64_t
+Processor::getNAccesses(void) const noexcept
+{
+  return nAccesses;
+}
+
+uint64_t
+Processor::getCoreAccesses(void) const noexcept
+{
+  return cores[currentCore].nAccesses;
+}
+
+HostCounters *
+Processor::getHostCounters(void) const noexcept
+{
+  return hostCounters.get();
+}
@@ -0,0 +1,93 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    setsampler.cc - Set sampling of set-associative models
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "setsampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+
+SetSampler::SetSampler(const uint64_t nSets, const uint32_t ratio,
+                       const uint32_t nClasses)
+  : nClasses(nClasses), slots(nSets, unsampled), sets(), accesses(),
+    misses(), nSkipped(nClasses, 0)
+{
+  if (ratio == 0)
+    throw std::runtime_error("set sampling: the ratio must be at least 1.");
+
+  /* A fixed seed, such that runs are comparable. Sets are drawn at random
+   * rather than by stride, which could alias with page colours.
+   */
+  std::vector<uint64_t> order(nSets);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937_64 random(0x5e75a3b1e5UL);
+  for (uint64_t i = nSets - 1; i > 0; --i)
+    std::swap(order[i], order[random() % (i + 1)]);
+
+  const uint64_t nSampled = std::max<uint64_t>(1, nSets / ratio);
+  sets.assign(order.begin(), order.begin() + nSampled);
+  std::sort(sets.begin(), sets.end());
+  for (uint64_t i = 0; i < sets.size(); ++i)
+    slots[sets[i]] = i;
+
+  accesses.assign(nSampled * nClasses, 0);
+  misses.assign(nSampled * nClasses, 0);
+}
+
+const std::vector<uint64_t> &
+SetSampler::getSets(void) const
+{
+  return sets;
+}
+
+uint64_t
+SetSampler::getNSets(void) const
+{
+  return slots.size();
+}
+
+SetSampler::Estimate
+SetSampler::estimate(const uint32_t cls) const
+{
+  const uint64_t n = sets.size();
+  const double nSets = slots.size();
+  uint64_t sampled = 0, sampledMisses = 0;
+  for (uint64_t i = 0; i < n; ++i)
+    {
+      sampled += accesses[i * nClasses + cls];
+      sampledMisses += misses[i * nClasses + cls];
+    }
+
+  Estimate e{ sampled + nSkipped[cls], sampled, 0., 0., 0. };
+  e.misses = sampledMisses * nSets / n;
+  if (e.accesses == 0)
+    return e;
+
+  e.missRate = std::min(1., e.misses / e.accesses);
+  if (n < 2 || n == slots.size())
+    return e;
+
+  /* Variance of the expansion estimator of the total under sampling of
+   * sets without replacement.
+   */
+  const double mean = (double)sampledMisses / n;
+  double sum = 0.;
+  for (uint64_t i = 0; i < n; ++i)
+    {
+      const double d = misses[i * nClasses + cls] - mean;
+      sum += d * d;
+    }
+
+  const double f = n / nSets;
+  const double variance = nSets * nSets * (1. - f) * sum / (n - 1) / n;
+  e.error = 1.96 * std::sqrt(variance) / e.accesses;
+
+  return e;
+}
@@ -0,0 +1,216 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tlbobservers.cc - TLB models observing the translations of the MMU
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "tlbobservers.h"
+#include "mmu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+
+TLBObservers::TLBObservers(const MMU &mmu, const std::vector<std::string> &specs,
+                           const uint32_t sampling)
+  : mmu(mmu), sampling(sampling), observers()
+{
+  for (const std::string &spec : specs)
+    {
+      size_t end = 0;
+      unsigned long nEntries = 0, nWays = 0, nVictims = 0;
+      std::string organisation;
+      try
+        {
+          nEntries = std::stoul(spec, &end);
+          if (end < spec.size() && spec[end] == ':')
+            {
+              size_t pos = end + 1;
+              nWays = std::stoul(spec.substr(pos), &end);
+              end += pos;
+            }
+          if (end < spec.size() && spec[end] == ':')
+            {
+              size_t pos = end + 1;
+              end = std::min(spec.find('+', pos), spec.size());
+              organisation = spec.substr(pos, end - pos);
+              TLB::parseOrganisation(organisation);
+            }
+          if (end < spec.size() && spec[end] == '+')
+            {
+              size_t pos = end + 1;
+              nVictims = std::stoul(spec.substr(pos), &end);
+              end += pos;
+            }
+        }
+      catch (std::exception &)
+        {
+          end = 0;
+        }
+      if (end != spec.size() || nEntries == 0)
+        throw std::runtime_error("Invalid TLB observer: " + spec);
+
+      Observer observer{ spec, nEntries, nWays, nVictims, organisation, {} };
+      observers.push_back(std::move(observer));
+    }
+
+  setNCores(mmu.getNCores());
+}
+
+TLBObservers::~TLBObservers()
+{
+  std::cerr << std::dec << std::endl
+            << "TLB Observer Statistics:" << std::endl;
+  for (size_t i = 0; i < observers.size(); ++i)
+    {
+      uint64_t nLookups{}, nHits{}, nEvictions{}, nFlush{}, nFlushEvictions{};
+      getStatistics(i, nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+
+      const Observer &observer = observers[i];
+      std::cerr << "# " << observer.nEntries << " entries";
+      if (observer.nWays)
+        std::cerr << ", " << observer.nWays << "-way";
+      if (not observer.organisation.empty())
+        std::cerr << ", " << observer.organisation;
+      if (observer.nVictims)
+        std::cerr << ", " << observer.nVictims << " victims";
+      std::cerr << ": " << nHits << " hits of " << nLookups << " lookups ("
+                << std::fixed << std::setprecision(2)
+                << (nLookups ? 100. * nHits / nLookups : 0.) << "%), "
+                << nEvictions << " line evictions, "
+                << nFlushEvictions << " due to flush" << std::endl;
+
+      if (observer.nVictims)
+        {
+          uint64_t nVictimHits = 0;
+          for (const auto &tlb : observer.cores)
+            nVictimHits += tlb->getNVictimHits();
+          std::cerr << "#   victim TLB hits: " << nVictimHits << " ("
+                    << (nLookups ? 100. * nVictimHits / nLookups : 0.)
+                    << "%)" << std::endl;
+        }
+
+      /* Utilisation per page size, if the observer holds blocks */
+      std::vector<const TLB *> tlbs;
+      uint64_t nBlockHits = 0;
+      for (const auto &tlb : observer.cores)
+        {
+          tlbs.push_back(tlb.get());
+          for (unsigned size = 1; size < nPageSizes; ++size)
+            nBlockHits += tlb->getNSizeHits(size);
+        }
+      if (nBlockHits > 0 ||
+          tlbs.front()->getOrganisation() != TLBOrganisation::SetAssociative)
+        TLB::reportPageSizes(tlbs, "#   ", std::cerr);
+
+      /* Hit rate of all sets, estimated from those of every core. */
+      if (observer.cores.front()->getSampler())
+        {
+          double misses = 0., variance = 0.;
+          uint64_t nAccesses = 0;
+          for (const auto &tlb : observer.cores)
+            {
+              const SetSampler::Estimate e = tlb->getSampler()->estimate(0);
+              misses += e.misses;
+              variance += (e.error * e.accesses) * (e.error * e.accesses);
+              nAccesses += e.accesses;
+            }
+
+          const double rate = nAccesses ? 1. - misses / nAccesses : 0.;
+          const double error = nAccesses ? std::sqrt(variance) / nAccesses : 0.;
+          const SetSampler *sampler = observer.cores.front()->getSampler();
+          std::cerr << "#   sampled " << sampler->getSets().size() << " of "
+                    << sampler->getNSets() << " sets: hit rate "
+                    << 100. * rate << "% +- " << 100. * error << "% of "
+                    << nAccesses << " lookups" << std::endl;
+        }
+    }
+
+  std::cerr.unsetf(std::ios_base::floatfield);
+  std::cerr << std::setprecision(6);
+}
+
+TLB &
+TLBObservers::getTLB(Observer &observer)
+{
+  return *observer.cores[mmu.getSelectedCore()];
+}
+
+void
+TLBObservers::translate(const uint64_t vPage, const bool isWrite,
+                        const bool found, const uint64_t pPage,
+                        const bool global, const unsigned size)
+{
+  for (Observer &observer : observers)
+    {
+      TLB &tlb = getTLB(observer);
+      uint64_t observedPage;
+      if (not tlb.lookup(vPage, observedPage, isWrite) && found)
+        tlb.add(vPage, pPage, isWrite, global, size);
+    }
+}
+
+void
+TLBObservers::invalidate(const uint64_t vPage, const uint64_t asid)
+{
+  for (Observer &observer : observers)
+    getTLB(observer).invalidate(vPage, asid);
+}
+
+void
+TLBObservers::flush(const bool keepGlobal)
+{
+  for (Observer &observer : observers)
+    getTLB(observer).flush(keepGlobal);
+}
+
+void
+TLBObservers::setASID(const uint64_t asid)
+{
+  for (Observer &observer : observers)
+    getTLB(observer).setASID(asid);
+}
+
+void
+TLBObservers::setNCores(const unsigned nCores)
+{
+  for (Observer &observer : observers)
+    {
+      const TLBOrganisation organisation =
+          TLB::parseOrganisation(observer.organisation);
+      while (observer.cores.size() < nCores)
+        observer.cores.push_back(std::make_unique<TLB>(observer.nEntries, mmu,
+                                                       observer.nWays, sampling,
+                                                       observer.nVictims,
+                                                       organisation));
+    }
+}
+
+size_t
+TLBObservers::size(void) const
+{
+  return observers.size();
+}
+
+void
+TLBObservers::getStatistics(const size_t index, uint64_t &nLookups,
+                            uint64_t &nHits, uint64_t &nEvictions,
+                            uint64_t &nFlush,
+                            uint64_t &nFlushEvictions) const
+{
+  nLookups = nHits = nEvictions = nFlush = nFlushEvictions = 0;
+  for (const auto &tlb : observers.at(index).cores)
+    {
+      uint64_t lookups{}, hits{}, evictions{}, flush{}, flushEvictions{};
+      tlb->getStatistics(lookups, hits, evictions, flush, flushEvictions);
+      nLookups += lookups;
+      nHits += hits;
+      nEvictions += evictions;
+      nFlush += flush;
+      nFlushEvictions += flushEvictions;
+    }
+}
@@ -0,0 +1,106 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    cache.h - Physically indexed data cache model
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdint.h>
+
+#include <array>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "setsampler.h"
+
+
+/* Origin of a cache access: a memory access of the running process or a
+ * page table entry read by the MMU during a page table walk.
+ */
+enum class CacheAccess : short
+{
+  Data,
+  PageTable
+};
+
+struct CacheStatistics
+{
+  uint64_t accesses;
+  uint64_t misses;
+  uint64_t compulsory;
+  uint64_t capacity;
+  uint64_t conflict;
+};
+
+
+/* A set-associative, physically indexed cache with LRU replacement. Only
+ * tags are tracked. Misses are classified as compulsory (first reference
+ * to a line), capacity (also missed by a fully associative LRU cache of the
+ * same size) or conflict (only missed due to limited associativity). The
+ * latter is what physical page placement influences: frames of the same
+ * colour compete for the same sets.
+ */
+class Cache
+{
+  protected:
+    const uint64_t lineSize;
+    const uint64_t nWays;
+    const uint64_t nSets;
+
+    uint8_t lineBits;
+
+    /* Tags and last use time per way, stored set by set. */
+    std::vector<uint64_t> tags;
+    std::vector<uint64_t> lastUse;
+    uint64_t clock;
+
+    /* Fully associative LRU shadow cache and the lines ever referenced,
+     * used to classify misses. The latter is a bitmap per 64 consecutive
+     * lines, such that it is bounded by the memory footprint rather than
+     * growing by a hash node per line.
+     */
+    std::list<uint64_t> shadowOrder;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> shadowMap;
+    std::unordered_map<uint64_t, uint64_t> seen;
+
+    std::array<CacheStatistics, 2> stats;
+
+    /* nullptr if every set is simulated */
+    std::unique_ptr<SetSampler> sampler;
+
+    bool      accessShadow(const uint64_t line);
+    bool      markSeen(const uint64_t line);
+
+  public:
+    /* size and lineSize in bytes; the number of sets (size / (ways *
+     * lineSize)) and lineSize must be powers of two. With a sampling ratio
+     * above 1, only a sample of the sets is simulated (see SetSampler);
+     * the statistics then cover the sampled sets.
+     */
+    Cache(const uint64_t size, const uint64_t ways, const uint64_t lineSize,
+          const uint32_t sampling = 1);
+    ~Cache();
+
+    /* Access the line containing pAddr. Returns true on a hit. */
+    bool      access(const uint64_t pAddr, const CacheAccess kind);
+
+    /* The number of page colours: distinct groups of sets that a page of
+     * the given size maps to.
+     */
+    uint64_t  getNColours(const uint64_t pageSize) const;
+
+    const CacheStatistics &getStatistics(const CacheAccess kind) const;
+
+    /* The sampler of the sets, or nullptr if all are simulated. */
+    const SetSampler *getSampler(void) const;
+
+    Cache(const Cache &) = delete;
+    Cache &operator=(const Cache &) = delete;
+};
+
+#endif /* __CACHE_H__ */
@@ -0,0 +1,183 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    checker.h - Differential checking of translations
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __CHECKER_H__
+#define __CHECKER_H__
+
+#include <stdint.h>
+
+#include <array>
+#include <iosfwd>
+#include <vector>
+
+#include "process.h" /* for MemAccess */
+
+class MMU;
+
+
+/* Straightforward set-associative TLB with LRU replacement, with the
+ * semantics of the original TLB: a write through an entry filled by a
+ * read misses, updates of a present page keep its LRU position and global
+ * entries match any ASID. Sets are indexed by the low bits of the virtual
+ * page. Evicted entries move to the victim TLB, if any, which swaps an
+ * entry that hits with the LRU entry of its set. It is kept deliberately
+ * simple, as it is the reference that the TLB of the MMU is checked
+ * against.
+ */
+class ReferenceTLB
+{
+  protected:
+    struct Entry
+    {
+      uint64_t vPage;
+      uint64_t pPage;
+      uint64_t asid;
+      uint64_t lastUse;
+      bool valid;
+      bool dirty;
+      bool global;
+
+      Entry()
+        : vPage(0), pPage(0), asid(0), lastUse(0), valid(false), dirty(false),
+          global(false)
+      { }
+
+      bool matches(const uint64_t vp, const uint64_t as) const
+      {
+        return valid && vPage == vp && (global || asid == as);
+      }
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Entry> victims;
+    size_t nWays;
+    uint64_t clock;
+
+    /* The entries of the set of vPage */
+    Entry    *begin(const uint64_t vPage);
+    Entry    *end(const uint64_t vPage);
+
+    /* A free entry, or else the least recently used one */
+    static Entry *replace(Entry *begin, Entry *end);
+
+  public:
+    /* Fully associative if ways is 0. */
+    ReferenceTLB(const size_t nEntries, const size_t ways = 0,
+                 const size_t nVictims = 0);
+
+    bool      lookup(const uint64_t vPage, const uint64_t asid,
+                     const bool isWrite, uint64_t &pPage);
+    void      add(const uint64_t vPage, const uint64_t asid,
+                  const uint64_t pPage, const bool dirty, const bool global);
+    void      invalidate(const uint64_t vPage, const uint64_t asid);
+    void      flush(const bool keepGlobal);
+
+    /* Print the entries for vPage in any address space. */
+    void      dump(const uint64_t vPage, std::ostream &os) const;
+};
+
+
+/* Checks the translations of the MMU in lockstep against a reference.
+ * On sampled accesses, the result of every TLB hit and page table walk is
+ * compared to a naive walk of the page table (MMU::referenceTranslation).
+ * When every access is checked and the TLB is set-associative, a
+ * ReferenceTLB per core also receives all TLB operations, and its hits
+ * and misses must match those of the TLB. The first divergence is
+ * reported with the access, the results and the recent TLB operations of
+ * the core; later ones are only counted.
+ */
+class TranslationChecker
+{
+  protected:
+    constexpr static size_t historySize = 16;
+
+    enum class Op : short
+    {
+      Lookup,
+      Add,
+      Invalidate,
+      Flush,
+      SetASID
+    };
+
+    struct Event
+    {
+      Op op;
+      uint64_t vPage;
+      uint64_t pPage;
+      uint64_t asid;
+      bool flag;      /* hit, dirty or keepGlobal */
+    };
+
+    struct Core
+    {
+      std::vector<ReferenceTLB> tlb;   /* empty or one */
+      std::array<Event, historySize> history;
+      size_t nEvents;
+
+      Core() : tlb(), history(), nEvents(0) { }
+    };
+
+    const MMU &mmu;
+    const uint64_t period;   /* a walk is checked every period accesses */
+    const bool lockstep;
+    std::vector<Core> cores;
+
+    uint64_t nAccesses;
+    bool sampled;           /* the current access is checked */
+    uint64_t nLookupChecks;
+    uint64_t nWalkChecks;
+    uint64_t nDivergences;
+
+    Core     &getCore(void);
+    bool      checksTLB(void) const;
+    ReferenceTLB *getReferenceTLB(void);
+    void      record(const Op op, const uint64_t vPage, const uint64_t pPage,
+                     const uint64_t asid, const bool flag);
+    void      diverge(const char *what, const MemAccess &access,
+                      const uint64_t vPage, const uint64_t asid,
+                      const bool found, const uint64_t pPage,
+                      const bool refFound, const uint64_t refPPage);
+
+  public:
+    /* Walks are checked for a fraction rate of the accesses; the TLB is
+     * compared in lockstep only if rate is 1 and the TLB is
+     * set-associative.
+     */
+    TranslationChecker(const MMU &mmu, const double rate);
+    ~TranslationChecker();
+
+    /* Called at the start of every translation with the outcome of the
+     * TLB lookup; without a TLB, hit is false.
+     */
+    void      checkLookup(const MemAccess &access, const uint64_t vPage,
+                          const uint64_t asid, const bool isWrite,
+                          const bool hit, const uint64_t pPage);
+
+    /* Called for every page table walk after a TLB miss. */
+    void      checkWalk(const MemAccess &access, const uint64_t vPage,
+                        const uint64_t asid, const bool found,
+                        const uint64_t pPage);
+
+    /* TLB operations on the selected core, mirrored in the reference. */
+    void      add(const uint64_t vPage, const uint64_t asid,
+                  const uint64_t pPage, const bool dirty, const bool global);
+    void      invalidate(const uint64_t vPage, const uint64_t asid);
+    void      flush(const bool keepGlobal);
+    void      setASID(const uint64_t asid);
+
+    /* The TLB was replaced; start with empty references. */
+    void      reset(void);
+
+    uint64_t  getNChecks(void) const;
+    uint64_t  getNDivergences(void) const;
+
+    TranslationChecker(const TranslationChecker &) = delete;
+    TranslationChecker &operator=(const TranslationChecker &) = delete;
+};
+
+#endif /* __CHECKER_H__ */
@@ -0,0 +1,106 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    hostcounters.h - Host performance counters of the simulator itself
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __HOSTCOUNTERS_H__
+#define __HOSTCOUNTERS_H__
+
+#include <stdint.h>
+
+#include <array>
+#include <string>
+
+
+/* Phases of the simulation loop that are measured. */
+enum class HostPhase : int
+{
+  Decode,       /* reading the next access from the trace */
+  Translate,    /* the MMU, without page fault handling */
+  Fault,        /* the page fault handler of the OS kernel */
+  Interrupt,    /* timer and exit interrupts, i.e. scheduling */
+  Count
+};
+
+/* Measures the behaviour of the host while it runs the simulation: the
+ * time, cycles, instructions, last level cache misses and data TLB misses
+ * spent in each phase. The hardware counters are read with
+ * perf_event_open, in user mode only, as a single group. Where these are
+ * unavailable, as is common in containers and virtual machines, only the
+ * time is measured.
+ *
+ * Reading the counters costs a system call, so accesses are sampled: one
+ * in period is measured and accounted with weight period. Faults and
+ * interrupts are infrequent and are measured every time. Phases may
+ * nest; a phase is accounted without the phases measured within it.
+ */
+class HostCounters
+{
+  public:
+    constexpr static int maxEvents = 5;   /* time and four counters */
+
+    struct Reading
+    {
+      std::array<uint64_t, maxEvents> values;
+      std::array<uint64_t, maxEvents> excluded;
+    };
+
+  protected:
+    constexpr static int nPhases = static_cast<int>(HostPhase::Count);
+
+    const uint32_t period;
+    uint32_t untilSample;
+
+    int leader;                            /* group fd, -1 if unavailable */
+    std::array<int, maxEvents> fds;
+    std::array<int, maxEvents> eventIndex;  /* per group member */
+    int nCounters;                         /* in the group */
+    std::array<bool, maxEvents> available;
+    std::string unavailableReason;
+
+    /* Counts of nested phases since the start, see stop(). */
+    std::array<uint64_t, maxEvents> excluded;
+
+    std::array<uint64_t, nPhases> nCalls;
+    std::array<uint64_t, nPhases> nMeasured;
+    std::array<std::array<uint64_t, maxEvents>, nPhases> totals;
+
+    void      openCounters(void);
+    void      read(std::array<uint64_t, maxEvents> &values) const;
+
+  public:
+    HostCounters(const uint32_t period);
+    ~HostCounters();
+
+    /* Whether the next access is to be measured. */
+    inline bool sample(void)
+    {
+      if (--untilSample > 0)
+        return false;
+
+      untilSample = period;
+      return true;
+    }
+
+    uint32_t  getPeriod(void) const;
+
+    /* Whether the hardware counters could be opened. */
+    bool      hasCounters(void) const;
+
+    void      start(Reading &reading) const;
+    void      stop(const HostPhase phase, const Reading &start,
+                   const uint32_t weight = 1);
+
+    /* Estimated calls of phase and counts of event index, 0 being the
+     * time in nanoseconds.
+     */
+    uint64_t  getCalls(const HostPhase phase) const;
+    uint64_t  getTotal(const HostPhase phase, const int event) const;
+
+    HostCounters(const HostCounters &) = delete;
+    HostCounters &operator=(const HostCounters &) = delete;
+};
+
+#endif /* __HOSTCOUNTERS_H__ */
@@ -0,0 +1,154 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    hotpages.h - Hot page and miss heatmap profiling
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __HOTPAGES_H__
+#define __HOTPAGES_H__
+
+#include <stdint.h>
+
+#include <array>
+#include <iosfwd>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+
+/* Events attributed to virtual pages. A walk is a page table walk that
+ * found a valid translation, a fault one that did not.
+ */
+enum class PageEvent : short
+{
+  TLBMiss,
+  Walk,
+  Fault
+};
+
+
+/* Count-min sketch (Cormode and Muthukrishnan): estimates the number of
+ * times a key was added, never underestimating, using depth rows of
+ * width counters.
+ */
+class CountMinSketch
+{
+  protected:
+    size_t width;
+    size_t depth;
+    std::vector<uint32_t> counters;
+
+    size_t    getIndex(const uint64_t key, const size_t row) const;
+
+  public:
+    CountMinSketch(const size_t width, const size_t depth);
+
+    void      add(const uint64_t key, const uint32_t count = 1);
+    uint64_t  estimate(const uint64_t key) const;
+
+    /* Add all counts of other, which must have the same dimensions. */
+    void      merge(const CountMinSketch &other);
+};
+
+
+/* Space-saving top-k (Metwally et al.): keeps k counters; a key that is
+ * not tracked replaces the one with the smallest count, inheriting that
+ * count as its error. Every key with more than n / k occurrences is
+ * tracked.
+ */
+class SpaceSaving
+{
+  public:
+    struct Counter
+    {
+      uint64_t key;
+      uint64_t count;
+      uint64_t error;   /* count overestimates by at most this */
+
+      Counter(uint64_t key, uint64_t count, uint64_t error)
+        : key(key), count(count), error(error)
+      { }
+    };
+
+  protected:
+    const size_t k;
+    std::vector<Counter> counters;  /* binary min-heap on count */
+    std::unordered_map<uint64_t, size_t> index;  /* key -> counter */
+
+    void      swapCounters(const size_t a, const size_t b);
+    void      siftUp(size_t i);
+    void      siftDown(size_t i);
+
+  public:
+    SpaceSaving(const size_t k);
+
+    void      add(const uint64_t key);
+
+    /* Tracked keys by decreasing count. */
+    std::vector<Counter> getTop(void) const;
+};
+
+
+/* Attributes TLB misses, page table walks and page faults to the virtual
+ * pages of every address space (ASID) with bounded memory: per event a
+ * count-min sketch estimates the count of any page and a space-saving
+ * summary per address space tracks the hottest pages.
+ *
+ * The heatmap counts TLB misses per address region (of regionBits) and time
+ * interval (in memory accesses) in a count-min sketch per interval. When
+ * maxIntervals are in use, neighbouring intervals are merged and the
+ * interval length doubles, so it covers the whole run in bounded memory.
+ * The rows shown are the hottest regions.
+ */
+class HotPages
+{
+  protected:
+    constexpr static size_t sketchWidth = 4096;
+    constexpr static size_t sketchDepth = 4;
+    constexpr static size_t heatmapWidth = 1024;
+    constexpr static size_t heatmapRows = 16;
+    constexpr static size_t maxIntervals = 64;
+    constexpr static uint64_t firstInterval = 1024;
+    constexpr static int regionBits = 21;
+    constexpr static int nEvents = 3;
+
+    const size_t k;
+    uint64_t clock;      /* memory accesses */
+    uint64_t interval;
+
+    std::array<uint64_t, nEvents> nEventsTotal;
+    std::vector<CountMinSketch> pageCounts;               /* per event */
+    std::array<std::map<uint64_t, SpaceSaving>, nEvents> topPages;  /* per ASID */
+
+    SpaceSaving topRegions;
+    std::vector<CountMinSketch> heatmap;  /* per interval */
+
+    static uint64_t makeKey(const uint64_t asid, const uint64_t value);
+    void      printHeatmap(std::ostream &os) const;
+
+  public:
+    HotPages(const size_t k);
+    ~HotPages();
+
+    /* To be called for every memory access, advances the clock. */
+    inline void tick(void)
+    {
+      ++clock;
+    }
+
+    void      record(const PageEvent event, const uint64_t asid,
+                     const uint64_t vAddr, const uint8_t pageBits);
+
+    void      report(std::ostream &os) const;
+
+    /* Estimated number of events on the page of vAddr. */
+    uint64_t  estimate(const PageEvent event, const uint64_t asid,
+                       const uint64_t vAddr, const uint8_t pageBits) const;
+
+    /* The hottest pages (virtual page numbers) of an address space. */
+    std::vector<SpaceSaving::Counter> getTop(const PageEvent event,
+                                             const uint64_t asid) const;
+};
+
+#endif /* __HOTPAGES_H__ */
@@ -9,54 +9,257 @@
 #define __MMU_H__
 
 #include <functional>
+#include <list>
 #include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "process.h" /* for MemAccess */
+#include "cache.h"
+#include "hotpages.h"
+#include "pcprofile.h"
+#include "checker.h"
+#include "hostcounters.h"
+#include "setsampler.h"
+#include "tlbobservers.h"
 
 
 using PageFaultFunction = std::function<void(uintptr_t)>;
 
 class MMU;
 
+/* Page sizes a TLB entry may map, as the log2 of the number of pages: a
+ * page and the blocks of levels 2 and 1 of the AArch64 page table with
+ * 16 KiB granule (32 MiB and 64 GiB).
+ */
+constexpr static unsigned nPageSizes = 3;
+constexpr static unsigned pageSizeShifts[nPageSizes] = { 0, 11, 22 };
+extern const char *pageSizeNames[nPageSizes];
+
+struct TLBEntry
+{
+  uint64_t vPage;   /* first page of the mapping */
+  uint64_t pPage;
+  uint64_t asid;
+  bool valid;
+  bool dirty;
+  bool global;  /* matches any ASID */
+  uint8_t size;   /* page size of the mapping */
+  uint8_t shift;  /* pages matched; 0 if the mapping was split into pages */
+  
+  TLBEntry() : vPage(0), pPage(0), asid(0), valid(false), dirty(false), global(false),
+    size(0), shift(0) {}
+  TLBEntry(uint64_t vp, uint64_t pp, uint64_t as, bool d, bool g = false,
+           uint8_t sz = 0, uint8_t sh = 0)
+    : vPage(vp), pPage(pp), asid(as), valid(true), dirty(d), global(g),
+      size(sz), shift(sh) {}
+
+  inline bool matches(const uint64_t vp, const uint64_t as) const
+  {
+    return valid && ((vPage ^ vp) >> shift) == 0 && (global || asid == as);
+  }
+};
+
+/* Ways of a set-associative TLB are indexed by the low bits of the page
+ * number, such that entries for larger page sizes are split into pages.
+ * A split TLB divides the ways among the page sizes, each indexed by the
+ * number of a page of its size. In a skewed-associative TLB, every way is
+ * indexed by its own hash function; which page size a way holds for an
+ * address is a function of the address bits above that page size, so
+ * that the ways a page size occupies rotate over regions of memory.
+ */
+enum class TLBOrganisation : short
+{
+  SetAssociative,
+  Split,
+  Skewed
+};
+
 class TLB
 {
   protected:
-    /* Number of entries in TLB */
+    /* Number of entries in TLB, of ways per set and of sets */
     const size_t nEntries;
+    const size_t nWays;
+    const size_t nSets;
+    const TLBOrganisation organisation;
+
+    /* Ways that hold either block size for an address, in a split or
+     * skewed TLB; pages take the other ways.
+     */
+    const size_t nBlockWays;
 
     /* Reference to MMU; to be filled by initializer list in constructor */
     const MMU &mmu;
 
     /* TLB statistics */
-    int nLookups;
-    int nHits;
-    int nEvictions;
-    int nFlush;
-    int nFlushEvictions;
+    uint64_t nLookups;
+    uint64_t nHits;
+    uint64_t nEvictions;
+    uint64_t nFlush;
+    uint64_t nFlushEvictions;
+    uint64_t nGlobalHits;
+    uint64_t nVictimHits;
+
+    /* Per page size: hits and the valid entries summed over one in
+     * utilisationPeriod lookups.
+     */
+    constexpr static uint64_t utilisationPeriod = 256;
+    uint64_t nSizeHits[nPageSizes];
+    uint64_t nSizeEntries[nPageSizes];
+    uint64_t nUtilisationSamples;
     
     /* Current ASID for TLB entries */
     uint64_t currentASID;
 
+    /* TLB entries, stored set by set, and the time of their last use
+     * for LRU replacement within a set.
+     */
+    std::vector<TLBEntry> tlbEntries;
+    std::vector<uint64_t> lastUse;
+    uint64_t clock;
+
+    /* Optional fully associative victim TLB, filled with the entries
+     * evicted from the sets and probed when a lookup misses in its set.
+     * Empty if disabled.
+     */
+    std::vector<TLBEntry> victims;
+    std::vector<uint64_t> victimLastUse;
+
+    /* Valid, non-global entries per ASID, in the sets and the victim
+     * TLB; kept up to date on every fill and removal.
+     */
+    std::unordered_map<uint64_t, size_t> nASIDEntries;
+
+    /* nullptr if every set is simulated */
+    std::unique_ptr<SetSampler> sampler;
+
+    inline size_t getSetBase(const uint64_t vPage) const
+    {
+      return (vPage & (nSets - 1)) * nWays;
+    }
+
+    /* In a split or skewed TLB, the rotation of the ways that hold each
+     * block size for vPage, the page size a way then holds and the slot
+     * of vPage in a way for a page size.
+     */
+    void   getRotation(const uint64_t vPage, size_t &r1, size_t &r2) const;
+    unsigned getWaySize(const size_t way, const size_t r1,
+                        const size_t r2) const;
+    size_t getSlot(const size_t way, const uint64_t vPage,
+                   const unsigned size) const;
+
+    /* The index of the entry matching vPage, or nEntries if none. */
+    size_t findEntry(const uint64_t vPage, const uint64_t asid) const;
+
+    /* The free or else least recently used entry that may hold the
+     * mapping of vPage of size; sets evict if an entry is replaced.
+     */
+    size_t findReplacement(const uint64_t vPage, const unsigned size,
+                           bool &evict) const;
+
+    void   sampleUtilisation(void);
+
+    /* Count entry, if valid and not global, in nASIDEntries when it
+     * enters the TLB (delta 1) or before it leaves (delta -1).
+     */
+    void   countEntry(const TLBEntry &entry, const int delta);
+
+    size_t findVictim(const uint64_t vPage, const uint64_t asid) const;
+    void   addVictim(const TLBEntry &entry);
+    bool   lookupVictim(const uint64_t vPage, uint64_t &pPage, bool isWrite,
+                        bool *global, unsigned *size);
+
   public:
-    TLB(const size_t nEntries, const MMU &mmu);
+    /* A set-associative TLB of nEntries with ways entries per set, or
+     * fully associative if ways is 0. With a sampling ratio above 1, only
+     * a sample of the sets is simulated (see SetSampler): lookups in the
+     * other sets miss without being counted, so such a TLB is only fit
+     * to observe translations, not to make these. With victimEntries,
+     * entries evicted from the sets move to a victim TLB of that size;
+     * a lookup that hits there swaps the entry with the least recently
+     * used one of its set. A split or skewed TLB needs at least three
+     * ways and is not sampled.
+     */
+    TLB(const size_t nEntries, const MMU &mmu, const size_t ways = 0,
+        const uint32_t sampling = 1, const size_t victimEntries = 0,
+        const TLBOrganisation organisation = TLBOrganisation::SetAssociative);
     ~TLB();
 
-    /* This method should lookup the virtual page number to a physical page number */
-    bool lookup(const uint64_t vPage, uint64_t &pPage);
+    /* The organisation named set (or empty), split or skewed. */
+    static TLBOrganisation parseOrganisation(const std::string &name);
+
+    /* This method should lookup the virtual page number to a physical page
+     * number. A write through an entry that was filled by a read misses, such
+     * that the page table walk can set the dirty bit. On a hit, global is
+     * set to whether the entry is global and size to the page size of its
+     * mapping, if given.
+     */
+    bool lookup(const uint64_t vPage, uint64_t &pPage, bool isWrite = false,
+                bool *global = nullptr, unsigned *size = nullptr);
+
+    /* This method should store a physical page number for a given virtual
+     * page number, or update the entry if the page is already present.
+     * Global entries match regardless of the current ASID. The mapping
+     * of vPage to pPage may be part of a block of a larger page size.
+     */
+    void add(const uint64_t vPage, const uint64_t pPage, bool dirty = false,
+             bool global = false, unsigned size = 0);
+
+    /* This method should invalidate the entry for a single virtual page,
+     * in the current or the given address space.
+     */
+    void invalidate(const uint64_t vPage);
+    void invalidate(const uint64_t vPage, const uint64_t asid);
 
-    /* This method should store a physical page number for a given virtual page number */
-    void add(const uint64_t vPage, const uint64_t pPage);
+    /* Number of valid, non-global entries tagged with asid. */
+    size_t countEntries(const uint64_t asid) const;
+
+    /* This method should flush all TLB entries upon a context switch; with
+     * keepGlobal, global entries are retained.
+     */
+    void flush(bool keepGlobal = false);
 
-    /* This method should flush all TLB entries upon a context switch */
-    void flush(void);
+    /* This method should set the ASID used to tag and match entries */
+    void setASID(const uint64_t asid);
 
     /* This method should clear the entire state of the TLB */
     void clear(void);
 
     /* This method should yield all TLB statistics */
-    void getStatistics(int &nLookups, int &nHits, int &nEvictions,
-                       int &nFlush, int &nFlushEvictions) const;
+    void getStatistics(uint64_t &nLookups, uint64_t &nHits,
+                       uint64_t &nEvictions, uint64_t &nFlush,
+                       uint64_t &nFlushEvictions) const;
+    uint64_t getNGlobalHits(void) const;
+    size_t getNEntries(void) const;
+    size_t getNWays(void) const;
+    TLBOrganisation getOrganisation(void) const;
+
+    /* Hits in the victim TLB, not included in nHits, and its size. */
+    uint64_t getNVictimHits(void) const;
+    size_t getNVictimEntries(void) const;
+
+    /* Hits on mappings of a page size, the mean number of entries these
+     * occupy and the entries a split TLB of this geometry reserves for
+     * that page size.
+     */
+    uint64_t getNSizeHits(const unsigned size) const;
+    double getMeanSizeEntries(const unsigned size) const;
+    size_t getSplitEntries(const unsigned size) const;
+
+    /* Print the hits and utilisation per page size of tlbs, which share
+     * their geometry, prefixing each line with prefix.
+     */
+    static void reportPageSizes(const std::vector<const TLB *> &tlbs,
+                                const char *prefix, std::ostream &os);
+
+    /* The sampler of the sets, or nullptr if all are simulated. */
+    const SetSampler *getSampler(void) const;
+
+    TLB(const TLB &) = delete;
+    TLB &operator=(const TLB &) = delete;
 };
 
 class MMU
@@ -65,8 +268,55 @@ class MMU
     uintptr_t root;
     PageFaultFunction pageFaultHandler;
     std::unique_ptr<TLB> tlb;
+    std::unique_ptr<Cache> cache;  /* nullptr if not modelled */
+    std::unique_ptr<HotPages> hotPages;  /* nullptr if not profiling */
+    std::unique_ptr<PCProfile> pcProfile;  /* nullptr if not profiling */
+    std::unique_ptr<TranslationChecker> checker;  /* nullptr if not checking */
+    HostCounters *hostCounters;  /* of the Processor, nullptr if not measuring */
+    std::unique_ptr<TLBObservers> observers;  /* nullptr if none */
+    uint64_t currentPC;
     uint64_t currentASID;
 
+    /* To be set by performTranslation if the translated page is mapped
+     * globally (i.e. for all address spaces).
+     */
+    bool walkGlobal;
+
+    /* To be set by performTranslation to the page size of the mapping,
+     * if it is a block.
+     */
+    unsigned walkSize;
+
+    /* Whether a store through a TLB entry that was filled by a read
+     * misses, such that the walk sets the dirty bit.
+     */
+    bool dirtyTracking;
+
+    /* Every core has its own TLB, page table pointer and ASID. Those of
+     * the selected core are kept in root, tlb and currentASID, those of
+     * the other cores here.
+     */
+    struct CoreState
+    {
+      uintptr_t root;
+      uint64_t asid;
+      std::unique_ptr<TLB> tlb;
+
+      CoreState() : root(0x0), asid(0), tlb(nullptr) { }
+    };
+
+    std::vector<CoreState> cores;
+    unsigned selectedCore;
+
+    /* To be called by performTranslation for every page table entry that
+     * is read, such that page table lines are accounted in the cache.
+     */
+    inline void tableAccess(const void *entry)
+    {
+      if (cache)
+        cache->access(reinterpret_cast<uintptr_t>(entry), CacheAccess::PageTable);
+    }
+
   public:
     MMU();
     virtual ~MMU();
@@ -80,13 +330,68 @@ class MMU
 
     /* TLB management methods */
     void setTLB(std::unique_ptr<TLB> tlb_ptr);
+    TLB *getTLB(void) const;
     void setCurrentASID(uint64_t asid);
-    void flushTLB(void);
-    
-    /* This method is used to acquire statistics from the TLB implementation */
-    void getTLBStatistics(int &nLookups, int &nHits,
-                          int &nEvictions,
-                          int &nFlush, int &nFlushEvictions);
+    void flushTLB(bool keepGlobal = false);
+    void invalidateTLB(const uint64_t vAddr);
+    void invalidateTLB(const uint64_t vAddr, const uint64_t asid);
+    size_t getTLBFootprint(const uint64_t asid) const;
+
+    /* Dirty bits are tracked by default; a kernel that never reads these
+     * may disable tracking, such that stores hit clean TLB entries.
+     */
+    void setDirtyTracking(const bool enable);
+
+    /* Add cores up to a total of nCores, each with an empty TLB of the
+     * size of the current one. The cache is shared by all cores.
+     */
+    void setNCores(const unsigned nCores);
+    unsigned getNCores(void) const;
+
+    /* Subsequent accesses, TLB operations and page table pointer changes
+     * apply to the given core.
+     */
+    void selectCore(const unsigned core);
+    unsigned getSelectedCore(void) const;
+
+    void setCache(std::unique_ptr<Cache> cache_ptr);
+    Cache *getCache(void) const;
+
+    /* Profile of TLB misses, walks and faults per page, or nullptr. */
+    HotPages *getHotPages(void) const;
+
+    /* Instruction that makes the following accesses, to which these are
+     * attributed in the PC profile (nullptr if not profiling).
+     */
+    inline void setPC(const uint64_t pc)
+    {
+      currentPC = pc;
+    }
+    uint64_t getPC(void) const;
+    PCProfile *getPCProfile(void) const;
+
+    TranslationChecker *getChecker(void) const;
+
+    /* TLB models observing the translations, or nullptr. */
+    TLBObservers *getObservers(void) const;
+
+    /* Page fault handling is measured as a phase of its own. */
+    void setHostCounters(HostCounters *counters);
+
+    MMU(const MMU &) = delete;
+    MMU &operator=(const MMU &) = delete;
+
+    /* This method is used to acquire statistics from the TLB of the
+     * selected core.
+     */
+    void getTLBStatistics(uint64_t &nLookups, uint64_t &nHits,
+                          uint64_t &nEvictions,
+                          uint64_t &nFlush, uint64_t &nFlushEvictions);
+
+    /* Lookups and hits, including those in the victim TLB, summed over
+     * the TLBs of all cores.
+     */
+    void getTotalTLBStatistics(uint64_t &nLookups, uint64_t &nHits) const;
 
     /* These methods should return the architecture's page size / bits. */
     virtual uint8_t getPageBits(void) const = 0;
@@ -102,6 +407,13 @@ class MMU
     virtual bool performTranslation(const uint64_t vPage,
                                     uint64_t &pPage,
                                     bool isWrite) = 0;
+
+    /* Translate like performTranslation, by a plain walk of the page
+     * table that accounts nothing and changes no bits. Used as reference
+     * when checking translations.
+     */
+    virtual bool referenceTranslation(const uint64_t vPage,
+                                      uint64_t &pPage) const = 0;
 };
 
 
@@ -10,17 +10,28 @@
 
 #include "processor.h"
 #include "process.h"
+#include <iosfwd>
 #include <map>
+#include <set>
 #include <vector>
 
 class OSKernel;
 class PhysMemManager;
+class SwapManager;
+class CompressedPool;
+class Compactor;
+class FrameCache;
+class Scheduler;
+class TLBGather;
+class LiveStats;
 
 /* Structure representing a physical page allocated to a process. */
 struct PhysPage
 {
   uint64_t PID;
   uintptr_t addr;   /* physical page address */
+  uintptr_t vAddr;  /* virtual page address this page is mapped at */
+  uint32_t refCount; /* # address spaces mapping this page */
 
   /* To be used by MMUDriver to be able to quickly locate page table
    * entry that corresponds to this physical page.
@@ -60,10 +71,54 @@ class MMUDriver
     virtual void      setPageValid(PhysPage &pPage,
                                    bool setting) = 0;
 
+    /* Get and reset the referenced bit, and get the dirty bit for the
+     * specified physical page. Used for page replacement.
+     */
+    virtual bool      getPageReferenced(const PhysPage &pPage) const = 0;
+    virtual void      setPageReferenced(PhysPage &pPage,
+                                        bool setting) = 0;
+    virtual bool      getPageDirty(const PhysPage &pPage) const = 0;
+
+    /* Move the mapping of the specified physical page to a different
+     * physical page, retaining the other bits in the page table entry.
+     */
+    virtual void      remapPage(PhysPage &pPage,
+                                const uintptr_t newAddr) = 0;
+
     /* Return number of bytes that has been allocated to store
      * page tables.
      */
     virtual uint64_t  getBytesAllocated(void) const = 0;
+
+    /* Shared page tables. Address spaces mapping the same shared region
+     * link a single last-level table, such that its pages are mapped once
+     * for all of them. In a global region, the page table entries are
+     * also marked global, such that the TLB entries match any ASID.
+     * Returns the size of the region mapped by one shareable table, or 0
+     * if the driver does not support sharing.
+     */
+    virtual uint64_t  getSharedTableSpan(void) const;
+
+    /* Link the shared table covering vAddr into the page table of PID,
+     * creating the table if needed. Returns true if the page at vAddr is
+     * mapped as a result.
+     */
+    virtual bool      linkSharedTable(const uint64_t PID,
+                                      const uintptr_t vAddr,
+                                      const bool global);
+
+    /* Release the shared table covering vAddr, once it is no longer
+     * linked by any page table and all its pages have been released.
+     */
+    virtual void      releaseSharedTable(const uintptr_t vAddr);
+
+    /* Print the occupancy of the page table of PID per level: the number
+     * of tables, a histogram of valid entries per table, the regions that
+     * could be mapped by a block and the ratio of unused entries. Drivers
+     * that do not support the analysis print nothing.
+     */
+    virtual void      reportPageTable(const uint64_t PID,
+                                      std::ostream &os) const;
 };
 
 
@@ -76,17 +131,149 @@ class OSKernel
 {
   protected:
     std::unique_ptr<PhysMemManager> manager;
+    std::unique_ptr<CompressedPool> zswap;  /* nullptr if not configured */
+    std::unique_ptr<SwapManager> swap;  /* nullptr if swapping is disabled */
+    std::unique_ptr<Compactor> compactor;  /* nullptr if disabled */
+    std::unique_ptr<FrameCache> frameCache;  /* nullptr if disabled */
     Processor &processor;
     MMUDriver &driver;
-    ProcessList &processList;
-    std::shared_ptr<Process> current;
+    std::unique_ptr<Scheduler> scheduler;
+
+    std::unique_ptr<TLBGather> tlbGather;
+    std::unique_ptr<LiveStats> liveStats;   /* nullptr if not published */
+
+    /* Per core state */
+    struct Core
+    {
+      std::shared_ptr<Process> current;
+      uint64_t sliceStart;  /* core accesses at the last dispatch */
+      uint64_t lastTLBLookups; /* TLB statistics at the last context switch */
+      uint64_t lastTLBHits;
+
+      Core()
+        : current(nullptr), sliceStart(0), lastTLBLookups(0), lastTLBHits(0)
+      { }
+    };
+
+    std::vector<Core> cores;
 
     int nPageFaults;
     int nContextSwitches;
+    int nEvictedPages;
+    int nHighOrderAllocs;
+    int nHighOrderFailures;
+    int nSharedLinks;       /* faults resolved by linking a shared table */
+    int nSharedRefs;        /* references taken on resident shared pages */
+
+    /* Owner of the pages in shared and global regions. These are reference
+     * counted by the address spaces that map them.
+     */
+    const static uint64_t sharedPID = ~0UL;
+
+    /* Accesses between checks of the fragmentation score for proactive
+     * compaction.
+     */
+    const static uint64_t compactionCheckInterval = 100000;
+
+    /* Configured shared ranges, in units of the shared table span. */
+    struct SharedRange
+    {
+      uint64_t start;
+      uint64_t end;
+      bool global;  /* never released, entries match any ASID */
+    };
+
+    /* A region mapped by a single shared table, and the address spaces
+     * that have it linked.
+     */
+    struct SharedRegion
+    {
+      bool global;
+      std::set<uint64_t> users;
+
+      SharedRegion(bool global) : global(global), users() { }
+    };
+
+    uint64_t sharedSpan;
+    std::vector<SharedRange> sharedRanges;
+    std::map<uint64_t, SharedRegion> sharedRegions;
     
     /* Track all physical pages allocated to each process */
     std::map<uint64_t, std::vector<PhysPage>> processPages;
 
+    /* Clock hand for page replacement: PID and index into processPages */
+    uint64_t clockPID;
+    size_t clockIndex;
+
+    /* Per address space (PID) state; threads of a process share the page
+     * table and ASID. Entries are kept after termination for statistics.
+     */
+    struct AddressSpace
+    {
+      uint64_t asid;
+      int nThreads;
+      int nLiveThreads;
+      int nPageFaults;
+      int nSwitches;        /* switches to this address space */
+      int nThreadSwitches;  /* of which between threads, without flush */
+      uint64_t nTLBLookups;
+      uint64_t nTLBHits;
+
+      AddressSpace(uint64_t asid)
+        : asid(asid), nThreads(0), nLiveThreads(0), nPageFaults(0), nSwitches(0),
+          nThreadSwitches(0), nTLBLookups(0), nTLBHits(0)
+      { }
+    };
+
+    std::map<uint64_t, AddressSpace> addressSpaces;
+
+    /* Per thread (TID) scheduling statistics; times are in memory
+     * accesses. TLB misses are counted while the thread runs, these are
+     * mostly refills after the switch to the thread.
+     */
+    struct ThreadStats
+    {
+      int number;         /* in order of creation */
+      uint64_t PID;
+      uint64_t runtime;
+      uint64_t waitTime;
+      uint64_t readySince;
+      int nDispatches;
+      uint64_t nTLBMisses;
+
+      ThreadStats(int number, uint64_t PID)
+        : number(number), PID(PID), runtime(0), waitTime(0), readySince(0),
+          nDispatches(0), nTLBMisses(0)
+      { }
+    };
+
+    std::map<uint64_t, ThreadStats> threadStats;
+
+    uint64_t nextTableReport;  /* processor clock */
+    uint64_t nextCompactionCheck;  /* processor clock */
+
+    void makeReady(const std::shared_ptr<Process> &thread);
+    void exitThread(const std::shared_ptr<Process> &thread);
+    void releaseOwnedPages(const uint64_t PID);
+    const SharedRange *findSharedRange(const uintptr_t vAddr) const;
+    bool mapSharedPage(const uint64_t PID, const uintptr_t vAddr,
+                       const bool global);
+    void unmapShared(const uint64_t PID);
+    void invalidatePage(const PhysPage &page);
+    void accountTLB(const Process &thread);
+    void preempt(const bool exit);
+    void dispatch(const std::shared_ptr<Process> &next);
+    void dispatchGang(void);
+    void reportPageTables(void);
+    void updateLiveStats(const bool finished);
+
+    bool allocatePhysPages(size_t count, uintptr_t &addr);
+    bool allocateProcessPage(PhysPage &page);
+    void releaseProcessPage(const uintptr_t addr);
+    bool selectVictim(PhysPage &victim);
+    bool reclaimPages(void);
+    void swapInPage(const uint64_t PID, const uintptr_t vAddr);
+    bool compactMemory(const size_t count, const bool proactive);
 
     void logPageFault(const uint64_t faultAddr);
     void logPageMapping(const uint64_t virtualAddr,
@@ -94,7 +281,7 @@ class OSKernel
 
   public:
     OSKernel(Processor &processor, MMUDriver &driver,
-             uint64_t memorySize, ProcessList &processList);
+             uint64_t memorySize, ProcessList processList);
     virtual ~OSKernel();
 
     void *allocateMemory(size_t size, uint64_t align);
@@ -108,7 +295,11 @@ class OSKernel
     /* Getters for statistics */
     int getNPageFaults() const;
     int getNContextSwitches() const;
+    int getNEvictedPages() const;
     int getMaxAllocatedPages() const;
+    int getNShootdownIPIs() const;
+    int getNShootdownIPIsAvoided() const;
+    uint64_t getNTLBMisses(const uint64_t TID) const;
 };
 
 #endif /* __OSKERNEL_H__ */
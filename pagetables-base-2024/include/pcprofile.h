@@ -0,0 +1,62 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    pcprofile.h - Attribution of translation overhead to instructions
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __PCPROFILE_H__
+#define __PCPROFILE_H__
+
+#include <stdint.h>
+
+#include <array>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include "hotpages.h"  /* for PageEvent */
+
+
+/* Counts data TLB misses, walks and page faults per instruction address
+ * (PC) of every address space. On destruction the counts are written in
+ * the folded stacks format of flamegraph.pl, one line per event, address
+ * space and PC:
+ *
+ *   tlb_miss;ASID 1;0x4005d0 12
+ */
+class PCProfile
+{
+  protected:
+    constexpr static int nEvents = 3;
+    using Counts = std::array<uint64_t, nEvents>;
+
+    std::string filename;
+    std::ofstream file;
+
+    /* (ASID, PC) -> counts per event */
+    std::unordered_map<uint64_t, Counts> counts;
+    Counts nEventsTotal;
+
+    static uint64_t makeKey(const uint64_t asid, const uint64_t pc);
+
+  public:
+    PCProfile(const std::string &filename);
+    ~PCProfile();
+
+    inline void record(const PageEvent event, const uint64_t asid,
+                       const uint64_t pc)
+    {
+      const int e = static_cast<int>(event);
+      ++counts[makeKey(asid, pc)][e];
+      ++nEventsTotal[e];
+    }
+
+    uint64_t  getCount(const PageEvent event, const uint64_t asid,
+                       const uint64_t pc) const;
+
+    /* Write the folded stacks to os. */
+    void      write(std::ostream &os) const;
+};
+
+#endif /* __PCPROFILE_H__ */
@@ -44,21 +44,32 @@ std::ostream &operator<<(std::ostream &stream, const MemAccess &access);
 
 
 /*
- * Process abstraction.
+ * Process abstraction. A Process object represents a thread of execution;
+ * threads created with a leader share the leader's address space and
+ * therefore its PID.
  */
 
 class Process
 {
   private:
     std::unique_ptr<TraceReader> reader;
+    const uint64_t PID;
+    uint64_t lastPC;
 
   public:
-    Process(std::istream &input);
+    Process(std::istream &input, const Process *leader = nullptr);
     ~Process();
 
+    /* Identifies the address space */
     uint64_t getPID(void) const;
+    /* Identifies the thread */
+    uint64_t getTID(void) const;
 
     void getMemoryAccess(MemAccess &access);
+    /* Address of the most recent instruction; the data accesses that
+     * follow it in the trace are made by that instruction.
+     */
+    uint64_t getPC(void) const;
     bool finished(void) const;
 };
 
@@ -9,7 +9,10 @@
 #define __PROCESSOR_H__
 
 #include <functional>
+#include <memory>
+#include <vector>
 
+#include "hostcounters.h"
 #include "mmu.h"
 #include "process.h"
 
@@ -26,23 +29,65 @@ using InterruptHandler = std::function<void(InterruptRequest request)>;
 class Processor
 {
   protected:
+    /* The cores run in parallel; these are simulated in lockstep, one
+     * time slice of every core per round.
+     */
+    struct Core
+    {
+      std::shared_ptr<Process> process;
+      int timerInterval;
+      uint64_t nAccesses;
+    };
+
     MMU &mmu;
-    std::shared_ptr<Process> current;
+    std::vector<Core> cores;
+    unsigned currentCore;
     InterruptHandler interruptHandler;
-    int timerInterval;
+    uint64_t nAccesses;  /* serves as clock */
+    std::unique_ptr<HostCounters> hostCounters;  /* nullptr if not measuring */
+
+    /* A single access, with its phases measured by the host counters. */
+    void measuredAccess(Core &core);
+    void interrupt(const InterruptRequest request);
 
   public:
     Processor(MMU &mmu);
+    ~Processor();
 
     inline MMU &getMMU(void) const noexcept
     {
       return mmu;
     }
 
+    /* Add cores up to a total of nCores, with the timer interval of the
+     * first core.
+     */
+    void setNCores(const unsigned nCores);
+    unsigned getNCores(void) const noexcept;
+
+    /* The process, timer interval and MMU state that are set apply to the
+     * current core. Interrupts are raised on the core that is current.
+     */
+    void selectCore(const unsigned core);
+    unsigned getCurrentCore(void) const noexcept;
+
     void setProcess(std::shared_ptr<Process> process) noexcept;
     void setTimerInterval(const int interval) noexcept;
     void setInterruptHandler(InterruptHandler handler) noexcept;
     void run(void);
+
+    /* Time, in memory accesses: every round advances the clock by the
+     * longest time slice of that round.
+     */
+    uint64_t getNAccesses(void) const noexcept;
+
+    /* Number of memory accesses performed by the current core. */
+    uint64_t getCoreAccesses(void) const noexcept;
+
+    HostCounters *getHostCounters(void) const noexcept;
+
+    Processor(const Processor &) = delete;
+    Processor &operator=(const Processor &) = delete;
 };
 
 #endif /* __PROCESSOR_H__ */
@@ -0,0 +1,76 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    setsampler.h - Set sampling of set-associative models
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __SETSAMPLER_H__
+#define __SETSAMPLER_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+
+/* Selects a fixed, pseudo-random subset of one in ratio sets of a
+ * set-associative structure. Only the sampled sets are simulated, so the
+ * cost of a large structure shrinks with the ratio; accesses to the other
+ * sets are merely counted. The misses of the whole structure are
+ * extrapolated from those of the sampled sets and divided by the known
+ * number of accesses. Misses are spread far more evenly over the sets
+ * than accesses, which concentrate on a few hot sets, so this is more
+ * accurate than the miss rate of the sampled sets themselves. The error
+ * bars follow from the variance of the misses per sampled set. Accesses
+ * are recorded per class (e.g. data and page table accesses of a cache).
+ */
+class SetSampler
+{
+  protected:
+    constexpr static uint32_t unsampled = ~0U;
+
+    const uint32_t nClasses;
+    std::vector<uint32_t> slots;      /* per set: slot or unsampled */
+    std::vector<uint64_t> sets;       /* sampled sets, in order */
+    std::vector<uint64_t> accesses;   /* per slot and class */
+    std::vector<uint64_t> misses;
+    std::vector<uint64_t> nSkipped;   /* per class */
+
+  public:
+    struct Estimate
+    {
+      uint64_t accesses;      /* sampled and skipped */
+      uint64_t sampled;
+      double misses;          /* extrapolated */
+      double missRate;
+      double error;           /* 95% confidence half-width of missRate */
+    };
+
+    SetSampler(const uint64_t nSets, const uint32_t ratio,
+               const uint32_t nClasses = 1);
+
+    inline bool isSampled(const uint64_t set) const
+    {
+      return slots[set] != unsampled;
+    }
+
+    inline void record(const uint64_t set, const uint32_t cls, const bool miss)
+    {
+      const uint64_t i = (uint64_t)slots[set] * nClasses + cls;
+      ++accesses[i];
+      misses[i] += miss;
+    }
+
+    inline void skip(const uint32_t cls)
+    {
+      ++nSkipped[cls];
+    }
+
+    /* The sampled sets, in increasing order. */
+    const std::vector<uint64_t> &getSets(void) const;
+    uint64_t  getNSets(void) const;
+
+    Estimate  estimate(const uint32_t cls) const;
+};
+
+#endif /* __SETSAMPLER_H__ */
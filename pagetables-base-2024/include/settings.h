@@ -10,6 +10,10 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 /*
  * Settings that may be changed via command-line arguments.
@@ -19,6 +23,113 @@
 extern bool LogMemoryAccesses;
 extern int ProcessTimeQuantum;
 extern uint32_t TLBEntries;
+extern uint32_t TLBAssoc;        /* ways; 0 is fully associative */
+extern uint32_t VictimTLBEntries; /* 0 disables the victim TLB */
+extern std::string TLBIndexing;  /* set, split or skewed */
+
+/* Swap configuration; swapping is disabled when SwapDevice is empty. */
+extern std::string SwapDevice;
+extern uint64_t SwapSize;        /* in KiB */
+extern uint32_t SwapCluster;     /* max. # pages reclaimed per pass */
+extern uint32_t SwapReadahead;   /* readahead window in slots; <= 1 is off */
+
+/* Compressed pool configuration; disabled when ZswapFraction is 0. */
+extern double ZswapFraction;     /* max. fraction of physical memory */
+extern std::string ZswapRatio;   /* compression ratio model */
+
+/* Memory compaction; proactive compaction is disabled when the
+ * fragmentation threshold is 0.
+ */
+extern bool CompactionEnabled;
+extern double CompactionProactive;
+
+/* Data cache model; disabled when CacheSize is 0. The cache geometry also
+ * determines the number of page colours.
+ */
+extern uint64_t CacheSize;       /* in KiB */
+extern uint32_t CacheAssoc;
+extern uint32_t CacheLineSize;   /* in bytes */
+extern std::string PageColouring; /* none, sequential, binhop or random */
+
+/* Physical frame allocator: firstfit, bitmap, bestfit or nextfit. */
+extern std::string PhysAllocator;
+
+/* Per-CPU page frame caches; disabled when the batch size is 0. */
+extern uint32_t FrameCacheBatch;
+
+/* Virtual address ranges [start, end) of identical read-only regions,
+ * of which the pages and page tables are shared by all processes mapping
+ * them. Global ranges are also not tagged with an ASID in the TLB.
+ */
+extern std::vector<std::pair<uint64_t, uint64_t>> SharedRanges;
+extern std::vector<std::pair<uint64_t, uint64_t>> GlobalRanges;
+
+/* Scheduling policy: rr, fair, mlfq, lottery or affinity. */
+extern std::string SchedulerPolicy;
+
+/* Lottery tickets of each thread of a process, by the number of the
+ * process in the order of the filenames, starting at 1. Processes that
+ * are absent hold the default number of tickets.
+ */
+extern std::map<uint64_t, uint64_t> LotteryTickets;
+
+/* Flush the TLB on context switches; otherwise entries of different
+ * address spaces are told apart by their ASID.
+ */
+extern bool TLBFlushOnSwitch;
+
+/* Number of simulated cores, each with its own TLB. With gang
+ * scheduling, the threads of an address space are dispatched together
+ * on the quantum boundaries shared by all cores.
+ */
+extern uint32_t NCores;
+extern bool GangScheduling;
+
+/* TLB invalidations are batched; a core that has more pages to
+ * invalidate in one batch is flushed instead. 0 disables batching.
+ */
+extern uint32_t TLBFlushCeiling;
+
+/* Report the occupancy of page tables when processes exit and, if the
+ * interval (in memory accesses) is non-zero, periodically.
+ */
+extern bool PageTableStats;
+extern uint64_t PageTableStatsInterval;
+
+/* Number of hottest pages per address space to report for TLB misses,
+ * walks and faults, along with a TLB miss heatmap. 0 disables this.
+ */
+extern uint32_t HotPagesTop;
+
+/* File to write data TLB misses, walks and page faults per instruction
+ * to, as folded stacks. Empty disables this.
+ */
+extern std::string PCProfileFile;
+
+/* File to publish live statistics in for pagetables-top, which SIGUSR1
+ * also prints; empty disables live statistics.
+ */
+extern std::string LiveStatsFile;
+
+/* Fraction of the accesses of which the translation is checked against a
+ * reference; at 1, the TLB is also checked in lockstep. 0 disables this.
+ */
+extern double CheckRate;
+
+/* Measure the host performance counters of the simulator in each phase
+ * of the simulation loop, for one in this many accesses. 0 disables this.
+ */
+extern uint32_t HostCountersPeriod;
+
+/* TLB models that observe the translations alongside the TLB of the MMU,
+ * each given as entries[:ways].
+ */
+extern std::vector<std::string> ObserverTLBs;
+
+/* Simulate only one in this many sets of the cache and of observer TLBs,
+ * and extrapolate their miss rates. 1 simulates every set.
+ */
+extern uint32_t SetSampling;
 
 
 #endif /* __SETTINGS_H__ */
@@ -0,0 +1,86 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tlbobservers.h - TLB models observing the translations of the MMU
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __TLBOBSERVERS_H__
+#define __TLBOBSERVERS_H__
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class MMU;
+class TLB;
+
+
+/* Independent TLB models that see the same stream of translations and
+ * invalidations as the TLB of the MMU, such that several designs are
+ * compared in a single run. The page tables and page faults are driven
+ * by the MMU and its own TLB alone: an observer that misses is filled
+ * with the translation the MMU found, without a walk of its own, and
+ * only its statistics differ. Every core has its own instance of each
+ * model, like the TLB of the MMU.
+ */
+class TLBObservers
+{
+  protected:
+    struct Observer
+    {
+      std::string spec;
+      size_t nEntries;
+      size_t nWays;           /* 0 if fully associative */
+      size_t nVictims;        /* entries of the victim TLB, if any */
+      std::string organisation;
+      std::vector<std::unique_ptr<TLB>> cores;
+    };
+
+    const MMU &mmu;
+    const uint32_t sampling;
+    std::vector<Observer> observers;
+
+    TLB      &getTLB(Observer &observer);
+
+  public:
+    /* One observer per spec, entries[:ways[:organisation]][+victims],
+     * fully associative if ways is not given, set-associative, split or
+     * skewed (see TLBOrganisation) and with a victim TLB of victims
+     * entries if given. Large set-associative observers may simulate only
+     * one in sampling sets.
+     */
+    TLBObservers(const MMU &mmu, const std::vector<std::string> &specs,
+                 const uint32_t sampling = 1);
+    ~TLBObservers();
+
+    /* The outcome of a translation by the MMU of vPage in the current
+     * address space: whether it was found and, if so, its physical page,
+     * whether it is mapped globally and the page size of its mapping.
+     */
+    void      translate(const uint64_t vPage, const bool isWrite,
+                        const bool found, const uint64_t pPage,
+                        const bool global, const unsigned size = 0);
+
+    /* Operations on the TLB of the selected core, applied to all models. */
+    void      invalidate(const uint64_t vPage, const uint64_t asid);
+    void      flush(const bool keepGlobal);
+    void      setASID(const uint64_t asid);
+
+    void      setNCores(const unsigned nCores);
+
+    size_t    size(void) const;
+
+    /* Statistics of observer index, summed over all cores. */
+    void      getStatistics(const size_t index, uint64_t &nLookups,
+                            uint64_t &nHits, uint64_t &nEvictions,
+                            uint64_t &nFlush,
+                            uint64_t &nFlushEvictions) const;
+
+    TLBObservers(const TLBObservers &) = delete;
+    TLBObservers &operator=(const TLBObservers &) = delete;
+};
+
+#endif /* __TLBOBSERVERS_H__ */
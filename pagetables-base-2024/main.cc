@@ -18,11 +18,83 @@
 
 uint64_t MemorySize = 1 * 1024 * 1024; /* Default to 1024 * 1024 KiB = 1 GiB */
 
+/* Options without a short equivalent are identified by values outside
+ * of the character range.
+ */
+enum LongOption : int
+{
+  OptSwap = 256,
+  OptSwapSize,
+  OptSwapCluster,
+  OptReadahead,
+  OptZswap,
+  OptZswapRatio,
+  OptCompaction,
+  OptCompactionProactive,
+  OptCache,
+  OptPageColouring,
+  OptFrameCache,
+  OptAllocator,
+  OptShared,
+  OptGlobal,
+  OptScheduler,
+  OptNoTLBFlush,
+  OptCores,
+  OptGang,
+  OptFlushCeiling,
+  OptTableStats,
+  OptHotPages,
+  OptPCProfile,
+  OptLiveStats,
+  OptCheck,
+  OptHostCounters,
+  OptObserveTLB,
+  OptSetSampling,
+  OptVictimTLB,
+  OptThread,
+  OptTickets,
+};
+
+static const struct option longOptions[] =
+{
+  { "swap",          required_argument, nullptr, OptSwap },
+  { "swap-size",     required_argument, nullptr, OptSwapSize },
+  { "swap-cluster",  required_argument, nullptr, OptSwapCluster },
+  { "readahead",     required_argument, nullptr, OptReadahead },
+  { "zswap",         required_argument, nullptr, OptZswap },
+  { "zswap-ratio",   required_argument, nullptr, OptZswapRatio },
+  { "compaction",    no_argument,       nullptr, OptCompaction },
+  { "compaction-proactive", required_argument, nullptr, OptCompactionProactive },
+  { "cache",         required_argument, nullptr, OptCache },
+  { "page-colouring", required_argument, nullptr, OptPageColouring },
+  { "frame-cache",   required_argument, nullptr, OptFrameCache },
+  { "allocator",     required_argument, nullptr, OptAllocator },
+  { "shared",        required_argument, nullptr, OptShared },
+  { "global",        required_argument, nullptr, OptGlobal },
+  { "scheduler",     required_argument, nullptr, OptScheduler },
+  { "no-tlb-flush",  no_argument,       nullptr, OptNoTLBFlush },
+  { "cores",         required_argument, nullptr, OptCores },
+  { "gang",          no_argument,       nullptr, OptGang },
+  { "tlb-flush-ceiling", required_argument, nullptr, OptFlushCeiling },
+  { "pt-stats",      optional_argument, nullptr, OptTableStats },
+  { "hot-pages",     optional_argument, nullptr, OptHotPages },
+  { "pc-profile",    required_argument, nullptr, OptPCProfile },
+  { "live-stats",    required_argument, nullptr, OptLiveStats },
+  { "check",         optional_argument, nullptr, OptCheck },
+  { "host-counters", optional_argument, nullptr, OptHostCounters },
+  { "observe-tlb",   required_argument, nullptr, OptObserveTLB },
+  { "set-sampling",  required_argument, nullptr, OptSetSampling },
+  { "victim-tlb",    required_argument, nullptr, OptVictimTLB },
+  { "thread",        required_argument, nullptr, OptThread },
+  { "tickets",       required_argument, nullptr, OptTickets },
+  { nullptr,         0,                 nullptr, 0 }
+};
+
 
 static void
 showHelp(const char *progName)
 {
-  std::cerr << progName << " [-l] {-s|-a} [-q quantum] [-m memsize] [-t tlbsize] [filenames ...]" << std::endl;
+  std::cerr << progName << " [-l] {-s|-a} [-q quantum] [-m memsize] [-t tlbsize[:ways[:organisation]]] [options] [filenames ...]" << std::endl;
   std::cerr <<
 R"HERE(
     -l           Log all memory accesses to stderr.
@@ -30,21 +102,117 @@ R"HERE(
     -a           Use AArch64 page table.
     -q quantum   Configure process "time quantum" to quantum.
     -m memsize   Memory size in KiB.
-    -t tlbsize   Configure size of TLB (number of entries).
+    -t tlbsize[:ways[:organisation]]
+                 Configure size of TLB (number of entries, default 64;
+                 0 disables the TLB) and its associativity (fully
+                 associative by default). The organisation is set
+                 (default), split (ways divided among the 16 KiB,
+                 32 MiB and 64 GiB page sizes) or skewed (ways indexed
+                 by their own hash and shared by the page sizes).
+
+    --swap=device          Enable swapping to device (ssd, nvme or hdd).
+    --swap-size=size       Swap space size in KiB.
+    --swap-cluster=pages   Max. # pages evicted per reclaim pass.
+    --readahead=slots      Swap-in readahead window, including the faulting
+                           slot (0 or 1 disables).
+    --zswap=fraction       Store evicted pages in a compressed pool of at
+                           most this fraction of memory, before swapping
+                           to the device (if any). Without a device, memory
+                           runs out when the pool is full.
+    --zswap-ratio=model    Compression ratio per page: R, uniform:MIN:MAX,
+                           normal:MEAN:SD or file:PATH.
+    --compaction           Compact memory when a multi-page allocation
+                           fails due to fragmentation.
+    --compaction-proactive=threshold
+                           Also compact on timer interrupts when the
+                           fragmentation score exceeds threshold (0-1).
+    --cache=size[:ways[:line]]
+                           Model a physically indexed cache of size KiB
+                           (default 16 ways, 64 byte lines) and report
+                           conflict misses of data and page table lines.
+    --page-colouring=policy
+                           Select frame colours using policy sequential,
+                           binhop or random; requires --cache.
+    --allocator=name       Physical frame allocator: firstfit (default),
+                           bitmap, bestfit or nextfit.
+    --frame-cache=batch    Allocate single pages from per-CPU frame caches
+                           that are refilled and drained in batches.
+    --shared=start-end     Virtual addresses [start, end) (hex) hold an
+                           identical read-only region (e.g. program text) in
+                           all processes: map it with reference counted
+                           pages and page tables shared between processes.
+                           start and end must be aligned to the span of one
+                           L3 table (32 MiB). May be repeated; AArch64 only.
+    --global=start-end     As --shared, but map the region globally: its
+                           TLB entries are kept across context switches.
+                           The same alignment applies.
+    --scheduler=policy     Scheduling policy: rr (round robin, default),
+                           fair, mlfq, lottery or affinity (prefer processes
+                           with entries left in the TLB).
+    --tickets=n            Give each thread of the process of the preceding
+                           filename n lottery tickets (default 100).
+    --no-tlb-flush         Keep the TLB on context switches and tell the
+                           entries of processes apart by ASID.
+    --cores=n              Simulate n cores, each with its own TLB, that
+                           run in lockstep quanta.
+    --gang                 Gang scheduling: dispatch the threads of an
+                           address space on all cores at the same quantum
+                           boundary.
+    --tlb-flush-ceiling=n  Batch the TLB invalidations of evictions and
+                           compaction; flush a TLB that has more than n
+                           pages to invalidate (default 33, 0 disables
+                           batching).
+    --pt-stats[=interval]  Report the occupancy of each level of the page
+                           tables when processes exit, and every interval
+                           memory accesses if given; AArch64 only.
+    --hot-pages[=k]        Report the k (default 8) pages with the most TLB
+                           misses, walks and faults per process, and a
+                           heatmap of TLB misses over time.
+    --pc-profile=file      Write the data TLB misses, walks and page faults
+                           per instruction to file as folded stacks, for
+                           flamegraph.pl.
+    --live-stats=file      Publish counters while running in the memory-
+                           mapped file, to be read by pagetables-top. On
+                           SIGUSR1, the counters are printed.
+    --check[=rate]         Check the translations of a fraction rate (default
+                           1) of the accesses against a naive page table
+                           walk; at rate 1, also check a set-associative
+                           TLB against a reference TLB in lockstep. Reports
+                           the first divergence.
+    --host-counters[=period]
+                           Measure time, cycles, instructions, LLC and dTLB
+                           misses of the simulator itself per phase (trace
+                           decoding, translation, faults, interrupts), for
+                           one in period (default 64) accesses. Without
+                           perf_event_open, only the time is measured.
+    --observe-tlb=entries[:ways[:organisation]][+victims]
+                           Simulate a TLB of entries alongside the TLB of the
+                           MMU, on the same translations, and report its
+                           statistics. May be given multiple times, to
+                           compare several TLBs in one run.
+    --set-sampling=ratio   Simulate only one in ratio sets of the cache and
+                           of observer TLBs, and estimate their miss rates
+                           with 95% error bars.
+    --victim-tlb=entries   Move entries evicted from the TLB to a fully
+                           associative victim TLB, probed on a TLB miss
+                           before the page table walk.
+    --thread=file          Run file as another thread of the process of the
+                           preceding filename, sharing its address space.
+                           May be repeated.
 
     One of -s or -a must be specified.
-    filenames may be one or more files.
+    filenames may be one or more files, each run as a process.
 )HERE";
 }
 
 template<typename M, typename D> static void
-run(uint64_t memorySize, ProcessList &processList)
+run(uint64_t memorySize, ProcessList processList)
 {
   M mmu;
   D driver;
 
   Processor processor(mmu);
-  OSKernel kernel(processor, driver, memorySize, processList);
+  OSKernel kernel(processor, driver, memorySize, std::move(processList));
 
   processor.run();
 }
@@ -61,17 +229,28 @@ exitWithError(const char *progName, const char *errorMsg)
 int
 main(int argc, char **argv)
 {
-  char c;
+  int c;
   const char *progName = argv[0];
 
   bool useSimple = false;
   bool useAArch64 = false;
 
-  /* Parse options */
-  while ((c = getopt(argc, argv, "lsaq:hm:t:")) != -1)
+  /* Trace files per process: the first runs the process, the others
+   * are its threads.
+   */
+  std::vector<std::vector<std::string>> traceFiles;
+
+  /* Parse options. The leading '-' returns filenames in order, as
+   * option 1, such that --thread applies to the preceding filename.
+   */
+  while ((c = getopt_long(argc, argv, "-lsaq:hm:t:", longOptions, nullptr)) != -1)
     {
       switch (c)
         {
+          case 1:
+            traceFiles.emplace_back(1, optarg);
+            break;
+
           case 'l':
             LogMemoryAccesses = true;
             break;
@@ -93,7 +272,172 @@ main(int argc, char **argv)
             break;
 
           case 't':
-            TLBEntries = std::stoi(optarg);
+            {
+              const std::string spec(optarg);
+              const size_t pos = spec.find(':');
+              TLBEntries = std::stoul(spec.substr(0, pos));
+              if (pos != std::string::npos)
+                {
+                  const size_t next = spec.find(':', pos + 1);
+                  TLBAssoc = std::stoul(spec.substr(pos + 1, next - pos - 1));
+                  if (next != std::string::npos)
+                    TLBIndexing = spec.substr(next + 1);
+                }
+              if (TLBIndexing != "set" && TLBIndexing != "split" &&
+                  TLBIndexing != "skewed")
+                exitWithError(progName, "Error: the TLB organisation must be set, split or skewed.\n\n");
+            }
+            break;
+
+          case OptSwap:
+            SwapDevice = optarg;
+            break;
+
+          case OptSwapSize:
+            SwapSize = std::stoull(optarg);
+            break;
+
+          case OptSwapCluster:
+            SwapCluster = std::stoul(optarg);
+            break;
+
+          case OptReadahead:
+            SwapReadahead = std::stoul(optarg);
+            break;
+
+          case OptZswap:
+            ZswapFraction = std::stod(optarg);
+            break;
+
+          case OptZswapRatio:
+            ZswapRatio = optarg;
+            break;
+
+          case OptCompaction:
+            CompactionEnabled = true;
+            break;
+
+          case OptCompactionProactive:
+            CompactionEnabled = true;
+            CompactionProactive = std::stod(optarg);
+            break;
+
+          case OptCache:
+            {
+              std::string spec(optarg);
+              size_t pos = spec.find(':');
+              CacheSize = std::stoull(spec.substr(0, pos));
+              if (pos != std::string::npos)
+                {
+                  spec = spec.substr(pos + 1);
+                  pos = spec.find(':');
+                  CacheAssoc = std::stoul(spec.substr(0, pos));
+                  if (pos != std::string::npos)
+                    CacheLineSize = std::stoul(spec.substr(pos + 1));
+                }
+            }
+            break;
+
+          case OptPageColouring:
+            PageColouring = optarg;
+            break;
+
+          case OptFrameCache:
+            FrameCacheBatch = std::stoul(optarg);
+            break;
+
+          case OptAllocator:
+            PhysAllocator = optarg;
+            break;
+
+          case OptShared:
+          case OptGlobal:
+            {
+              const std::string range(optarg);
+              const size_t pos = range.find('-');
+              if (pos == std::string::npos)
+                exitWithError(progName, "Error: invalid address range.\n\n");
+
+              (c == OptGlobal ? GlobalRanges : SharedRanges)
+                .emplace_back(std::stoull(range.substr(0, pos), nullptr, 16),
+                              std::stoull(range.substr(pos + 1), nullptr, 16));
+            }
+            break;
+
+          case OptScheduler:
+            SchedulerPolicy = optarg;
+            break;
+
+          case OptNoTLBFlush:
+            TLBFlushOnSwitch = false;
+            break;
+
+          case OptCores:
+            NCores = std::stoul(optarg);
+            if (NCores == 0)
+              exitWithError(progName, "Error: need at least one core.\n\n");
+            break;
+
+          case OptGang:
+            GangScheduling = true;
+            break;
+
+          case OptFlushCeiling:
+            TLBFlushCeiling = std::stoul(optarg);
+            break;
+
+          case OptTableStats:
+            PageTableStats = true;
+            if (optarg)
+              PageTableStatsInterval = std::stoull(optarg);
+            break;
+
+          case OptHotPages:
+            HotPagesTop = optarg ? std::stoul(optarg) : 8;
+            break;
+
+          case OptPCProfile:
+            PCProfileFile = optarg;
+            break;
+
+          case OptLiveStats:
+            LiveStatsFile = optarg;
+            break;
+
+          case OptCheck:
+            CheckRate = optarg ? std::stod(optarg) : 1.;
+            break;
+
+          case OptHostCounters:
+            HostCountersPeriod = optarg ? std::stoul(optarg) : 64;
+            break;
+
+          case OptObserveTLB:
+            ObserverTLBs.emplace_back(optarg);
+            break;
+
+          case OptSetSampling:
+            SetSampling = std::stoul(optarg);
+            if (SetSampling == 0)
+              exitWithError(progName, "Error: the set sampling ratio must be at least 1.\n\n");
+            break;
+
+          case OptVictimTLB:
+            VictimTLBEntries = std::stoul(optarg);
+            break;
+
+          case OptThread:
+            if (traceFiles.empty())
+              exitWithError(progName, "Error: --thread must follow the filename of its process.\n\n");
+            traceFiles.back().emplace_back(optarg);
+            break;
+
+          case OptTickets:
+            if (traceFiles.empty())
+              exitWithError(progName, "Error: --tickets must follow the filename of its process.\n\n");
+            LotteryTickets[traceFiles.size()] = std::stoull(optarg);
+            if (LotteryTickets[traceFiles.size()] == 0)
+              exitWithError(progName, "Error: a process needs at least one ticket.\n\n");
             break;
 
           case 'h':
@@ -103,8 +447,9 @@ main(int argc, char **argv)
         }
     }
 
-  argc -= optind;
-  argv += optind;
+  /* Filenames after "--" are not returned by getopt_long. */
+  for (int i = optind; i < argc; ++i)
+    traceFiles.emplace_back(1, argv[i]);
 
   if (not useSimple and not useAArch64)
     exitWithError(progName, "Error: no page table type specified.\n\n");
@@ -112,7 +457,7 @@ main(int argc, char **argv)
   if ((useSimple + useAArch64) > 1)
     exitWithError(progName, "Error: can only specify one of {-s|-a}.\n\n");
 
-  if (argc == 0)
+  if (traceFiles.empty())
     exitWithError(progName, "Error: no input files specified.\n\n");
 
   /* Start main program, catch any exceptions and let the user know. */
@@ -124,18 +469,28 @@ main(int argc, char **argv)
       std::list<std::ifstream> files;
       ProcessList processList;
 
-      for (int i = 0; i < argc; ++i)
+      /* The threads of a process share the address space of the first. */
+      for (auto &process : traceFiles)
         {
-          files.emplace_back(std::ifstream(argv[i]));
-          if (not files.back())
-            throw std::runtime_error("Could not open file " + std::string(argv[i]));
-          processList.emplace_back(std::make_shared<Process>(files.back()));
+          const Process *leader = nullptr;
+
+          for (auto &filename : process)
+            {
+              files.emplace_back(std::ifstream(filename));
+              if (not files.back())
+                throw std::runtime_error("Could not open file " + filename);
+
+              processList.emplace_back(std::make_shared<Process>(files.back(),
+                                                                 leader));
+              if (leader == nullptr)
+                leader = processList.back().get();
+            }
         }
 
       if (useSimple)
-        run<Simple::SimpleMMU, Simple::SimpleMMUDriver>(MemorySize << 10, processList);
+        run<Simple::SimpleMMU, Simple::SimpleMMUDriver>(MemorySize << 10, std::move(processList));
       else if (useAArch64)
-        run<AArch64::AArch64MMU, AArch64::AArch64MMUDriver>(MemorySize << 10, processList);
+        run<AArch64::AArch64MMU, AArch64::AArch64MMUDriver>(MemorySize << 10, std::move(processList));
       else
         exitWithError(progName, "Error: unknown page table type specified.\n\n");
     }
@@ -0,0 +1,233 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    bitmapallocator.cc - Hierarchical bitmap frame allocator
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "bitmapallocator.h"
+
+#include <algorithm>
+
+
+constexpr static uint64_t wordBits = 64;
+constexpr static uint64_t allOnes = ~0UL;
+
+/* Mask of count bits starting at bit offset. */
+static inline uint64_t
+bitMask(const uint64_t offset, const uint64_t count)
+{
+  return (count == wordBits ? allOnes : ((1UL << count) - 1)) << offset;
+}
+
+/* Length of the longest run of set bits in a word. */
+static inline uint64_t
+longestRun(uint64_t word)
+{
+  uint64_t length = 0;
+  for (; word != 0; ++length)
+    word &= word >> 1;
+
+  return length;
+}
+
+
+BitmapAllocator::BitmapAllocator(const uint64_t nPages)
+  : nPages(nPages),
+    leaves((nPages + wordBits - 1) / wordBits, 0),
+    summary((leaves.size() + wordBits - 1) / wordBits, 0),
+    cursor(0)
+{
+  /* Bits beyond the last frame stay clear, i.e. are never free. */
+  setRange(0, nPages, true);
+}
+
+void
+BitmapAllocator::setRange(uint64_t startPage, uint64_t count, const bool free)
+{
+  while (count > 0)
+    {
+      const uint64_t word = startPage / wordBits;
+      const uint64_t offset = startPage % wordBits;
+      const uint64_t n = std::min(wordBits - offset, count);
+
+      if (free)
+        leaves[word] |= bitMask(offset, n);
+      else
+        leaves[word] &= ~bitMask(offset, n);
+
+      const uint64_t summaryBit = 1UL << (word % wordBits);
+      if (leaves[word])
+        summary[word / wordBits] |= summaryBit;
+      else
+        summary[word / wordBits] &= ~summaryBit;
+
+      startPage += n;
+      count -= n;
+    }
+}
+
+/* Find the first free frame at or after from. */
+bool
+BitmapAllocator::findNextFree(const uint64_t from, uint64_t &page) const
+{
+  uint64_t word = from / wordBits;
+  if (word >= leaves.size())
+    return false;
+
+  /* Remainder of the current leaf word. */
+  uint64_t bits = leaves[word] & (allOnes << (from % wordBits));
+  if (bits)
+    {
+      page = word * wordBits + __builtin_ctzll(bits);
+      return true;
+    }
+
+  /* Next leaf word with a free frame, using the summary. */
+  ++word;
+  uint64_t index = word / wordBits;
+  if (index >= summary.size())
+    return false;
+
+  bits = summary[index] & (allOnes << (word % wordBits));
+  while (bits == 0)
+    {
+      if (++index == summary.size())
+        return false;
+      bits = summary[index];
+    }
+
+  word = index * wordBits + __builtin_ctzll(bits);
+  page = word * wordBits + __builtin_ctzll(leaves[word]);
+  return true;
+}
+
+/* Number of consecutive free frames starting at page, up to max. */
+uint64_t
+BitmapAllocator::freeRunLength(uint64_t page, const uint64_t max) const
+{
+  uint64_t length = 0;
+
+  while (length < max && page < nPages)
+    {
+      uint64_t word = page / wordBits;
+      const uint64_t offset = page % wordBits;
+
+      /* Skip over fully free words, four at a time. */
+      if (offset == 0)
+        {
+          uint64_t end = word;
+          while (end + 4 <= leaves.size() && length + 4 * wordBits <= max &&
+                 (leaves[end] & leaves[end + 1] &
+                  leaves[end + 2] & leaves[end + 3]) == allOnes)
+            {
+              end += 4;
+              length += 4 * wordBits;
+            }
+
+          if (end != word)
+            {
+              page = end * wordBits;
+              continue;
+            }
+        }
+
+      /* Trailing free bits of the (shifted) word. */
+      const uint64_t inverted = ~(leaves[word] >> offset);
+      const uint64_t n = inverted ? __builtin_ctzll(inverted) : wordBits;
+
+      length += n;
+      page += n;
+      if (n < wordBits - offset)
+        break;
+    }
+
+  return std::min(length, max);
+}
+
+bool
+BitmapAllocator::allocate(const uint64_t count, uint64_t &startPage)
+{
+  if (count == 1)
+    {
+      if (not findNextFree(cursor, startPage) &&
+          not findNextFree(0, startPage))
+        return false;
+
+      setRange(startPage, 1, false);
+      cursor = startPage + 1;
+      return true;
+    }
+
+  uint64_t page = 0;
+  while (findNextFree(page, page))
+    {
+      const uint64_t length = freeRunLength(page, count);
+      if (length == count)
+        {
+          setRange(page, count, false);
+          startPage = page;
+          return true;
+        }
+
+      /* The frame after the run is in use. */
+      page += length + 1;
+    }
+
+  return false;
+}
+
+bool
+BitmapAllocator::allocateAt(const uint64_t startPage, const uint64_t count)
+{
+  if (freeRunLength(startPage, count) < count)
+    return false;
+
+  setRange(startPage, count, false);
+  return true;
+}
+
+void
+BitmapAllocator::release(const uint64_t startPage, const uint64_t count)
+{
+  setRange(startPage, count, true);
+}
+
+uint64_t
+BitmapAllocator::getLargestFreeRun(void) const
+{
+  uint64_t largest = 0;
+  uint64_t current = 0;
+
+  for (const uint64_t word : leaves)
+    {
+      if (word == allOnes)
+        {
+          current += wordBits;
+          continue;
+        }
+
+      /* A run continues into the trailing free bits of this word; a new
+       * run starts with its leading free bits.
+       */
+      current += __builtin_ctzll(~word);
+      largest = std::max({ largest, current, longestRun(word) });
+      current = __builtin_clzll(~word);
+    }
+
+  return std::max(largest, current);
+}
+
+void
+BitmapAllocator::getFreeMap(std::vector<bool> &freeMap) const
+{
+  for (uint64_t word = 0; word < leaves.size(); ++word)
+    for (uint64_t bits = leaves[word]; bits != 0; bits &= bits - 1)
+      freeMap[word * wordBits + __builtin_ctzll(bits)] = true;
+}
+
+const char *
+BitmapAllocator::getName(void) const
+{
+  return "bitmap";
+}
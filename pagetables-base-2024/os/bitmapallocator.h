@@ -0,0 +1,50 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    bitmapallocator.h - Hierarchical bitmap frame allocator
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __BITMAPALLOCATOR_H__
+#define __BITMAPALLOCATOR_H__
+
+#include "frameallocator.h"
+
+
+/* Free frames are tracked with one bit per frame (set if free) in leaf
+ * words, and one summary bit per leaf word (set if the leaf word has a
+ * free frame). This is about 1 bit of metadata per frame. Free frames are
+ * found with count-trailing-zeros on the summary and leaf words, contiguous
+ * runs by scanning a word at a time.
+ *
+ * Single frames are allocated next-fit from a cursor, which makes
+ * allocation O(1) amortised; multi-frame runs are allocated first-fit.
+ */
+class BitmapAllocator : public FrameAllocator
+{
+  protected:
+    const uint64_t nPages;
+    std::vector<uint64_t> leaves;
+    std::vector<uint64_t> summary;
+    uint64_t cursor;
+
+    void      setRange(uint64_t startPage, uint64_t count, const bool free);
+    bool      findNextFree(const uint64_t from, uint64_t &page) const;
+    uint64_t  freeRunLength(uint64_t page, const uint64_t max) const;
+
+  public:
+    BitmapAllocator(const uint64_t nPages);
+
+    virtual bool      allocate(const uint64_t count,
+                               uint64_t &startPage) override;
+    virtual bool      allocateAt(const uint64_t startPage,
+                                 const uint64_t count) override;
+    virtual void      release(const uint64_t startPage,
+                              const uint64_t count) override;
+
+    virtual uint64_t  getLargestFreeRun(void) const override;
+    virtual void      getFreeMap(std::vector<bool> &freeMap) const override;
+    virtual const char *getName(void) const override;
+};
+
+#endif /* __BITMAPALLOCATOR_H__ */
@@ -0,0 +1,145 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    compactor.cc - Physical memory compaction
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "compactor.h"
+#include "physmemmanager.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+/* Cost model: copying a page at memory bandwidth, plus updating the page
+ * table entry and invalidating the TLB entry. Scanning costs a small
+ * amount per page inspected.
+ */
+static const uint64_t copyBandwidth = 10UL * 1000 * 1000 * 1000;  /* bytes/s */
+static const uint64_t remapCost = 1000;                           /* ns */
+static const uint64_t scanCost = 10;                              /* ns */
+
+
+Compactor::Compactor(PhysMemManager &manager, MMUDriver &driver)
+  : manager(manager), driver(driver), pageSize(driver.getPageSize()),
+    nRuns(0), nProactiveRuns(0), nSuccessful(0),
+    nMigrateScanned(0), nFreeScanned(0), nMigrated(0), totalCost(0)
+{
+}
+
+Compactor::~Compactor()
+{
+  std::cerr << std::dec << std::endl
+            << "Compaction Statistics:" << std::endl
+            << "# compaction runs: " << nRuns
+            << " (proactive: " << nProactiveRuns << ")" << std::endl
+            << "# successful runs: " << nSuccessful << std::endl
+            << "# pages scanned: " << nMigrateScanned << " migrate, "
+            << nFreeScanned << " free" << std::endl
+            << "# pages migrated: " << nMigrated << std::endl
+            << "total compaction cost: " << totalCost / 1000 << " us" << std::endl;
+}
+
+bool
+Compactor::compact(const size_t count, std::vector<PhysPage *> &movable,
+                   InvalidateFunction invalidate, const bool proactive)
+{
+  if (proactive)
+    ++nProactiveRuns;
+  else
+    ++nRuns;
+
+  if (manager.getLargestFreeRun() >= count)
+    {
+      ++nSuccessful;
+      return true;
+    }
+
+  /* Compaction cannot help if there is not enough free memory at all. */
+  if (manager.getNFreePages() < count)
+    return false;
+
+  std::vector<bool> freeMap;
+  manager.getFreeMap(freeMap);
+
+  std::sort(movable.begin(), movable.end(),
+            [](const PhysPage *a, const PhysPage *b)
+              { return a->addr < b->addr; });
+
+  uint64_t freeScanner = manager.getNPages();
+  bool success = false;
+
+  for (PhysPage *page : movable)
+    {
+      const uint64_t index = manager.getPageIndex(page->addr);
+      ++nMigrateScanned;
+      totalCost += scanCost;
+
+      /* Find the next free page above the migrate scanner. */
+      bool found = false;
+      while (freeScanner > index + 1)
+        {
+          --freeScanner;
+          ++nFreeScanned;
+          totalCost += scanCost;
+
+          if (freeMap[freeScanner])
+            {
+              found = true;
+              break;
+            }
+        }
+
+      /* The scanners have met. */
+      if (not found)
+        break;
+
+      /* Move the page. The simulator does not store data in physical
+       * pages, so the copy is only accounted for.
+       */
+      const uintptr_t oldAddr = page->addr;
+      const uintptr_t newAddr = manager.getPageAddress(freeScanner);
+      if (not manager.allocatePagesAt(newAddr, 1))
+        throw std::runtime_error("compaction: free scanner found used page.");
+
+      driver.remapPage(*page, newAddr);
+      invalidate(*page);
+      manager.releasePages(oldAddr, 1);
+
+      freeMap[freeScanner] = false;
+      freeMap[index] = true;
+
+      ++nMigrated;
+      totalCost += remapCost + (pageSize * 1000000000UL) / copyBandwidth;
+
+      /* No free run was large enough before, and runs only grew around
+       * the page just freed, so only that run needs to be measured.
+       */
+      uint64_t begin = index, end = index + 1;
+      while (begin > 0 && freeMap[begin - 1] && end - begin < count)
+        --begin;
+      while (end < freeMap.size() && freeMap[end] && end - begin < count)
+        ++end;
+      if (end - begin >= count)
+        {
+          success = true;
+          break;
+        }
+    }
+
+  if (success)
+    ++nSuccessful;
+
+  return success;
+}
+
+double
+Compactor::getFragmentation(void) const
+{
+  const uint64_t nFree = manager.getNFreePages();
+  if (nFree == 0)
+    return 0.;
+
+  return 1. - (double)manager.getLargestFreeRun() / nFree;
+}
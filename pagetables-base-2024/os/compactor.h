@@ -0,0 +1,67 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    compactor.h - Physical memory compaction
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __COMPACTOR_H__
+#define __COMPACTOR_H__
+
+#include "oskernel.h"
+
+#include <functional>
+#include <vector>
+
+class PhysMemManager;
+
+/* Function called after a page has been moved, such that stale TLB
+ * entries for the page can be invalidated.
+ */
+using InvalidateFunction = std::function<void(const PhysPage &)>;
+
+
+/* Memory compaction creates contiguous free ranges by moving pages, in
+ * the style of the Linux compaction engine. A migrate scanner walks the
+ * movable pages upwards from the start of physical memory, while a free
+ * scanner walks downwards from the end looking for free pages. Each page
+ * found by the migrate scanner is moved to the next free page, until a
+ * free run of the requested size exists or the scanners meet.
+ */
+class Compactor
+{
+  protected:
+    PhysMemManager &manager;
+    MMUDriver &driver;
+    const uint64_t pageSize;
+
+    /* Statistics */
+    uint64_t nRuns;
+    uint64_t nProactiveRuns;
+    uint64_t nSuccessful;
+    uint64_t nMigrateScanned;
+    uint64_t nFreeScanned;
+    uint64_t nMigrated;
+    uint64_t totalCost;
+
+  public:
+    Compactor(PhysMemManager &manager, MMUDriver &driver);
+    ~Compactor();
+
+    /* Move pages from the list of movable pages until a free run of count
+     * pages is available. The PhysPage structures are updated in place.
+     * Returns true if such a run is available afterwards.
+     */
+    bool      compact(const size_t count, std::vector<PhysPage *> &movable,
+                      InvalidateFunction invalidate, const bool proactive);
+
+    /* Fragmentation score: the fraction of free memory that is not part
+     * of the largest free run.
+     */
+    double    getFragmentation(void) const;
+
+    Compactor(const Compactor &) = delete;
+    Compactor &operator=(const Compactor &) = delete;
+};
+
+#endif /* __COMPACTOR_H__ */
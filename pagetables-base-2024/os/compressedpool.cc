@@ -0,0 +1,262 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    compressedpool.cc - Compressed in-memory swap tier
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "compressedpool.h"
+#include "physmemmanager.h"
+#include "framecache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+
+/* LZ4-like throughput figures for a single core, plus a fixed overhead
+ * per (de)compression call.
+ */
+static const uint64_t compressThroughput = 700UL * 1000 * 1000;    /* bytes/s */
+static const uint64_t decompressThroughput = 4000UL * 1000 * 1000; /* bytes/s */
+static const uint64_t callOverhead = 300;                          /* ns */
+
+
+/*
+ * CompressionModel
+ */
+
+CompressionModel::CompressionModel(const std::string &spec)
+  : kind(Kind::Fixed), param1(1.), param2(0.), samples(), rng(42)
+{
+  std::vector<std::string> fields;
+  std::stringstream stream(spec);
+  std::string field;
+  while (std::getline(stream, field, ':'))
+    fields.push_back(field);
+
+  try
+    {
+      if (fields.size() == 1)
+        {
+          kind = Kind::Fixed;
+          param1 = std::stod(fields[0]);
+        }
+      else if (fields.size() == 3 && fields[0] == "uniform")
+        {
+          kind = Kind::Uniform;
+          param1 = std::stod(fields[1]);
+          param2 = std::stod(fields[2]);
+        }
+      else if (fields.size() == 3 && fields[0] == "normal")
+        {
+          kind = Kind::Normal;
+          param1 = std::stod(fields[1]);
+          param2 = std::stod(fields[2]);
+        }
+      else if (fields.size() >= 2 && fields[0] == "file")
+        {
+          kind = Kind::Sampled;
+
+          const std::string path = spec.substr(spec.find(':') + 1);
+          std::ifstream input(path);
+          if (not input)
+            throw std::runtime_error("could not open compression ratio file " + path);
+
+          double ratio;
+          while (input >> ratio)
+            samples.push_back(ratio);
+
+          if (samples.empty())
+            throw std::runtime_error("no compression ratios in " + path);
+        }
+      else
+        throw std::invalid_argument(spec);
+    }
+  catch (std::logic_error &)
+    {
+      throw std::runtime_error("invalid compression ratio specification '"
+                               + spec + "'.");
+    }
+}
+
+double
+CompressionModel::sample(void)
+{
+  double ratio = param1;
+
+  switch (kind)
+    {
+      case Kind::Fixed:
+        break;
+
+      case Kind::Uniform:
+        ratio = std::uniform_real_distribution<double>(param1, param2)(rng);
+        break;
+
+      case Kind::Normal:
+        ratio = std::normal_distribution<double>(param1, param2)(rng);
+        break;
+
+      case Kind::Sampled:
+        ratio = samples[std::uniform_int_distribution<size_t>(0, samples.size() - 1)(rng)];
+        break;
+    }
+
+  return std::max(ratio, 1.);
+}
+
+
+/*
+ * CompressedPool
+ */
+
+CompressedPool::CompressedPool(PhysMemManager &manager,
+                               const uint64_t pageSize,
+                               const uint64_t memoryPages,
+                               const double fraction,
+                               const std::string &ratioSpec,
+                               FrameCache *frameCache)
+  : manager(manager), frameCache(frameCache), pageSize(pageSize),
+    maxFrames(memoryPages * fraction), memoryPages(memoryPages),
+    model(ratioSpec), frames(), bytesStored(0), nPagesStored(0),
+    nStores(0), nLoads(0), nRejected(0), nPoolFull(0),
+    totalUncompressed(0), totalCompressed(0),
+    totalCompressTime(0), totalDecompressTime(0),
+    peakGain(0), peakFrames(0)
+{
+  if (fraction <= 0. || fraction > 1.)
+    throw std::runtime_error("compressed pool fraction must be in (0, 1].");
+
+  std::cerr << "BOOT: compressed pool of at most "
+            << std::dec << maxFrames << " pages." << std::endl;
+}
+
+CompressedPool::~CompressedPool()
+{
+  if (not frames.empty())
+    std::cerr << "CompressedPool: error: pages remain in pool." << std::endl;
+
+  const double ratio =
+      totalCompressed ? (double)totalUncompressed / totalCompressed : 0.;
+
+  std::cerr << std::dec << std::endl
+            << "Compressed Pool Statistics:" << std::endl
+            << "# stores: " << nStores
+            << " (rejected: " << nRejected
+            << ", pool full: " << nPoolFull << ")" << std::endl
+            << "# loads: " << nLoads << std::endl
+            << "avg. compression ratio: " << ratio << std::endl
+            << "total compression time: " << totalCompressTime / 1000 << " us" << std::endl
+            << "total decompression time: " << totalDecompressTime / 1000 << " us" << std::endl
+            << "max. # pool pages: " << peakFrames << std::endl
+            << "peak effective capacity gain: " << peakGain << " pages ("
+            << (100. * peakGain / memoryPages) << "% of memory)" << std::endl;
+}
+
+/* Grow or shrink the set of frames backing the pool, such that the
+ * given number of bytes fits.
+ */
+bool
+CompressedPool::resize(const uint64_t bytes)
+{
+  const uint64_t needed = (bytes + pageSize - 1) / pageSize;
+
+  while (frames.size() < needed)
+    {
+      uintptr_t frame;
+      if (frames.size() >= maxFrames)
+        return false;
+
+      while (not manager.allocatePages(1, frame))
+        if (not frameCache || frameCache->drain() == 0)
+          return false;
+
+      frames.push_back(frame);
+    }
+
+  while (frames.size() > needed)
+    {
+      manager.releasePages(frames.back(), 1);
+      frames.pop_back();
+    }
+
+  return true;
+}
+
+/* The capacity gain is the number of pages held by the pool minus the
+ * number of frames used to hold them.
+ */
+void
+CompressedPool::updatePeak(void)
+{
+  peakFrames = std::max<uint64_t>(peakFrames, frames.size());
+  if (nPagesStored > frames.size())
+    peakGain = std::max<uint64_t>(peakGain, nPagesStored - frames.size());
+}
+
+uint32_t
+CompressedPool::compress(void)
+{
+  const uint32_t size = pageSize / model.sample();
+
+  totalCompressTime += callOverhead +
+      (pageSize * 1000000000UL) / compressThroughput;
+
+  if (size >= pageSize)
+    {
+      ++nRejected;
+      return 0;
+    }
+
+  return size;
+}
+
+bool
+CompressedPool::insert(const uint32_t size)
+{
+  if (not resize(bytesStored + size))
+    {
+      /* Drop any frames that were taken while trying to grow. */
+      resize(bytesStored);
+      ++nPoolFull;
+      return false;
+    }
+
+  bytesStored += size;
+  ++nPagesStored;
+
+  ++nStores;
+  totalUncompressed += pageSize;
+  totalCompressed += size;
+
+  updatePeak();
+  return true;
+}
+
+uint64_t
+CompressedPool::load(const uint32_t size)
+{
+  const uint64_t latency = callOverhead +
+      (pageSize * 1000000000UL) / decompressThroughput;
+
+  invalidate(size);
+
+  ++nLoads;
+  totalDecompressTime += latency;
+
+  return latency;
+}
+
+void
+CompressedPool::invalidate(const uint32_t size)
+{
+  if (nPagesStored == 0 || bytesStored < size)
+    throw std::runtime_error("attempt to remove page not in compressed pool.");
+
+  bytesStored -= size;
+  --nPagesStored;
+  resize(bytesStored);
+}
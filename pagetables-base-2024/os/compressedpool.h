@@ -0,0 +1,112 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    compressedpool.h - Compressed in-memory swap tier
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __COMPRESSEDPOOL_H__
+#define __COMPRESSEDPOOL_H__
+
+#include "settings.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+class FrameCache;
+class PhysMemManager;
+
+
+/* Model of the compression ratio achieved per page. Since the simulator
+ * does not track page contents, a ratio is drawn for every compressed
+ * page. The specification is one of:
+ *   R                 fixed ratio R
+ *   uniform:MIN:MAX   uniformly distributed ratio
+ *   normal:MEAN:SD    normally distributed ratio
+ *   file:PATH         ratios sampled from a file with one ratio per line
+ * Ratios below 1 (expansion) are clamped to 1.
+ */
+class CompressionModel
+{
+  protected:
+    enum class Kind { Fixed, Uniform, Normal, Sampled };
+
+    Kind kind;
+    double param1;
+    double param2;
+    std::vector<double> samples;
+    std::mt19937_64 rng;
+
+  public:
+    CompressionModel(const std::string &spec);
+
+    double    sample(void);
+};
+
+
+/* A pool of compressed pages stored in frames taken from the physical
+ * memory manager, similar to zswap. Compressed pages are assumed to be
+ * packed perfectly, so the pool occupies ceil(stored bytes / page size)
+ * frames. The pool never grows beyond maxFrames frames. Frames held in
+ * frameCache, if given, are drained when the manager has none left.
+ */
+class CompressedPool
+{
+  protected:
+    PhysMemManager &manager;
+    FrameCache *frameCache;
+    const uint64_t pageSize;
+    const uint64_t maxFrames;
+    const uint64_t memoryPages;
+    CompressionModel model;
+
+    std::vector<uintptr_t> frames;
+    uint64_t bytesStored;
+    uint64_t nPagesStored;
+
+    /* Statistics */
+    uint64_t nStores;
+    uint64_t nLoads;
+    uint64_t nRejected;
+    uint64_t nPoolFull;
+    uint64_t totalUncompressed;
+    uint64_t totalCompressed;
+    uint64_t totalCompressTime;
+    uint64_t totalDecompressTime;
+    uint64_t peakGain;
+    uint64_t peakFrames;
+
+    bool      resize(const uint64_t bytes);
+    void      updatePeak(void);
+
+  public:
+    CompressedPool(PhysMemManager &manager, const uint64_t pageSize,
+                   const uint64_t memoryPages, const double fraction,
+                   const std::string &ratioSpec,
+                   FrameCache *frameCache = nullptr);
+    ~CompressedPool();
+
+    /* Compress a page that is about to be stored. Returns the compressed
+     * size, or 0 if the page does not compress and should be rejected.
+     */
+    uint32_t  compress(void);
+
+    /* Store a compressed page of the given size. Returns false if the
+     * pool has reached its maximum size or no frame is available.
+     */
+    bool      insert(const uint32_t size);
+
+    /* Load (decompress) a page of the given compressed size and remove
+     * it from the pool. Returns the decompression latency in ns.
+     */
+    uint64_t  load(const uint32_t size);
+
+    /* Remove a page from the pool without loading it. */
+    void      invalidate(const uint32_t size);
+
+    CompressedPool(const CompressedPool &) = delete;
+    CompressedPool &operator=(const CompressedPool &) = delete;
+};
+
+#endif /* __COMPRESSEDPOOL_H__ */
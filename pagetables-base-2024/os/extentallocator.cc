@@ -0,0 +1,258 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    extentallocator.cc - Ordered free extent allocator
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "extentallocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+
+/*
+ * NodePool
+ */
+
+NodePool::NodePool()
+  : nodeSize(0), chunks(), freeList(nullptr)
+{
+}
+
+void *
+NodePool::allocate(const size_t size)
+{
+  /* All nodes of one container have the same size; round up such that
+   * every node is suitably aligned and can hold a free list link.
+   */
+  if (nodeSize == 0)
+    {
+      const size_t align = alignof(std::max_align_t);
+      nodeSize = (std::max(size, sizeof(void *)) + align - 1) & ~(align - 1);
+    }
+  else if (size > nodeSize)
+    throw std::runtime_error("node pool: node size mismatch.");
+
+  if (freeList == nullptr)
+    {
+      chunks.emplace_back(new char[nodeSize * nodesPerChunk]);
+      char *chunk = chunks.back().get();
+      for (size_t i = 0; i < nodesPerChunk; ++i)
+        deallocate(chunk + i * nodeSize);
+    }
+
+  void *node = freeList;
+  freeList = *static_cast<void **>(node);
+  return node;
+}
+
+void
+NodePool::deallocate(void *node)
+{
+  *static_cast<void **>(node) = freeList;
+  freeList = node;
+}
+
+
+/*
+ * ExtentAllocator
+ */
+
+ExtentAllocator::ExtentAllocator(const uint64_t nPages, const Fit fit)
+  : fit(fit), startPool(), sizePool(),
+    byStart(StartIndex::allocator_type(&startPool)),
+    bySize(SizeIndex::allocator_type(&sizePool)),
+    cursor(0), nLeaves(1), largest()
+{
+  if (fit == Fit::Next)
+    {
+      while (nLeaves < nPages)
+        nLeaves *= 2;
+      largest.resize(2 * nLeaves, 0);
+    }
+
+  insertExtent(0, nPages);
+}
+
+void
+ExtentAllocator::insertExtent(const uint64_t startPage, const uint64_t count)
+{
+  byStart.emplace(startPage, count);
+  bySize.emplace(count, startPage);
+  updateLargest(startPage, count);
+}
+
+void
+ExtentAllocator::eraseExtent(StartIndex::iterator it)
+{
+  updateLargest(it->first, 0);
+  bySize.erase({ it->second, it->first });
+  byStart.erase(it);
+}
+
+void
+ExtentAllocator::updateLargest(const uint64_t startPage, const uint64_t count)
+{
+  if (largest.empty())
+    return;
+
+  uint64_t node = nLeaves + startPage;
+  largest[node] = count;
+  for (node /= 2; node >= 1; node /= 2)
+    largest[node] = std::max(largest[2 * node], largest[2 * node + 1]);
+}
+
+/* Returns the lowest start frame >= from of an extent of at least count
+ * frames within the subtree node covering [lo, hi), or nLeaves if none.
+ * Subtrees that lie before from or hold no fitting extent are skipped, so
+ * only the paths towards from and towards the result are followed.
+ */
+uint64_t
+ExtentAllocator::findLargest(const uint64_t node, const uint64_t lo,
+                             const uint64_t hi, const uint64_t from,
+                             const uint64_t count) const
+{
+  if (hi <= from || largest[node] < count)
+    return nLeaves;
+  if (node >= nLeaves)
+    return lo;
+
+  const uint64_t mid = lo + (hi - lo) / 2;
+  uint64_t found = findLargest(2 * node, lo, mid, from, count);
+  if (found == nLeaves)
+    found = findLargest(2 * node + 1, mid, hi, from, count);
+  return found;
+}
+
+/* Allocate [startPage, startPage + count) from the extent at it. */
+void
+ExtentAllocator::allocateFrom(StartIndex::iterator it,
+                              const uint64_t startPage, const uint64_t count)
+{
+  const uint64_t extentStart = it->first;
+  const uint64_t extentEnd = it->first + it->second;
+  eraseExtent(it);
+
+  if (startPage > extentStart)
+    insertExtent(extentStart, startPage - extentStart);
+  if (startPage + count < extentEnd)
+    insertExtent(startPage + count, extentEnd - (startPage + count));
+}
+
+ExtentAllocator::StartIndex::iterator
+ExtentAllocator::findNextFit(const uint64_t count)
+{
+  /* Start at the extent containing the cursor, if any. */
+  auto start = byStart.upper_bound(cursor);
+  if (start != byStart.begin() &&
+      std::prev(start)->first + std::prev(start)->second > cursor)
+    {
+      --start;
+      if (start->second >= count)
+        return start;
+    }
+
+  /* Then the first fitting extent after it, wrapping around once. */
+  const uint64_t from = start == byStart.end() ? nLeaves : start->first;
+  uint64_t found = findLargest(1, 0, nLeaves, from, count);
+  if (found == nLeaves)
+    found = findLargest(1, 0, nLeaves, 0, count);
+  if (found == nLeaves)
+    return byStart.end();
+
+  return byStart.find(found);
+}
+
+bool
+ExtentAllocator::allocate(const uint64_t count, uint64_t &startPage)
+{
+  if (fit == Fit::Best)
+    {
+      auto best = bySize.lower_bound({ count, 0 });
+      if (best == bySize.end())
+        return false;
+
+      startPage = best->second;
+      allocateFrom(byStart.find(startPage), startPage, count);
+      return true;
+    }
+
+  auto it = findNextFit(count);
+  if (it == byStart.end())
+    return false;
+
+  /* Continue at the cursor when it lies within the extent. */
+  startPage = std::max(it->first, cursor);
+  if (startPage + count > it->first + it->second)
+    startPage = it->first;
+
+  allocateFrom(it, startPage, count);
+  cursor = startPage + count;
+  return true;
+}
+
+bool
+ExtentAllocator::allocateAt(const uint64_t startPage, const uint64_t count)
+{
+  auto it = byStart.upper_bound(startPage);
+  if (it == byStart.begin())
+    return false;
+
+  --it;
+  if (startPage + count > it->first + it->second)
+    return false;
+
+  allocateFrom(it, startPage, count);
+  return true;
+}
+
+void
+ExtentAllocator::release(const uint64_t startPage, const uint64_t count)
+{
+  uint64_t newStart = startPage;
+  uint64_t newCount = count;
+
+  /* Coalesce with the following and preceding extents. */
+  auto next = byStart.lower_bound(startPage);
+  if (next != byStart.end() && next->first == startPage + count)
+    {
+      newCount += next->second;
+      auto following = std::next(next);
+      eraseExtent(next);
+      next = following;
+    }
+
+  if (next != byStart.begin())
+    {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == startPage)
+        {
+          newStart = prev->first;
+          newCount += prev->second;
+          eraseExtent(prev);
+        }
+    }
+
+  insertExtent(newStart, newCount);
+}
+
+uint64_t
+ExtentAllocator::getLargestFreeRun(void) const
+{
+  return bySize.empty() ? 0 : bySize.rbegin()->first;
+}
+
+void
+ExtentAllocator::getFreeMap(std::vector<bool> &freeMap) const
+{
+  for (const auto &extent : byStart)
+    std::fill_n(freeMap.begin() + extent.first, extent.second, true);
+}
+
+const char *
+ExtentAllocator::getName(void) const
+{
+  return fit == Fit::Best ? "bestfit" : "nextfit";
+}
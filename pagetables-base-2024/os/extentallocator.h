@@ -0,0 +1,153 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    extentallocator.h - Ordered free extent allocator
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __EXTENTALLOCATOR_H__
+#define __EXTENTALLOCATOR_H__
+
+#include "frameallocator.h"
+
+#include <map>
+#include <set>
+
+
+/* Pool of fixed-size nodes for the extent indexes. Freed nodes are kept on
+ * a free list and reused, so that the steady state of allocating and
+ * releasing frames does not call the general purpose allocator.
+ */
+class NodePool
+{
+  protected:
+    constexpr static size_t nodesPerChunk = 256;
+
+    size_t nodeSize;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    void *freeList;
+
+  public:
+    NodePool();
+
+    void     *allocate(const size_t size);
+    void      deallocate(void *node);
+
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+};
+
+/* Standard allocator handing out single nodes from a NodePool. */
+template<typename T>
+class PoolAllocator
+{
+  public:
+    using value_type = T;
+
+    NodePool *pool;
+
+    explicit PoolAllocator(NodePool *pool) noexcept : pool(pool) { }
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &other) noexcept : pool(other.pool) { }
+
+    T *allocate(const size_t n)
+    {
+      if (n != 1)
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+      return static_cast<T *>(pool->allocate(sizeof(T)));
+    }
+
+    void deallocate(T *p, const size_t n)
+    {
+      if (n != 1)
+        ::operator delete(p);
+      else
+        pool->deallocate(p);
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U> &other) const noexcept
+    {
+      return pool == other.pool;
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U> &other) const noexcept
+    {
+      return pool != other.pool;
+    }
+};
+
+
+/* Free ranges (extents) are kept in two ordered indexes: by start frame,
+ * to find and coalesce the neighbours of a released range in O(log n),
+ * and by size, to find the best fitting extent in O(log n).
+ *   BestFit: the smallest extent that fits, the lowest one among equals.
+ *   NextFit: the first extent that fits after the previous allocation.
+ * NextFit additionally keeps a max tree over the start frames, holding the
+ * largest extent per subtree, so that the first fitting extent after the
+ * cursor is also found in O(log n).
+ */
+class ExtentAllocator : public FrameAllocator
+{
+  public:
+    enum class Fit { Best, Next };
+
+  protected:
+    using StartIndex =
+      std::map<uint64_t, uint64_t, std::less<uint64_t>,
+               PoolAllocator<std::pair<const uint64_t, uint64_t>>>;
+    using SizeIndex =
+      std::set<std::pair<uint64_t, uint64_t>,
+               std::less<std::pair<uint64_t, uint64_t>>,
+               PoolAllocator<std::pair<uint64_t, uint64_t>>>;
+
+    const Fit fit;
+
+    /* The pools must outlive the indexes. */
+    NodePool startPool;
+    NodePool sizePool;
+
+    StartIndex byStart;   /* start -> count */
+    SizeIndex bySize;     /* (count, start) */
+
+    uint64_t cursor;      /* NextFit: end of the previous allocation */
+
+    /* NextFit: implicit binary tree with nLeaves leaves, leaf i holds the
+     * size of the extent starting at frame i (0 if none), inner nodes the
+     * maximum of their children.
+     */
+    uint64_t nLeaves;
+    std::vector<uint64_t> largest;
+
+    void      updateLargest(const uint64_t startPage, const uint64_t count);
+    uint64_t  findLargest(const uint64_t node, const uint64_t lo,
+                          const uint64_t hi, const uint64_t from,
+                          const uint64_t count) const;
+
+    void      insertExtent(const uint64_t startPage, const uint64_t count);
+    void      eraseExtent(StartIndex::iterator it);
+    void      allocateFrom(StartIndex::iterator it, const uint64_t startPage,
+                           const uint64_t count);
+    StartIndex::iterator findNextFit(const uint64_t count);
+
+  public:
+    ExtentAllocator(const uint64_t nPages, const Fit fit);
+
+    virtual bool      allocate(const uint64_t count,
+                               uint64_t &startPage) override;
+    virtual bool      allocateAt(const uint64_t startPage,
+                                 const uint64_t count) override;
+    virtual void      release(const uint64_t startPage,
+                              const uint64_t count) override;
+
+    virtual uint64_t  getLargestFreeRun(void) const override;
+    virtual void      getFreeMap(std::vector<bool> &freeMap) const override;
+    virtual const char *getName(void) const override;
+
+    ExtentAllocator(const ExtentAllocator &) = delete;
+    ExtentAllocator &operator=(const ExtentAllocator &) = delete;
+};
+
+#endif /* __EXTENTALLOCATOR_H__ */
@@ -0,0 +1,172 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    frameallocator.cc - Free frame tracking for the physical memory manager
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "frameallocator.h"
+#include "bitmapallocator.h"
+#include "extentallocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+FrameAllocator::~FrameAllocator()
+{
+}
+
+std::unique_ptr<FrameAllocator>
+createFrameAllocator(const std::string &name, const uint64_t nPages)
+{
+  if (name == "firstfit")
+    return std::make_unique<FirstFitAllocator>(nPages);
+  else if (name == "bitmap")
+    return std::make_unique<BitmapAllocator>(nPages);
+  else if (name == "bestfit")
+    return std::make_unique<ExtentAllocator>(nPages, ExtentAllocator::Fit::Best);
+  else if (name == "nextfit")
+    return std::make_unique<ExtentAllocator>(nPages, ExtentAllocator::Fit::Next);
+
+  throw std::runtime_error("unknown frame allocator: " + name);
+}
+
+
+/*
+ * FirstFitAllocator
+ */
+
+FirstFitAllocator::FirstFitAllocator(const uint64_t nPages)
+  : holes()
+{
+  /* Initialize hole list with one large hole covering all memory */
+  holes.emplace_back(0, nPages);
+}
+
+std::list<Hole>::iterator
+FirstFitAllocator::findFit(size_t count)
+{
+  /* First-fit algorithm: find the first hole that can accommodate 'count' pages */
+  for (auto it = holes.begin(); it != holes.end(); ++it) {
+    if (it->count >= count) {
+      return it;
+    }
+  }
+  return holes.end();
+}
+
+void
+FirstFitAllocator::splitHole(std::list<Hole>::iterator it, uint64_t startPage, uint64_t count)
+{
+  /* Split a hole after allocating 'count' pages starting at 'startPage' */
+  Hole originalHole = *it;
+  holes.erase(it);
+
+  /* Add hole before allocation if any */
+  if (startPage > originalHole.startPage) {
+    holes.emplace_back(originalHole.startPage, startPage - originalHole.startPage);
+  }
+
+  /* Add hole after allocation if any */
+  uint64_t endPage = startPage + count;
+  uint64_t originalEndPage = originalHole.startPage + originalHole.count;
+  if (endPage < originalEndPage) {
+    holes.emplace_back(endPage, originalEndPage - endPage);
+  }
+}
+
+void
+FirstFitAllocator::addHole(uint64_t startPage, uint64_t count)
+{
+  /* Add a new hole to the list */
+  holes.emplace_back(startPage, count);
+}
+
+void
+FirstFitAllocator::mergeHoles()
+{
+  /* Sort holes by start page for efficient merging */
+  holes.sort([](const Hole &a, const Hole &b) {
+    return a.startPage < b.startPage;
+  });
+
+  /* Merge adjacent holes */
+  auto it = holes.begin();
+  while (it != holes.end()) {
+    auto next = std::next(it);
+    if (next != holes.end() && it->startPage + it->count == next->startPage) {
+      /* Merge adjacent holes */
+      it->count += next->count;
+      holes.erase(next);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool
+FirstFitAllocator::allocate(const uint64_t count, uint64_t &startPage)
+{
+  /* Find first hole that fits using first-fit algorithm */
+  auto it = findFit(count);
+  if (it == holes.end()) {
+    return false;
+  }
+
+  /* Allocate from the beginning of the found hole */
+  startPage = it->startPage;
+
+  /* Update hole list by splitting the hole */
+  splitHole(it, startPage, count);
+
+  return true;
+}
+
+bool
+FirstFitAllocator::allocateAt(const uint64_t startPage, const uint64_t count)
+{
+  /* Find the hole that contains the requested range, if any. */
+  for (auto it = holes.begin(); it != holes.end(); ++it) {
+    if (it->startPage <= startPage &&
+        startPage + count <= it->startPage + it->count) {
+      splitHole(it, startPage, count);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+FirstFitAllocator::release(const uint64_t startPage, const uint64_t count)
+{
+  /* Add the released pages as a new hole */
+  addHole(startPage, count);
+
+  /* Merge adjacent holes to minimize fragmentation */
+  mergeHoles();
+}
+
+uint64_t
+FirstFitAllocator::getLargestFreeRun(void) const
+{
+  uint64_t largest = 0;
+  for (const Hole &hole : holes)
+    largest = std::max(largest, hole.count);
+
+  return largest;
+}
+
+void
+FirstFitAllocator::getFreeMap(std::vector<bool> &freeMap) const
+{
+  for (const Hole &hole : holes)
+    std::fill_n(freeMap.begin() + hole.startPage, hole.count, true);
+}
+
+const char *
+FirstFitAllocator::getName(void) const
+{
+  return "firstfit";
+}
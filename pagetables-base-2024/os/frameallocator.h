@@ -0,0 +1,91 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    frameallocator.h - Free frame tracking for the physical memory manager
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __FRAMEALLOCATOR_H__
+#define __FRAMEALLOCATOR_H__
+
+#include "settings.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/* Interface of the data structures that keep track of free physical
+ * frames. Frames are identified by their index in physical memory; the
+ * physical memory manager translates these to addresses and keeps the
+ * statistics.
+ */
+class FrameAllocator
+{
+  public:
+    virtual ~FrameAllocator();
+
+    /* Allocate count contiguous frames; returns the first in startPage. */
+    virtual bool      allocate(const uint64_t count, uint64_t &startPage) = 0;
+
+    /* Allocate the given frames, if these are all free. */
+    virtual bool      allocateAt(const uint64_t startPage,
+                                 const uint64_t count) = 0;
+
+    virtual void      release(const uint64_t startPage,
+                              const uint64_t count) = 0;
+
+    virtual uint64_t  getLargestFreeRun(void) const = 0;
+
+    /* Mark all free frames in freeMap, which is all false on entry. */
+    virtual void      getFreeMap(std::vector<bool> &freeMap) const = 0;
+    virtual const char *getName(void) const = 0;
+};
+
+/* Create the allocator with the given name ("firstfit", "bitmap",
+ * "bestfit" or "nextfit") for nPages frames, all free. Throws
+ * std::runtime_error for unknown names.
+ */
+std::unique_ptr<FrameAllocator>
+createFrameAllocator(const std::string &name, const uint64_t nPages);
+
+
+struct Hole
+{
+  uint64_t startPage;
+  uint64_t count;
+
+  Hole(uint64_t start, uint64_t cnt) : startPage(start), count(cnt) {}
+};
+
+/* First-fit allocation from an (unordered) list of holes. */
+class FirstFitAllocator : public FrameAllocator
+{
+  protected:
+    /* Hole list: maintains free memory regions */
+    std::list<Hole> holes;
+
+    /* Helper methods for hole management */
+    void mergeHoles();
+    std::list<Hole>::iterator findFit(size_t count);
+    void addHole(uint64_t startPage, uint64_t count);
+    void splitHole(std::list<Hole>::iterator it, uint64_t startPage,
+                   uint64_t count);
+
+  public:
+    FirstFitAllocator(const uint64_t nPages);
+
+    virtual bool      allocate(const uint64_t count,
+                               uint64_t &startPage) override;
+    virtual bool      allocateAt(const uint64_t startPage,
+                                 const uint64_t count) override;
+    virtual void      release(const uint64_t startPage,
+                              const uint64_t count) override;
+
+    virtual uint64_t  getLargestFreeRun(void) const override;
+    virtual void      getFreeMap(std::vector<bool> &freeMap) const override;
+    virtual const char *getName(void) const override;
+};
+
+#endif /* __FRAMEALLOCATOR_H__ */
@@ -0,0 +1,105 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    framecache.cc - Per-CPU page frame caches
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "framecache.h"
+#include "physmemmanager.h"
+
+#include <iostream>
+
+
+FrameCache::FrameCache(PhysMemManager &manager, const size_t nCPUs,
+                       const size_t batchSize)
+  : manager(manager), batchSize(batchSize), lock(), magazines(nCPUs)
+{
+  /* A magazine holds at most two batches; reserve up front such that the
+   * fast paths never allocate.
+   */
+  for (Magazine &magazine : magazines)
+    magazine.frames.reserve(2 * batchSize);
+}
+
+FrameCache::~FrameCache()
+{
+  drain();
+
+  uint64_t nAllocs = 0, nReleases = 0, nRefills = 0, nDrains = 0;
+  for (const Magazine &magazine : magazines)
+    {
+      nAllocs += magazine.nAllocs;
+      nReleases += magazine.nReleases;
+      nRefills += magazine.nRefills;
+      nDrains += magazine.nDrains;
+    }
+
+  std::cerr << std::dec << std::endl
+            << "Frame Cache Statistics:" << std::endl
+            << "# CPUs: " << magazines.size()
+            << ", batch size: " << batchSize << std::endl
+            << "# page allocations: " << nAllocs
+            << " (refills: " << nRefills << ")" << std::endl
+            << "# page releases: " << nReleases
+            << " (drains: " << nDrains << ")" << std::endl;
+}
+
+bool
+FrameCache::allocatePage(const unsigned cpu, uintptr_t &addr)
+{
+  Magazine &magazine = magazines[cpu];
+
+  if (magazine.frames.empty())
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (manager.allocateBatch(batchSize, magazine.frames) == 0)
+        return false;
+      ++magazine.nRefills;
+    }
+
+  addr = magazine.frames.back();
+  magazine.frames.pop_back();
+  manager.takeCachedPage();
+  ++magazine.nAllocs;
+
+  return true;
+}
+
+void
+FrameCache::releasePage(const unsigned cpu, const uintptr_t addr)
+{
+  Magazine &magazine = magazines[cpu];
+
+  /* Return the oldest batch, keeping recently released (cache-hot) frames
+   * in the magazine.
+   */
+  if (magazine.frames.size() >= 2 * batchSize)
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      manager.releaseBatch(magazine.frames.data(), batchSize);
+      magazine.frames.erase(magazine.frames.begin(),
+                            magazine.frames.begin() + batchSize);
+      ++magazine.nDrains;
+    }
+
+  manager.putCachedPage();
+  magazine.frames.push_back(addr);
+  ++magazine.nReleases;
+}
+
+size_t
+FrameCache::drain(void)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  size_t count = 0;
+  for (Magazine &magazine : magazines)
+    {
+      manager.releaseBatch(magazine.frames.data(), magazine.frames.size());
+      count += magazine.frames.size();
+      magazine.frames.clear();
+    }
+
+  return count;
+}
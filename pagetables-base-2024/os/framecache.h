@@ -0,0 +1,73 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    framecache.h - Per-CPU page frame caches
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __FRAMECACHE_H__
+#define __FRAMECACHE_H__
+
+#include "settings.h"
+
+#include <mutex>
+#include <vector>
+
+class PhysMemManager;
+
+
+/* A concurrent front end for single-page allocations. Every CPU (thread)
+ * owns a magazine: a stack of free frames that it allocates from and
+ * releases to without synchronization. An empty magazine is refilled with
+ * a batch of frames from the physical memory manager, a full one is
+ * drained by returning a batch; only these bulk transfers take the global
+ * lock. A CPU index must only be used by one thread at a time.
+ *
+ * Pages in magazines remain allocated in the physical memory manager, but
+ * are accounted as cached, such that getMaxAllocatedPages() still reports
+ * the pages actually in use.
+ */
+class FrameCache
+{
+  protected:
+    /* Aligned to avoid false sharing between CPUs. */
+    struct alignas(64) Magazine
+    {
+      std::vector<uintptr_t> frames;
+      uint64_t nAllocs;
+      uint64_t nReleases;
+      uint64_t nRefills;
+      uint64_t nDrains;
+
+      Magazine()
+        : frames(), nAllocs(0), nReleases(0), nRefills(0), nDrains(0)
+      { }
+    };
+
+    PhysMemManager &manager;
+    const size_t batchSize;
+    std::mutex lock;
+    std::vector<Magazine> magazines;
+
+  public:
+    FrameCache(PhysMemManager &manager, const size_t nCPUs,
+               const size_t batchSize);
+    ~FrameCache();
+
+    /* Allocate a single frame for the given CPU. Returns false if both the
+     * magazine and the physical memory manager are empty.
+     */
+    bool      allocatePage(const unsigned cpu, uintptr_t &addr);
+    void      releasePage(const unsigned cpu, const uintptr_t addr);
+
+    /* Return the frames of all magazines to the physical memory manager,
+     * e.g. before reclaiming memory. Must not run concurrently with
+     * allocatePage() or releasePage(). Returns the number of frames.
+     */
+    size_t    drain(void);
+
+    FrameCache(const FrameCache &) = delete;
+    FrameCache &operator=(const FrameCache &) = delete;
+};
+
+#endif /* __FRAMECACHE_H__ */
@@ -0,0 +1,70 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    hyperloglog.cc - Cardinality estimation in bounded memory
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "hyperloglog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+HyperLogLog::HyperLogLog(const int precision)
+  : precision(precision), registers()
+{
+  if (precision < 4 || precision > 18)
+    throw std::runtime_error("HyperLogLog precision must be between 4 and 18.");
+
+  registers.resize(1UL << precision, 0);
+}
+
+/* The finalizer of splitmix64. */
+uint64_t
+HyperLogLog::hash(const uint64_t value)
+{
+  uint64_t z = value + 0x9e3779b97f4a7c15UL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+  return z ^ (z >> 31);
+}
+
+void
+HyperLogLog::merge(const HyperLogLog &other)
+{
+  if (other.precision != precision)
+    throw std::runtime_error("cannot merge HyperLogLogs of different precision.");
+
+  for (size_t i = 0; i < registers.size(); ++i)
+    registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+void
+HyperLogLog::clear(void)
+{
+  std::fill(registers.begin(), registers.end(), 0);
+}
+
+double
+HyperLogLog::estimate(void) const
+{
+  const double m = registers.size();
+  double sum = 0.;
+  size_t nZero = 0;
+  for (const uint8_t reg : registers)
+    {
+      sum += std::ldexp(1., -reg);
+      if (reg == 0)
+        ++nZero;
+    }
+
+  const double alpha = 0.7213 / (1. + 1.079 / m);
+  const double raw = alpha * m * m / sum;
+
+  if (raw <= 2.5 * m && nZero > 0)
+    return m * std::log(m / nZero);
+
+  return raw;
+}
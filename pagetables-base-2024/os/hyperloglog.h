@@ -0,0 +1,53 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    hyperloglog.h - Cardinality estimation in bounded memory
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __HYPERLOGLOG_H__
+#define __HYPERLOGLOG_H__
+
+#include <cstdint>
+#include <vector>
+
+
+/* HyperLogLog sketch (Flajolet et al.) that estimates the number of
+ * distinct values added to it, using 2^precision one byte registers. The
+ * standard error is about 1.04 / sqrt(2^precision), i.e. 0.8% for the
+ * default precision. Small cardinalities are estimated by linear
+ * counting.
+ */
+class HyperLogLog
+{
+  protected:
+    const int precision;
+    std::vector<uint8_t> registers;
+
+  public:
+    HyperLogLog(const int precision = 14);
+
+    /* Mixes value into a uniformly distributed 64-bit hash. */
+    static uint64_t hash(const uint64_t value);
+
+    inline void add(const uint64_t value)
+    {
+      const uint64_t h = hash(value);
+      const uint64_t index = h >> (64 - precision);
+      /* Rank of the first set bit in the remaining bits; the sentinel
+       * bit bounds it when all of these are zero.
+       */
+      const uint64_t rest = (h << precision) | (1UL << (precision - 1));
+      const uint8_t rank = __builtin_clzll(rest) + 1;
+      if (rank > registers[index])
+        registers[index] = rank;
+    }
+
+    /* Add all values of other, which must have the same precision. */
+    void      merge(const HyperLogLog &other);
+    void      clear(void);
+
+    double    estimate(void) const;
+};
+
+#endif /* __HYPERLOGLOG_H__ */
@@ -0,0 +1,206 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    livestats.cc - Live metrics shared through a memory-mapped file
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "livestats.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+static volatile std::sig_atomic_t snapshotSignalled = 0;
+
+static void
+snapshotHandler(int)
+{
+  snapshotSignalled = 1;
+}
+
+
+/*
+ * LiveSnapshot
+ */
+
+void
+LiveSnapshot::print(std::ostream &os) const
+{
+  const LiveSnapshot &s = *this;
+  const uint64_t lookups = s[LiveCounter::TLBLookups];
+
+  os << std::dec
+     << "# elapsed: " << s[LiveCounter::ElapsedMs] / 1000. << " s"
+     << (s[LiveCounter::Finished] ? " (finished)" : "") << std::endl
+     << "# accesses: " << s[LiveCounter::Accesses]
+     << " (" << s[LiveCounter::AccessesPerSec] << "/s)" << std::endl
+     << "# TLB hits: " << s[LiveCounter::TLBHits] << " of " << lookups
+     << " (" << (lookups ? 100. * s[LiveCounter::TLBHits] / lookups : 0.)
+     << "%)" << std::endl
+     << "# page faults: " << s[LiveCounter::PageFaults] << std::endl
+     << "# context switches: " << s[LiveCounter::ContextSwitches] << std::endl
+     << "# evicted pages: " << s[LiveCounter::EvictedPages] << std::endl
+     << "# allocated pages: " << s[LiveCounter::AllocatedPages]
+     << " of " << s[LiveCounter::TotalPages] << std::endl;
+
+  const uint64_t nProcesses = std::min<uint64_t>(s[LiveCounter::NProcesses],
+                                                 maxLiveProcesses);
+  for (uint64_t i = 0; i < nProcesses; ++i)
+    {
+      const uint64_t processLookups = s.at(i, LiveProcessCounter::TLBLookups);
+      os << "# ASID " << s.at(i, LiveProcessCounter::ASID) << ": "
+         << s.at(i, LiveProcessCounter::LiveThreads) << " of "
+         << s.at(i, LiveProcessCounter::Threads) << " threads running, "
+         << s.at(i, LiveProcessCounter::Accesses) << " accesses, "
+         << s.at(i, LiveProcessCounter::PageFaults) << " page faults, TLB hit rate "
+         << std::setprecision(3)
+         << (processLookups ? 100. * s.at(i, LiveProcessCounter::TLBHits) / processLookups : 0.)
+         << std::setprecision(6) << "%" << std::endl;
+    }
+}
+
+
+/*
+ * LiveStatsRegion
+ */
+
+bool
+LiveStatsRegion::read(LiveSnapshot &snapshot) const
+{
+  for (int attempt = 0; attempt < 1000; ++attempt)
+    {
+      const uint64_t before = sequence.load(std::memory_order_acquire);
+      if (before & 1)
+        continue;
+
+      for (int i = 0; i < nLiveCounters; ++i)
+        snapshot.counters[i] = counters[i].load(std::memory_order_relaxed);
+      for (int p = 0; p < maxLiveProcesses; ++p)
+        for (int i = 0; i < nLiveProcessCounters; ++i)
+          snapshot.processes[p][i] = processes[p][i].load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == before)
+        return true;
+    }
+
+  return false;
+}
+
+void
+LiveStatsRegion::write(const LiveSnapshot &snapshot)
+{
+  const uint64_t current = sequence.load(std::memory_order_relaxed);
+  sequence.store(current + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (int i = 0; i < nLiveCounters; ++i)
+    counters[i].store(snapshot.counters[i], std::memory_order_relaxed);
+  for (int p = 0; p < maxLiveProcesses; ++p)
+    for (int i = 0; i < nLiveProcessCounters; ++i)
+      processes[p][i].store(snapshot.processes[p][i], std::memory_order_relaxed);
+
+  sequence.store(current + 2, std::memory_order_release);
+}
+
+
+/*
+ * LiveStats
+ */
+
+constexpr std::chrono::milliseconds LiveStats::updateInterval;
+constexpr std::chrono::seconds LiveStats::rateInterval;
+
+LiveStats::LiveStats(const std::string &filename)
+  : filename(filename), region(nullptr), start(Clock::now()),
+    lastUpdate(start), lastRate(start), lastRateAccesses(0), accessesPerSec(0),
+    previousAction()
+{
+  const size_t size = sizeof(LiveStatsRegion);
+  const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, size) != 0)
+    {
+      const std::string error(std::strerror(errno));
+      if (fd >= 0)
+        close(fd);
+      throw std::runtime_error("Could not create live statistics file " +
+                               filename + ": " + error);
+    }
+
+  void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+    throw std::runtime_error("Could not map live statistics file " + filename);
+
+  /* The mapping is zero filled; the magic is set last, such that readers
+   * ignore a region that is not yet initialized.
+   */
+  region = static_cast<LiveStatsRegion *>(mem);
+  region->pid.store(getpid(), std::memory_order_relaxed);
+  region->magic.store(LiveStatsRegion::magicValue, std::memory_order_release);
+
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = snapshotHandler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR1, &action, &previousAction);
+}
+
+LiveStats::~LiveStats()
+{
+  sigaction(SIGUSR1, &previousAction, nullptr);
+  munmap(region, sizeof(LiveStatsRegion));
+}
+
+bool
+LiveStats::isDue(void)
+{
+  return snapshotSignalled || Clock::now() - lastUpdate >= updateInterval;
+}
+
+void
+LiveStats::update(LiveSnapshot &snapshot)
+{
+  const Clock::time_point now = Clock::now();
+  const uint64_t accesses = snapshot[LiveCounter::Accesses];
+  if (now - lastRate >= rateInterval)
+    {
+      const double seconds = std::chrono::duration<double>(now - lastRate).count();
+      accessesPerSec = (accesses - lastRateAccesses) / seconds;
+      lastRate = now;
+      lastRateAccesses = accesses;
+    }
+  else if (lastRate == start && now > start)
+    {
+      /* Less than rateInterval since the start */
+      const double seconds = std::chrono::duration<double>(now - start).count();
+      accessesPerSec = accesses / seconds;
+    }
+
+  snapshot[LiveCounter::AccessesPerSec] = accessesPerSec;
+  snapshot[LiveCounter::ElapsedMs] =
+    std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+
+  region->write(snapshot);
+  lastUpdate = now;
+}
+
+bool
+LiveStats::snapshotRequested(void)
+{
+  if (not snapshotSignalled)
+    return false;
+
+  snapshotSignalled = 0;
+  return true;
+}
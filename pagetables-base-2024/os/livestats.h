@@ -0,0 +1,150 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    livestats.h - Live metrics shared through a memory-mapped file
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __LIVESTATS_H__
+#define __LIVESTATS_H__
+
+#include <stdint.h>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <string>
+
+
+/* Counters of the whole simulation and of every process, by index. */
+enum class LiveCounter : int
+{
+  Accesses,
+  AccessesPerSec,
+  TLBLookups,
+  TLBHits,
+  PageFaults,
+  ContextSwitches,
+  EvictedPages,
+  AllocatedPages,
+  TotalPages,
+  NProcesses,
+  ElapsedMs,
+  Finished,
+  Count
+};
+
+enum class LiveProcessCounter : int
+{
+  ASID,
+  Threads,
+  LiveThreads,
+  Accesses,
+  PageFaults,
+  TLBLookups,   /* accounted at context switches */
+  TLBHits,
+  Count
+};
+
+constexpr static int nLiveCounters = static_cast<int>(LiveCounter::Count);
+constexpr static int nLiveProcessCounters = static_cast<int>(LiveProcessCounter::Count);
+constexpr static int maxLiveProcesses = 64;  /* by ASID, further ones are not shown */
+
+/* A consistent copy of all counters. */
+struct LiveSnapshot
+{
+  uint64_t counters[nLiveCounters];
+  uint64_t processes[maxLiveProcesses][nLiveProcessCounters];
+
+  LiveSnapshot() : counters{}, processes{} { }
+
+  inline uint64_t &operator[](const LiveCounter counter)
+  {
+    return counters[static_cast<int>(counter)];
+  }
+
+  inline uint64_t operator[](const LiveCounter counter) const
+  {
+    return counters[static_cast<int>(counter)];
+  }
+
+  inline uint64_t &at(const int process, const LiveProcessCounter counter)
+  {
+    return processes[process][static_cast<int>(counter)];
+  }
+
+  inline uint64_t at(const int process, const LiveProcessCounter counter) const
+  {
+    return processes[process][static_cast<int>(counter)];
+  }
+
+  void      print(std::ostream &os) const;
+};
+
+/* Layout of the file. The counters are written under a sequence lock:
+ * the sequence number is odd while an update is in progress, such that a
+ * reader in another process can retry until it has copied a consistent
+ * snapshot, without ever blocking the simulation.
+ */
+struct LiveStatsRegion
+{
+  constexpr static uint64_t magicValue = 0x3145564c54474150UL;  /* "PAGTLVE1" */
+
+  std::atomic<uint64_t> magic;
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> pid;         /* of the simulator */
+  std::atomic<uint64_t> counters[nLiveCounters];
+  std::atomic<uint64_t> processes[maxLiveProcesses][nLiveProcessCounters];
+
+  /* Returns false if no consistent snapshot was obtained in a number of
+   * attempts.
+   */
+  bool      read(LiveSnapshot &snapshot) const;
+  void      write(const LiveSnapshot &snapshot);
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "live statistics need lock-free 64-bit atomics");
+
+
+/* Publishes the counters of a running simulation, at most every
+ * updateInterval of wall clock time, to a memory-mapped file that
+ * pagetables-top reads. On SIGUSR1 the next update is printed as well;
+ * the previous handler of SIGUSR1 is restored on destruction.
+ */
+class LiveStats
+{
+  protected:
+    constexpr static std::chrono::milliseconds updateInterval{ 100 };
+    constexpr static std::chrono::seconds rateInterval{ 1 };
+
+    using Clock = std::chrono::steady_clock;
+
+    const std::string filename;
+    LiveStatsRegion *region;
+    Clock::time_point start;
+    Clock::time_point lastUpdate;
+    Clock::time_point lastRate;
+    uint64_t lastRateAccesses;
+    uint64_t accessesPerSec;
+    struct sigaction previousAction;
+
+  public:
+    LiveStats(const std::string &filename);
+    ~LiveStats();
+
+    /* Whether an update is due, or a snapshot was requested. */
+    bool      isDue(void);
+
+    /* Publish the counters; the rate and elapsed time are filled in. */
+    void      update(LiveSnapshot &snapshot);
+
+    /* Whether SIGUSR1 was received since the last call. */
+    static bool snapshotRequested(void);
+
+    LiveStats(const LiveStats &) = delete;
+    LiveStats &operator=(const LiveStats &) = delete;
+};
+
+#endif /* __LIVESTATS_H__ */
@@ -7,8 +7,16 @@
 
 #include "oskernel.h"
 #include "physmemmanager.h"
+#include "swapmanager.h"
+#include "compressedpool.h"
+#include "compactor.h"
+#include "framecache.h"
+#include "scheduler.h"
+#include "tlbgather.h"
+#include "livestats.h"
 #include "settings.h"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -25,32 +33,171 @@ MMUDriver::~MMUDriver()
 {
 }
 
+/* By default, page tables cannot be shared. */
+
+uint64_t
+MMUDriver::getSharedTableSpan(void) const
+{
+  return 0;
+}
+
+bool
+MMUDriver::linkSharedTable(const uint64_t, const uintptr_t, const bool)
+{
+  throw std::runtime_error("shared page tables are not supported.");
+}
+
+void
+MMUDriver::releaseSharedTable(const uintptr_t)
+{
+}
+
+void
+MMUDriver::reportPageTable(const uint64_t, std::ostream &) const
+{
+}
+
 
 /*
  * OSKernel
  */
 
 OSKernel::OSKernel(Processor &processor, MMUDriver &driver,
-                   uint64_t memorySize, ProcessList &processList)
-  : manager(std::make_unique<PhysMemManager>(driver.getPageSize(), memorySize)),
+                   uint64_t memorySize, ProcessList processList)
+  : manager(std::make_unique<PhysMemManager>(driver.getPageSize(), memorySize,
+                                             PhysAllocator)),
+    zswap(nullptr), swap(nullptr), compactor(nullptr), frameCache(nullptr),
     processor(processor), driver(driver),
-    processList(processList), current(nullptr),
-    nPageFaults(0), nContextSwitches(0), processPages()
+    scheduler(nullptr), tlbGather(nullptr),
+    liveStats(nullptr), cores(NCores),
+    nPageFaults(0), nContextSwitches(0), nEvictedPages(0),
+    nHighOrderAllocs(0), nHighOrderFailures(0), nSharedLinks(0), nSharedRefs(0),
+    sharedSpan(driver.getSharedTableSpan()), sharedRanges(), sharedRegions(),
+    processPages(),
+    clockPID(0), clockIndex(0), addressSpaces(),
+    threadStats(), nextTableReport(PageTableStatsInterval),
+    nextCompactionCheck(0)
 {
+  if (CompactionEnabled)
+    compactor = std::make_unique<Compactor>(*manager, driver);
+
+  /* Page colours are derived from the geometry of the modelled cache. */
+  ColourPolicy colourPolicy = parseColourPolicy(PageColouring);
+  if (colourPolicy != ColourPolicy::None)
+    {
+      Cache *cache = processor.getMMU().getCache();
+      if (not cache)
+        throw std::runtime_error("page colouring requires a cache model.");
+
+      manager->setColouring(colourPolicy,
+                            cache->getNColours(driver.getPageSize()));
+    }
+
+  /* Frames in the per-CPU caches have no colour, so the frame cache
+   * cannot be combined with page colouring.
+   */
+  if (FrameCacheBatch > 0)
+    {
+      if (colourPolicy != ColourPolicy::None)
+        throw std::runtime_error("frame cache cannot be combined with page colouring.");
+
+      frameCache = std::make_unique<FrameCache>(*manager, NCores,
+                                                FrameCacheBatch);
+    }
+
+  /* The compressed pool takes its frames from the frame cache as well,
+   * once the physical memory manager runs out.
+   */
+  if (ZswapFraction > 0.)
+    zswap = std::make_unique<CompressedPool>(*manager, driver.getPageSize(),
+                                             memorySize / driver.getPageSize(),
+                                             ZswapFraction, ZswapRatio,
+                                             frameCache.get());
+
+  if (not SwapDevice.empty() || zswap)
+    swap = std::make_unique<SwapManager>(SwapDevice, driver.getPageSize(),
+                                         SwapSize << 10, zswap.get());
+
   driver.setHostKernel(this);
 
-  /* Allocate root page tables for all processes. */
-  for (auto &p : processList)
-    driver.allocatePageTable(p->getPID());
+  /* Shared ranges must cover whole shared tables: rounding these outwards
+   * would share, or map globally, the private pages mapped by the same
+   * table. Global ranges take precedence where these overlap.
+   */
+  for (bool global : { true, false })
+    for (const auto &range : global ? GlobalRanges : SharedRanges)
+      {
+        if (sharedSpan == 0)
+          throw std::runtime_error("shared mappings are not supported by this page table.");
+        if (range.second <= range.first)
+          throw std::runtime_error("empty shared range.");
+        if (range.first % sharedSpan != 0 || range.second % sharedSpan != 0)
+          throw std::runtime_error("shared range not aligned to "
+                                   + std::to_string(sharedSpan >> 10)
+                                   + " KiB.");
+
+        sharedRanges.push_back(SharedRange{ range.first / sharedSpan,
+                                            (range.second - 1) / sharedSpan + 1,
+                                            global });
+      }
+
+  /* The affinity policy asks for the TLB entries left of an address
+   * space, the lottery policy for the tickets of its process. The ASID
+   * is the number of the process.
+   */
+  scheduler = createScheduler(SchedulerPolicy, ProcessTimeQuantum,
+                              [this](const Process &thread)
+                                {
+                                  const uint64_t asid = addressSpaces.at(thread.getPID()).asid;
+                                  return this->processor.getMMU().getTLBFootprint(asid);
+                                },
+                              [this](const Process &thread)
+                                {
+                                  const uint64_t asid = addressSpaces.at(thread.getPID()).asid;
+                                  auto it = LotteryTickets.find(asid);
+                                  return it == LotteryTickets.end()
+                                      ? LotteryScheduler::defaultTickets : it->second;
+                                });
 
   /* Configure processor: set page fault handler ("exception routine"),
-   * timer interrupt interval and interrupt handler.
+   * timer interrupt interval and interrupt handler. The TLB gather
+   * exists before the first page table is allocated, which may reclaim.
    */
   using std::placeholders::_1;
   processor.getMMU().initialize(std::bind(&OSKernel::pageFaultHandler,
                                           this, _1 ));
 
   processor.setTimerInterval(ProcessTimeQuantum);
+  processor.setNCores(NCores);
+
+  /* Dirty bits are only read when pages are reclaimed. */
+  processor.getMMU().setDirtyTracking(swap != nullptr);
+
+  tlbGather = std::make_unique<TLBGather>(processor, TLBFlushCeiling);
+
+  /* Allocate root page tables for all processes; threads of the same
+   * process share one. ASIDs are assigned in order, starting at 1. The
+   * scheduler takes over all threads.
+   */
+  for (auto &p : processList)
+    {
+      auto it = addressSpaces.find(p->getPID());
+      if (it == addressSpaces.end())
+        {
+          driver.allocatePageTable(p->getPID());
+          it = addressSpaces.emplace(p->getPID(),
+                                     AddressSpace(addressSpaces.size() + 1)).first;
+        }
+      ++it->second.nThreads;
+      ++it->second.nLiveThreads;
+
+      threadStats.emplace(p->getTID(), ThreadStats(threadStats.size() + 1,
+                                                   p->getPID()));
+      makeReady(p);
+    }
+
+  if (not LiveStatsFile.empty())
+    liveStats = std::make_unique<LiveStats>(LiveStatsFile);
 
   processor.setInterruptHandler(std::bind(&OSKernel::interruptHandler,
                                           this, _1 ));
@@ -58,18 +205,33 @@ OSKernel::OSKernel(Processor &processor, MMUDriver &driver,
 
 OSKernel::~OSKernel()
 {
-  if (current != nullptr)
-    {
-      processor.setProcess(nullptr);
-      processList.push_back(current);
-    }
+  for (unsigned core = 0; core < cores.size(); ++core)
+    if (cores[core].current != nullptr)
+      {
+        processor.selectCore(core);
+        processor.setProcess(nullptr);
+        scheduler->enqueue(cores[core].current);
+        cores[core].current = nullptr;
+      }
 
   /* Terminate all processes that remain. */
-  for (auto &p : processList)
-    terminateProcess(p->getPID());
+  while (std::shared_ptr<Process> thread = scheduler->pickNext())
+    exitThread(thread);
+
+  /* The pages of global regions outlive all processes. */
+  releaseOwnedPages(sharedPID);
+  for (const auto &kv : sharedRegions)
+    driver.releaseSharedTable(kv.first * sharedSpan);
+  sharedRegions.clear();
 
   driver.setHostKernel(nullptr);
 
+  if (frameCache)
+    frameCache->drain();
+
+  if (liveStats)
+    updateLiveStats(true);
+
   /* Check all allocated memory was released. */
   if (not manager->allReleased())
     std::cerr << std::endl
@@ -79,10 +241,63 @@ OSKernel::~OSKernel()
             << "Statistics:" << std::endl
             << "# context switches: " << getNContextSwitches() << std::endl
             << "# handled page faults: " << getNPageFaults() << std::endl
+            << "# evicted pages: " << getNEvictedPages() << std::endl
+            << "# high-order allocations: " << nHighOrderAllocs
+            << " (failed: " << nHighOrderFailures << ")" << std::endl;
+  if (not sharedRanges.empty())
+    std::cerr << "# shared table links: " << nSharedLinks << std::endl
+              << "# shared page references: " << nSharedRefs << std::endl;
+  std::cerr
             << "# bytes allocated for page tables: "
             << driver.getBytesAllocated() << std::endl
             << "max. # allocated physical pages: "
             << getMaxAllocatedPages() << std::endl;
+
+  std::map<uint64_t, const AddressSpace *> byASID;
+  for (const auto &kv : addressSpaces)
+    byASID[kv.second.asid] = &kv.second;
+
+  std::cerr << std::endl << "Address Space Statistics:" << std::endl;
+  for (const auto &kv : byASID)
+    {
+      const AddressSpace &as = *kv.second;
+      std::cerr << "# ASID " << as.asid << " (" << as.nThreads << " thread"
+                << (as.nThreads == 1 ? "" : "s") << "): "
+                << as.nPageFaults << " page faults, "
+                << as.nSwitches << " switches ("
+                << as.nThreadSwitches << " between threads), "
+                << "TLB hits: " << as.nTLBHits << "/" << as.nTLBLookups;
+      if (as.nTLBLookups > 0)
+        std::cerr << " (" << (((float)as.nTLBHits/as.nTLBLookups)*100.) << "%)";
+      std::cerr << std::endl;
+    }
+
+  std::map<int, const ThreadStats *> byNumber;
+  for (const auto &kv : threadStats)
+    byNumber[kv.second.number] = &kv.second;
+
+  std::cerr << std::endl << "Scheduler Statistics (" << scheduler->getName()
+            << "):" << std::endl;
+  for (const auto &kv : byNumber)
+    {
+      const ThreadStats &stats = *kv.second;
+      std::cerr << "# thread " << stats.number << " (ASID "
+                << addressSpaces.at(stats.PID).asid << "): "
+                << "runtime " << stats.runtime << ", "
+                << "wait time " << stats.waitTime << ", "
+                << stats.nDispatches << " switches, "
+                << stats.nTLBMisses << " TLB misses";
+      if (stats.nDispatches > 0)
+        std::cerr << " (" << ((float)stats.nTLBMisses / stats.nDispatches)
+                  << " per switch)";
+      std::cerr << std::endl;
+    }
+
+  if (cores.size() > 1)
+    std::cerr << std::endl
+              << "Multi-core Statistics:" << std::endl
+              << "# cores: " << cores.size()
+              << (GangScheduling ? " (gang scheduled)" : "") << std::endl;
 }
 
 void *
@@ -101,7 +316,7 @@ OSKernel::allocateMemory(size_t size, uint64_t align)
   size = (size + (pageSize - 1)) & ~(pageSize - 1);
 
   uintptr_t addr;
-  if (not manager->allocatePages(size / pageSize, addr))
+  if (not allocatePhysPages(size / pageSize, addr))
     throw std::runtime_error("cannot allocate memory: memory full.");
 
   return (void *)addr;
@@ -121,22 +336,427 @@ OSKernel::releaseMemory(void *ptr, size_t size)
 }
 
 
+/* Put a thread on the ready queue of the scheduler. */
+void
+OSKernel::makeReady(const std::shared_ptr<Process> &thread)
+{
+  threadStats.at(thread->getTID()).readySince = processor.getNAccesses();
+  scheduler->enqueue(thread);
+}
+
+/* Called when a thread has finished; the process terminates with its
+ * last thread.
+ */
+void
+OSKernel::exitThread(const std::shared_ptr<Process> &thread)
+{
+  scheduler->removeThread(*thread);
+
+  AddressSpace &as = addressSpaces.at(thread->getPID());
+  if (--as.nLiveThreads > 0)
+    {
+      std::cerr << "KERNEL: thread " << thread->getTID() << " of process "
+                << thread->getPID() << " has finished." << std::endl;
+      return;
+    }
+
+  terminateProcess(thread->getPID());
+}
+
 void
 OSKernel::terminateProcess(const uint64_t PID)
 {
   std::cerr << "KERNEL: process " << PID << " has finished." << std::endl;
 
+  if (PageTableStats)
+    driver.reportPageTable(PID, std::cerr);
+
+  releaseOwnedPages(PID);
+
+  /* Ask driver to release page tables; shared tables are released with
+   * their last user.
+   */
+  driver.releasePageTable(PID);
+  unmapShared(PID);
+}
+
+/* Release all physical pages and swap space owned by PID. */
+void
+OSKernel::releaseOwnedPages(const uint64_t PID)
+{
   /* Release all physical pages allocated by this process */
   auto it = processPages.find(PID);
   if (it != processPages.end()) {
     for (const PhysPage &page : it->second) {
-      manager->releasePages(page.addr, 1);
+      releaseProcessPage(page.addr);
     }
     processPages.erase(it);
   }
 
-  /* Ask driver to release page tables */
-  driver.releasePageTable(PID);
+  /* Release swap slots and swap cache pages */
+  if (swap)
+    {
+      std::vector<uintptr_t> frames;
+      swap->releaseProcess(PID, frames);
+      for (uintptr_t frame : frames)
+        releaseProcessPage(frame);
+    }
+}
+
+/* Return the configured shared range containing vAddr, if any. */
+const OSKernel::SharedRange *
+OSKernel::findSharedRange(const uintptr_t vAddr) const
+{
+  if (sharedRanges.empty())
+    return nullptr;
+
+  const uint64_t key = vAddr / sharedSpan;
+  for (const SharedRange &range : sharedRanges)
+    if (range.start <= key && key < range.end)
+      return &range;
+
+  return nullptr;
+}
+
+/* Link the shared region containing vAddr into the page table of PID.
+ * A new user takes a reference on all resident pages of the region.
+ * Returns true if the page at vAddr is resident.
+ */
+bool
+OSKernel::mapSharedPage(const uint64_t PID, const uintptr_t vAddr,
+                        const bool global)
+{
+  const uint64_t key = vAddr / sharedSpan;
+  auto region = sharedRegions.find(key);
+  if (region == sharedRegions.end())
+    {
+      region = sharedRegions.emplace(key, SharedRegion(global)).first;
+
+      /* A global TLB entry translates for every ASID, so a global region
+       * is linked into all live page tables at once, as kernel mappings
+       * are; the table walked on a miss then agrees with the TLB.
+       */
+      if (global)
+        for (const auto &kv : addressSpaces)
+          if (kv.first != PID && kv.second.nLiveThreads > 0)
+            {
+              region->second.users.insert(kv.first);
+              driver.linkSharedTable(kv.first, vAddr, global);
+            }
+    }
+
+  auto pages = processPages.find(sharedPID);
+  if (region->second.users.insert(PID).second && pages != processPages.end())
+    for (PhysPage &page : pages->second)
+      if (page.vAddr / sharedSpan == key)
+        {
+          ++page.refCount;
+          ++nSharedRefs;
+        }
+
+  return driver.linkSharedTable(PID, vAddr, global);
+}
+
+/* Drop the references of PID on the shared regions it has linked. Pages
+ * without references are released, and so is the shared table of a
+ * region without users, unless the region is global. Swap slots of
+ * shared pages are kept until the kernel exits, since a later user of
+ * the region maps the same contents.
+ */
+void
+OSKernel::unmapShared(const uint64_t PID)
+{
+  auto pages = processPages.find(sharedPID);
+
+  for (auto region = sharedRegions.begin(); region != sharedRegions.end(); )
+    {
+      if (region->second.users.erase(PID) == 0)
+        {
+          ++region;
+          continue;
+        }
+
+      if (pages != processPages.end())
+        {
+          std::vector<PhysPage> &list = pages->second;
+          for (size_t i = 0; i < list.size(); )
+            {
+              PhysPage &page = list[i];
+              if (page.vAddr / sharedSpan != region->first ||
+                  --page.refCount > 0 || region->second.global)
+                {
+                  ++i;
+                  continue;
+                }
+
+              releaseProcessPage(page.addr);
+              page = list.back();
+              list.pop_back();
+            }
+        }
+
+      if (region->second.users.empty() && not region->second.global)
+        {
+          driver.releaseSharedTable(region->first * sharedSpan);
+          region = sharedRegions.erase(region);
+        }
+      else
+        ++region;
+    }
+}
+
+/* Drop the TLB entry of a page that is remapped, made invalid or had its
+ * referenced bit cleared. Entries are tagged with the ASID of the owner,
+ * or of any of the users of a shared page; global entries match any ASID.
+ * The invalidation is queued in the TLB gather; callers finish the gather
+ * before the page can be used again.
+ */
+void
+OSKernel::invalidatePage(const PhysPage &page)
+{
+  if (page.PID != sharedPID)
+    {
+      auto as = addressSpaces.find(page.PID);
+      if (as != addressSpaces.end())
+        tlbGather->add(page.vAddr, as->second.asid);
+      return;
+    }
+
+  auto region = sharedRegions.find(page.vAddr / sharedSpan);
+  if (region == sharedRegions.end())
+    return;
+
+  if (region->second.global)
+    tlbGather->addGlobal(page.vAddr);
+  else
+    for (const uint64_t PID : region->second.users)
+      {
+        auto as = addressSpaces.find(PID);
+        if (as != addressSpaces.end())
+          tlbGather->add(page.vAddr, as->second.asid);
+      }
+}
+
+/* Allocate physical pages, reclaiming memory as long as that is
+ * possible. Returns false when memory is exhausted.
+ */
+bool
+OSKernel::allocatePhysPages(size_t count, uintptr_t &addr)
+{
+  if (count > 1)
+    ++nHighOrderAllocs;
+
+  while (not manager->allocatePages(count, addr))
+    {
+      /* A multi-page request may fail because free memory is fragmented;
+       * try to create a free run before reclaiming memory.
+       */
+      if (count > 1 && compactor && compactMemory(count, false))
+        continue;
+
+      /* Frames held in the per-CPU caches are free as well. */
+      if (frameCache && frameCache->drain() > 0)
+        continue;
+
+      if (not reclaimPages())
+        {
+          if (count > 1)
+            ++nHighOrderFailures;
+          return false;
+        }
+    }
+
+  return true;
+}
+
+/* Allocate the frame for a process page, reclaiming memory as long as
+ * that is possible. The frame's colour is chosen by the physical memory
+ * manager if page colouring is enabled.
+ */
+bool
+OSKernel::allocateProcessPage(PhysPage &page)
+{
+  const unsigned cpu = processor.getCurrentCore();
+  while (frameCache ? not frameCache->allocatePage(cpu, page.addr)
+                    : not manager->allocatePage(page.PID, page.vAddr, page.addr))
+    {
+      /* The magazines of the other cores may still hold free frames. */
+      if (frameCache && frameCache->drain() > 0)
+        continue;
+
+      if (not reclaimPages())
+        return false;
+    }
+
+  return true;
+}
+
+/* Release the frame of a process page. */
+void
+OSKernel::releaseProcessPage(const uintptr_t addr)
+{
+  if (frameCache)
+    frameCache->releasePage(processor.getCurrentCore(), addr);
+  else
+    manager->releasePages(addr, 1);
+}
+
+/* Run memory compaction over all resident process pages. Page tables,
+ * swap cache and compressed pool pages are not movable.
+ */
+bool
+OSKernel::compactMemory(const size_t count, const bool proactive)
+{
+  /* Cached free frames would look like unmovable pages. */
+  if (frameCache)
+    frameCache->drain();
+
+  std::vector<PhysPage *> movable;
+  for (auto &kv : processPages)
+    for (PhysPage &page : kv.second)
+      movable.push_back(&page);
+
+  const bool compacted = compactor->compact(count, movable,
+                                            [this](const PhysPage &page)
+                                              {
+                                                invalidatePage(page);
+                                              },
+                                            proactive);
+  tlbGather->finish();
+  return compacted;
+}
+
+/* Clock (second chance) replacement over all resident pages. Pages with
+ * the referenced bit set have the bit cleared and are skipped; two sweeps
+ * always suffice to find a victim. The victim is removed from
+ * processPages; the page that was last in the vector takes its place.
+ */
+bool
+OSKernel::selectVictim(PhysPage &victim)
+{
+  size_t nResident = 0;
+  for (auto &kv : processPages)
+    nResident += kv.second.size();
+
+  if (nResident == 0)
+    return false;
+
+  for (size_t i = 0; i <= 2 * nResident; ++i)
+    {
+      auto it = processPages.lower_bound(clockPID);
+      if (it == processPages.end() || it->first != clockPID)
+        clockIndex = 0;
+
+      while (it == processPages.end() || clockIndex >= it->second.size())
+        {
+          it = (it == processPages.end()) ? processPages.begin() : std::next(it);
+          clockIndex = 0;
+        }
+      clockPID = it->first;
+
+      PhysPage &page = it->second[clockIndex];
+      if (driver.getPageReferenced(page))
+        {
+          driver.setPageReferenced(page, false);
+
+          /* Drop the TLB entry, otherwise the next access would not set
+           * the referenced bit again.
+           */
+          invalidatePage(page);
+
+          ++clockIndex;
+          continue;
+        }
+
+      victim = page;
+      page = it->second.back();
+      it->second.pop_back();
+      return true;
+    }
+
+  return false;
+}
+
+/* Free physical memory. Unused readahead pages in the swap cache are
+ * dropped first. Otherwise, up to SwapCluster resident pages are evicted
+ * and the dirty ones are written to swap space in clusters. Returns false
+ * if no memory could be reclaimed.
+ */
+bool
+OSKernel::reclaimPages(void)
+{
+  if (not swap)
+    return false;
+
+  std::vector<uintptr_t> frames;
+  swap->shrinkCache(SwapCluster, frames);
+  for (uintptr_t frame : frames)
+    releaseProcessPage(frame);
+
+  if (not frames.empty())
+    return true;
+
+  std::vector<SwapPage> writeBack;
+  PhysPage victim;
+  uint32_t nVictims = 0;
+
+  while (nVictims < SwapCluster && selectVictim(victim))
+    {
+      const bool dirty = driver.getPageDirty(victim);
+
+      driver.setPageValid(victim, false);
+      invalidatePage(victim);
+
+      if (swap->evict(victim.PID, victim.vAddr, dirty))
+        writeBack.push_back(SwapPage{ victim.PID, victim.vAddr });
+
+      releaseProcessPage(victim.addr);
+      ++nVictims;
+    }
+
+  /* The victims' frames are reused once reclaim returns. */
+  tlbGather->finish();
+
+  /* Without a swap device, pages that do not fit in the compressed pool
+   * have nowhere to go.
+   */
+  if (not swap->swapOut(writeBack))
+    throw std::runtime_error(SwapDevice.empty()
+                             ? "Out of memory: compressed pool full and no swap device."
+                             : "Swap space full.");
+
+  nEvictedPages += nVictims;
+  return nVictims > 0;
+}
+
+/* Handle a major fault: read the page and its readahead window from the
+ * swap device. Readahead pages are placed in the swap cache, but the
+ * window is trimmed to the free frames, including those held in the frame
+ * caches, before the read is issued; readahead never causes reclaim.
+ */
+void
+OSKernel::swapInPage(const uint64_t PID, const uintptr_t vAddr)
+{
+  uint64_t spare = manager->getNFreePages();
+  if (frameCache)
+    spare += manager->getNCachedPages();
+
+  std::vector<uintptr_t> readahead;
+  swap->swapIn(PID, vAddr, readahead, spare);
+
+  const unsigned cpu = processor.getCurrentCore();
+  for (uintptr_t raAddr : readahead)
+    {
+      uintptr_t frame;
+      bool allocated = frameCache ? frameCache->allocatePage(cpu, frame)
+                                  : manager->allocatePages(1, frame);
+      if (not allocated && frameCache && frameCache->drain() > 0)
+        allocated = frameCache->allocatePage(cpu, frame);
+      if (not allocated)
+        throw std::runtime_error("No frame for swap readahead page.");
+
+      swap->addCached(PID, raAddr, frame);
+    }
 }
 
 void
@@ -150,16 +770,62 @@ OSKernel::pageFaultHandler(const uint64_t faultAddr)
   /* Allocate physical page and ask the driver to set the
    * virtual to physical mapping for this page.
    */
+  /* Without a running process (only in unit tests) the fault is
+   * attributed to PID 0.
+   */
+  const std::shared_ptr<Process> &current =
+    cores[processor.getCurrentCore()].current;
+  const uint64_t PID = current ? current->getPID() : 0;
+  auto as = addressSpaces.find(PID);
+  if (as != addressSpaces.end())
+    ++as->second.nPageFaults;
+
+  MMU &mmu = processor.getMMU();
+  const uint64_t asid = as != addressSpaces.end() ? as->second.asid : 0;
+  if (HotPages *hotPages = mmu.getHotPages())
+    hotPages->record(PageEvent::Fault, asid, faultAddr, mmu.getPageBits());
+  if (PCProfile *pcProfile = mmu.getPCProfile())
+    pcProfile->record(PageEvent::Fault, asid, mmu.getPC());
+
+  /* A page in a shared region may already be resident, but not yet be
+   * linked into the page table of this process. Otherwise, it is owned by
+   * sharedPID rather than by the faulting process, and referenced by all
+   * users of the region.
+   */
+  uint64_t owner = PID;
+  uint32_t refCount = 1;
+  const SharedRange *range = findSharedRange(vAddr);
+  if (range != nullptr)
+    {
+      if (mapSharedPage(PID, vAddr, range->global))
+        {
+          ++nSharedLinks;
+          return;
+        }
+
+      owner = sharedPID;
+      refCount = sharedRegions.at(vAddr / sharedSpan).users.size();
+    }
+
   PhysPage pPage;
-  if (not manager->allocatePages(1, pPage.addr))
+  pPage.PID = owner;
+  pPage.vAddr = vAddr;
+  pPage.refCount = refCount;
+
+  /* A page that was read ahead is already in the swap cache. */
+  if (not swap || not swap->takeCached(owner, vAddr, pPage.addr))
     {
-      throw std::runtime_error("Physical memory full.");
+      if (not allocateProcessPage(pPage))
+        throw std::runtime_error("Physical memory full.");
+
+      if (swap && swap->isSwapped(owner, vAddr))
+        swapInPage(owner, vAddr);
     }
-  pPage.PID = current->getPID();
-  driver.setMapping(current->getPID(), vAddr, pPage);
+
+  driver.setMapping(PID, vAddr, pPage);
   
   /* Track the allocated page for this process */
-  processPages[current->getPID()].push_back(pPage);
+  processPages[owner].push_back(pPage);
 
   logPageMapping(vAddr, pPage.addr);
 }
@@ -167,50 +833,277 @@ OSKernel::pageFaultHandler(const uint64_t faultAddr)
 void
 OSKernel::interruptHandler(InterruptRequest request)
 {
-  if (request == InterruptRequest::SyscallExit)
+  /* Proactive compaction: when the fragmentation score exceeds the
+   * threshold, compact until the largest free run covers the same
+   * fraction of free memory. The score takes a scan of all frames, so
+   * it is checked at most once every compactionCheckInterval accesses.
+   */
+  if (compactor && CompactionProactive > 0. &&
+      processor.getNAccesses() >= nextCompactionCheck)
     {
-      terminateProcess(current->getPID());
+      nextCompactionCheck = processor.getNAccesses() + compactionCheckInterval;
+      if (compactor->getFragmentation() > CompactionProactive)
+        {
+          const uint64_t nFree = manager->getNFreePages();
+          compactMemory(nFree - (uint64_t)(nFree * CompactionProactive), true);
+        }
     }
-  else
+
+  if (PageTableStatsInterval > 0 &&
+      processor.getNAccesses() >= nextTableReport)
     {
-      /* Process has not completed, so put back on the ready queue. */
-      if (current != nullptr)
-        processList.push_back(current);
+      reportPageTables();
+      while (nextTableReport <= processor.getNAccesses())
+        nextTableReport += PageTableStatsInterval;
     }
 
-  /* Select a new process to run using round robin scheduling. */
+  preempt(request == InterruptRequest::SyscallExit);
+
+  /* Select a new process to run using the scheduling policy. Gangs are
+   * formed once all cores have been preempted, on the interrupt of the
+   * last core.
+   */
+  if (not GangScheduling)
+    dispatch(scheduler->pickNext());
+  else if (processor.getCurrentCore() == cores.size() - 1)
+    dispatchGang();
 
-  /* Front of the queue (if any) is the next to run. */
-  std::shared_ptr<Process> prev = current;
-  if (processList.size() == 0)
-    current = nullptr;
+  if (liveStats && liveStats->isDue())
+    updateLiveStats(false);
+}
+
+/* Publish the live statistics; on SIGUSR1 these are printed as well. */
+void
+OSKernel::updateLiveStats(const bool finished)
+{
+  LiveSnapshot snapshot;
+
+  for (const auto &kv : addressSpaces)
+    {
+      const AddressSpace &as = kv.second;
+      if (as.asid > maxLiveProcesses)
+        continue;
+
+      const int i = as.asid - 1;
+      snapshot.at(i, LiveProcessCounter::ASID) = as.asid;
+      snapshot.at(i, LiveProcessCounter::Threads) = as.nThreads;
+      snapshot.at(i, LiveProcessCounter::LiveThreads) = as.nLiveThreads;
+      snapshot.at(i, LiveProcessCounter::PageFaults) = as.nPageFaults;
+      snapshot.at(i, LiveProcessCounter::TLBLookups) = as.nTLBLookups;
+      snapshot.at(i, LiveProcessCounter::TLBHits) = as.nTLBHits;
+    }
+
+  /* Accesses are charged at the end of every time slice. */
+  for (const auto &kv : threadStats)
+    {
+      snapshot[LiveCounter::Accesses] += kv.second.runtime;
+      const uint64_t asid = addressSpaces.at(kv.second.PID).asid;
+      if (asid <= maxLiveProcesses)
+        snapshot.at(asid - 1, LiveProcessCounter::Accesses) += kv.second.runtime;
+    }
+
+  processor.getMMU().getTotalTLBStatistics(snapshot[LiveCounter::TLBLookups],
+                                           snapshot[LiveCounter::TLBHits]);
+  snapshot[LiveCounter::PageFaults] = nPageFaults;
+  snapshot[LiveCounter::ContextSwitches] = nContextSwitches;
+  snapshot[LiveCounter::EvictedPages] = nEvictedPages;
+  snapshot[LiveCounter::TotalPages] = manager->getNPages();
+  snapshot[LiveCounter::AllocatedPages] =
+    manager->getNPages() - manager->getNFreePages();
+  snapshot[LiveCounter::NProcesses] = addressSpaces.size();
+  snapshot[LiveCounter::Finished] = finished;
+
+  liveStats->update(snapshot);
+
+  if (LiveStats::snapshotRequested())
+    {
+      std::cerr << std::endl << "Live Statistics:" << std::endl;
+      snapshot.print(std::cerr);
+    }
+}
+
+/* Print the page table occupancy of all processes that are alive. */
+void
+OSKernel::reportPageTables(void)
+{
+  std::cerr << std::dec << std::endl
+            << "KERNEL: page tables after " << processor.getNAccesses()
+            << " accesses" << std::endl;
+  for (const auto &kv : addressSpaces)
+    if (kv.second.nLiveThreads > 0)
+      driver.reportPageTable(kv.first, std::cerr);
+}
+
+/* Charge the time slice that has ended on the current core and put the
+ * thread back on the ready queue, unless it has exited. The thread stays
+ * current until the core is dispatched again.
+ */
+void
+OSKernel::preempt(const bool exit)
+{
+  Core &core = cores[processor.getCurrentCore()];
+  if (core.current == nullptr)
+    return;
+
+  const uint64_t runtime = processor.getCoreAccesses() - core.sliceStart;
+  threadStats.at(core.current->getTID()).runtime += runtime;
+  scheduler->charge(*core.current, runtime);
+
+  if (exit)
+    exitThread(core.current);
   else
+    /* Process has not completed, so put back on the ready queue. */
+    makeReady(core.current);
+}
+
+/* Run next (or nothing) on the current core. */
+void
+OSKernel::dispatch(const std::shared_ptr<Process> &next)
+{
+  Core &core = cores[processor.getCurrentCore()];
+  std::shared_ptr<Process> prev = core.current;
+  core.current = next;
+  core.sliceStart = processor.getCoreAccesses();
+  if (next != nullptr)
     {
-      current = processList.front();
-      processList.pop_front();
+      ThreadStats &stats = threadStats.at(next->getTID());
+      stats.waitTime += processor.getNAccesses() - stats.readySince;
+      processor.setTimerInterval(scheduler->getTimeSlice(*next));
     }
 
-  if (current != prev)
+  if (next == prev)
+    return;
+
+  if (prev != nullptr)
+    accountTLB(*prev);
+
+  /* Perform context switch; change root page table pointer */
+  if (next != nullptr)
     {
-      /* Perform context switch; change root page table pointer */
-      if (current != nullptr)
+      AddressSpace &as = addressSpaces.at(next->getPID());
+      ++as.nSwitches;
+      ++threadStats.at(next->getTID()).nDispatches;
+
+      /* Threads of the same process share the page table and their
+       * TLB entries remain valid.
+       */
+      if (prev != nullptr && prev->getPID() == next->getPID())
+        ++as.nThreadSwitches;
+      else
         {
-          uintptr_t table = driver.getPageTable(current->getPID());
+          uintptr_t table = driver.getPageTable(next->getPID());
           processor.getMMU().setPageTablePointer(table);
-          
-          /* Flush TLB on context switch to ensure process isolation */
-          processor.getMMU().flushTLB();
+          processor.getMMU().setCurrentASID(as.asid);
+
+          /* Flush TLB on context switch to ensure process isolation,
+           * unless relying on the ASIDs; global entries are shared by
+           * all processes.
+           */
+          tlbGather->switchTo(as.asid, TLBFlushOnSwitch);
         }
+    }
+  else
+    tlbGather->switchTo(0, false);
 
-      processor.setProcess(current);
+  processor.setProcess(next);
 
-      nContextSwitches++;
+  nContextSwitches++;
+  if (next != nullptr)
+    {
       std::cerr << std::hex << std::showbase
-          << "KERNEL: context switch: now executing " << current->getPID()
-          << std::endl;
+          << "KERNEL: context switch: now executing " << next->getPID()
+          << " thread " << next->getTID();
+      if (cores.size() > 1)
+        std::cerr << std::dec << " on core " << processor.getCurrentCore();
+      std::cerr << std::endl;
     }
 }
 
+/* Gang scheduling: fill the cores with the ready threads of one address
+ * space, then with those of the next, such that threads of an address
+ * space run at the same time and start on the same quantum boundary.
+ * Threads stay on the core they ran on; others are preferably placed on
+ * a core that ran the same address space, which saves a TLB flush.
+ */
+void
+OSKernel::dispatchGang(void)
+{
+  std::vector<std::shared_ptr<Process>> gang;
+  while (gang.size() < cores.size())
+    {
+      std::shared_ptr<Process> leader = scheduler->pickNext();
+      if (leader == nullptr)
+        break;
+
+      gang.push_back(leader);
+      std::shared_ptr<Process> sibling;
+      while (gang.size() < cores.size() &&
+             (sibling = scheduler->pickSibling(leader->getPID())) != nullptr)
+        gang.push_back(sibling);
+    }
+
+  const int slice = gang.empty() ? 0 : scheduler->getTimeSlice(*gang.front());
+
+  std::vector<std::shared_ptr<Process>> next(cores.size());
+  auto place = [&](auto match)
+    {
+      for (unsigned core = 0; core < cores.size(); ++core)
+        {
+          if (next[core] != nullptr)
+            continue;
+
+          auto it = std::find_if(gang.begin(), gang.end(),
+                                 [&](const std::shared_ptr<Process> &thread)
+                                   { return match(cores[core].current, thread); });
+          if (it != gang.end())
+            {
+              next[core] = *it;
+              gang.erase(it);
+            }
+        }
+    };
+
+  using Thread = const std::shared_ptr<Process> &;
+  place([](Thread prev, Thread thread) { return prev == thread; });
+  place([](Thread prev, Thread thread)
+          { return prev != nullptr && prev->getPID() == thread->getPID(); });
+  place([](Thread, Thread) { return true; });
+
+  const unsigned current = processor.getCurrentCore();
+  for (unsigned core = 0; core < cores.size(); ++core)
+    {
+      processor.selectCore(core);
+      dispatch(next[core]);
+      if (next[core] != nullptr)
+        processor.setTimerInterval(slice);
+    }
+  processor.selectCore(current);
+}
+
+/* Attribute the TLB lookups since the last context switch on the current
+ * core to the thread that was running and its address space. Hits in the
+ * victim TLB count as hits.
+ */
+void
+OSKernel::accountTLB(const Process &thread)
+{
+  uint64_t nLookups{}, nHits{}, nEvictions{}, nFlush{}, nFlushEvictions{};
+  processor.getMMU().getTLBStatistics(nLookups, nHits, nEvictions,
+                                      nFlush, nFlushEvictions);
+  if (const TLB *tlb = processor.getMMU().getTLB())
+    nHits += tlb->getNVictimHits();
+
+  Core &core = cores[processor.getCurrentCore()];
+  AddressSpace &as = addressSpaces.at(thread.getPID());
+  as.nTLBLookups += nLookups - core.lastTLBLookups;
+  as.nTLBHits += nHits - core.lastTLBHits;
+  threadStats.at(thread.getTID()).nTLBMisses +=
+    (nLookups - core.lastTLBLookups) - (nHits - core.lastTLBHits);
+
+  core.lastTLBLookups = nLookups;
+  core.lastTLBHits = nHits;
+}
+
 int
 OSKernel::getNPageFaults() const
 {
@@ -223,12 +1116,36 @@ OSKernel::getNContextSwitches() const
   return nContextSwitches;
 }
 
+int
+OSKernel::getNEvictedPages() const
+{
+  return nEvictedPages;
+}
+
 int
 OSKernel::getMaxAllocatedPages() const
 {
   return manager->getMaxAllocatedPages();
 }
 
+int
+OSKernel::getNShootdownIPIs() const
+{
+  return tlbGather->getNIPIs();
+}
+
+int
+OSKernel::getNShootdownIPIsAvoided() const
+{
+  return tlbGather->getNIPIsAvoided();
+}
+
+uint64_t
+OSKernel::getNTLBMisses(const uint64_t TID) const
+{
+  return threadStats.at(TID).nTLBMisses;
+}
+
 
 void
 OSKernel::logPageFault(const uint64_t faultAddr)
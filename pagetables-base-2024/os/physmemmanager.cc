@@ -15,10 +15,15 @@
 
 
 PhysMemManager::PhysMemManager(const uint64_t pageSize,
-                               const uint64_t memorySize)
+                               const uint64_t memorySize,
+                               const std::string &allocatorName)
   : baseAddress(nullptr), pageSize(pageSize), memorySize(memorySize),
     nPages(memorySize / pageSize), nAllocatedPages(0), maxAllocatedPages(0),
-    holes()
+    nCachedPages(0),
+    allocator(createFrameAllocator(allocatorName, memorySize / pageSize)),
+    colourPolicy(ColourPolicy::None), nColours(1), colourLists(),
+    processColour(), nextColour(0), colourRng(42),
+    nColouredAllocs(0), nColourFallbacks(0)
 {
   /* Circuit breaker: avoid too large memory allocations to avoid the user
    * of this program getting into trouble. We limit at 2 GiB.
@@ -34,107 +39,224 @@ PhysMemManager::PhysMemManager(const uint64_t pageSize,
     throw std::runtime_error("mmap for physical memory failed: "
                              + std::string(strerror(errno)));
 
-  /* Initialize hole list with one large hole covering all memory */
-  holes.emplace_back(0, nPages);
-
   std::cerr << "BOOT: system memory @ "
             << std::hex << std::showbase << baseAddress
             << " page size of " << pageSize << " bytes, "
             << std::dec
-            << (memorySize / pageSize) << " pages available." << std::endl;
+            << (memorySize / pageSize) << " pages available, "
+            << allocator->getName() << " allocator." << std::endl;
 }
 
 PhysMemManager::~PhysMemManager()
 {
+  if (colourPolicy != ColourPolicy::None)
+    std::cerr << std::dec << std::endl
+              << "Page Colouring Statistics:" << std::endl
+              << "# colours: " << nColours << std::endl
+              << "# coloured allocations: " << nColouredAllocs << std::endl
+              << "# allocations of a different colour: "
+              << nColourFallbacks << std::endl;
+
   munmap(baseAddress, memorySize);
 }
 
-std::list<Hole>::iterator
-PhysMemManager::findFit(size_t count)
+void
+PhysMemManager::addColoured(uint64_t startPage, uint64_t count)
 {
-  /* First-fit algorithm: find the first hole that can accommodate 'count' pages */
-  for (auto it = holes.begin(); it != holes.end(); ++it) {
-    if (it->count >= count) {
-      return it;
-    }
-  }
-  return holes.end();
+  if (colourPolicy == ColourPolicy::None)
+    return;
+
+  for (uint64_t page = startPage; page < startPage + count; ++page)
+    colourLists[page % nColours].insert(page);
 }
 
 void
-PhysMemManager::splitHole(std::list<Hole>::iterator it, uint64_t startPage, uint64_t count)
+PhysMemManager::removeColoured(uint64_t startPage, uint64_t count)
 {
-  /* Split a hole after allocating 'count' pages starting at 'startPage' */
-  Hole originalHole = *it;
-  holes.erase(it);
-  
-  /* Add hole before allocation if any */
-  if (startPage > originalHole.startPage) {
-    holes.emplace_back(originalHole.startPage, startPage - originalHole.startPage);
-  }
-  
-  /* Add hole after allocation if any */
-  uint64_t endPage = startPage + count;
-  uint64_t originalEndPage = originalHole.startPage + originalHole.count;
-  if (endPage < originalEndPage) {
-    holes.emplace_back(endPage, originalEndPage - endPage);
-  }
+  if (colourPolicy == ColourPolicy::None)
+    return;
+
+  for (uint64_t page = startPage; page < startPage + count; ++page)
+    colourLists[page % nColours].erase(page);
+}
+
+uint64_t
+PhysMemManager::selectColour(const uint64_t PID, const uintptr_t vAddr)
+{
+  switch (colourPolicy)
+    {
+      case ColourPolicy::Sequential:
+        {
+          /* Spread the first colour of successive processes evenly, such
+           * that their hot low pages do not share sets.
+           */
+          auto it = processColour.find(PID);
+          if (it == processColour.end())
+            it = processColour.emplace(PID, nextColour++ * (nColours / 2 + 1)).first;
+
+          return (it->second + vAddr / pageSize) % nColours;
+        }
+
+      case ColourPolicy::BinHopping:
+        return nextColour++ % nColours;
+
+      case ColourPolicy::Random:
+        return std::uniform_int_distribution<uint64_t>(0, nColours - 1)(colourRng);
+
+      default:
+        return 0;
+    }
+}
+
+bool
+PhysMemManager::takeRun(size_t count, uint64_t &startPage)
+{
+  /* Check upfront if pages are available at all. */
+  if (nAllocatedPages + count > nPages)
+    return false;
+
+  if (not allocator->allocate(count, startPage))
+    return false;
+
+  removeColoured(startPage, count);
+  return true;
 }
 
 void
-PhysMemManager::addHole(uint64_t startPage, uint64_t count)
+PhysMemManager::releaseRun(uint64_t startPage, uint64_t count)
 {
-  /* Add a new hole to the list */
-  holes.emplace_back(startPage, count);
+  allocator->release(startPage, count);
+  addColoured(startPage, count);
 }
 
 void
-PhysMemManager::mergeHoles()
+PhysMemManager::updateMaxAllocated(void)
 {
-  /* Sort holes by start page for efficient merging */
-  holes.sort([](const Hole &a, const Hole &b) {
-    return a.startPage < b.startPage;
-  });
-  
-  /* Merge adjacent holes */
-  auto it = holes.begin();
-  while (it != holes.end()) {
-    auto next = std::next(it);
-    if (next != holes.end() && it->startPage + it->count == next->startPage) {
-      /* Merge adjacent holes */
-      it->count += next->count;
-      holes.erase(next);
-    } else {
-      ++it;
-    }
-  }
+  const uint64_t inUse = nAllocatedPages - nCachedPages;
+  uint64_t max = maxAllocatedPages;
+  while (inUse > max && not maxAllocatedPages.compare_exchange_weak(max, inUse))
+    ;
 }
 
 bool
 PhysMemManager::allocatePages(size_t count, uintptr_t &addr)
 {
-  /* Check upfront if pages are available at all. */
-  if (nAllocatedPages + count > nPages)
+  uint64_t startPage;
+  if (not takeRun(count, startPage))
     return false;
 
-  /* Find first hole that fits using first-fit algorithm */
-  auto it = findFit(count);
-  if (it == holes.end()) {
-    return false;
-  }
-  
-  /* Allocate from the beginning of the found hole */
-  uint64_t startPage = it->startPage;
-  
   /* Calculate physical address */
   addr = (uintptr_t)baseAddress + startPage * pageSize;
   
-  /* Update hole list by splitting the hole */
-  splitHole(it, startPage, count);
-  
   /* Update statistics */
   nAllocatedPages += count;
-  maxAllocatedPages = std::max(maxAllocatedPages, nAllocatedPages);
+  updateMaxAllocated();
+
+  return true;
+}
+
+size_t
+PhysMemManager::allocateBatch(size_t count, std::vector<uintptr_t> &frames)
+{
+  /* Take the batch in as few runs as possible. The pages are counted as
+   * cached before they are counted as allocated, such that a concurrent
+   * updateMaxAllocated() never sees them as in use.
+   */
+  size_t n = 0;
+  size_t runLength = count;
+  while (n < count && runLength > 0)
+    {
+      uint64_t startPage;
+      if (not takeRun(runLength, startPage))
+        {
+          runLength /= 2;
+          continue;
+        }
+
+      nCachedPages += runLength;
+      nAllocatedPages += runLength;
+      for (uint64_t page = startPage; page < startPage + runLength; ++page)
+        frames.push_back((uintptr_t)baseAddress + page * pageSize);
+
+      n += runLength;
+      runLength = std::min(runLength, count - n);
+    }
+
+  return n;
+}
+
+void
+PhysMemManager::releaseBatch(const uintptr_t *frames, size_t count)
+{
+  if (count == 0)
+    return;
+
+  /* Return the frames as contiguous runs, such that the allocator merges
+   * each run once rather than every frame.
+   */
+  std::vector<uint64_t> pages(count);
+  for (size_t i = 0; i < count; ++i)
+    pages[i] = getPageIndex(frames[i]);
+  std::sort(pages.begin(), pages.end());
+
+  for (size_t i = 0; i < count; )
+    {
+      size_t end = i + 1;
+      while (end < count && pages[end] == pages[end - 1] + 1)
+        ++end;
+      releaseRun(pages[i], end - i);
+      i = end;
+    }
+
+  nAllocatedPages -= count;
+  nCachedPages -= count;
+}
+
+void
+PhysMemManager::takeCachedPage(void)
+{
+  --nCachedPages;
+  updateMaxAllocated();
+}
+
+void
+PhysMemManager::putCachedPage(void)
+{
+  ++nCachedPages;
+}
+
+bool
+PhysMemManager::allocatePage(const uint64_t PID, const uintptr_t vAddr,
+                             uintptr_t &addr)
+{
+  if (colourPolicy == ColourPolicy::None)
+    return allocatePages(1, addr);
+
+  if (nAllocatedPages == nPages)
+    return false;
+
+  /* Take the lowest free frame of the wanted colour, or of the nearest
+   * colour that still has free frames.
+   */
+  const uint64_t wanted = selectColour(PID, vAddr);
+  uint64_t colour = wanted;
+  while (colourLists[colour].empty())
+    colour = (colour + 1) % nColours;
+
+  const uint64_t page = *colourLists[colour].begin();
+  if (not allocator->allocateAt(page, 1))
+    return false;
+
+  if (colour != wanted)
+    ++nColourFallbacks;
+  ++nColouredAllocs;
+
+  removeColoured(page, 1);
+
+  addr = (uintptr_t)baseAddress + page * pageSize;
+
+  nAllocatedPages += 1;
+  updateMaxAllocated();
 
   return true;
 }
@@ -145,12 +267,8 @@ PhysMemManager::releasePages(uintptr_t addr, size_t count)
   /* Translate address back to page index. */
   uint64_t startPage = (addr - (uintptr_t)baseAddress) / pageSize;
   
-  /* Add the released pages as a new hole */
-  addHole(startPage, count);
-  
-  /* Merge adjacent holes to minimize fragmentation */
-  mergeHoles();
-  
+  releaseRun(startPage, count);
+
   /* Update statistics */
   nAllocatedPages -= count;
 }
@@ -165,4 +283,102 @@ uint64_t
 PhysMemManager::getMaxAllocatedPages(void) const
 {
   return maxAllocatedPages;
-}
\ No newline at end of file
+}
+
+uint64_t
+PhysMemManager::getNCachedPages(void) const
+{
+  return nCachedPages;
+}
+
+uint64_t
+PhysMemManager::getNPages(void) const
+{
+  return nPages;
+}
+
+uint64_t
+PhysMemManager::getNFreePages(void) const
+{
+  return nPages - nAllocatedPages;
+}
+
+uint64_t
+PhysMemManager::getLargestFreeRun(void) const
+{
+  return allocator->getLargestFreeRun();
+}
+
+void
+PhysMemManager::getFreeMap(std::vector<bool> &freeMap) const
+{
+  freeMap.assign(nPages, false);
+  allocator->getFreeMap(freeMap);
+}
+
+bool
+PhysMemManager::allocatePagesAt(uintptr_t addr, size_t count)
+{
+  uint64_t startPage = getPageIndex(addr);
+
+  if (not allocator->allocateAt(startPage, count))
+    return false;
+
+  removeColoured(startPage, count);
+  nAllocatedPages += count;
+  updateMaxAllocated();
+  return true;
+}
+
+uintptr_t
+PhysMemManager::getPageAddress(uint64_t index) const
+{
+  return (uintptr_t)baseAddress + index * pageSize;
+}
+
+uint64_t
+PhysMemManager::getPageIndex(uintptr_t addr) const
+{
+  return (addr - (uintptr_t)baseAddress) / pageSize;
+}
+
+void
+PhysMemManager::setColouring(const ColourPolicy policy, const uint64_t nColours)
+{
+  colourPolicy = ColourPolicy::None;
+  colourLists.clear();
+
+  if (policy == ColourPolicy::None || nColours == 0)
+    return;
+
+  colourPolicy = policy;
+  this->nColours = nColours;
+  colourLists.resize(nColours);
+
+  std::vector<bool> freeMap;
+  getFreeMap(freeMap);
+  for (uint64_t page = 0; page < nPages; ++page)
+    if (freeMap[page])
+      colourLists[page % nColours].insert(page);
+}
+
+uint64_t
+PhysMemManager::getColour(uintptr_t addr) const
+{
+  return getPageIndex(addr) % nColours;
+}
+
+ColourPolicy
+parseColourPolicy(const std::string &name)
+{
+  if (name == "none")
+    return ColourPolicy::None;
+  else if (name == "sequential")
+    return ColourPolicy::Sequential;
+  else if (name == "binhop")
+    return ColourPolicy::BinHopping;
+  else if (name == "random")
+    return ColourPolicy::Random;
+
+  throw std::runtime_error("unknown page colouring policy: " + name);
+}
@@ -9,23 +9,42 @@
 #define __PHYSMEMMANAGER_H__
 
 #include "settings.h"
+#include "frameallocator.h"
 
+#include <atomic>
 #include <vector>
-#include <list>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
 
 /* We assume that the RAM starts at 16GB in the physical address space.
  */
 const static uint64_t physMemBase = 16UL*1024*1024*1024;
 
 
-struct Hole
+/* Page colouring policies. A page colour is a group of cache sets that
+ * all frames with the same (frame number mod number of colours) map to.
+ *   Sequential: consecutive virtual pages of a process receive consecutive
+ *               colours, starting at a different colour per process.
+ *   BinHopping: colours are handed out round-robin in allocation order.
+ *   Random:     colours are chosen at random.
+ */
+enum class ColourPolicy
 {
-  uint64_t startPage;
-  uint64_t count;
-  
-  Hole(uint64_t start, uint64_t cnt) : startPage(start), count(cnt) {}
+  None,
+  Sequential,
+  BinHopping,
+  Random
 };
 
+/* Parse "none", "sequential", "binhop" or "random". Throws
+ * std::runtime_error for unknown policies.
+ */
+ColourPolicy parseColourPolicy(const std::string &name);
+
+
 class PhysMemManager
 {
   protected:
@@ -34,28 +53,86 @@ class PhysMemManager
     const uint64_t memorySize;
 
     uint64_t nPages;
-    uint64_t nAllocatedPages;
-    uint64_t maxAllocatedPages;
+    /* Counters are atomic such that a concurrent front end (FrameCache)
+     * can update them without holding its global lock. Pages held in the
+     * front end's per-thread caches are allocated but not in use, and are
+     * not counted in maxAllocatedPages.
+     */
+    std::atomic<uint64_t> nAllocatedPages;
+    std::atomic<uint64_t> maxAllocatedPages;
+    std::atomic<uint64_t> nCachedPages;
     
-    /* Hole list: maintains free memory regions */
-    std::list<Hole> holes;
-    
-    /* Helper methods for hole management */
-    void mergeHoles();
-    std::list<Hole>::iterator findFit(size_t count);
-    void addHole(uint64_t startPage, uint64_t count);
-    void removeHole(std::list<Hole>::iterator it);
-    void splitHole(std::list<Hole>::iterator it, uint64_t startPage, uint64_t count);
+    /* Data structure tracking the free frames */
+    std::unique_ptr<FrameAllocator> allocator;
+
+    bool takeRun(size_t count, uint64_t &startPage);
+    void releaseRun(uint64_t startPage, uint64_t count);
+    void updateMaxAllocated(void);
+
+    /* Page colouring: per-colour free lists of page indices, kept in sync
+     * with the frame allocator while colouring is enabled.
+     */
+    ColourPolicy colourPolicy;
+    uint64_t nColours;
+    std::vector<std::set<uint64_t>> colourLists;
+    std::unordered_map<uint64_t, uint64_t> processColour;
+    uint64_t nextColour;
+    std::mt19937_64 colourRng;
+
+    uint64_t nColouredAllocs;
+    uint64_t nColourFallbacks;
+
+    void addColoured(uint64_t startPage, uint64_t count);
+    void removeColoured(uint64_t startPage, uint64_t count);
+    uint64_t selectColour(const uint64_t PID, const uintptr_t vAddr);
 
   public:
-    PhysMemManager(const uint64_t pageSize, const uint64_t memorySize);
+    /* allocatorName selects the frame allocator, see createFrameAllocator(). */
+    PhysMemManager(const uint64_t pageSize, const uint64_t memorySize,
+                   const std::string &allocatorName = "firstfit");
     ~PhysMemManager();
 
     bool      allocatePages(size_t count, uintptr_t &addr);
+
+    /* Allocate a single frame to back the given virtual page. With page
+     * colouring enabled, a frame of the colour chosen by the policy is
+     * preferred; otherwise this is equal to allocatePages(1, addr).
+     */
+    bool      allocatePage(const uint64_t PID, const uintptr_t vAddr,
+                           uintptr_t &addr);
     void      releasePages(uintptr_t addr, size_t count);
 
+    /* Bulk transfers for a concurrent front end. allocateBatch() takes up
+     * to count single pages, appending their addresses to frames, and
+     * returns the number taken; the pages are accounted as cached. When a
+     * cached page is handed out or taken back, the front end calls
+     * takeCachedPage() or putCachedPage(). releaseBatch() returns cached
+     * pages. These methods (except take/putCachedPage) must be serialized
+     * with all other calls.
+     */
+    size_t    allocateBatch(size_t count, std::vector<uintptr_t> &frames);
+    void      releaseBatch(const uintptr_t *frames, size_t count);
+    void      takeCachedPage(void);
+    void      putCachedPage(void);
+
     bool      allReleased(void) const;
     uint64_t  getMaxAllocatedPages(void) const;
+    uint64_t  getNCachedPages(void) const;
+
+    /* Methods used by memory compaction. Pages are identified by their
+     * index in physical memory.
+     */
+    uint64_t  getNPages(void) const;
+    uint64_t  getNFreePages(void) const;
+    uint64_t  getLargestFreeRun(void) const;
+    void      getFreeMap(std::vector<bool> &freeMap) const;
+    bool      allocatePagesAt(uintptr_t addr, size_t count);
+    uintptr_t getPageAddress(uint64_t index) const;
+    uint64_t  getPageIndex(uintptr_t addr) const;
+
+    /* Enable page colouring with the given number of colours. */
+    void      setColouring(const ColourPolicy policy, const uint64_t nColours);
+    uint64_t  getColour(uintptr_t addr) const;
 
     PhysMemManager(const PhysMemManager &) = delete;
     PhysMemManager &operator=(const PhysMemManager &) = delete;
@@ -39,8 +39,10 @@ operator<<(std::ostream &stream, const MemAccess &access)
 
 
 
-Process::Process(std::istream &input)
-  : reader(std::make_unique<TraceReader>(input))
+Process::Process(std::istream &input, const Process *leader)
+  : reader(std::make_unique<TraceReader>(input)),
+    PID(leader ? leader->getPID() : reinterpret_cast<uint64_t>(this)),
+    lastPC(0)
 {
 }
 
@@ -51,7 +53,14 @@ Process::~Process()
 uint64_t
 Process::getPID(void) const
 {
-  /* Use the pointer to the Process as PID */
+  /* The pointer to the first Process of the address space */
+  return PID;
+}
+
+uint64_t
+Process::getTID(void) const
+{
+  /* Use the pointer to the Process as TID */
   return reinterpret_cast<const uint64_t>(this);
 }
 
@@ -59,6 +68,14 @@ void
 Process::getMemoryAccess(MemAccess &access)
 {
   *reader >> access;
+  if (access.type == MemAccessType::Instr)
+    lastPC = access.addr;
+}
+
+uint64_t
+Process::getPC(void) const
+{
+  return lastPC;
 }
 
 bool
@@ -0,0 +1,109 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    reusedistance.cc - Reuse distances in bounded memory
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "reusedistance.h"
+#include "hyperloglog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+
+ReuseDistance::ReuseDistance(const size_t maxSamples)
+  : maxSamples(maxSamples), threshold(~0UL), lastAccess(), byHash(),
+    tree(4 * maxSamples + 1, 0), now(0)
+{
+}
+
+void
+ReuseDistance::mark(uint64_t time, const int delta)
+{
+  for (++time; time <= tree.size(); time += time & -time)
+    tree[time - 1] += delta;
+}
+
+/* Number of marked times before time */
+uint64_t
+ReuseDistance::countBefore(uint64_t time) const
+{
+  uint64_t count = 0;
+  for (; time > 0; time -= time & -time)
+    count += tree[time - 1];
+  return count;
+}
+
+void
+ReuseDistance::renumber(void)
+{
+  std::vector<std::pair<uint64_t, uint64_t>> byTime;
+  for (const auto &kv : lastAccess)
+    byTime.emplace_back(kv.second, kv.first);
+  std::sort(byTime.begin(), byTime.end());
+
+  std::fill(tree.begin(), tree.end(), 0);
+  now = 0;
+  for (const auto &entry : byTime)
+    {
+      lastAccess[entry.second] = now;
+      mark(now++, 1);
+    }
+}
+
+bool
+ReuseDistance::access(const uint64_t page, uint64_t &distance)
+{
+  const uint64_t hash = HyperLogLog::hash(page);
+  if (hash > threshold)
+    return false;
+
+  auto it = lastAccess.find(page);
+  if (it != lastAccess.end())
+    {
+      const uint64_t live = lastAccess.size();
+      distance = live - countBefore(it->second + 1);
+      mark(it->second, -1);
+    }
+  else
+    {
+      byHash.emplace(hash, page);
+      it = lastAccess.emplace(page, 0).first;
+
+      if (lastAccess.size() > maxSamples)
+        {
+          auto largest = std::prev(byHash.end());
+          threshold = largest->first - 1;
+          const uint64_t evicted = largest->second;
+          byHash.erase(largest);
+          if (evicted == page)
+            {
+              lastAccess.erase(it);
+              return false;
+            }
+
+          mark(lastAccess.at(evicted), -1);
+          lastAccess.erase(evicted);
+          it = lastAccess.find(page);
+        }
+      distance = firstAccess;
+    }
+
+  if (now == tree.size())
+    {
+      lastAccess.erase(it);
+      renumber();
+      it = lastAccess.emplace(page, 0).first;
+    }
+  it->second = now;
+  mark(now++, 1);
+  return true;
+}
+
+double
+ReuseDistance::getRate(void) const
+{
+  return std::ldexp((double)threshold, -64);
+}
@@ -0,0 +1,62 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    reusedistance.h - Reuse distances in bounded memory
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __REUSEDISTANCE_H__
+#define __REUSEDISTANCE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+/* Reuse distance: the number of distinct pages accessed between two
+ * accesses to the same page, measured with fixed-size SHARDS (Waldspurger
+ * et al.). Only pages whose hash is below the threshold are tracked;
+ * distances are in sampled pages, to be scaled by the sampling rate.
+ * When more than maxSamples pages are tracked, the threshold is lowered
+ * to drop the page with the largest hash.
+ */
+class ReuseDistance
+{
+  protected:
+    const size_t maxSamples;
+    uint64_t threshold;
+
+    /* Sampled pages: last access time, and by hash for eviction */
+    std::unordered_map<uint64_t, uint64_t> lastAccess;
+    std::set<std::pair<uint64_t, uint64_t>> byHash;
+
+    /* Fenwick tree marking the times that are the last access of a
+     * sampled page; times are renumbered when the tree is full.
+     */
+    std::vector<uint32_t> tree;
+    uint64_t now;
+
+    void      mark(uint64_t time, const int delta);
+    uint64_t  countBefore(uint64_t time) const;
+    void      renumber(void);
+
+  public:
+    /* Distance of the first access to a page. */
+    constexpr static uint64_t firstAccess = ~0UL;
+
+    ReuseDistance(const size_t maxSamples);
+
+    /* Account an access to page. Returns false if page is not sampled;
+     * otherwise distance is set to the number of distinct sampled pages
+     * accessed since the previous access to page, or firstAccess.
+     */
+    bool      access(const uint64_t page, uint64_t &distance);
+
+    /* Fraction of the pages that is sampled. */
+    double    getRate(void) const;
+};
+
+#endif /* __REUSEDISTANCE_H__ */
@@ -0,0 +1,363 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    scheduler.cc - Process scheduling policies
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+Scheduler::Scheduler(const int quantum)
+  : quantum(quantum)
+{
+}
+
+Scheduler::~Scheduler()
+{
+}
+
+void
+Scheduler::charge(const Process &, const uint64_t)
+{
+}
+
+int
+Scheduler::getTimeSlice(const Process &) const
+{
+  return quantum;
+}
+
+void
+Scheduler::removeThread(const Process &)
+{
+}
+
+std::unique_ptr<Scheduler>
+createScheduler(const std::string &name, const int quantum,
+                TLBFootprint footprint, TicketCount ticketCount)
+{
+  if (name == "rr")
+    return std::make_unique<RoundRobinScheduler>(quantum);
+  else if (name == "fair")
+    return std::make_unique<FairScheduler>(quantum);
+  else if (name == "mlfq")
+    return std::make_unique<MLFQScheduler>(quantum);
+  else if (name == "lottery")
+    return std::make_unique<LotteryScheduler>(quantum, ticketCount);
+  else if (name == "affinity")
+    return std::make_unique<AffinityScheduler>(quantum, footprint);
+
+  throw std::runtime_error("unknown scheduler: " + name);
+}
+
+
+/*
+ * RoundRobinScheduler
+ */
+
+RoundRobinScheduler::RoundRobinScheduler(const int quantum)
+  : Scheduler(quantum), ready()
+{
+}
+
+void
+RoundRobinScheduler::enqueue(const std::shared_ptr<Process> &thread)
+{
+  ready.push_back(thread);
+}
+
+std::shared_ptr<Process>
+RoundRobinScheduler::pickNext(void)
+{
+  if (ready.empty())
+    return nullptr;
+
+  std::shared_ptr<Process> next = ready.front();
+  ready.pop_front();
+  return next;
+}
+
+std::shared_ptr<Process>
+RoundRobinScheduler::pickSibling(const uint64_t PID)
+{
+  return takeSibling(ready, PID);
+}
+
+const char *
+RoundRobinScheduler::getName(void) const
+{
+  return "rr";
+}
+
+
+/*
+ * FairScheduler
+ */
+
+FairScheduler::FairScheduler(const int quantum)
+  : Scheduler(quantum), ready(), vruntime(), minVruntime(0)
+{
+}
+
+void
+FairScheduler::enqueue(const std::shared_ptr<Process> &thread)
+{
+  uint64_t &key = vruntime.emplace(thread->getTID(), minVruntime).first->second;
+  key = std::max(key, minVruntime);
+
+  ready.emplace(key, thread);
+}
+
+std::shared_ptr<Process>
+FairScheduler::pickNext(void)
+{
+  if (ready.empty())
+    return nullptr;
+
+  auto first = ready.begin();
+  std::shared_ptr<Process> next = first->second;
+  minVruntime = std::max(minVruntime, first->first);
+  ready.erase(first);
+  return next;
+}
+
+std::shared_ptr<Process>
+FairScheduler::pickSibling(const uint64_t PID)
+{
+  return takeSibling(ready, PID, [](const auto &entry)
+                                   { return entry.second; });
+}
+
+void
+FairScheduler::charge(const Process &thread, const uint64_t runtime)
+{
+  vruntime[thread.getTID()] += runtime;
+}
+
+void
+FairScheduler::removeThread(const Process &thread)
+{
+  vruntime.erase(thread.getTID());
+}
+
+const char *
+FairScheduler::getName(void) const
+{
+  return "fair";
+}
+
+
+/*
+ * MLFQScheduler
+ */
+
+MLFQScheduler::MLFQScheduler(const int quantum)
+  : Scheduler(quantum), ready(), level(), sinceBoost(0)
+{
+}
+
+int
+MLFQScheduler::getLevel(const Process &thread) const
+{
+  auto it = level.find(thread.getTID());
+  return it == level.end() ? 0 : it->second;
+}
+
+void
+MLFQScheduler::enqueue(const std::shared_ptr<Process> &thread)
+{
+  ready[getLevel(*thread)].push_back(thread);
+}
+
+std::shared_ptr<Process>
+MLFQScheduler::pickNext(void)
+{
+  for (auto &queue : ready)
+    if (not queue.empty())
+      {
+        std::shared_ptr<Process> next = queue.front();
+        queue.pop_front();
+        return next;
+      }
+
+  return nullptr;
+}
+
+std::shared_ptr<Process>
+MLFQScheduler::pickSibling(const uint64_t PID)
+{
+  for (auto &queue : ready)
+    if (std::shared_ptr<Process> next = takeSibling(queue, PID))
+      return next;
+
+  return nullptr;
+}
+
+void
+MLFQScheduler::charge(const Process &thread, const uint64_t runtime)
+{
+  const int current = getLevel(thread);
+  if (runtime >= (uint64_t)getTimeSlice(thread) && current + 1 < nLevels)
+    level[thread.getTID()] = current + 1;
+
+  /* Priority boost: all threads, queued or not, return to the top. */
+  sinceBoost += runtime;
+  if (sinceBoost >= boostSlices * quantum)
+    {
+      sinceBoost = 0;
+      level.clear();
+      for (int i = 1; i < nLevels; ++i)
+        {
+          ready[0].insert(ready[0].end(), ready[i].begin(), ready[i].end());
+          ready[i].clear();
+        }
+    }
+}
+
+int
+MLFQScheduler::getTimeSlice(const Process &thread) const
+{
+  return quantum << getLevel(thread);
+}
+
+void
+MLFQScheduler::removeThread(const Process &thread)
+{
+  level.erase(thread.getTID());
+}
+
+const char *
+MLFQScheduler::getName(void) const
+{
+  return "mlfq";
+}
+
+
+/*
+ * LotteryScheduler
+ */
+
+LotteryScheduler::LotteryScheduler(const int quantum, TicketCount ticketCount)
+  : Scheduler(quantum), ticketCount(ticketCount), ready(), tickets(), rng(42)
+{
+}
+
+void
+LotteryScheduler::enqueue(const std::shared_ptr<Process> &thread)
+{
+  if (tickets.find(thread->getTID()) == tickets.end())
+    tickets.emplace(thread->getTID(), ticketCount(*thread));
+  ready.push_back(thread);
+}
+
+std::shared_ptr<Process>
+LotteryScheduler::pickNext(void)
+{
+  uint64_t total = 0;
+  for (const auto &thread : ready)
+    total += tickets.at(thread->getTID());
+
+  if (total == 0)
+    return nullptr;
+
+  uint64_t winner = std::uniform_int_distribution<uint64_t>(0, total - 1)(rng);
+  for (auto it = ready.begin(); it != ready.end(); ++it)
+    {
+      const uint64_t count = tickets.at((*it)->getTID());
+      if (winner < count)
+        {
+          std::shared_ptr<Process> next = *it;
+          ready.erase(it);
+          return next;
+        }
+      winner -= count;
+    }
+
+  return nullptr;
+}
+
+/* Siblings share the lottery win of the first thread of the gang. */
+std::shared_ptr<Process>
+LotteryScheduler::pickSibling(const uint64_t PID)
+{
+  return takeSibling(ready, PID);
+}
+
+void
+LotteryScheduler::removeThread(const Process &thread)
+{
+  tickets.erase(thread.getTID());
+}
+
+const char *
+LotteryScheduler::getName(void) const
+{
+  return "lottery";
+}
+
+
+/*
+ * AffinityScheduler
+ */
+
+AffinityScheduler::AffinityScheduler(const int quantum, TLBFootprint footprint)
+  : Scheduler(quantum), footprint(footprint), ready()
+{
+}
+
+void
+AffinityScheduler::enqueue(const std::shared_ptr<Process> &thread)
+{
+  ready.emplace_back(thread);
+}
+
+std::shared_ptr<Process>
+AffinityScheduler::pickNext(void)
+{
+  if (ready.empty())
+    return nullptr;
+
+  /* The largest footprint wins, the earliest arrival among equals. */
+  auto best = ready.begin();
+  if (best->nSkips < maxSkips)
+    {
+      size_t bestEntries = footprint(*best->thread);
+      for (auto it = std::next(ready.begin()); it != ready.end(); ++it)
+        {
+          const size_t entries = footprint(*it->thread);
+          if (entries > bestEntries)
+            {
+              best = it;
+              bestEntries = entries;
+            }
+        }
+    }
+
+  /* Threads that arrived earlier have been passed over. */
+  for (auto it = ready.begin(); it != best; ++it)
+    ++it->nSkips;
+
+  std::shared_ptr<Process> next = best->thread;
+  ready.erase(best);
+  return next;
+}
+
+/* All threads of an address space have the same footprint; these are
+ * taken in order of arrival.
+ */
+std::shared_ptr<Process>
+AffinityScheduler::pickSibling(const uint64_t PID)
+{
+  return takeSibling(ready, PID, [](const Entry &entry)
+                                   { return entry.thread; });
+}
+
+const char *
+AffinityScheduler::getName(void) const
+{
+  return "affinity";
+}
@@ -0,0 +1,227 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    scheduler.h - Process scheduling policies
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include "process.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/* Interface of the policies that select the next thread to run. The
+ * scheduler owns the ready queue: threads are enqueued when these become
+ * runnable or are preempted, and removed by pickNext. Time is measured in
+ * memory accesses.
+ */
+class Scheduler
+{
+  protected:
+    const int quantum;
+
+    /* Remove the first thread of process PID from queue, in the order of
+     * queue, and return it; nullptr if there is none. threadOf gives the
+     * thread of an element of queue.
+     */
+    template<typename Queue, typename ThreadOf>
+    static std::shared_ptr<Process>
+    takeSibling(Queue &queue, const uint64_t PID, ThreadOf threadOf)
+    {
+      for (auto it = queue.begin(); it != queue.end(); ++it)
+        if (threadOf(*it)->getPID() == PID)
+          {
+            std::shared_ptr<Process> next = threadOf(*it);
+            queue.erase(it);
+            return next;
+          }
+
+      return nullptr;
+    }
+
+    template<typename Queue>
+    static std::shared_ptr<Process>
+    takeSibling(Queue &queue, const uint64_t PID)
+    {
+      return takeSibling(queue, PID, [](const std::shared_ptr<Process> &thread)
+                                       { return thread; });
+    }
+
+  public:
+    Scheduler(const int quantum);
+    virtual ~Scheduler();
+
+    virtual void      enqueue(const std::shared_ptr<Process> &thread) = 0;
+
+    /* Select the next thread to run and remove it from the ready queue;
+     * nullptr if no thread is runnable.
+     */
+    virtual std::shared_ptr<Process> pickNext(void) = 0;
+
+    /* As pickNext, but only consider the threads of process PID; used to
+     * complete a gang.
+     */
+    virtual std::shared_ptr<Process> pickSibling(const uint64_t PID) = 0;
+
+    /* Account a time slice that thread has just run. */
+    virtual void      charge(const Process &thread, const uint64_t runtime);
+
+    /* Length of the next time slice of thread; the quantum by default. */
+    virtual int       getTimeSlice(const Process &thread) const;
+
+    /* Forget all state of a thread that has finished. */
+    virtual void      removeThread(const Process &thread);
+
+    virtual const char *getName(void) const = 0;
+};
+
+/* Number of TLB entries of the address space of a thread. */
+using TLBFootprint = std::function<size_t(const Process &thread)>;
+
+/* Number of lottery tickets a thread holds. */
+using TicketCount = std::function<uint64_t(const Process &thread)>;
+
+/* Create the scheduler with the given name ("rr", "fair", "mlfq",
+ * "lottery" or "affinity"), for the given base time quantum. Throws
+ * std::runtime_error for unknown names.
+ */
+std::unique_ptr<Scheduler>
+createScheduler(const std::string &name, const int quantum,
+                TLBFootprint footprint, TicketCount ticketCount);
+
+
+/* Round robin in order of arrival. */
+class RoundRobinScheduler : public Scheduler
+{
+  protected:
+    std::deque<std::shared_ptr<Process>> ready;
+
+  public:
+    RoundRobinScheduler(const int quantum);
+
+    virtual void      enqueue(const std::shared_ptr<Process> &thread) override;
+    virtual std::shared_ptr<Process> pickNext(void) override;
+    virtual std::shared_ptr<Process> pickSibling(const uint64_t PID) override;
+    virtual const char *getName(void) const override;
+};
+
+/* Fair share, like CFS: the thread that has received the least virtual
+ * runtime runs next. Threads that become runnable start at the minimum
+ * virtual runtime, so these cannot claim the time they did not run.
+ */
+class FairScheduler : public Scheduler
+{
+  protected:
+    /* Ordered by virtual runtime; equal keys in order of arrival. */
+    std::multimap<uint64_t, std::shared_ptr<Process>> ready;
+    std::unordered_map<uint64_t, uint64_t> vruntime;   /* by TID */
+    uint64_t minVruntime;
+
+  public:
+    FairScheduler(const int quantum);
+
+    virtual void      enqueue(const std::shared_ptr<Process> &thread) override;
+    virtual std::shared_ptr<Process> pickNext(void) override;
+    virtual std::shared_ptr<Process> pickSibling(const uint64_t PID) override;
+    virtual void      charge(const Process &thread,
+                             const uint64_t runtime) override;
+    virtual void      removeThread(const Process &thread) override;
+    virtual const char *getName(void) const override;
+};
+
+/* Multi-level feedback queue. Threads start at the highest priority
+ * level; a thread that uses its full time slice moves one level down,
+ * where slices are twice as long. Periodically all threads are boosted
+ * back to the highest level, such that none starves.
+ */
+class MLFQScheduler : public Scheduler
+{
+  protected:
+    constexpr static int nLevels = 3;
+    constexpr static uint64_t boostSlices = 32;  /* in base quanta */
+
+    std::deque<std::shared_ptr<Process>> ready[nLevels];
+    std::unordered_map<uint64_t, int> level;   /* by TID */
+    uint64_t sinceBoost;
+
+    int       getLevel(const Process &thread) const;
+
+  public:
+    MLFQScheduler(const int quantum);
+
+    virtual void      enqueue(const std::shared_ptr<Process> &thread) override;
+    virtual std::shared_ptr<Process> pickNext(void) override;
+    virtual std::shared_ptr<Process> pickSibling(const uint64_t PID) override;
+    virtual void      charge(const Process &thread,
+                             const uint64_t runtime) override;
+    virtual int       getTimeSlice(const Process &thread) const override;
+    virtual void      removeThread(const Process &thread) override;
+    virtual const char *getName(void) const override;
+};
+
+/* Lottery scheduling: every runnable thread holds a number of tickets
+ * and the next thread is drawn at random, in proportion to these. The
+ * tickets of a thread are asked for when it is first enqueued.
+ */
+class LotteryScheduler : public Scheduler
+{
+  protected:
+    const TicketCount ticketCount;
+    std::vector<std::shared_ptr<Process>> ready;
+    std::unordered_map<uint64_t, uint64_t> tickets;   /* by TID */
+    std::mt19937_64 rng;
+
+  public:
+    constexpr static uint64_t defaultTickets = 100;
+
+    LotteryScheduler(const int quantum, TicketCount ticketCount);
+
+    virtual void      enqueue(const std::shared_ptr<Process> &thread) override;
+    virtual std::shared_ptr<Process> pickNext(void) override;
+    virtual std::shared_ptr<Process> pickSibling(const uint64_t PID) override;
+    virtual void      removeThread(const Process &thread) override;
+    virtual const char *getName(void) const override;
+};
+
+/* Prefers the thread whose address space has the most entries left in
+ * the TLB, such that fewer entries have to be refilled. A thread that
+ * has been passed over maxSkips times runs next regardless, in order of
+ * arrival. Only useful if the TLB is not flushed on context switches.
+ */
+class AffinityScheduler : public Scheduler
+{
+  protected:
+    constexpr static int maxSkips = 3;
+
+    struct Entry
+    {
+      std::shared_ptr<Process> thread;
+      int nSkips;
+
+      Entry(const std::shared_ptr<Process> &thread)
+        : thread(thread), nSkips(0)
+      { }
+    };
+
+    const TLBFootprint footprint;
+    std::deque<Entry> ready;
+
+  public:
+    AffinityScheduler(const int quantum, TLBFootprint footprint);
+
+    virtual void      enqueue(const std::shared_ptr<Process> &thread) override;
+    virtual std::shared_ptr<Process> pickNext(void) override;
+    virtual std::shared_ptr<Process> pickSibling(const uint64_t PID) override;
+    virtual const char *getName(void) const override;
+};
+
+#endif /* __SCHEDULER_H__ */
@@ -0,0 +1,439 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    swapmanager.cc - Swap space and swap device model
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "swapmanager.h"
+#include "compressedpool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+
+/*
+ * SwapDeviceModel
+ */
+
+/* Rough figures for a single outstanding request on commodity devices. */
+static const SwapDeviceModel deviceModels[] =
+{
+  { "hdd",  8000000, 8000000,  150UL * 1000 * 1000 },
+  { "ssd",    90000,   40000,  520UL * 1000 * 1000 },
+  { "nvme",   20000,   12000, 3200UL * 1000 * 1000 },
+};
+
+uint64_t
+SwapDeviceModel::readCost(const uint64_t bytes) const
+{
+  return readLatency + (bytes * 1000000000UL) / bandwidth;
+}
+
+uint64_t
+SwapDeviceModel::writeCost(const uint64_t bytes) const
+{
+  return writeLatency + (bytes * 1000000000UL) / bandwidth;
+}
+
+const SwapDeviceModel &
+SwapDeviceModel::get(const std::string &name)
+{
+  for (auto &model : deviceModels)
+    if (name == model.name)
+      return model;
+
+  throw std::runtime_error("unknown swap device '" + name + "'.");
+}
+
+
+/*
+ * SwapManager
+ */
+
+SwapManager::SwapManager(const std::string &deviceName,
+                         const uint64_t pageSize,
+                         const uint64_t swapSize,
+                         CompressedPool *pool)
+  : device(deviceName.empty() ? nullptr : &SwapDeviceModel::get(deviceName)),
+    pool(pool), pageSize(pageSize),
+    nSlots(device ? swapSize / pageSize : 0),
+    swapMap(nSlots, 0), slotOwners(nSlots),
+    nFreeSlots(nSlots), nextSlot(0), entries(), cacheList(), poolList(),
+    nMajorFaults(0), nPoolLoads(0), nPoolWritebacks(0),
+    nCacheHits(0), nReadRequests(0), nWriteRequests(0),
+    nPagesRead(0), nPagesWritten(0), nPagesDropped(0),
+    nReadaheadPages(0),
+    totalFaultLatency(0), maxFaultLatency(0), totalWriteTime(0),
+    latencyHistogram()
+{
+  if (not device && not pool)
+    throw std::runtime_error("swapping needs a swap device or compressed pool.");
+
+  if (device && nSlots == 0)
+    throw std::runtime_error("swap space smaller than a single page.");
+
+  if (device)
+    std::cerr << "BOOT: swap device " << device->name << ", "
+              << std::dec << nSlots << " slots available." << std::endl;
+}
+
+SwapManager::~SwapManager()
+{
+  const uint64_t avgLatency =
+      nMajorFaults ? totalFaultLatency / nMajorFaults : 0;
+
+  std::cerr << std::dec << std::endl
+            << "Swap Statistics (" << (device ? device->name : "no device")
+            << "):" << std::endl
+            << "# major faults: " << nMajorFaults
+            << " (from compressed pool: " << nPoolLoads << ")" << std::endl
+            << "# swap cache hits: " << nCacheHits << std::endl
+            << "avg. major fault latency: " << avgLatency / 1000 << " us" << std::endl
+            << "max. major fault latency: " << maxFaultLatency / 1000 << " us" << std::endl
+            << "major fault latency distribution:" << std::endl;
+
+  for (size_t i = 0; i < latencyHistogram.size(); ++i)
+    {
+      if (latencyHistogram[i] == 0)
+        continue;
+
+      if (i == 0)
+        std::cerr << "  < 1 us: ";
+      else
+        std::cerr << "  " << (1UL << (i - 1)) << "-" << (1UL << i) << " us: ";
+      std::cerr << latencyHistogram[i] << std::endl;
+    }
+
+  std::cerr << "# read requests: " << nReadRequests
+            << " (" << nPagesRead << " pages, "
+            << nPagesRead * pageSize << " bytes)" << std::endl
+            << "# write requests: " << nWriteRequests
+            << " (" << nPagesWritten << " pages, "
+            << nPagesWritten * pageSize << " bytes)" << std::endl
+            << "total write time: " << totalWriteTime / 1000 << " us" << std::endl
+            << "# compressed pool writebacks: " << nPoolWritebacks << std::endl
+            << "# clean pages dropped: " << nPagesDropped << std::endl
+            << "# readahead pages: " << nReadaheadPages
+            << " (used: " << nCacheHits << ")" << std::endl;
+}
+
+SwapManager::SwapEntry *
+SwapManager::findEntry(const uint64_t PID, const uintptr_t vAddr)
+{
+  auto process = entries.find(PID);
+  if (process == entries.end())
+    return nullptr;
+
+  auto it = process->second.find(vAddr);
+  if (it == process->second.end())
+    return nullptr;
+
+  return &it->second;
+}
+
+size_t
+SwapManager::allocateRun(const size_t count, uint64_t &first)
+{
+  if (nFreeSlots == 0 || count == 0)
+    return 0;
+
+  /* Next-fit: continue scanning where the previous cluster ended, so that
+   * subsequent clusters are laid out sequentially on the device.
+   */
+  uint64_t slot = nextSlot;
+  while (swapMap[slot] != 0)
+    slot = (slot + 1) % nSlots;
+
+  size_t length = 0;
+  while (length < count && slot + length < nSlots &&
+         swapMap[slot + length] == 0)
+    ++length;
+
+  first = slot;
+  nextSlot = (slot + length) % nSlots;
+  return length;
+}
+
+void
+SwapManager::freeSlot(const uint64_t slot)
+{
+  if (swapMap[slot] == 0)
+    throw std::runtime_error("attempt to free unused swap slot.");
+
+  if (--swapMap[slot] == 0)
+    ++nFreeSlots;
+}
+
+void
+SwapManager::uncache(SwapEntry &entry)
+{
+  cacheList.erase(entry.cachePos);
+  entry.cachePos = cacheList.end();
+  entry.cachedFrame = 0;
+}
+
+void
+SwapManager::recordFaultLatency(const uint64_t latency)
+{
+  size_t bucket = 0;
+  for (uint64_t us = latency / 1000; us > 0; us >>= 1)
+    ++bucket;
+
+  ++latencyHistogram[std::min(bucket, latencyHistogram.size() - 1)];
+
+  ++nMajorFaults;
+  totalFaultLatency += latency;
+  maxFaultLatency = std::max(maxFaultLatency, latency);
+}
+
+bool
+SwapManager::isSwapped(const uint64_t PID, const uintptr_t vAddr)
+{
+  SwapEntry *entry = findEntry(PID, vAddr);
+
+  return entry && not entry->resident;
+}
+
+bool
+SwapManager::takeCached(const uint64_t PID, const uintptr_t vAddr,
+                        uintptr_t &frame)
+{
+  SwapEntry *entry = findEntry(PID, vAddr);
+  if (not entry || entry->cachedFrame == 0)
+    return false;
+
+  frame = entry->cachedFrame;
+  uncache(*entry);
+  entry->resident = true;
+  ++nCacheHits;
+
+  return true;
+}
+
+void
+SwapManager::swapIn(const uint64_t PID, const uintptr_t vAddr,
+                    std::vector<uintptr_t> &readahead,
+                    const size_t maxReadahead)
+{
+  SwapEntry *entry = findEntry(PID, vAddr);
+  if (not entry || entry->resident)
+    throw std::runtime_error("attempt to swap in page not in swap space.");
+
+  readahead.clear();
+  entry->resident = true;
+
+  /* Loads from the compressed pool are exclusive: the compressed copy is
+   * dropped, so the page has no backing copy until it is stored again.
+   */
+  if (entry->compressedSize != 0)
+    {
+      recordFaultLatency(pool->load(entry->compressedSize));
+      poolList.erase(entry->poolPos);
+      entry->compressedSize = 0;
+      ++nPoolLoads;
+      return;
+    }
+
+  /* Read the aligned window of slots around the faulting slot. Only
+   * slots of the same process that are not already in memory are read.
+   */
+  if (SwapReadahead > 1)
+    {
+      const uint64_t start = entry->slot - (entry->slot % SwapReadahead);
+      for (uint64_t slot = start;
+           slot < start + SwapReadahead && slot < nSlots &&
+           readahead.size() < maxReadahead; ++slot)
+        {
+          if (slot == entry->slot || swapMap[slot] == 0 ||
+              slotOwners[slot].PID != PID)
+            continue;
+
+          SwapEntry *other = findEntry(PID, slotOwners[slot].vAddr);
+          if (other && other->slot == slot &&
+              not other->resident && other->cachedFrame == 0)
+            readahead.push_back(slotOwners[slot].vAddr);
+        }
+    }
+
+  const uint64_t nPages = 1 + readahead.size();
+
+  ++nReadRequests;
+  nPagesRead += nPages;
+  nReadaheadPages += readahead.size();
+  recordFaultLatency(device->readCost(nPages * pageSize));
+}
+
+void
+SwapManager::addCached(const uint64_t PID, const uintptr_t vAddr,
+                       const uintptr_t frame)
+{
+  SwapEntry *entry = findEntry(PID, vAddr);
+  if (not entry || entry->resident || entry->cachedFrame != 0)
+    throw std::runtime_error("attempt to cache page not in swap space.");
+
+  entry->cachedFrame = frame;
+  entry->cachePos = cacheList.emplace(cacheList.end(), PID, vAddr);
+}
+
+bool
+SwapManager::evict(const uint64_t PID, const uintptr_t vAddr,
+                   const bool dirty)
+{
+  auto process = entries.find(PID);
+  if (process != entries.end())
+    {
+      auto it = process->second.find(vAddr);
+      if (it != process->second.end())
+        {
+          /* The slot still holds an up-to-date copy; no I/O needed. */
+          if (not dirty && it->second.slot != noSlot)
+            {
+              it->second.resident = false;
+              ++nPagesDropped;
+              return false;
+            }
+
+          /* Stale copy, or loaded from the compressed pool: give up the
+           * slot, the page is stored anew.
+           */
+          if (it->second.slot != noSlot)
+            freeSlot(it->second.slot);
+          process->second.erase(it);
+          return true;
+        }
+    }
+
+  /* A page that was never written only contains zeroes and can be
+   * recreated on the next fault.
+   */
+  if (not dirty)
+    {
+      ++nPagesDropped;
+      return false;
+    }
+
+  return true;
+}
+
+/* Try to store a page in the compressed pool. If the pool is full, its
+ * oldest pages are moved to writeBack to make room, as long as a swap
+ * device is available to take them.
+ */
+bool
+SwapManager::storeCompressed(const SwapPage &page,
+                             std::vector<SwapPage> &writeBack)
+{
+  const uint32_t size = pool->compress();
+  if (size == 0)
+    return false;
+
+  bool stored = pool->insert(size);
+  while (not stored && device && not poolList.empty())
+    {
+      auto [PID, vAddr] = poolList.front();
+      auto process = entries.find(PID);
+      auto it = process->second.find(vAddr);
+
+      pool->invalidate(it->second.compressedSize);
+      poolList.pop_front();
+      process->second.erase(it);
+
+      writeBack.push_back(SwapPage{ PID, vAddr });
+      ++nPoolWritebacks;
+
+      stored = pool->insert(size);
+    }
+
+  if (not stored)
+    return false;
+
+  SwapEntry &entry = entries[page.PID][page.vAddr];
+  entry.compressedSize = size;
+  entry.poolPos = poolList.emplace(poolList.end(), page.PID, page.vAddr);
+  return true;
+}
+
+bool
+SwapManager::swapOut(const std::vector<SwapPage> &pages)
+{
+  std::vector<SwapPage> deviceWrites;
+  for (const SwapPage &page : pages)
+    if (not pool || not storeCompressed(page, deviceWrites))
+      deviceWrites.push_back(page);
+
+  size_t i = 0;
+  while (i < deviceWrites.size())
+    {
+      uint64_t first;
+      const size_t length = allocateRun(deviceWrites.size() - i, first);
+      if (length == 0)
+        return false;
+
+      for (size_t j = 0; j < length; ++j, ++i)
+        {
+          const uint64_t slot = first + j;
+          const SwapPage &page = deviceWrites[i];
+
+          swapMap[slot] = 1;
+          --nFreeSlots;
+          slotOwners[slot] = SlotOwner{ page.PID, page.vAddr };
+
+          SwapEntry &entry = entries[page.PID][page.vAddr];
+          entry.slot = slot;
+        }
+
+      ++nWriteRequests;
+      nPagesWritten += length;
+      totalWriteTime += device->writeCost(length * pageSize);
+    }
+
+  return true;
+}
+
+void
+SwapManager::shrinkCache(const size_t count, std::vector<uintptr_t> &frames)
+{
+  for (size_t i = 0; i < count && not cacheList.empty(); ++i)
+    {
+      auto [PID, vAddr] = cacheList.front();
+      SwapEntry *entry = findEntry(PID, vAddr);
+
+      frames.push_back(entry->cachedFrame);
+      uncache(*entry);
+    }
+}
+
+void
+SwapManager::releaseProcess(const uint64_t PID,
+                            std::vector<uintptr_t> &frames)
+{
+  auto process = entries.find(PID);
+  if (process == entries.end())
+    return;
+
+  for (auto &[vAddr, entry] : process->second)
+    {
+      if (entry.cachedFrame != 0)
+        {
+          frames.push_back(entry.cachedFrame);
+          uncache(entry);
+        }
+      if (entry.compressedSize != 0)
+        {
+          pool->invalidate(entry.compressedSize);
+          poolList.erase(entry.poolPos);
+        }
+      if (entry.slot != noSlot)
+        freeSlot(entry.slot);
+    }
+
+  entries.erase(process);
+}
+
+uint64_t
+SwapManager::getNMajorFaults(void) const
+{
+  return nMajorFaults;
+}
@@ -0,0 +1,198 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    swapmanager.h - Swap space and swap device model
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __SWAPMANAGER_H__
+#define __SWAPMANAGER_H__
+
+#include "settings.h"
+
+#include <array>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Simple latency/bandwidth model of a block device holding the swap area.
+ * An I/O request of n bytes costs latency + n / bandwidth nanoseconds.
+ */
+struct SwapDeviceModel
+{
+  const char *name;
+  uint64_t readLatency;   /* ns */
+  uint64_t writeLatency;  /* ns */
+  uint64_t bandwidth;     /* bytes per second */
+
+  uint64_t readCost(const uint64_t bytes) const;
+  uint64_t writeCost(const uint64_t bytes) const;
+
+  /* Return the model for the device with the given name ("ssd", "nvme"
+   * or "hdd"). Throws std::runtime_error for unknown devices.
+   */
+  static const SwapDeviceModel &get(const std::string &name);
+};
+
+class CompressedPool;
+
+
+/* A page that is about to be written to swap space. */
+struct SwapPage
+{
+  uint64_t PID;
+  uintptr_t vAddr;
+};
+
+
+/* The swap manager keeps track of which virtual pages have a copy in swap
+ * space. Slots are allocated in clusters, such that the dirty victims of
+ * one reclaim pass are written with a single I/O request where possible.
+ * Pages that are read ahead of a swap-in fault are kept in a swap cache:
+ * physical pages that are not mapped until the process faults on them.
+ *
+ * If a compressed pool is configured, evicted pages are stored there
+ * first. When the pool is full, its least recently stored pages are
+ * written back to the swap device. Without a swap device, the pool is the
+ * only backing store.
+ */
+class SwapManager
+{
+  protected:
+    const static uint64_t noSlot = ~0UL;
+
+    using PageList = std::list<std::pair<uint64_t, uintptr_t>>;
+
+    struct SwapEntry
+    {
+      uint64_t slot;          /* device slot, noSlot if none */
+      uint32_t compressedSize; /* size in compressed pool, 0 if not stored */
+      uintptr_t cachedFrame;  /* swap cache frame, 0 if not cached */
+      bool resident;          /* page is mapped */
+      PageList::iterator cachePos;
+      PageList::iterator poolPos;
+
+      SwapEntry()
+        : slot(noSlot), compressedSize(0), cachedFrame(0), resident(false),
+          cachePos(), poolPos()
+      { }
+    };
+
+    struct SlotOwner
+    {
+      uint64_t PID;
+      uintptr_t vAddr;
+    };
+
+    const SwapDeviceModel *device;  /* nullptr if there is no swap device */
+    CompressedPool *pool;           /* no ownership, may be nullptr */
+    const uint64_t pageSize;
+    const uint64_t nSlots;
+
+    /* Swap map: usage count per slot (0 means free), together with the
+     * owning virtual page of each used slot to be able to locate
+     * neighbouring pages for readahead.
+     */
+    std::vector<uint8_t> swapMap;
+    std::vector<SlotOwner> slotOwners;
+    uint64_t nFreeSlots;
+    uint64_t nextSlot;
+
+    /* Per process: virtual page address to swap entry. */
+    std::map<uint64_t, std::unordered_map<uintptr_t, SwapEntry>> entries;
+
+    /* Swap cache pages in order of insertion; dropped in FIFO order. */
+    PageList cacheList;
+
+    /* Compressed pool pages in order of insertion; written back to the
+     * device in FIFO order.
+     */
+    PageList poolList;
+
+    /* Statistics */
+    uint64_t nMajorFaults;
+    uint64_t nPoolLoads;
+    uint64_t nPoolWritebacks;
+    uint64_t nCacheHits;
+    uint64_t nReadRequests;
+    uint64_t nWriteRequests;
+    uint64_t nPagesRead;
+    uint64_t nPagesWritten;
+    uint64_t nPagesDropped;
+    uint64_t nReadaheadPages;
+    uint64_t totalFaultLatency;
+    uint64_t maxFaultLatency;
+    uint64_t totalWriteTime;
+
+    /* Major fault latency histogram; bucket i counts latencies in
+     * [2^(i-1), 2^i) microseconds, bucket 0 those below 1 us.
+     */
+    std::array<uint64_t, 24> latencyHistogram;
+
+    SwapEntry *findEntry(const uint64_t PID, const uintptr_t vAddr);
+    size_t allocateRun(const size_t count, uint64_t &first);
+    void freeSlot(const uint64_t slot);
+    void uncache(SwapEntry &entry);
+    bool storeCompressed(const SwapPage &page,
+                         std::vector<SwapPage> &writeBack);
+    void recordFaultLatency(const uint64_t latency);
+
+  public:
+    /* An empty deviceName configures a swap manager without device; a
+     * compressed pool must be given in that case.
+     */
+    SwapManager(const std::string &deviceName, const uint64_t pageSize,
+                const uint64_t swapSize, CompressedPool *pool = nullptr);
+    ~SwapManager();
+
+    /* Returns true if the given virtual page is backed by swap space and
+     * not currently mapped.
+     */
+    bool      isSwapped(const uint64_t PID, const uintptr_t vAddr);
+
+    /* Remove a page from the swap cache and return its frame. Returns
+     * false if the page was not in the swap cache.
+     */
+    bool      takeCached(const uint64_t PID, const uintptr_t vAddr,
+                         uintptr_t &frame);
+
+    /* Load a swapped page (a major fault). Pages in the compressed pool
+     * are decompressed. Otherwise the page is read from the device, and
+     * up to maxReadahead neighbouring slots of the same process within the
+     * readahead window are read with the same request; their virtual
+     * addresses are returned in readahead and must each be passed to
+     * addCached() with a frame. maxReadahead is the number of frames the
+     * caller can spare, so only pages that will be cached are read.
+     */
+    void      swapIn(const uint64_t PID, const uintptr_t vAddr,
+                     std::vector<uintptr_t> &readahead,
+                     const size_t maxReadahead);
+    void      addCached(const uint64_t PID, const uintptr_t vAddr,
+                        const uintptr_t frame);
+
+    /* Called when a page is unmapped for eviction. Returns true if the
+     * page has to be written to swap space, false if it can be dropped.
+     */
+    bool      evict(const uint64_t PID, const uintptr_t vAddr,
+                    const bool dirty);
+
+    /* Store the given pages in the compressed pool or write them to swap
+     * space using clustered slots. Returns false if swap space is full.
+     */
+    bool      swapOut(const std::vector<SwapPage> &pages);
+
+    /* Drop up to count pages from the swap cache, returning their frames. */
+    void      shrinkCache(const size_t count, std::vector<uintptr_t> &frames);
+
+    /* Release all slots of a process, returning any swap cache frames. */
+    void      releaseProcess(const uint64_t PID, std::vector<uintptr_t> &frames);
+
+    uint64_t  getNMajorFaults(void) const;
+
+    SwapManager(const SwapManager &) = delete;
+    SwapManager &operator=(const SwapManager &) = delete;
+};
+
+#endif /* __SWAPMANAGER_H__ */
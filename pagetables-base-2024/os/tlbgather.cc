@@ -0,0 +1,220 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tlbgather.cc - Batched TLB invalidation and shootdown
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include "tlbgather.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+TLBGather::TLBGather(Processor &processor, const size_t ceiling)
+  : processor(processor), ceiling(ceiling), pending(),
+    cores(processor.getNCores()),
+    nInvalidations(0), nBatches(0), nPageInvalidations(0), nFullFlushes(0),
+    nDeferred(0), nDeferredAbsorbed(0), nIPIs(0), nBroadcastIPIs(0)
+{
+}
+
+TLBGather::~TLBGather()
+{
+  if (nInvalidations == 0)
+    return;
+
+  const uint64_t cost = nPageInvalidations * pageCost +
+                        nFullFlushes * flushCost + nIPIs * ipiCost;
+
+  std::cerr << std::dec << std::endl
+            << "TLB Shootdown Statistics:" << std::endl
+            << "# invalidations: " << nInvalidations
+            << " (batches: " << nBatches << ")" << std::endl
+            << "# single-page invalidations: " << nPageInvalidations << std::endl
+            << "# full flushes: " << nFullFlushes
+            << " (ceiling: " << ceiling << " pages)" << std::endl
+            << "# deferred invalidations: " << nDeferred
+            << " (absorbed by flushes: " << nDeferredAbsorbed << ")" << std::endl;
+  if (cores.size() > 1)
+    std::cerr << "# shootdown IPIs sent: " << nIPIs << std::endl
+              << "# shootdown IPIs avoided: " << getNIPIsAvoided()
+              << " (of " << nBroadcastIPIs << " when broadcast per page)"
+              << std::endl;
+  std::cerr << "# estimated invalidation cost: " << cost << " cycles"
+            << std::endl;
+}
+
+/* Whether the TLB of core may hold the entry. */
+bool
+TLBGather::isCached(const Core &core, const Invalidation &inv) const
+{
+  if (inv.second == globalASID)
+    return core.mayHoldGlobal;
+
+  return core.cachedASIDs.count(inv.second) > 0;
+}
+
+/* Flush the TLB of the current core, which absorbs its deferred
+ * invalidations. A flush that keeps global entries does not absorb those
+ * of global pages, which are performed first.
+ */
+void
+TLBGather::flush(Core &core, const bool keepGlobal)
+{
+  MMU &mmu = processor.getMMU();
+  for (const Invalidation &inv : core.deferred)
+    if (keepGlobal && inv.second == globalASID)
+      {
+        mmu.invalidateTLB(inv.first);
+        ++nPageInvalidations;
+      }
+    else
+      ++nDeferredAbsorbed;
+  core.deferred.clear();
+
+  mmu.flushTLB(keepGlobal);
+}
+
+/* Invalidate batch in the TLB of the current core. */
+void
+TLBGather::invalidate(const std::set<Invalidation> &batch)
+{
+  MMU &mmu = processor.getMMU();
+  Core &core = cores[processor.getCurrentCore()];
+
+  if (ceiling > 0 && batch.size() > ceiling)
+    {
+      const bool keepGlobal =
+        std::none_of(batch.begin(), batch.end(),
+                     [](const Invalidation &inv)
+                       { return inv.second == globalASID; });
+      flush(core, keepGlobal);
+      ++nFullFlushes;
+
+      core.cachedASIDs.clear();
+      if (core.asid != 0)
+        core.cachedASIDs.insert(core.asid);
+      if (not keepGlobal)
+        core.mayHoldGlobal = core.asid != 0;
+      return;
+    }
+
+  for (const Invalidation &inv : batch)
+    {
+      if (inv.second == globalASID)
+        mmu.invalidateTLB(inv.first);
+      else
+        mmu.invalidateTLB(inv.first, inv.second);
+      ++nPageInvalidations;
+    }
+}
+
+void
+TLBGather::add(const uint64_t vAddr, const uint64_t asid)
+{
+  pending.emplace(vAddr, asid);
+  ++nInvalidations;
+
+  if (ceiling == 0)
+    finish();
+}
+
+void
+TLBGather::addGlobal(const uint64_t vAddr)
+{
+  add(vAddr, globalASID);
+}
+
+void
+TLBGather::finish(void)
+{
+  if (pending.empty())
+    return;
+
+  ++nBatches;
+  nBroadcastIPIs += pending.size() * (cores.size() - 1);
+
+  /* The current core always invalidates right away, as it may have
+   * entries from before the gather tracked it.
+   */
+  const unsigned local = processor.getCurrentCore();
+  for (unsigned i = 0; i < cores.size(); ++i)
+    {
+      Core &core = cores[i];
+      std::set<Invalidation> batch;
+      bool urgent = (i == local);
+
+      for (const Invalidation &inv : pending)
+        if (i == local || isCached(core, inv))
+          {
+            batch.insert(inv);
+            if (core.asid != 0 &&
+                (inv.second == globalASID || inv.second == core.asid))
+              urgent = true;
+          }
+
+      if (batch.empty())
+        continue;
+
+      if (not urgent)
+        {
+          nDeferred += batch.size();
+          core.deferred.insert(batch.begin(), batch.end());
+          continue;
+        }
+
+      if (i != local)
+        ++nIPIs;
+
+      processor.selectCore(i);
+      invalidate(batch);
+    }
+  processor.selectCore(local);
+
+  pending.clear();
+}
+
+void
+TLBGather::switchTo(const uint64_t asid, const bool flush)
+{
+  Core &core = cores[processor.getCurrentCore()];
+
+  if (asid != 0)
+    {
+      if (flush)
+        {
+          this->flush(core, true);
+          core.cachedASIDs.clear();
+        }
+      else if (not core.deferred.empty())
+        {
+          std::set<Invalidation> deferred;
+          deferred.swap(core.deferred);
+          invalidate(deferred);
+        }
+
+      core.cachedASIDs.insert(asid);
+      core.mayHoldGlobal = true;
+    }
+
+  core.asid = asid;
+}
+
+uint64_t
+TLBGather::getNIPIs(void) const
+{
+  return nIPIs;
+}
+
+uint64_t
+TLBGather::getNIPIsAvoided(void) const
+{
+  return nBroadcastIPIs - nIPIs;
+}
+
+uint64_t
+TLBGather::getNFullFlushes(void) const
+{
+  return nFullFlushes;
+}
@@ -0,0 +1,101 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tlbgather.h - Batched TLB invalidation and shootdown
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __TLBGATHER_H__
+#define __TLBGATHER_H__
+
+#include "processor.h"
+
+#include <set>
+#include <utility>
+#include <vector>
+
+
+/* Gathers the TLB invalidations of a burst of unmaps or evictions, like
+ * mmu_gather in Linux, and performs these at once in finish(). A core
+ * with more invalidations than the ceiling has its TLB flushed instead,
+ * and every remote core that needs an invalidation gets a single IPI per
+ * batch. A remote core that does not run any of the affected address
+ * spaces cannot use the stale entries before its next context switch, so
+ * its invalidations are deferred until then; a flush on that switch
+ * makes these unnecessary.
+ *
+ * The gather tracks which address spaces may have entries in the TLB of
+ * every core, so all TLB flushes should go through switchTo().
+ */
+class TLBGather
+{
+  protected:
+    /* Rough costs in cycles, for the reported estimate. */
+    constexpr static uint64_t pageCost = 100;
+    constexpr static uint64_t flushCost = 500;
+    constexpr static uint64_t ipiCost = 2000;
+
+    /* (virtual address, ASID); global pages match any ASID. */
+    constexpr static uint64_t globalASID = ~0UL;
+    using Invalidation = std::pair<uint64_t, uint64_t>;
+
+    struct Core
+    {
+      uint64_t asid;        /* running address space, 0 if idle */
+      bool mayHoldGlobal;
+      std::set<uint64_t> cachedASIDs;
+      std::set<Invalidation> deferred;
+
+      Core()
+        : asid(0), mayHoldGlobal(false), cachedASIDs(), deferred()
+      { }
+    };
+
+    Processor &processor;
+    const size_t ceiling;   /* 0 invalidates every page right away */
+    std::set<Invalidation> pending;
+    std::vector<Core> cores;
+
+    uint64_t nInvalidations;
+    uint64_t nBatches;
+    uint64_t nPageInvalidations;
+    uint64_t nFullFlushes;
+    uint64_t nDeferred;
+    uint64_t nDeferredAbsorbed;  /* made unnecessary by a flush */
+    uint64_t nIPIs;
+    uint64_t nBroadcastIPIs;     /* for an IPI to all cores per page */
+
+    bool      isCached(const Core &core, const Invalidation &inv) const;
+    void      flush(Core &core, const bool keepGlobal);
+    void      invalidate(const std::set<Invalidation> &batch);
+
+  public:
+    TLBGather(Processor &processor, const size_t ceiling);
+    ~TLBGather();
+
+    /* Queue the invalidation of the entry of vAddr in address space asid,
+     * or in all address spaces for a global page.
+     */
+    void      add(const uint64_t vAddr, const uint64_t asid);
+    void      addGlobal(const uint64_t vAddr);
+
+    /* Perform the queued invalidations, before the memory of the pages is
+     * reused by a process.
+     */
+    void      finish(void);
+
+    /* The current core switches to address space asid (0 if it becomes
+     * idle), flushing its TLB if flush is set. Deferred invalidations are
+     * performed first; the flush absorbs those of non-global pages.
+     */
+    void      switchTo(const uint64_t asid, const bool flush);
+
+    uint64_t  getNIPIs(void) const;
+    uint64_t  getNIPIsAvoided(void) const;
+    uint64_t  getNFullFlushes(void) const;
+
+    TLBGather(const TLBGather &) = delete;
+    TLBGather &operator=(const TLBGather &) = delete;
+};
+
+#endif /* __TLBGATHER_H__ */
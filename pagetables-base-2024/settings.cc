@@ -10,4 +10,50 @@
 /* Variables to store settings that may be changed via command-line args. */
 bool LogMemoryAccesses = false;
 int ProcessTimeQuantum = 1000;
-uint32_t TLBEntries = 32;
+uint32_t TLBEntries = 64;
+uint32_t TLBAssoc = 0;
+uint32_t VictimTLBEntries = 0;
+std::string TLBIndexing = "set";
+
+std::string SwapDevice = "";
+uint64_t SwapSize = 4 * 1024 * 1024; /* 4 GiB */
+uint32_t SwapCluster = 16;
+uint32_t SwapReadahead = 8;
+
+double ZswapFraction = 0.;
+std::string ZswapRatio = "3";
+
+bool CompactionEnabled = false;
+double CompactionProactive = 0.;
+
+uint64_t CacheSize = 0;
+uint32_t CacheAssoc = 16;
+uint32_t CacheLineSize = 64;
+std::string PageColouring = "none";
+
+std::string PhysAllocator = "firstfit";
+uint32_t FrameCacheBatch = 0;
+
+std::vector<std::pair<uint64_t, uint64_t>> SharedRanges;
+std::vector<std::pair<uint64_t, uint64_t>> GlobalRanges;
+
+std::string SchedulerPolicy = "rr";
+std::map<uint64_t, uint64_t> LotteryTickets;
+bool TLBFlushOnSwitch = true;
+
+uint32_t NCores = 1;
+bool GangScheduling = false;
+uint32_t TLBFlushCeiling = 33;
+
+bool PageTableStats = false;
+uint64_t PageTableStatsInterval = 0;
+
+uint32_t HotPagesTop = 0;
+std::string PCProfileFile = "";
+std::string LiveStatsFile = "";
+double CheckRate = 0.;
+
+uint32_t HostCountersPeriod = 0;
+
+std::vector<std::string> ObserverTLBs;
+uint32_t SetSampling = 1;
@@ -10,15 +10,25 @@
 
 #include "arch/include/aarch64.h"
 #include "os/physmemmanager.h"
+#include "os/livestats.h"
 #include "oskernel.h"
+#include "tests/settingsfixture.h"
 using namespace AArch64;
 
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <memory>
+#include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include <unistd.h>
+
 constexpr static uint64_t MemorySize = (1 * 1024 * 1024) << 10;
 
-BOOST_AUTO_TEST_SUITE(aarch64_test)
+BOOST_FIXTURE_TEST_SUITE(aarch64_test, SettingsFixture)
 
 /*
  * Test AArch64MMU class separately
@@ -161,6 +171,36 @@ BOOST_FIXTURE_TEST_CASE( dirty_bit_test, AArch64MMUFixture )
   BOOST_CHECK_EQUAL( l3_table[l3_idx].dirty, 1 );
 }
 
+/* Test translation through 32 MiB and 64 GiB block descriptors */
+BOOST_FIXTURE_TEST_CASE( block_translation, AArch64MMUFixture )
+{
+  uint64_t vPage = 0x12345;
+  setupValidMapping(vPage, 0xABCDE);
+
+  /* Replace the L3 table by a 32 MiB block, and map a 64 GiB block. */
+  const uint64_t vAddr = vPage << pageBits;
+  SimpleTableEntry &l2_entry = l2_table[L2_INDEX(vAddr)];
+  l2_entry.type = 0;
+  l2_entry.physicalPageNum = 0x40000;
+
+  const uint64_t blockPage = (1UL << (L2_BITS + L3_BITS)) + 0x777;
+  SimpleTableEntry &l1_entry = l1_table[L1_INDEX(blockPage << pageBits)];
+  l1_entry.valid = 1;
+  l1_entry.type = 0;
+  l1_entry.physicalPageNum = 3UL << (L2_BITS + L3_BITS);
+
+  uint64_t pPage;
+  BOOST_CHECK( mmu.performTranslation(vPage, pPage, true) == true );
+  BOOST_CHECK_EQUAL( pPage, 0x40000 + (vPage & (L3_ENTRIES - 1)) );
+  BOOST_CHECK_EQUAL( l2_entry.referenced, 1 );
+  BOOST_CHECK_EQUAL( l2_entry.dirty, 1 );
+
+  BOOST_CHECK( mmu.performTranslation(blockPage, pPage, false) == true );
+  BOOST_CHECK_EQUAL( pPage, (3UL << (L2_BITS + L3_BITS)) + 0x777 );
+  BOOST_CHECK( mmu.referenceTranslation(blockPage, pPage) == true );
+  BOOST_CHECK_EQUAL( pPage, (3UL << (L2_BITS + L3_BITS)) + 0x777 );
+}
+
 /* Test architecture parameters */
 BOOST_AUTO_TEST_CASE( architecture_parameters )
 {
@@ -239,12 +279,35 @@ BOOST_AUTO_TEST_CASE( tlb_flush )
   BOOST_CHECK( tlb.lookup(0x3000, pPage) == false );
 }
 
+BOOST_AUTO_TEST_CASE( tlb_global_entries )
+{
+  AArch64MMU mmu;
+  TLB tlb(4, mmu);
+
+  tlb.setASID(1);
+  tlb.add(0x1000, 0x2000);
+  tlb.add(0x3000, 0x4000, false, true);
+
+  /* Global entries match any ASID and survive a flush that keeps them. */
+  uint64_t pPage;
+  tlb.setASID(2);
+  BOOST_CHECK( tlb.lookup(0x1000, pPage) == false );
+  BOOST_CHECK( tlb.lookup(0x3000, pPage) == true );
+
+  tlb.flush(true);
+  BOOST_CHECK( tlb.lookup(0x3000, pPage) == true );
+  BOOST_CHECK_EQUAL( tlb.getNGlobalHits(), 2 );
+
+  tlb.flush();
+  BOOST_CHECK( tlb.lookup(0x3000, pPage) == false );
+}
+
 BOOST_AUTO_TEST_CASE( tlb_statistics )
 {
   AArch64MMU mmu;
   TLB tlb(4, mmu);
   
-  int nLookups, nHits, nEvictions, nFlush, nFlushEvictions;
+  uint64_t nLookups, nHits, nEvictions, nFlush, nFlushEvictions;
   tlb.getStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
   
   /* Initial statistics should be zero */
@@ -266,6 +329,134 @@ BOOST_AUTO_TEST_CASE( tlb_statistics )
   BOOST_CHECK_EQUAL( nHits, 1 );
 }
 
+BOOST_AUTO_TEST_CASE( tlb_set_associative )
+{
+  AArch64MMU mmu;
+  TLB tlb(8, mmu, 2);  /* 4 sets of 2 ways; pages 0, 4 and 8 share set 0 */
+
+  tlb.add(0, 100);
+  tlb.add(4, 104);
+  tlb.add(1, 101);
+
+  /* Page 8 evicts the least recently used page of set 0 only. */
+  uint64_t pPage;
+  BOOST_CHECK( tlb.lookup(0, pPage) == true );
+  tlb.add(8, 108);
+  BOOST_CHECK( tlb.lookup(4, pPage) == false );
+  BOOST_CHECK( tlb.lookup(0, pPage) == true );
+  BOOST_CHECK( tlb.lookup(8, pPage) == true );
+  BOOST_CHECK( tlb.lookup(1, pPage) == true );
+
+  uint64_t nLookups, nHits, nEvictions, nFlush, nFlushEvictions;
+  tlb.getStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+  BOOST_CHECK_EQUAL( nEvictions, 1 );
+
+  BOOST_CHECK_THROW( TLB(12, mmu, 4), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( tlb_victim )
+{
+  AArch64MMU mmu;
+  TLB tlb(4, mmu, 2, 1, 2);  /* 2 sets of 2 ways and 2 victim entries */
+
+  /* Page 4 evicts page 0 from set 0 into the victim TLB. */
+  tlb.add(0, 100);
+  tlb.add(2, 102);
+  tlb.add(4, 104);
+
+  /* Each victim hit swaps with the LRU entry of the set. */
+  uint64_t pPage = 0;
+  BOOST_CHECK( tlb.lookup(0, pPage) == true );
+  BOOST_CHECK_EQUAL( pPage, 100 );
+  BOOST_CHECK( tlb.lookup(2, pPage) == true );
+  BOOST_CHECK( tlb.lookup(4, pPage) == true );
+  BOOST_CHECK_EQUAL( tlb.getNVictimHits(), 3 );
+
+  /* A write through a clean victim misses, and the walk updates it. */
+  BOOST_CHECK( tlb.lookup(0, pPage, true) == false );
+  tlb.add(0, 100, true);
+  BOOST_CHECK( tlb.lookup(0, pPage, true) == true );
+  BOOST_CHECK_EQUAL( tlb.getNVictimHits(), 4 );
+
+  uint64_t nLookups, nHits, nEvictions, nFlush, nFlushEvictions;
+  tlb.getStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+  BOOST_CHECK_EQUAL( nHits, 0 );
+  BOOST_CHECK_EQUAL( nEvictions, 1 );
+
+  /* Invalidations and flushes reach the victim TLB as well. */
+  tlb.invalidate(2);
+  BOOST_CHECK( tlb.lookup(2, pPage) == false );
+  BOOST_CHECK_EQUAL( tlb.countEntries(0), 2 );
+  tlb.flush();
+  BOOST_CHECK( tlb.lookup(0, pPage) == false );
+  BOOST_CHECK( tlb.lookup(4, pPage) == false );
+}
+
+BOOST_AUTO_TEST_CASE( tlb_page_sizes )
+{
+  AArch64MMU mmu;
+  TLB tlb(16, mmu, 4, 1, 0, TLBOrganisation::Skewed);
+
+  /* A page, a 32 MiB block and a 64 GiB block in one TLB */
+  tlb.add(0x1, 0x100);
+  tlb.add(0x805, 0x4005, false, false, 1);
+  tlb.add((1UL << 22) + 7, (2UL << 22) + 7, false, false, 2);
+
+  uint64_t pPage = 0;
+  unsigned size = 0;
+  BOOST_CHECK( tlb.lookup(0x1, pPage) == true );
+  BOOST_CHECK_EQUAL( pPage, 0x100 );
+  BOOST_CHECK( tlb.lookup(0xf00, pPage, false, nullptr, &size) == true );
+  BOOST_CHECK_EQUAL( pPage, 0x4700 );
+  BOOST_CHECK_EQUAL( size, 1 );
+  BOOST_CHECK( tlb.lookup((1UL << 22) + 12345, pPage, false, nullptr, &size) == true );
+  BOOST_CHECK_EQUAL( pPage, (2UL << 22) + 12345 );
+  BOOST_CHECK_EQUAL( size, 2 );
+  BOOST_CHECK( tlb.lookup(0x2, pPage) == false );
+  BOOST_CHECK_EQUAL( tlb.getNSizeHits(1), 1 );
+
+  /* Invalidating any page of a block drops the block. */
+  tlb.invalidate(0x8ff);
+  BOOST_CHECK( tlb.lookup(0x805, pPage) == false );
+  BOOST_CHECK_EQUAL( tlb.getSplitEntries(0), 8 );
+  BOOST_CHECK_EQUAL( tlb.getSplitEntries(2), 4 );
+
+  /* A set-associative TLB holds the pages of a block separately. */
+  TLB setTLB(16, mmu, 4);
+  setTLB.add(0x805, 0x4005, false, false, 1);
+  BOOST_CHECK( setTLB.lookup(0x805, pPage) == true );
+  BOOST_CHECK( setTLB.lookup(0x806, pPage) == false );
+
+  BOOST_CHECK_THROW( TLB(16, mmu, 2, 1, 0, TLBOrganisation::Split),
+                     std::runtime_error );
+
+  /* Mixed page sizes at random: every hit translates correctly. Regions
+   * of 64 GiB are mapped by blocks of either size or by pages.
+   */
+  for (TLBOrganisation organisation : { TLBOrganisation::Split, TLBOrganisation::Skewed })
+    {
+      TLB mixed(64, mmu, 8, 1, 4, organisation);
+      std::mt19937_64 random(42);
+      const uint64_t offset = 5UL << 22;
+      for (int i = 0; i < 20000; ++i)
+        {
+          const uint64_t region = random() % 12;
+          const uint64_t vPage = (region << 22) | ((random() % 64) << (region % 3 == 1 ? 11 : 0));
+          const bool isWrite = random() % 4 == 0;
+          if (mixed.lookup(vPage, pPage, isWrite))
+            BOOST_REQUIRE_EQUAL( pPage, vPage + offset );
+          else
+            mixed.add(vPage, vPage + offset, isWrite, false, region % 3);
+          if (i % 1000 == 0)
+            mixed.invalidate(vPage);
+        }
+
+      for (unsigned size = 0; size < nPageSizes; ++size)
+        BOOST_CHECK( mixed.getNSizeHits(size) > 0 );
+      BOOST_CHECK( mixed.getMeanSizeEntries(0) > 0. );
+    }
+}
+
 /*
  * Test PhysMemManager with hole list
  */
@@ -363,4 +554,663 @@ BOOST_AUTO_TEST_CASE( physmem_out_of_memory )
   BOOST_CHECK( manager.allReleased() == true );
 }
 
-BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
+/*
+ * Test page replacement with swapping enabled
+ */
+
+BOOST_AUTO_TEST_CASE( swap_out_and_in )
+{
+  /* Touch 16 pages twice with only 8 pages of memory, 4 of which are
+   * needed for the page tables.
+   */
+  std::stringstream trace;
+  for (int round = 0; round < 2; ++round)
+    for (uint64_t page = 0; page < 16; ++page)
+      trace << " S " << std::hex << (0x10000000 + page * pageSize) << ",8\n";
+
+  SwapDevice = "nvme";
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  ProcessList list = { std::make_shared<Process>(trace) };
+  OSKernel kernel(processor, driver, 8 * pageSize, list);
+
+  processor.run();
+
+  /* Every access in the second round faults on an evicted page. */
+  BOOST_CHECK_EQUAL( kernel.getNPageFaults(), 32 );
+  BOOST_CHECK( kernel.getNEvictedPages() >= 28 );
+  BOOST_CHECK_EQUAL( kernel.getMaxAllocatedPages(), 8 );
+}
+
+/*
+ * Test stores through TLB entries filled by loads
+ */
+
+BOOST_AUTO_TEST_CASE( store_through_clean_entry )
+{
+  for (bool swapping : { true, false })
+    {
+      SettingsFixture settings;
+      std::stringstream trace(" L 10000000,8\n S 10000000,8\n");
+
+      if (swapping)
+        SwapDevice = "nvme";
+
+      AArch64MMU mmu;
+      AArch64MMUDriver driver;
+      Processor processor(mmu);
+      ProcessList list = { std::make_shared<Process>(trace) };
+      {
+        OSKernel kernel(processor, driver, 64 * pageSize, list);
+        processor.run();
+
+        /* The store walks to set the dirty bit only if reclaim reads it. */
+        uint64_t nLookups{}, nHits{}, nEvictions{}, nFlush{}, nFlushEvictions{};
+        mmu.getTLBStatistics(nLookups, nHits, nEvictions, nFlush,
+                             nFlushEvictions);
+        BOOST_CHECK_EQUAL( nHits, swapping ? 0 : 1 );
+      }
+    }
+}
+
+/*
+ * Test running out of memory with a compressed pool and no swap device
+ */
+
+BOOST_AUTO_TEST_CASE( zswap_without_device )
+{
+  std::stringstream trace;
+  for (uint64_t page = 0; page < 16; ++page)
+    trace << " S " << std::hex << (0x10000000 + page * pageSize) << ",8\n";
+
+  /* Incompressible pages do not fit in the pool. */
+  ZswapFraction = 0.25;
+  ZswapRatio = "1";
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  ProcessList list = { std::make_shared<Process>(trace) };
+  OSKernel kernel(processor, driver, 8 * pageSize, list);
+
+  auto outOfMemory = [](const std::runtime_error &error)
+    {
+      const std::string message(error.what());
+      return message.find("compressed pool") != std::string::npos;
+    };
+  BOOST_CHECK_EXCEPTION( processor.run(), std::runtime_error,
+                         outOfMemory );
+}
+
+/*
+ * Test reclaim while the kernel allocates the root page tables
+ */
+
+BOOST_AUTO_TEST_CASE( reclaim_during_boot )
+{
+  /* Memory holds the root tables of two of the three processes; the
+   * third has nothing to reclaim from and finds memory full.
+   */
+  std::stringstream traces[3];
+  ProcessList list;
+  for (auto &trace : traces)
+    {
+      trace << " L 10000000,8\n";
+      list.push_back(std::make_shared<Process>(trace));
+    }
+
+  SwapDevice = "nvme";
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  BOOST_CHECK_THROW( OSKernel(processor, driver, 2 * pageSize, list),
+                     std::runtime_error );
+}
+
+/*
+ * Test threads sharing an address space
+ */
+
+BOOST_AUTO_TEST_CASE( threads_share_address_space )
+{
+  for (bool shared : { true, false })
+    {
+      std::stringstream trace1, trace2;
+      for (uint64_t page = 0; page < 4; ++page)
+        {
+          trace1 << " L " << std::hex << (0x10000000 + page * pageSize) << ",8\n";
+          trace2 << " S " << std::hex << (0x10000000 + page * pageSize) << ",8\n";
+        }
+
+      AArch64MMU mmu;
+      AArch64MMUDriver driver;
+      Processor processor(mmu);
+      auto leader = std::make_shared<Process>(trace1);
+      auto thread = std::make_shared<Process>(trace2,
+                                              shared ? leader.get() : nullptr);
+      BOOST_CHECK_EQUAL( shared, leader->getPID() == thread->getPID() );
+      BOOST_CHECK( leader->getTID() != thread->getTID() );
+
+      ProcessList list = { leader, thread };
+      OSKernel kernel(processor, driver, 64 * pageSize, list);
+      processor.run();
+
+      /* The second thread finds its pages mapped and the TLB intact. */
+      uint64_t nLookups{}, nHits{}, nEvictions{}, nFlush{}, nFlushEvictions{};
+      mmu.getTLBStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+      BOOST_CHECK_EQUAL( kernel.getNPageFaults(), shared ? 4 : 8 );
+      BOOST_CHECK_EQUAL( nFlush, shared ? 1 : 2 );
+    }
+}
+
+/*
+ * Test global mappings shared by processes
+ */
+
+BOOST_AUTO_TEST_CASE( global_mappings )
+{
+  for (bool global : { true, false })
+    {
+      /* Both processes access one page in the global range and one
+       * private page.
+       */
+      std::stringstream trace1(" L 40000000,8\n L 10000000,8\n");
+      std::stringstream trace2(" L 40000000,8\n L 10000000,8\n");
+
+      SettingsFixture settings;
+      if (global)
+        GlobalRanges = { { 0x40000000, 0x42000000 } };
+      CheckRate = 1.;
+
+      AArch64MMU mmu;
+      AArch64MMUDriver driver;
+      Processor processor(mmu);
+      ProcessList list = { std::make_shared<Process>(trace1),
+                           std::make_shared<Process>(trace2) };
+      {
+        OSKernel kernel(processor, driver, 64 * pageSize, list);
+        processor.run();
+
+        /* The second process hits the global TLB entry of the first. */
+        BOOST_CHECK_EQUAL( kernel.getNPageFaults(), global ? 3 : 4 );
+        BOOST_CHECK_EQUAL( mmu.getTLB()->getNGlobalHits(), global ? 1 : 0 );
+
+        /* That entry agrees with the page table of the second process,
+         * to which the global region was linked with the first fault.
+         */
+        BOOST_REQUIRE( mmu.getChecker() != nullptr );
+        BOOST_CHECK_EQUAL( mmu.getChecker()->getNDivergences(), 0 );
+      }
+    }
+}
+
+/*
+ * Test sharing of pages and page tables of identical regions
+ */
+
+BOOST_AUTO_TEST_CASE( shared_regions )
+{
+  const uint64_t tableSize = L3_ENTRIES * sizeof(SimpleTableEntry);
+  uint64_t bytesAllocated[2] = { 0, 0 };
+  int maxAllocated[2] = { 0, 0 };
+
+  /* Run the processes interleaved, such that the region stays in use. */
+  ProcessTimeQuantum = 1;
+  for (bool shared : { true, false })
+    {
+      std::stringstream traces[3];
+      for (auto &trace : traces)
+        trace << " L 40000000,8\n L 40004000,8\n L 10000000,8\n";
+
+      SettingsFixture settings;
+      if (shared)
+        SharedRanges = { { 0x40000000, 0x42000000 } };
+
+      AArch64MMU mmu;
+      AArch64MMUDriver driver;
+      Processor processor(mmu);
+      ProcessList list;
+      for (auto &trace : traces)
+        list.push_back(std::make_shared<Process>(trace));
+      {
+        OSKernel kernel(processor, driver, 64 * pageSize, list);
+        processor.run();
+
+        /* The first process maps both shared pages; the others only
+         * fault once to link the shared table.
+         */
+        BOOST_CHECK_EQUAL( kernel.getNPageFaults(), shared ? 7 : 9 );
+        maxAllocated[shared] = kernel.getMaxAllocatedPages();
+      }
+
+      bytesAllocated[shared] = driver.getBytesAllocated();
+    }
+
+  /* Two of the three copies of the shared pages and of the L3 table that
+   * maps these were not needed.
+   */
+  BOOST_CHECK_EQUAL( bytesAllocated[true] + 2 * tableSize, bytesAllocated[false] );
+  BOOST_CHECK_EQUAL( maxAllocated[true] + 2 * 2 + 2, maxAllocated[false] );
+}
+
+BOOST_AUTO_TEST_CASE( shared_region_bounds )
+{
+  /* A shared or global range that does not cover whole L3 tables is
+   * rejected.
+   */
+  for (bool global : { true, false })
+    {
+      SettingsFixture settings;
+      std::stringstream trace(" L 40000000,8\n");
+      (global ? GlobalRanges : SharedRanges) = { { 0x40000000, 0x40004000 } };
+
+      AArch64MMU mmu;
+      AArch64MMUDriver driver;
+      Processor processor(mmu);
+      ProcessList list = { std::make_shared<Process>(trace) };
+      BOOST_CHECK_THROW( OSKernel(processor, driver, 64 * pageSize, list),
+                         std::runtime_error );
+    }
+
+  /* Both processes write the page just past the shared range; each gets
+   * a private copy, next to the shared page.
+   */
+  std::stringstream trace1(" L 40000000,8\n S 42000000,8\n");
+  std::stringstream trace2(" L 40000000,8\n S 42000000,8\n");
+  SharedRanges = { { 0x40000000, 0x42000000 } };
+  CheckRate = 1.;
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  ProcessList list = { std::make_shared<Process>(trace1),
+                       std::make_shared<Process>(trace2) };
+  OSKernel kernel(processor, driver, 64 * pageSize, list);
+  processor.run();
+
+  BOOST_CHECK_EQUAL( kernel.getNPageFaults(), 4 );
+  BOOST_REQUIRE( mmu.getChecker() != nullptr );
+  BOOST_CHECK_EQUAL( mmu.getChecker()->getNDivergences(), 0 );
+}
+
+/*
+ * Test gang scheduling on multiple cores
+ */
+
+BOOST_AUTO_TEST_CASE( gang_scheduling )
+{
+  /* Two threads store to the same pages, in half as much memory, such
+   * that pages are evicted while these run.
+   */
+  NCores = 2;
+  ProcessTimeQuantum = 1;
+  SwapDevice = "nvme";
+  TLBFlushCeiling = 0;
+  for (bool gang : { true, false })
+    {
+      std::stringstream traces[2];
+      for (auto &trace : traces)
+        for (int round = 0; round < 2; ++round)
+          for (uint64_t page = 0; page < 16; ++page)
+            trace << " S " << std::hex << (0x10000000 + page * pageSize) << ",8\n";
+
+      GangScheduling = gang;
+
+      AArch64MMU mmu;
+      AArch64MMUDriver driver;
+      Processor processor(mmu);
+      auto first = std::make_shared<Process>(traces[0]);
+      ProcessList list = { first,
+                           std::make_shared<Process>(traces[1],
+                                                     gang ? first.get() : nullptr) };
+      {
+        OSKernel kernel(processor, driver, 16 * pageSize, list);
+        processor.run();
+        BOOST_CHECK( kernel.getNEvictedPages() > 0 );
+
+        /* The threads of the gang run on both cores, so every shootdown
+         * needs an IPI. Separate processes stay on their own core, and
+         * only the other core's pages need one.
+         */
+        if (gang)
+          {
+            BOOST_CHECK( kernel.getNShootdownIPIs() > 0 );
+            BOOST_CHECK_EQUAL( kernel.getNShootdownIPIsAvoided(), 0 );
+          }
+        else
+          {
+            BOOST_CHECK( kernel.getNShootdownIPIs() > 0 );
+            BOOST_CHECK( kernel.getNShootdownIPIsAvoided() > 0 );
+          }
+      }
+    }
+}
+
+/*
+ * Test batching of TLB invalidations
+ */
+
+BOOST_AUTO_TEST_CASE( batched_invalidation )
+{
+  /* As swap_out_and_in: every reclaim pass evicts several pages. */
+  std::stringstream traces[2];
+  for (auto &trace : traces)
+    for (int round = 0; round < 2; ++round)
+      for (uint64_t page = 0; page < 16; ++page)
+        trace << " S " << std::hex << (0x10000000 + page * pageSize) << ",8\n";
+
+  SwapDevice = "nvme";
+  for (uint32_t ceiling : { 0, 1 })
+    {
+      TLBFlushCeiling = ceiling;
+
+      AArch64MMU mmu;
+      AArch64MMUDriver driver;
+      Processor processor(mmu);
+      ProcessList list = { std::make_shared<Process>(traces[ceiling]) };
+      OSKernel kernel(processor, driver, 8 * pageSize, list);
+      processor.run();
+
+      /* Above the ceiling, the TLB is flushed instead; the outcome is
+       * the same.
+       */
+      uint64_t nLookups{}, nHits{}, nEvictions{}, nFlush{}, nFlushEvictions{};
+      mmu.getTLBStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+      BOOST_CHECK_EQUAL( kernel.getNPageFaults(), 32 );
+      if (ceiling == 0)
+        BOOST_CHECK_EQUAL( nFlush, 1 );
+      else
+        BOOST_CHECK( nFlush > 1 );
+    }
+}
+
+/*
+ * Test page table occupancy analysis
+ */
+
+BOOST_AUTO_TEST_CASE( page_table_occupancy )
+{
+  std::stringstream trace(" L 10000000,8\n");
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  auto process = std::make_shared<Process>(trace);
+  ProcessList list = { process };
+  OSKernel kernel(processor, driver, 64 * pageSize, list);
+
+  /* One 32 MiB region mapped entirely to contiguous, aligned frames and
+   * three pages elsewhere.
+   */
+  PhysPage page;
+  for (uint64_t i = 0; i < L3_ENTRIES; ++i)
+    {
+      page.addr = (L3_ENTRIES + i) << pageBits;
+      driver.setMapping(process->getPID(), 0x40000000 + (i << pageBits), page);
+    }
+  for (uint64_t i = 0; i < 3; ++i)
+    {
+      page.addr = (8 * L3_ENTRIES + 2 * i) << pageBits;
+      driver.setMapping(process->getPID(), 0x10000000 + (i << pageBits), page);
+    }
+
+  std::stringstream report;
+  driver.reportPageTable(process->getPID(), report);
+  const std::string text = report.str();
+  BOOST_CHECK( text.find("# level 2: 1 tables, 2 of 2048 entries valid") != std::string::npos );
+  BOOST_CHECK( text.find("# level 3: 2 tables, 2051 of 4096 entries valid") != std::string::npos );
+  BOOST_CHECK( text.find("valid entries per table: 2-3: 1, 2048: 1") != std::string::npos );
+  BOOST_CHECK( text.find("fully mapped: 1 (50%), block mappable: 1 (50%)") != std::string::npos );
+}
+
+/*
+ * Test the attribution of data TLB misses and faults to instructions
+ */
+
+BOOST_AUTO_TEST_CASE( pc_attribution )
+{
+  /* The instruction at 0x400004 loads from two pages, the one at
+   * 0x400008 from one of these again.
+   */
+  std::stringstream trace("I  400004,4\n"
+                          " L 10000000,8\n"
+                          " L 10010000,8\n"
+                          "I  400008,4\n"
+                          " L 10000000,8\n");
+
+  PCProfileFile = "/dev/null";
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  ProcessList list = { std::make_shared<Process>(trace) };
+  OSKernel kernel(processor, driver, 64 * pageSize, list);
+  processor.run();
+
+  const PCProfile *profile = mmu.getPCProfile();
+  BOOST_REQUIRE( profile != nullptr );
+  /* The instruction fetch faults too, the page of 0x400008 is mapped. */
+  BOOST_CHECK_EQUAL( profile->getCount(PageEvent::Fault, 1, 0x400004), 3 );
+  BOOST_CHECK_EQUAL( profile->getCount(PageEvent::Fault, 1, 0x400008), 0 );
+  BOOST_CHECK_EQUAL( profile->getCount(PageEvent::Walk, 1, 0x400004), 2 );
+  BOOST_CHECK_EQUAL( profile->getCount(PageEvent::TLBMiss, 1, 0x400008), 0 );
+}
+
+/*
+ * Test the live statistics published at exit
+ */
+
+BOOST_AUTO_TEST_CASE( live_statistics )
+{
+  std::stringstream trace(" L 10000000,8\n"
+                          " L 10010000,8\n");
+
+  /* The file is written in a fresh temporary directory, which is removed
+   * also if the test fails.
+   */
+  struct TemporaryDirectory
+  {
+    std::string path;
+
+    TemporaryDirectory() : path("/tmp/pagetables-XXXXXX")
+    {
+      if (mkdtemp(&path[0]) == nullptr)
+        throw std::runtime_error("cannot create temporary directory.");
+    }
+
+    ~TemporaryDirectory()
+    {
+      std::remove((path + "/live_statistics").c_str());
+      rmdir(path.c_str());
+    }
+  } directory;
+
+  LiveStatsFile = directory.path + "/live_statistics";
+  {
+    AArch64MMU mmu;
+    AArch64MMUDriver driver;
+    Processor processor(mmu);
+    ProcessList list = { std::make_shared<Process>(trace) };
+    OSKernel kernel(processor, driver, 64 * pageSize, list);
+    processor.run();
+  }
+
+  /* The handler of SIGUSR1 is restored. */
+  struct sigaction action;
+  sigaction(SIGUSR1, nullptr, &action);
+  BOOST_CHECK( action.sa_handler == SIG_DFL );
+
+  /* The file outlives the kernel. */
+  std::ifstream file(LiveStatsFile, std::ios::binary);
+  auto region = std::make_unique<LiveStatsRegion>();
+  file.read(reinterpret_cast<char *>(region.get()), sizeof(LiveStatsRegion));
+  BOOST_REQUIRE( file.good() );
+
+  LiveSnapshot snapshot;
+  BOOST_REQUIRE( region->read(snapshot) );
+  BOOST_CHECK_EQUAL( snapshot[LiveCounter::Finished], 1 );
+  BOOST_CHECK_EQUAL( snapshot[LiveCounter::Accesses], 2 );
+  BOOST_CHECK_EQUAL( snapshot[LiveCounter::PageFaults], 2 );
+  BOOST_CHECK_EQUAL( snapshot[LiveCounter::NProcesses], 1 );
+  BOOST_CHECK_EQUAL( snapshot.at(0, LiveProcessCounter::Accesses), 2 );
+  BOOST_CHECK_EQUAL( snapshot.at(0, LiveProcessCounter::LiveThreads), 0 );
+}
+
+/*
+ * Test the detection of a stale TLB entry by the translation checker
+ */
+
+BOOST_AUTO_TEST_CASE( translation_checker )
+{
+  std::stringstream trace(" L 10000000,8\n");
+
+  CheckRate = 1.;
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  auto process = std::make_shared<Process>(trace);
+  ProcessList list = { process };
+  OSKernel kernel(processor, driver, 64 * pageSize, list);
+  kernel.interruptHandler(InterruptRequest::Timer);
+
+  const MemAccess access{ MemAccessType::Load, 0x10000000, 8 };
+  mmu.processMemAccess(access);
+  mmu.processMemAccess(access);
+  BOOST_REQUIRE( mmu.getChecker() != nullptr );
+  BOOST_CHECK( mmu.getChecker()->getNChecks() > 0 );
+  BOOST_CHECK_EQUAL( mmu.getChecker()->getNDivergences(), 0 );
+
+  /* Remap the page without invalidating the TLB entry. */
+  PhysPage page;
+  page.addr = 40 * pageSize;
+  driver.setMapping(process->getPID(), 0x10000000, page);
+  mmu.processMemAccess(access);
+  BOOST_CHECK_EQUAL( mmu.getChecker()->getNDivergences(), 1 );
+
+  /* Nor does the reference TLB see the remap. */
+  mmu.invalidateTLB(0x10000000);
+  mmu.processMemAccess(access);
+  BOOST_CHECK_EQUAL( mmu.getChecker()->getNDivergences(), 1 );
+}
+
+/*
+ * Test the phases measured by the host counters
+ */
+
+BOOST_AUTO_TEST_CASE( host_counters )
+{
+  std::stringstream trace(" L 10000000,8\n"
+                          " L 10000008,8\n"
+                          " L 10010000,8\n"
+                          " L 10010008,8\n");
+
+  /* Every other access is measured and counts twice. */
+  HostCountersPeriod = 2;
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  ProcessList list = { std::make_shared<Process>(trace) };
+  OSKernel kernel(processor, driver, 64 * pageSize, list);
+  processor.run();
+
+  const HostCounters *counters = processor.getHostCounters();
+  BOOST_REQUIRE( counters != nullptr );
+  BOOST_CHECK_EQUAL( counters->getCalls(HostPhase::Decode), 4 );
+  BOOST_CHECK_EQUAL( counters->getCalls(HostPhase::Translate), 4 );
+  /* Faults are always measured, whether the access is or not. */
+  BOOST_CHECK_EQUAL( counters->getCalls(HostPhase::Fault), 2 );
+  BOOST_CHECK( counters->getCalls(HostPhase::Interrupt) > 0 );
+  BOOST_CHECK( counters->getTotal(HostPhase::Fault, 0) > 0 );
+}
+
+/*
+ * Test TLB models observing the translations of the MMU
+ */
+
+BOOST_AUTO_TEST_CASE( tlb_observers )
+{
+  /* Three pages, visited round robin, thrash a 2-entry TLB. */
+  std::stringstream trace(" L 10000000,8\n"
+                          " L 10010000,8\n"
+                          " L 10020000,8\n"
+                          " L 10000000,8\n"
+                          " L 10010000,8\n"
+                          " L 10020000,8\n"
+                          " S 10000000,8\n");
+
+  TLBEntries = 4;
+  ObserverTLBs = { "2", "4" };
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  ProcessList list = { std::make_shared<Process>(trace) };
+  OSKernel kernel(processor, driver, 64 * pageSize, list);
+  processor.run();
+
+  const TLBObservers *observers = mmu.getObservers();
+  BOOST_REQUIRE( observers != nullptr );
+  BOOST_REQUIRE_EQUAL( observers->size(), 2 );
+
+  uint64_t nLookups, nHits, nEvictions, nFlush, nFlushEvictions;
+  mmu.getTLBStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+
+  /* An observer like the TLB of the MMU sees the same; without swap,
+   * the store hits the entry filled by a load.
+   */
+  uint64_t lookups, hits, evictions, flush, flushEvictions;
+  observers->getStatistics(1, lookups, hits, evictions, flush, flushEvictions);
+  BOOST_CHECK_EQUAL( lookups, nLookups );
+  BOOST_CHECK_EQUAL( hits, nHits );
+  BOOST_CHECK_EQUAL( hits, 4 );
+
+  /* Faults are driven by the MMU, so the lookups are the same. */
+  observers->getStatistics(0, lookups, hits, evictions, flush, flushEvictions);
+  BOOST_CHECK_EQUAL( lookups, nLookups );
+  BOOST_CHECK_EQUAL( hits, 0 );
+  BOOST_CHECK( evictions > 0 );
+}
+
+/*
+ * Test the accounting of victim TLB hits per thread
+ */
+
+BOOST_AUTO_TEST_CASE( victim_tlb_accounting )
+{
+  /* Three pages, visited round robin, thrash a 2-entry TLB; the victim
+   * TLB holds the evicted entry.
+   */
+  std::stringstream trace(" L 10000000,8\n"
+                          " L 10010000,8\n"
+                          " L 10020000,8\n"
+                          " L 10000000,8\n"
+                          " L 10010000,8\n"
+                          " L 10020000,8\n");
+
+  TLBEntries = 2;
+  VictimTLBEntries = 2;
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  auto process = std::make_shared<Process>(trace);
+  ProcessList list = { process };
+  OSKernel kernel(processor, driver, 64 * pageSize, list);
+  processor.run();
+
+  uint64_t nLookups, nHits, nEvictions, nFlush, nFlushEvictions;
+  mmu.getTLBStatistics(nLookups, nHits, nEvictions, nFlush, nFlushEvictions);
+  const uint64_t nVictimHits = mmu.getTLB()->getNVictimHits();
+  BOOST_CHECK( nVictimHits > 0 );
+
+  /* Hits in the victim TLB are not misses of the thread. */
+  BOOST_CHECK_EQUAL( kernel.getNTLBMisses(process->getTID()),
+                     nLookups - nHits - nVictimHits );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/compactor.cc - unit tests for memory compaction.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#define BOOST_TEST_MODULE Compactor
+#include <boost/test/unit_test.hpp>
+
+#include "arch/include/aarch64.h"
+#include "oskernel.h"
+#include "tests/settingsfixture.h"
+using namespace AArch64;
+
+#include <memory>
+#include <sstream>
+#include <vector>
+
+
+BOOST_FIXTURE_TEST_SUITE(compactor_test, SettingsFixture)
+
+/*
+ * Test memory compaction for multi-page allocations
+ */
+
+BOOST_AUTO_TEST_CASE( compaction_creates_free_run )
+{
+  std::stringstream trace(" L 10000000,8\n");
+
+  CompactionEnabled = true;
+
+  AArch64MMU mmu;
+  AArch64MMUDriver driver;
+  Processor processor(mmu);
+  ProcessList list = { std::make_shared<Process>(trace) };
+  OSKernel kernel(processor, driver, 16 * pageSize, list);
+
+  /* Schedule the process, such that page faults can be handled. */
+  kernel.interruptHandler(InterruptRequest::Timer);
+
+  /* Interleave process pages with kernel allocations, then release the
+   * latter to leave only single-page holes.
+   */
+  std::vector<void *> blocks;
+  for (uint64_t i = 0; i < 6; ++i)
+    {
+      kernel.pageFaultHandler(0x10000000 + i * pageSize);
+      blocks.push_back(kernel.allocateMemory(pageSize, pageSize));
+    }
+  for (void *block : blocks)
+    kernel.releaseMemory(block, pageSize);
+
+  /* Only possible after moving process pages. */
+  void *run = kernel.allocateMemory(3 * pageSize, pageSize);
+  BOOST_CHECK( run != nullptr );
+
+  /* Moved pages are still mapped at the same virtual address. */
+  for (uint64_t i = 0; i < 6; ++i)
+    {
+      MemAccess access{ .type = MemAccessType::Load,
+                        .addr = 0x10000000 + i * pageSize, .size = 8 };
+      uint64_t pAddr = 0;
+      BOOST_CHECK( mmu.getTranslation(access, pAddr) );
+      BOOST_CHECK( pAddr < (uintptr_t)run || pAddr >= (uintptr_t)run + 3 * pageSize );
+    }
+
+  kernel.releaseMemory(run, 3 * pageSize);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/hotpages.cc - unit tests for hot page profiling.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#define BOOST_TEST_MODULE HotPages
+#include <boost/test/unit_test.hpp>
+
+#include "hotpages.h"
+
+#include <sstream>
+
+
+BOOST_AUTO_TEST_SUITE(hotpages_test)
+
+constexpr static uint8_t pageBits = 14;
+
+/*
+ * Test the attribution of events to hot pages
+ */
+
+BOOST_AUTO_TEST_CASE( hot_pages )
+{
+  HotPages hotPages(2);
+
+  /* One hot page among many cold ones, in two address spaces. */
+  for (uint64_t i = 0; i < 100; ++i)
+    {
+      hotPages.tick();
+      hotPages.record(PageEvent::TLBMiss, 1, 0x10000000, pageBits);
+      hotPages.record(PageEvent::TLBMiss, 1, 0x20000000 + (i << pageBits), pageBits);
+      hotPages.record(PageEvent::TLBMiss, 2, 0x10000000 + (i << pageBits), pageBits);
+    }
+
+  auto top = hotPages.getTop(PageEvent::TLBMiss, 1);
+  BOOST_CHECK( top.size() == 2 );
+  BOOST_CHECK( top[0].key == (0x10000000 >> pageBits) );
+  BOOST_CHECK( top[0].count == 100 && top[0].error == 0 );
+  BOOST_CHECK( hotPages.estimate(PageEvent::TLBMiss, 1, 0x10000000, pageBits) >= 100 );
+  BOOST_CHECK( hotPages.estimate(PageEvent::TLBMiss, 2, 0x10000000, pageBits) < 100 );
+  BOOST_CHECK( hotPages.getTop(PageEvent::Fault, 1).empty() );
+
+  std::stringstream report;
+  hotPages.report(report);
+  BOOST_CHECK( report.str().find("# TLB misses: 300") != std::string::npos );
+  BOOST_CHECK( report.str().find("TLB miss heatmap") != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( space_saving_heap )
+{
+  /* A skewed stream: key i occurs 64 / (i + 1) times, interleaved with
+   * keys that occur once.
+   */
+  SpaceSaving summary(8);
+  uint64_t nAdded = 0;
+  for (uint64_t round = 0; round < 64; ++round)
+    {
+      for (uint64_t key = 0; key < 4; ++key)
+        if (round % (key + 1) == 0)
+          {
+            summary.add(key);
+            ++nAdded;
+          }
+      summary.add(1000 + round);
+      ++nAdded;
+    }
+
+  /* The frequent keys are tracked, and each count is an overestimate by
+   * at most its error. The counts sum to the stream length.
+   */
+  auto top = summary.getTop();
+  BOOST_REQUIRE_EQUAL( top.size(), 8 );
+  uint64_t total = 0;
+  for (const auto &counter : top)
+    total += counter.count;
+  BOOST_CHECK_EQUAL( total, nAdded );
+  for (size_t i = 0; i < 4; ++i)
+    {
+      const uint64_t key = top[i].key;
+      BOOST_REQUIRE( key < 4 );
+      const uint64_t exact = (64 + key) / (key + 1);
+      BOOST_CHECK( top[i].count >= exact );
+      BOOST_CHECK( top[i].count - top[i].error <= exact );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,11 @@
 #include <boost/test/unit_test.hpp>
 
 #include "os/physmemmanager.h"
+#include "os/framecache.h"
+#include "cache.h"
+#include <atomic>
+#include <thread>
+#include <string>
 #include <vector>
 #include <set>
 #include <random>
@@ -232,4 +237,345 @@ BOOST_AUTO_TEST_CASE( stress_test_fragmentation )
   BOOST_CHECK(manager.allReleased());
 }
 
+BOOST_AUTO_TEST_CASE( bitmap_allocation )
+{
+  const uint64_t pageSize = 4096;
+  const uint64_t memorySize = 200 * pageSize;  // not a multiple of 64
+  PhysMemManager manager(pageSize, memorySize, "bitmap");
+
+  // Single pages are handed out next-fit
+  uintptr_t addr1, addr2;
+  BOOST_CHECK(manager.allocatePages(1, addr1));
+  BOOST_CHECK(manager.allocatePages(1, addr2));
+  BOOST_CHECK_EQUAL(addr2, addr1 + pageSize);
+  manager.releasePages(addr1, 1);
+  BOOST_CHECK(manager.allocatePages(1, addr1));
+  BOOST_CHECK_EQUAL(addr1, addr2 + pageSize);
+
+  // A run spanning words is found after the allocated pages
+  uintptr_t run;
+  BOOST_CHECK(manager.allocatePages(150, run));
+  BOOST_CHECK_EQUAL(manager.getPageIndex(run), 3);
+  BOOST_CHECK_EQUAL(manager.getLargestFreeRun(), 47);
+  uintptr_t other;
+  BOOST_CHECK(!manager.allocatePages(48, other));
+  BOOST_CHECK(!manager.allocatePagesAt(manager.getPageAddress(152), 2));
+  BOOST_CHECK(manager.allocatePagesAt(manager.getPageAddress(160), 40));
+  BOOST_CHECK_EQUAL(manager.getLargestFreeRun(), 7);
+
+  // Single pages continue after the cursor, skipping allocated runs,
+  // and wrap around to the first free page
+  uintptr_t addr3;
+  for (uint64_t i = 153; i < 160; i++) {
+    BOOST_CHECK(manager.allocatePages(1, addr3));
+    BOOST_CHECK_EQUAL(manager.getPageIndex(addr3), i);
+  }
+  BOOST_CHECK(manager.allocatePages(1, addr3));
+  BOOST_CHECK_EQUAL(manager.getPageIndex(addr3), 0);
+  BOOST_CHECK(!manager.allocatePages(1, addr3));
+}
+
+BOOST_AUTO_TEST_CASE( extent_fit_policies )
+{
+  const uint64_t pageSize = 4096;
+
+  for (const char *name : { "bestfit", "nextfit" }) {
+    PhysMemManager manager(pageSize, 40 * pageSize, name);
+
+    // Create free extents of 8, 3 and 5 pages: [0-7], [10-12], [20-24]
+    uintptr_t all;
+    BOOST_CHECK(manager.allocatePages(40, all));
+    manager.releasePages(manager.getPageAddress(0), 8);
+    manager.releasePages(manager.getPageAddress(10), 3);
+    manager.releasePages(manager.getPageAddress(20), 5);
+    BOOST_CHECK_EQUAL(manager.getLargestFreeRun(), 8);
+
+    uintptr_t addr1, addr2;
+    BOOST_CHECK(manager.allocatePages(3, addr1));
+    BOOST_CHECK(manager.allocatePages(2, addr2));
+    if (std::string(name) == "bestfit") {
+      // The exact fit, then the smallest extent that fits
+      BOOST_CHECK_EQUAL(manager.getPageIndex(addr1), 10);
+      BOOST_CHECK_EQUAL(manager.getPageIndex(addr2), 20);
+    } else {
+      // Continue where the previous allocation ended
+      BOOST_CHECK_EQUAL(manager.getPageIndex(addr1), 0);
+      BOOST_CHECK_EQUAL(manager.getPageIndex(addr2), 3);
+    }
+
+    // Releasing the gaps coalesces everything into one extent
+    manager.releasePages(addr1, 3);
+    manager.releasePages(addr2, 2);
+    manager.releasePages(manager.getPageAddress(8), 2);
+    manager.releasePages(manager.getPageAddress(13), 7);
+    manager.releasePages(manager.getPageAddress(25), 15);
+    BOOST_CHECK_EQUAL(manager.getLargestFreeRun(), 40);
+    BOOST_CHECK(manager.allReleased());
+  }
+}
+
+BOOST_AUTO_TEST_CASE( nextfit_skips_and_wraps )
+{
+  const uint64_t pageSize = 4096;
+  PhysMemManager manager(pageSize, 40 * pageSize, "nextfit");
+
+  // Free extents of 4, 2 and 6 pages: [0-3], [10-11], [20-25]
+  uintptr_t all;
+  BOOST_CHECK(manager.allocatePages(40, all));
+  manager.releasePages(manager.getPageAddress(0), 4);
+  manager.releasePages(manager.getPageAddress(10), 2);
+  manager.releasePages(manager.getPageAddress(20), 6);
+
+  // Skip the extent that is too small, then wrap around to the start
+  uintptr_t addr1, addr2, addr3;
+  BOOST_CHECK(manager.allocatePages(3, addr1));
+  BOOST_CHECK_EQUAL(manager.getPageIndex(addr1), 0);
+  BOOST_CHECK(manager.allocatePages(5, addr2));
+  BOOST_CHECK_EQUAL(manager.getPageIndex(addr2), 20);
+  BOOST_CHECK(manager.allocatePages(2, addr3));
+  BOOST_CHECK_EQUAL(manager.getPageIndex(addr3), 10);
+  BOOST_CHECK(!manager.allocatePages(2, addr3));
+}
+
+BOOST_AUTO_TEST_CASE( allocators_agree )
+{
+  const uint64_t pageSize = 4096;
+  const uint64_t nPages = 1000;
+
+  // Apply the same random sequence to each allocator and compare the free
+  // frames with a reference model after every step.
+  for (const char *name : { "firstfit", "bitmap", "bestfit", "nextfit" }) {
+    PhysMemManager manager(pageSize, nPages * pageSize, name);
+    std::vector<bool> reference(nPages, true);
+    std::vector<std::pair<uintptr_t, size_t>> allocations;
+    std::mt19937 gen(7);
+
+    for (int i = 0; i < 2000; i++) {
+      if (allocations.empty() || gen() % 5 < 3) {
+        size_t size = gen() % 3 ? 1 : 1 + gen() % 100;
+        uintptr_t addr;
+        if (manager.allocatePages(size, addr)) {
+          uint64_t first = manager.getPageIndex(addr);
+          for (uint64_t p = first; p < first + size; p++) {
+            BOOST_REQUIRE(reference[p]);
+            reference[p] = false;
+          }
+          allocations.push_back({addr, size});
+        }
+      } else {
+        size_t index = gen() % allocations.size();
+        auto [addr, size] = allocations[index];
+        manager.releasePages(addr, size);
+        uint64_t first = manager.getPageIndex(addr);
+        std::fill_n(reference.begin() + first, size, true);
+        allocations.erase(allocations.begin() + index);
+      }
+
+      std::vector<bool> freeMap;
+      manager.getFreeMap(freeMap);
+      BOOST_REQUIRE(freeMap == reference);
+
+      uint64_t largest = 0, current = 0;
+      for (bool free : reference) {
+        current = free ? current + 1 : 0;
+        largest = std::max(largest, current);
+      }
+      BOOST_REQUIRE_EQUAL(manager.getLargestFreeRun(), largest);
+    }
+  }
+
+  BOOST_CHECK_THROW(createFrameAllocator("slab", 16), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( page_colouring_policies )
+{
+  const uint64_t pageSize = 4096;
+  PhysMemManager manager(pageSize, 64 * pageSize);
+  manager.setColouring(ColourPolicy::Sequential, 8);
+
+  // Consecutive virtual pages receive consecutive colours
+  uintptr_t addr;
+  for (uint64_t i = 0; i < 8; i++) {
+    BOOST_CHECK(manager.allocatePage(1, i * pageSize, addr));
+    BOOST_CHECK_EQUAL(manager.getColour(addr), i);
+  }
+
+  // A second process starts at a different colour
+  BOOST_CHECK(manager.allocatePage(2, 0, addr));
+  BOOST_CHECK_EQUAL(manager.getColour(addr), 5);
+
+  // Once a colour is exhausted, the next colour is used
+  for (uint64_t i = 1; i < 8; i++) {
+    BOOST_CHECK(manager.allocatePage(1, 8 * i * pageSize, addr));
+    BOOST_CHECK_EQUAL(manager.getColour(addr), 0);
+  }
+  BOOST_CHECK(manager.allocatePage(1, 64 * pageSize, addr));
+  BOOST_CHECK_EQUAL(manager.getColour(addr), 1);
+
+  // Released frames return to their colour list
+  uintptr_t first = manager.getPageAddress(0);
+  manager.releasePages(first, 1);
+  BOOST_CHECK(manager.allocatePage(1, 0, addr));
+  BOOST_CHECK_EQUAL(addr, first);
+
+  // Bin hopping hands out colours in allocation order
+  PhysMemManager hopping(pageSize, 64 * pageSize);
+  hopping.setColouring(ColourPolicy::BinHopping, 8);
+  for (uint64_t i = 0; i < 16; i++) {
+    BOOST_CHECK(hopping.allocatePage(1, 0, addr));
+    BOOST_CHECK_EQUAL(hopping.getColour(addr), i % 8);
+  }
+
+  BOOST_CHECK_THROW(parseColourPolicy("rainbow"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( page_colouring_avoids_conflicts )
+{
+  const uint64_t pageSize = 4096;
+  PhysMemManager manager(pageSize, 64 * pageSize);
+
+  // 32 KiB, 2-way: a way covers 4 pages, so there are 4 colours
+  Cache sameColour(32 * 1024, 2, 64);
+  Cache coloured(32 * 1024, 2, 64);
+  BOOST_CHECK_EQUAL(coloured.getNColours(pageSize), 4);
+
+  manager.setColouring(ColourPolicy::Sequential, 4);
+  std::vector<uintptr_t> frames;
+  for (uint64_t i = 0; i < 4; i++) {
+    uintptr_t addr;
+    BOOST_CHECK(manager.allocatePage(1, i * pageSize, addr));
+    frames.push_back(addr);
+  }
+
+  // Touch the first line of four pages, ten times over
+  for (int round = 0; round < 10; round++)
+    for (uint64_t i = 0; i < 4; i++) {
+      sameColour.access(manager.getPageAddress(4 * i), CacheAccess::Data);
+      coloured.access(frames[i], CacheAccess::Data);
+    }
+
+  BOOST_CHECK_EQUAL(sameColour.getStatistics(CacheAccess::Data).compulsory, 4);
+  BOOST_CHECK_EQUAL(sameColour.getStatistics(CacheAccess::Data).conflict, 36);
+  BOOST_CHECK_EQUAL(coloured.getStatistics(CacheAccess::Data).misses, 4);
+  BOOST_CHECK_EQUAL(coloured.getStatistics(CacheAccess::Data).conflict, 0);
+}
+
+BOOST_AUTO_TEST_CASE( frame_cache_accounting )
+{
+  const uint64_t pageSize = 4096;
+  PhysMemManager manager(pageSize, 64 * pageSize);
+
+  {
+    FrameCache cache(manager, 1, 8);
+
+    // A refill takes a whole batch, but only one page is in use
+    uintptr_t addr;
+    BOOST_CHECK(cache.allocatePage(0, addr));
+    BOOST_CHECK_EQUAL(manager.getNFreePages(), 56);
+    BOOST_CHECK_EQUAL(manager.getMaxAllocatedPages(), 1);
+
+    // Released pages stay in the magazine until it overflows
+    cache.releasePage(0, addr);
+    BOOST_CHECK_EQUAL(manager.getNFreePages(), 56);
+
+    // The magazine serves all 64 pages after refills
+    std::vector<uintptr_t> addrs;
+    while (cache.allocatePage(0, addr))
+      addrs.push_back(addr);
+    BOOST_CHECK_EQUAL(addrs.size(), 64);
+    BOOST_CHECK_EQUAL(manager.getMaxAllocatedPages(), 64);
+
+    for (auto a : addrs)
+      cache.releasePage(0, a);
+    BOOST_CHECK_EQUAL(cache.drain(), 16);
+  }
+
+  BOOST_CHECK(manager.allReleased());
+}
+
+BOOST_AUTO_TEST_CASE( frame_cache_cross_cpu )
+{
+  const uint64_t pageSize = 4096;
+  PhysMemManager manager(pageSize, 64 * pageSize);
+
+  {
+    FrameCache cache(manager, 2, 8);
+
+    // A frame allocated on CPU 0 and released on CPU 1 is reused by CPU 1
+    // without a refill
+    uintptr_t addr, reused;
+    BOOST_CHECK(cache.allocatePage(0, addr));
+    cache.releasePage(1, addr);
+    BOOST_CHECK(cache.allocatePage(1, reused));
+    BOOST_CHECK_EQUAL(reused, addr);
+    BOOST_CHECK_EQUAL(manager.getNFreePages(), 56);
+
+    // CPU 1 overflows and returns its oldest batch
+    std::vector<uintptr_t> addrs;
+    for (int i = 0; i < 24; i++) {
+      BOOST_CHECK(cache.allocatePage(0, addr));
+      addrs.push_back(addr);
+    }
+    for (auto a : addrs)
+      cache.releasePage(1, a);
+    BOOST_CHECK_EQUAL(manager.getNFreePages(), 40);
+
+    // Drained batches are merged back into a single free run
+    cache.releasePage(1, reused);
+    const uint64_t nFree = manager.getNFreePages();
+    BOOST_CHECK_EQUAL(cache.drain(), 64 - nFree);
+    BOOST_CHECK_EQUAL(manager.getLargestFreeRun(), 64);
+  }
+
+  BOOST_CHECK(manager.allReleased());
+}
+
+BOOST_AUTO_TEST_CASE( frame_cache_concurrent )
+{
+  const uint64_t pageSize = 4096;
+  const uint64_t nPages = 256;
+  const unsigned nThreads = 4;
+  PhysMemManager manager(pageSize, nPages * pageSize);
+
+  // Owner count per frame, to detect frames handed out twice
+  std::vector<std::atomic<int>> owners(nPages);
+  std::atomic<int> nDuplicates(0);
+
+  {
+    FrameCache cache(manager, nThreads, 8);
+
+    std::vector<std::thread> threads;
+    for (unsigned cpu = 0; cpu < nThreads; cpu++) {
+      threads.emplace_back([&, cpu]() {
+        std::mt19937 gen(cpu);
+        std::vector<uintptr_t> held;
+        for (int i = 0; i < 20000; i++) {
+          uintptr_t addr;
+          if (held.size() < 32 && gen() % 2 && cache.allocatePage(cpu, addr)) {
+            if (owners[manager.getPageIndex(addr)].fetch_add(1) != 0)
+              nDuplicates++;
+            held.push_back(addr);
+          } else if (not held.empty()) {
+            addr = held.back();
+            held.pop_back();
+            owners[manager.getPageIndex(addr)].fetch_sub(1);
+            cache.releasePage(cpu, addr);
+          }
+        }
+        for (auto addr : held) {
+          owners[manager.getPageIndex(addr)].fetch_sub(1);
+          cache.releasePage(cpu, addr);
+        }
+      });
+    }
+    for (auto &t : threads)
+      t.join();
+
+    BOOST_CHECK_EQUAL(nDuplicates, 0);
+    BOOST_CHECK(manager.getMaxAllocatedPages() <= nThreads * 32);
+  }
+
+  BOOST_CHECK(manager.allReleased());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
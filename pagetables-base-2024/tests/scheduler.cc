@@ -0,0 +1,105 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/scheduler.cc - unit tests for the scheduling policies.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#define BOOST_TEST_MODULE Scheduler
+#include <boost/test/unit_test.hpp>
+
+#include "os/scheduler.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+
+BOOST_AUTO_TEST_SUITE(scheduler_test)
+
+/*
+ * Test scheduling policies
+ */
+
+BOOST_AUTO_TEST_CASE( scheduler_policies )
+{
+  std::stringstream traces[3];
+  std::vector<std::shared_ptr<Process>> threads;
+  for (auto &trace : traces)
+    {
+      trace << " L 10000000,8\n";
+      threads.push_back(std::make_shared<Process>(trace));
+    }
+
+  /* Fair: the thread with the least runtime runs next. */
+  FairScheduler fair(100);
+  for (auto &thread : threads)
+    fair.enqueue(thread);
+  BOOST_CHECK( fair.pickNext() == threads[0] );
+  fair.charge(*threads[0], 100);
+  fair.enqueue(threads[0]);
+  BOOST_CHECK( fair.pickNext() == threads[1] );
+  fair.charge(*threads[1], 10);
+  fair.enqueue(threads[1]);
+  BOOST_CHECK( fair.pickNext() == threads[2] );
+  BOOST_CHECK( fair.pickNext() == threads[1] );
+  BOOST_CHECK( fair.pickNext() == threads[0] );
+  BOOST_CHECK( fair.pickNext() == nullptr );
+
+  /* MLFQ: a thread using its full slice drops a level, and is boosted
+   * back eventually.
+   */
+  MLFQScheduler mlfq(100);
+  for (auto &thread : threads)
+    mlfq.enqueue(thread);
+  BOOST_CHECK( mlfq.pickNext() == threads[0] );
+  mlfq.charge(*threads[0], 100);
+  BOOST_CHECK_EQUAL( mlfq.getTimeSlice(*threads[0]), 200 );
+  mlfq.enqueue(threads[0]);
+  BOOST_CHECK( mlfq.pickNext() == threads[1] );
+  mlfq.charge(*threads[1], 50);
+  BOOST_CHECK_EQUAL( mlfq.getTimeSlice(*threads[1]), 100 );
+  mlfq.enqueue(threads[1]);
+  BOOST_CHECK( mlfq.pickNext() == threads[2] );
+  BOOST_CHECK( mlfq.pickNext() == threads[1] );
+  mlfq.charge(*threads[1], 32 * 100);
+  BOOST_CHECK_EQUAL( mlfq.getTimeSlice(*threads[0]), 100 );
+
+  /* Lottery: threads win in proportion to their tickets. */
+  LotteryScheduler lottery(100, [&threads](const Process &thread) -> uint64_t
+                                  {
+                                    if (&thread == threads[0].get())
+                                      return 0;
+                                    return &thread == threads[2].get() ? 300 : 100;
+                                  });
+  for (auto &thread : threads)
+    lottery.enqueue(thread);
+  int nWins[3] = { 0, 0, 0 };
+  for (int i = 0; i < 4000; ++i)
+    {
+      auto winner = lottery.pickNext();
+      ++nWins[std::find(threads.begin(), threads.end(), winner) - threads.begin()];
+      lottery.enqueue(winner);
+    }
+  BOOST_CHECK_EQUAL( nWins[0], 0 );
+  BOOST_CHECK( nWins[2] > 2 * nWins[1] && nWins[2] < 4 * nWins[1] );
+
+  /* Affinity: the largest TLB footprint runs next, but no thread is
+   * passed over more than a few times.
+   */
+  AffinityScheduler affinity(100, [&threads](const Process &thread)
+                                    {
+                                      return &thread == threads[2].get() ? 10 : 0;
+                                    });
+  for (auto &thread : threads)
+    affinity.enqueue(thread);
+  for (int i = 0; i < 3; ++i)
+    {
+      BOOST_CHECK( affinity.pickNext() == threads[2] );
+      affinity.enqueue(threads[2]);
+    }
+  BOOST_CHECK( affinity.pickNext() == threads[0] );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
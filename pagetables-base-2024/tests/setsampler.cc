@@ -0,0 +1,64 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/setsampler.cc - unit tests for set sampling.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#define BOOST_TEST_MODULE SetSampler
+#include <boost/test/unit_test.hpp>
+
+#include "arch/include/aarch64.h"
+#include "setsampler.h"
+using namespace AArch64;
+
+#include <cmath>
+#include <random>
+
+
+BOOST_AUTO_TEST_SUITE(setsampler_test)
+
+/*
+ * Test the estimate of a TLB of which only some sets are simulated
+ */
+
+BOOST_AUTO_TEST_CASE( set_sampling )
+{
+  AArch64MMU mmu;
+  TLB full(256, mmu, 4);
+  TLB sampled(256, mmu, 4, 8);
+
+  /* A skewed stream: half of the lookups go to a few hot pages. */
+  std::mt19937_64 random(1);
+  const int nLookups = 50000;
+  for (int i = 0; i < nLookups; ++i)
+    {
+      const uint64_t vPage = random() % 2 ? random() % 4 : random() % 1024;
+      for (TLB *tlb : { &full, &sampled })
+        {
+          uint64_t pPage;
+          if (not tlb->lookup(vPage, pPage))
+            tlb->add(vPage, vPage);
+        }
+    }
+
+  const SetSampler *sampler = sampled.getSampler();
+  BOOST_REQUIRE( sampler != nullptr );
+  BOOST_CHECK_EQUAL( sampler->getSets().size(), 8 );
+  BOOST_CHECK( full.getSampler() == nullptr );
+
+  /* Lookups in sets that are not sampled are only counted. */
+  uint64_t lookups, hits, evictions, flush, flushEvictions;
+  sampled.getStatistics(lookups, hits, evictions, flush, flushEvictions);
+  const SetSampler::Estimate e = sampler->estimate(0);
+  BOOST_CHECK_EQUAL( e.accesses, nLookups );
+  BOOST_CHECK_EQUAL( e.sampled, lookups );
+  BOOST_CHECK( lookups < nLookups / 2 );
+
+  full.getStatistics(lookups, hits, evictions, flush, flushEvictions);
+  const double missRate = 1. - (double)hits / lookups;
+  BOOST_CHECK( e.error > 0. );
+  BOOST_CHECK( std::abs(e.missRate - missRate) <= e.error );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
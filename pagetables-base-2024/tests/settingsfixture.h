@@ -0,0 +1,82 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/settingsfixture.h - Restore the settings after each test.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#ifndef __SETTINGSFIXTURE_H__
+#define __SETTINGSFIXTURE_H__
+
+#include "settings.h"
+
+#include <functional>
+#include <vector>
+
+/* Saves all settings on construction and restores them on destruction,
+ * such that a test that changes settings and fails does not affect the
+ * tests after it.
+ */
+struct SettingsFixture
+{
+  std::vector<std::function<void()>> restore;
+
+  template<typename T>
+  void save(T &setting)
+  {
+    restore.push_back([&setting, value = setting]() { setting = value; });
+  }
+
+  SettingsFixture()
+    : restore()
+  {
+    save(LogMemoryAccesses);
+    save(ProcessTimeQuantum);
+    save(TLBEntries);
+    save(TLBAssoc);
+    save(VictimTLBEntries);
+    save(TLBIndexing);
+    save(SwapDevice);
+    save(SwapSize);
+    save(SwapCluster);
+    save(SwapReadahead);
+    save(ZswapFraction);
+    save(ZswapRatio);
+    save(CompactionEnabled);
+    save(CompactionProactive);
+    save(CacheSize);
+    save(CacheAssoc);
+    save(CacheLineSize);
+    save(PageColouring);
+    save(PhysAllocator);
+    save(FrameCacheBatch);
+    save(SharedRanges);
+    save(GlobalRanges);
+    save(SchedulerPolicy);
+    save(LotteryTickets);
+    save(TLBFlushOnSwitch);
+    save(NCores);
+    save(GangScheduling);
+    save(TLBFlushCeiling);
+    save(PageTableStats);
+    save(PageTableStatsInterval);
+    save(HotPagesTop);
+    save(PCProfileFile);
+    save(LiveStatsFile);
+    save(CheckRate);
+    save(HostCountersPeriod);
+    save(ObserverTLBs);
+    save(SetSampling);
+  }
+
+  ~SettingsFixture()
+  {
+    for (auto &restoreSetting : restore)
+      restoreSetting();
+  }
+
+  SettingsFixture(const SettingsFixture &) = delete;
+  SettingsFixture &operator=(const SettingsFixture &) = delete;
+};
+
+#endif /* __SETTINGSFIXTURE_H__ */
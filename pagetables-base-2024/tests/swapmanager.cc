@@ -0,0 +1,241 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/swapmanager.cc - unit tests for swap space management.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#define BOOST_TEST_MODULE SwapManager
+#include <boost/test/unit_test.hpp>
+
+#include "os/swapmanager.h"
+#include "os/compressedpool.h"
+#include "os/physmemmanager.h"
+#include "os/framecache.h"
+#include "tests/settingsfixture.h"
+
+#include <stdexcept>
+#include <vector>
+
+
+BOOST_FIXTURE_TEST_SUITE(swapmanager_test, SettingsFixture)
+
+constexpr static uint64_t pageSize = 16384;
+
+BOOST_AUTO_TEST_CASE( device_models )
+{
+  const SwapDeviceModel &hdd = SwapDeviceModel::get("hdd");
+  const SwapDeviceModel &nvme = SwapDeviceModel::get("nvme");
+
+  /* Latency dominates small requests, bandwidth large ones. */
+  BOOST_CHECK(hdd.readCost(pageSize) > nvme.readCost(pageSize));
+  BOOST_CHECK(nvme.readCost(64 * pageSize) > nvme.readCost(pageSize));
+  BOOST_CHECK(nvme.readCost(8 * pageSize) < 8 * nvme.readCost(pageSize));
+
+  BOOST_CHECK_THROW(SwapDeviceModel::get("floppy"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( clean_pages_are_dropped )
+{
+  SwapManager swap("ssd", pageSize, 16 * pageSize);
+
+  /* A page that was never written need not be stored. */
+  BOOST_CHECK(swap.evict(1, 0x0, false) == false);
+  BOOST_CHECK(swap.isSwapped(1, 0x0) == false);
+
+  /* A dirty page is written and can be swapped in again. */
+  BOOST_CHECK(swap.evict(1, pageSize, true) == true);
+  BOOST_CHECK(swap.swapOut({ SwapPage{ 1, pageSize } }));
+  BOOST_CHECK(swap.isSwapped(1, pageSize));
+
+  std::vector<uintptr_t> readahead;
+  swap.swapIn(1, pageSize, readahead, 8);
+  BOOST_CHECK(swap.isSwapped(1, pageSize) == false);
+  BOOST_CHECK_EQUAL(swap.getNMajorFaults(), 1);
+
+  /* The slot still holds a clean copy after swap-in. */
+  BOOST_CHECK(swap.evict(1, pageSize, false) == false);
+  BOOST_CHECK(swap.isSwapped(1, pageSize));
+
+  std::vector<uintptr_t> frames;
+  swap.releaseProcess(1, frames);
+  BOOST_CHECK(frames.empty());
+}
+
+BOOST_AUTO_TEST_CASE( readahead_window )
+{
+  SwapReadahead = 4;
+  SwapManager swap("nvme", pageSize, 16 * pageSize);
+
+  /* A cluster of 6 pages occupies slots 0-5; pages of another process
+   * follow in slots 6-7.
+   */
+  std::vector<SwapPage> pages;
+  for (uintptr_t i = 0; i < 6; ++i)
+    pages.push_back(SwapPage{ 1, i * pageSize });
+  pages.push_back(SwapPage{ 2, 0x0 });
+  pages.push_back(SwapPage{ 2, pageSize });
+  BOOST_CHECK(swap.swapOut(pages));
+
+  /* Faulting slot 5 reads the aligned window 4-7, but only slot 4
+   * belongs to the same process.
+   */
+  std::vector<uintptr_t> readahead;
+  swap.swapIn(1, 5 * pageSize, readahead, 8);
+  BOOST_REQUIRE_EQUAL(readahead.size(), 1);
+  BOOST_CHECK_EQUAL(readahead[0], 4 * pageSize);
+
+  /* Once cached, a fault on the readahead page is served from memory. */
+  swap.addCached(1, 4 * pageSize, 0x1000);
+  uintptr_t frame = 0;
+  BOOST_CHECK(swap.takeCached(1, 4 * pageSize, frame));
+  BOOST_CHECK_EQUAL(frame, 0x1000);
+  BOOST_CHECK(swap.takeCached(1, 4 * pageSize, frame) == false);
+
+  /* The window is trimmed to the frames the caller can spare. */
+  swap.swapIn(1, 0x0, readahead, 2);
+  BOOST_CHECK_EQUAL(readahead.size(), 2);
+  BOOST_CHECK(swap.isSwapped(1, 3 * pageSize));
+
+  /* Unused swap cache pages are returned on shrink. */
+  swap.addCached(1, readahead[0], 0x2000);
+
+  std::vector<uintptr_t> frames;
+  swap.shrinkCache(8, frames);
+  BOOST_REQUIRE_EQUAL(frames.size(), 1);
+  BOOST_CHECK_EQUAL(frames[0], 0x2000);
+
+  swap.releaseProcess(1, frames);
+  swap.releaseProcess(2, frames);
+}
+
+BOOST_AUTO_TEST_CASE( swap_space_full )
+{
+  SwapManager swap("hdd", pageSize, 2 * pageSize);
+
+  BOOST_CHECK(swap.swapOut({ SwapPage{ 1, 0x0 }, SwapPage{ 1, pageSize } }));
+  BOOST_CHECK(swap.swapOut({ SwapPage{ 1, 2 * pageSize } }) == false);
+
+  /* Rewriting a dirty page frees its old slot first. */
+  std::vector<uintptr_t> readahead;
+  swap.swapIn(1, 0x0, readahead, 8);
+  BOOST_CHECK(swap.evict(1, 0x0, true));
+  BOOST_CHECK(swap.swapOut({ SwapPage{ 1, 0x0 } }));
+
+  std::vector<uintptr_t> frames;
+  swap.releaseProcess(1, frames);
+  BOOST_CHECK(swap.swapOut({ SwapPage{ 2, 0x0 }, SwapPage{ 2, pageSize } }));
+}
+
+BOOST_AUTO_TEST_CASE( compression_models )
+{
+  CompressionModel fixed("2.5");
+  BOOST_CHECK_EQUAL(fixed.sample(), 2.5);
+
+  /* Expansion is clamped to a ratio of 1. */
+  CompressionModel expanding("0.5");
+  BOOST_CHECK_EQUAL(expanding.sample(), 1.);
+
+  CompressionModel uniform("uniform:2:3");
+  for (int i = 0; i < 100; ++i)
+    {
+      double ratio = uniform.sample();
+      BOOST_CHECK(ratio >= 2. && ratio <= 3.);
+    }
+
+  BOOST_CHECK_THROW(CompressionModel("normal:3"), std::runtime_error);
+  BOOST_CHECK_THROW(CompressionModel("file:/nonexistent"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( compressed_pool_capacity )
+{
+  PhysMemManager manager(pageSize, 16 * pageSize);
+
+  {
+    /* At most 4 frames, each holding 4 compressed pages. */
+    CompressedPool pool(manager, pageSize, 16, 0.25, "4");
+
+    std::vector<uint32_t> sizes;
+    for (int i = 0; i < 16; ++i)
+      {
+        uint32_t size = pool.compress();
+        BOOST_CHECK_EQUAL(size, pageSize / 4);
+        BOOST_CHECK(pool.insert(size));
+        sizes.push_back(size);
+      }
+    BOOST_CHECK(pool.insert(pool.compress()) == false);
+    BOOST_CHECK_EQUAL(manager.getMaxAllocatedPages(), 4);
+
+    /* Loading costs decompression time and gives back frames. */
+    for (uint32_t size : sizes)
+      BOOST_CHECK(pool.load(size) > 0);
+  }
+
+  BOOST_CHECK(manager.allReleased());
+}
+
+BOOST_AUTO_TEST_CASE( compressed_pool_with_frame_cache )
+{
+  PhysMemManager manager(pageSize, 16 * pageSize);
+
+  {
+    FrameCache cache(manager, 1, 8);
+    CompressedPool pool(manager, pageSize, 16, 0.25, "4", &cache);
+
+    /* Processes hold 8 frames; the other 8 are free in the cache. */
+    std::vector<uintptr_t> frames(16);
+    for (uintptr_t &frame : frames)
+      BOOST_REQUIRE(cache.allocatePage(0, frame));
+    for (int i = 8; i < 16; ++i)
+      cache.releasePage(0, frames[i]);
+    BOOST_REQUIRE_EQUAL(manager.getNFreePages(), 0);
+
+    /* The pool drains the cache for its frames. */
+    const uint32_t size = pool.compress();
+    BOOST_CHECK(pool.insert(size));
+    BOOST_CHECK_EQUAL(manager.getNFreePages(), 7);
+    pool.load(size);
+
+    for (int i = 0; i < 8; ++i)
+      cache.releasePage(0, frames[i]);
+    cache.drain();
+  }
+
+  BOOST_CHECK(manager.allReleased());
+}
+
+BOOST_AUTO_TEST_CASE( compressed_pool_without_device )
+{
+  PhysMemManager manager(pageSize, 16 * pageSize);
+
+  {
+    CompressedPool pool(manager, pageSize, 16, 0.25, "2");
+    SwapManager swap("", pageSize, 0, &pool);
+
+    BOOST_CHECK(swap.evict(1, 0x0, true));
+    BOOST_CHECK(swap.swapOut({ SwapPage{ 1, 0x0 } }));
+    BOOST_CHECK(swap.isSwapped(1, 0x0));
+
+    std::vector<uintptr_t> readahead;
+    swap.swapIn(1, 0x0, readahead, 8);
+    BOOST_CHECK(readahead.empty());
+    BOOST_CHECK_EQUAL(swap.getNMajorFaults(), 1);
+
+    /* Loads are exclusive, so even a clean page has to be stored again. */
+    BOOST_CHECK(swap.evict(1, 0x0, false));
+
+    /* 8 pages fill the pool; without a device the 9th does not fit. */
+    std::vector<SwapPage> pages;
+    for (uintptr_t i = 0; i < 8; ++i)
+      pages.push_back(SwapPage{ 1, i * pageSize });
+    BOOST_CHECK(swap.swapOut(pages));
+    BOOST_CHECK(swap.swapOut({ SwapPage{ 1, 8 * pageSize } }) == false);
+
+    std::vector<uintptr_t> frames;
+    swap.releaseProcess(1, frames);
+  }
+
+  BOOST_CHECK(manager.allReleased());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/tlbgather.cc - unit tests for batched TLB invalidations.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#define BOOST_TEST_MODULE TLBGather
+#include <boost/test/unit_test.hpp>
+
+#include "arch/include/aarch64.h"
+#include "processor.h"
+#include "os/tlbgather.h"
+using namespace AArch64;
+
+
+BOOST_AUTO_TEST_SUITE(tlbgather_test)
+
+/*
+ * Test deferred TLB invalidations
+ */
+
+BOOST_AUTO_TEST_CASE( tlb_gather_deferred_global )
+{
+  AArch64MMU mmu;
+  Processor processor(mmu);
+  processor.setNCores(2);
+  TLBGather gather(processor, 33);
+  uint64_t pPage = 0;
+
+  /* Core 1 caches a global page and becomes idle; core 0 runs. */
+  processor.selectCore(1);
+  gather.switchTo(1, false);
+  mmu.getTLB()->add(5, 100, false, true);
+  gather.switchTo(0, false);
+  processor.selectCore(0);
+  gather.switchTo(2, false);
+
+  /* The idle core cannot use the entry, so its invalidation waits. */
+  gather.addGlobal(5UL << mmu.getPageBits());
+  gather.finish();
+  processor.selectCore(1);
+  BOOST_CHECK( mmu.getTLB()->lookup(5, pPage) == true );
+
+  /* A flush that keeps global entries must still remove it. */
+  gather.switchTo(1, true);
+  BOOST_CHECK( mmu.getTLB()->lookup(5, pPage) == false );
+}
+
+BOOST_AUTO_TEST_CASE( tlb_gather_full_flush_global )
+{
+  AArch64MMU mmu;
+  Processor processor(mmu);
+  processor.setNCores(2);
+  TLBGather gather(processor, 2);
+  uint64_t pPage = 0;
+
+  /* Core 1 caches a global page and becomes idle; core 0 runs. Its
+   * invalidation is deferred on core 1.
+   */
+  processor.selectCore(1);
+  gather.switchTo(1, false);
+  mmu.getTLB()->add(5, 100, false, true);
+  gather.switchTo(0, false);
+  processor.selectCore(0);
+  gather.switchTo(2, false);
+  gather.addGlobal(5UL << mmu.getPageBits());
+  gather.finish();
+
+  /* The idle core then flushes for a batch above the ceiling without
+   * global pages, which keeps global entries; core 0, running the
+   * address space, flushes as well.
+   */
+  processor.selectCore(1);
+  for (uint64_t page = 7; page < 10; ++page)
+    gather.add(page << mmu.getPageBits(), 2);
+  gather.finish();
+  BOOST_CHECK_EQUAL( gather.getNFullFlushes(), 2 );
+  BOOST_CHECK( mmu.getTLB()->lookup(5, pPage) == false );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tests/tracestat.cc - unit tests for the estimators of tracestat.
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#define BOOST_TEST_MODULE TraceStat
+#include <boost/test/unit_test.hpp>
+
+#include "os/hyperloglog.h"
+#include "os/reusedistance.h"
+
+#include <stdexcept>
+#include <vector>
+
+
+BOOST_AUTO_TEST_SUITE(tracestat_test)
+
+/*
+ * Test HyperLogLog
+ */
+
+BOOST_AUTO_TEST_CASE( hyperloglog_cardinalities )
+{
+  BOOST_CHECK_THROW(HyperLogLog(3), std::runtime_error);
+  BOOST_CHECK_THROW(HyperLogLog(19), std::runtime_error);
+
+  HyperLogLog empty;
+  BOOST_CHECK_EQUAL(empty.estimate(), 0.);
+
+  /* Small cardinalities are counted linearly, large ones are within a
+   * few standard errors (0.8%).
+   */
+  const uint64_t cardinalities[] = { 10, 1000, 100000, 1000000 };
+  const double tolerances[] = { 1., 1., 3., 3. };   /* in percent */
+  for (int i = 0; i < 4; ++i)
+    {
+      HyperLogLog hll;
+      for (uint64_t value = 0; value < cardinalities[i]; ++value)
+        hll.add(value);
+      BOOST_CHECK_CLOSE(hll.estimate(), (double)cardinalities[i],
+                        tolerances[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( hyperloglog_duplicates_and_merge )
+{
+  HyperLogLog once, twice, low, high;
+  for (uint64_t value = 0; value < 50000; ++value)
+    {
+      once.add(value);
+      twice.add(value);
+      twice.add(value);
+      (value < 20000 ? low : high).add(value);
+    }
+
+  /* Repeated values do not count, and merging the sketches of disjoint
+   * halves gives the sketch of the whole.
+   */
+  BOOST_CHECK_EQUAL(twice.estimate(), once.estimate());
+  low.merge(high);
+  BOOST_CHECK_EQUAL(low.estimate(), once.estimate());
+
+  BOOST_CHECK_THROW(low.merge(HyperLogLog(10)), std::runtime_error);
+
+  low.clear();
+  BOOST_CHECK_EQUAL(low.estimate(), 0.);
+}
+
+/*
+ * Test reuse distances
+ */
+
+BOOST_AUTO_TEST_CASE( reuse_distance_exact )
+{
+  /* With room for all pages, every page is sampled and the distances
+   * are exact.
+   */
+  ReuseDistance reuse(8);
+  const uint64_t trace[] = { 1, 2, 3, 3, 2, 1, 4, 1 };
+  const uint64_t expected[] =
+    {
+      ReuseDistance::firstAccess, ReuseDistance::firstAccess,
+      ReuseDistance::firstAccess, 0, 1, 2, ReuseDistance::firstAccess, 1
+    };
+
+  for (int i = 0; i < 8; ++i)
+    {
+      uint64_t distance = 0;
+      BOOST_CHECK(reuse.access(trace[i], distance));
+      BOOST_CHECK_EQUAL(distance, expected[i]);
+    }
+  BOOST_CHECK_EQUAL(reuse.getRate(), 1.);
+}
+
+BOOST_AUTO_TEST_CASE( reuse_distance_renumbering )
+{
+  /* The times of 3 samples run out after 13 accesses, and are then
+   * renumbered.
+   */
+  ReuseDistance reuse(3);
+  uint64_t distance = 0;
+  for (int i = 0; i < 12; ++i)
+    {
+      BOOST_CHECK(reuse.access(i % 3, distance));
+      BOOST_CHECK_EQUAL(distance, i < 3 ? ReuseDistance::firstAccess : 2);
+    }
+
+  /* ... 0 1 2 | 2 1 0, renumbering at the second access of 1 */
+  BOOST_CHECK(reuse.access(2, distance));
+  BOOST_CHECK_EQUAL(distance, 0);
+  BOOST_CHECK(reuse.access(1, distance));
+  BOOST_CHECK_EQUAL(distance, 1);
+  BOOST_CHECK(reuse.access(0, distance));
+  BOOST_CHECK_EQUAL(distance, 2);
+  BOOST_CHECK(reuse.access(2, distance));
+  BOOST_CHECK_EQUAL(distance, 2);
+}
+
+BOOST_AUTO_TEST_CASE( reuse_distance_eviction )
+{
+  /* Of pages 0 to 3, 0 has the largest hash, then 2, 1 and 3; the hash
+   * of 12 lies between those of 1 and 2.
+   */
+  BOOST_REQUIRE(HyperLogLog::hash(0) > HyperLogLog::hash(2));
+  BOOST_REQUIRE(HyperLogLog::hash(2) > HyperLogLog::hash(12));
+  BOOST_REQUIRE(HyperLogLog::hash(12) > HyperLogLog::hash(1));
+  BOOST_REQUIRE(HyperLogLog::hash(1) > HyperLogLog::hash(3));
+
+  ReuseDistance reuse(2);
+  uint64_t distance = 0;
+  BOOST_CHECK(reuse.access(0, distance));
+  BOOST_CHECK(reuse.access(1, distance));
+
+  /* A third page drops 0, which is no longer sampled. */
+  BOOST_CHECK(reuse.access(2, distance));
+  BOOST_CHECK_EQUAL(distance, ReuseDistance::firstAccess);
+  BOOST_CHECK(reuse.getRate() < 1.);
+  BOOST_CHECK(not reuse.access(0, distance));
+  BOOST_CHECK(reuse.access(1, distance));
+  BOOST_CHECK_EQUAL(distance, 1);
+
+  /* 3 drops 2; 12 is below the threshold, but drops itself. */
+  BOOST_CHECK(reuse.access(3, distance));
+  BOOST_CHECK_EQUAL(distance, ReuseDistance::firstAccess);
+  BOOST_CHECK(not reuse.access(2, distance));
+  BOOST_CHECK(not reuse.access(12, distance));
+  BOOST_CHECK(not reuse.access(12, distance));
+
+  /* Dropped pages do not count in the distances of the others. */
+  BOOST_CHECK(reuse.access(1, distance));
+  BOOST_CHECK_EQUAL(distance, 1);
+  BOOST_CHECK(reuse.access(3, distance));
+  BOOST_CHECK_EQUAL(distance, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
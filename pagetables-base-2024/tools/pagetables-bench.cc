@@ -0,0 +1,680 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    pagetables-bench.cc - Macro benchmark of the simulator itself
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/* Generates a fixed corpus of synthetic multi-process traces and runs
+ * pagetables on every trace set in a number of configurations, measuring
+ * the simulator: accesses per second of wall clock time, the peak RSS of
+ * the host process and the time to start up on a trivial trace. The
+ * results are written as JSON, one run per line, and are compared against
+ * the results of the previous run.
+ */
+
+/* Bump when the generated traces change, such that an existing corpus
+ * is regenerated rather than compared against.
+ */
+static const int CorpusVersion = 1;
+
+struct Workload
+{
+  const char *name;
+  int nProcesses;
+  int nThreads;              /* per process, sharing the address space */
+  uint64_t accesses;         /* per thread */
+  uint64_t footprint;        /* data bytes per process */
+};
+
+/* From small to tens of millions of accesses. */
+static const Workload workloads[] =
+{
+  { "small",  2, 1,   50000,  4UL << 20 },
+  { "medium", 4, 1,  250000, 16UL << 20 },
+  { "large",  4, 2,  625000, 64UL << 20 },
+  { "huge",   8, 1, 2500000, 32UL << 20 },
+};
+
+struct Config
+{
+  const char *name;
+  std::vector<std::string> args;
+};
+
+static const Config configs[] =
+{
+  { "simple",         { "-s", "-m", "2097152" } },
+  { "aarch64",        { "-a" } },
+  { "aarch64-tlb16",  { "-a", "-t", "16" } },
+  { "aarch64-tlb256", { "-a", "-t", "256" } },
+  { "aarch64-notlb",  { "-a", "-t", "0" } },
+  { "aarch64-swap",   { "-a", "-m", "32768", "--swap=ssd" } },
+};
+
+
+/*
+ * Corpus generation
+ */
+
+/* splitmix64, such that the corpus does not depend on the standard
+ * library implementation.
+ */
+class Random
+{
+  protected:
+    uint64_t state;
+
+  public:
+    Random(const uint64_t seed) : state(seed) { }
+
+    uint64_t next(void)
+    {
+      uint64_t z = (state += 0x9e3779b97f4a7c15UL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+      return z ^ (z >> 31);
+    }
+
+    /* In [0, n) */
+    uint64_t below(const uint64_t n)
+    {
+      return next() % n;
+    }
+
+    bool chance(const unsigned percent)
+    {
+      return below(100) < percent;
+    }
+};
+
+class TraceWriter
+{
+  protected:
+    const std::string filename;
+    gzFile file;
+    std::string buffer;
+
+    void flush(void)
+    {
+      if (gzwrite(file, buffer.data(), buffer.size()) != (int)buffer.size())
+        throw std::runtime_error("Could not write " + filename);
+      buffer.clear();
+    }
+
+  public:
+    TraceWriter(const std::string &filename)
+      : filename(filename), file(gzopen(filename.c_str(), "wb1")), buffer()
+    {
+      if (file == nullptr)
+        throw std::runtime_error("Could not create " + filename);
+      buffer.reserve(1 << 20);
+      buffer += "==1== lackey\n";
+    }
+
+    ~TraceWriter()
+    {
+      if (file != nullptr)
+        gzclose(file);
+    }
+
+    void write(const char *type, const uint64_t addr, const int size)
+    {
+      char line[40];
+      const int n = snprintf(line, sizeof(line), "%s %08lx,%d\n", type, addr, size);
+      buffer.append(line, n);
+      if (buffer.size() >= (1 << 20) - sizeof(line))
+        flush();
+    }
+
+    void close(void)
+    {
+      flush();
+      if (gzclose(file) != Z_OK)
+        throw std::runtime_error("Could not write " + filename);
+      file = nullptr;
+    }
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+};
+
+/* One thread of a process: a loop-heavy instruction stream over 256 KiB
+ * of code, with data accesses to a small stack, sequential sweeps through
+ * the heap and skewed random accesses to it. Threads of a process use the
+ * same layout, so they share pages. Returns the number of accesses.
+ */
+static uint64_t
+generateThread(const std::string &filename, const Workload &workload,
+               const uint64_t seed)
+{
+  const uint64_t codeBase = 0x400000;
+  const uint64_t codeSize = 256UL << 10;
+  const uint64_t heapBase = 0x10000000;
+  const uint64_t stackTop = 0x7ff000000;
+  const uint64_t stackSize = 16UL << 10;
+  const uint64_t hotSize = std::max<uint64_t>(workload.footprint / 16, 4096);
+
+  Random random(seed);
+  TraceWriter writer(filename);
+
+  uint64_t pc = codeBase;
+  uint64_t loopStart = pc;
+  uint64_t sweep = random.below(workload.footprint / 8) * 8;
+  uint64_t nAccesses = 0;
+
+  while (nAccesses < workload.accesses)
+    {
+      writer.write("I ", pc, 4);
+      ++nAccesses;
+
+      /* Basic blocks of 8 instructions mostly branch back to the start
+       * of the loop; otherwise to a new loop elsewhere in the code.
+       */
+      pc += 4;
+      if ((pc & 31) == 0)
+        {
+          if (random.chance(80))
+            pc = loopStart;
+          else
+            pc = loopStart = codeBase + random.below(codeSize / 32) * 32;
+        }
+
+      if (nAccesses == workload.accesses || not random.chance(40))
+        continue;
+
+      const char *type = random.chance(30) ? " S" : " L";
+      const unsigned kind = random.below(100);
+      uint64_t addr;
+      if (kind < 50)
+        addr = stackTop - 8 - random.below(stackSize / 8) * 8;
+      else if (kind < 80)
+        {
+          addr = heapBase + sweep;
+          sweep = (sweep + 8) % workload.footprint;
+        }
+      else if (random.chance(80))
+        addr = heapBase + random.below(hotSize / 8) * 8;
+      else
+        addr = heapBase + random.below(workload.footprint / 8) * 8;
+
+      writer.write(type, addr, 8);
+      ++nAccesses;
+    }
+
+  writer.close();
+  return nAccesses;
+}
+
+static std::string
+traceFilename(const std::string &corpus, const Workload &workload,
+              const int process, const int thread)
+{
+  return corpus + "/" + workload.name + "-p" + std::to_string(process) +
+    "-t" + std::to_string(thread) + ".trace.gz";
+}
+
+/* The arguments to pagetables: a file per process, each followed by
+ * --thread=file for its other threads.
+ */
+static std::vector<std::string>
+traceArguments(const std::string &corpus, const Workload &workload)
+{
+  std::vector<std::string> args;
+  for (int p = 0; p < workload.nProcesses; ++p)
+    for (int t = 0; t < workload.nThreads; ++t)
+      args.push_back((t ? "--thread=" : "") +
+                     traceFilename(corpus, workload, p, t));
+  return args;
+}
+
+/* Generate the traces of workload, unless a complete set of the current
+ * version exists. Returns the total number of accesses.
+ */
+static uint64_t
+generateWorkload(const std::string &corpus, const Workload &workload)
+{
+  const uint64_t total =
+    workload.nProcesses * workload.nThreads * workload.accesses;
+  const std::string stamp = corpus + "/" + workload.name + ".done";
+
+  int version = 0;
+  std::ifstream(stamp) >> version;
+  if (version == CorpusVersion)
+    return total;
+
+  std::cerr << "Generating " << workload.name << " (" << total
+            << " accesses)..." << std::endl;
+  for (int p = 0; p < workload.nProcesses; ++p)
+    for (int t = 0; t < workload.nThreads; ++t)
+      generateThread(traceFilename(corpus, workload, p, t), workload,
+                     (uint64_t)CorpusVersion << 32 | p << 8 | t);
+
+  std::ofstream(stamp) << CorpusVersion << std::endl;
+  return total;
+}
+
+/* A single instruction fetch, to measure startup and teardown. */
+static std::string
+generateStartup(const std::string &corpus)
+{
+  const std::string filename = corpus + "/startup.trace.gz";
+  TraceWriter writer(filename);
+  writer.write("I ", 0x400000, 4);
+  writer.close();
+  return filename;
+}
+
+
+/*
+ * Running the simulator
+ */
+
+struct Measurement
+{
+  double seconds;
+  uint64_t maxRSS;     /* KiB */
+
+  Measurement() : seconds(0.), maxRSS(0) { }
+};
+
+/* Run pagetables with its output discarded; its peak RSS comes from
+ * the resource usage of the child.
+ */
+static Measurement
+runOnce(const std::string &pagetables, const std::vector<std::string> &args)
+{
+  std::vector<char *> argv;
+  argv.push_back(const_cast<char *>(pagetables.c_str()));
+  for (auto &arg : args)
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  const auto start = std::chrono::steady_clock::now();
+  const pid_t pid = fork();
+  if (pid < 0)
+    throw std::runtime_error(std::string("fork failed: ") + std::strerror(errno));
+
+  if (pid == 0)
+    {
+      const int null = open("/dev/null", O_WRONLY);
+      if (null >= 0)
+        {
+          dup2(null, STDOUT_FILENO);
+          dup2(null, STDERR_FILENO);
+        }
+      execv(argv[0], argv.data());
+      _exit(127);
+    }
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid)
+    throw std::runtime_error(std::string("wait4 failed: ") + std::strerror(errno));
+
+  Measurement m;
+  m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  m.maxRSS = usage.ru_maxrss;
+
+  if (not WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      std::string command;
+      for (auto *arg : argv)
+        if (arg)
+          command += std::string(command.empty() ? "" : " ") + arg;
+      throw std::runtime_error("simulation failed: " + command);
+    }
+
+  return m;
+}
+
+/* Fastest of repeat runs, and the largest peak RSS. */
+static Measurement
+run(const std::string &pagetables, const std::vector<std::string> &args,
+    const int repeat)
+{
+  Measurement best;
+  for (int i = 0; i < repeat; ++i)
+    {
+      const Measurement m = runOnce(pagetables, args);
+      if (i == 0 || m.seconds < best.seconds)
+        best.seconds = m.seconds;
+      best.maxRSS = std::max(best.maxRSS, m.maxRSS);
+    }
+  return best;
+}
+
+
+/*
+ * Baselines
+ */
+
+struct Result
+{
+  std::string workload;    /* empty for startup results */
+  std::string config;
+  uint64_t accesses;
+  Measurement m;
+
+  Result() : workload(), config(), accesses(0), m() { }
+
+  std::string key(void) const
+  {
+    return (workload.empty() ? "startup" : workload) + "/" + config;
+  }
+
+  double accessesPerSec(void) const
+  {
+    return m.seconds > 0. ? accesses / m.seconds : 0.;
+  }
+};
+
+/* Value of "name": in a line written by writeResults. */
+static bool
+findField(const std::string &line, const std::string &name, std::string &value)
+{
+  const std::string pattern = "\"" + name + "\": ";
+  size_t pos = line.find(pattern);
+  if (pos == std::string::npos)
+    return false;
+
+  pos += pattern.size();
+  if (line[pos] == '"')
+    {
+      const size_t end = line.find('"', pos + 1);
+      value = line.substr(pos + 1, end - pos - 1);
+    }
+  else
+    value = line.substr(pos, line.find_first_of(",}", pos) - pos);
+  return true;
+}
+
+static std::map<std::string, Result>
+readResults(const std::string &filename)
+{
+  std::map<std::string, Result> results;
+  std::ifstream file(filename);
+  std::string line, value;
+  while (std::getline(file, line))
+    {
+      Result r;
+      if (not findField(line, "config", r.config))
+        continue;
+      findField(line, "workload", r.workload);
+      if (findField(line, "accesses", value))
+        r.accesses = std::stoull(value);
+      if (findField(line, "seconds", value))
+        r.m.seconds = std::stod(value);
+      if (findField(line, "max_rss_kib", value))
+        r.m.maxRSS = std::stoull(value);
+      results[r.key()] = r;
+    }
+  return results;
+}
+
+static void
+writeResults(const std::string &filename, const std::string &pagetables,
+             const std::vector<Result> &runs, const std::vector<Result> &startups)
+{
+  std::ofstream file(filename);
+  if (not file)
+    throw std::runtime_error("Could not create " + filename);
+
+  struct utsname host;
+  uname(&host);
+  const auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+  file << std::fixed
+       << "{" << std::endl
+       << "  \"format\": \"pagetables-macrobench\", \"version\": " << CorpusVersion
+       << "," << std::endl
+       << "  \"host\": \"" << host.nodename << "\", \"machine\": \""
+       << host.machine << "\", \"time\": " << now << "," << std::endl
+       << "  \"pagetables\": \"" << pagetables << "\"," << std::endl;
+
+  file << "  \"runs\": [" << std::endl;
+  for (size_t i = 0; i < runs.size(); ++i)
+    {
+      const Result &r = runs[i];
+      file << "    { \"workload\": \"" << r.workload << "\", \"config\": \""
+           << r.config << "\", \"accesses\": " << r.accesses
+           << ", \"seconds\": " << std::setprecision(4) << r.m.seconds
+           << ", \"accesses_per_sec\": " << std::setprecision(0) << r.accessesPerSec()
+           << ", \"max_rss_kib\": " << r.m.maxRSS << " }"
+           << (i + 1 < runs.size() ? "," : "") << std::endl;
+    }
+  file << "  ]," << std::endl;
+
+  file << "  \"startup\": [" << std::endl;
+  for (size_t i = 0; i < startups.size(); ++i)
+    {
+      const Result &r = startups[i];
+      file << "    { \"config\": \"" << r.config << "\", \"seconds\": "
+           << std::setprecision(4) << r.m.seconds
+           << ", \"startup_ms\": " << std::setprecision(2) << r.m.seconds * 1000.
+           << ", \"max_rss_kib\": " << r.m.maxRSS << " }"
+           << (i + 1 < startups.size() ? "," : "") << std::endl;
+    }
+  file << "  ]" << std::endl << "}" << std::endl;
+
+  if (not file)
+    throw std::runtime_error("Could not write " + filename);
+}
+
+static std::string
+change(const double now, const double before)
+{
+  if (before <= 0.)
+    return "";
+
+  std::ostringstream s;
+  s << std::fixed << std::setprecision(1) << std::showpos
+    << 100. * (now - before) / before << "%";
+  return s.str();
+}
+
+static void
+report(const Result &r, const std::map<std::string, Result> &previous)
+{
+  auto it = previous.find(r.key());
+  const Result *before = it != previous.end() ? &it->second : nullptr;
+
+  std::cout << std::left << std::setw(24) << r.key() << std::right << std::fixed;
+  if (r.workload.empty())
+    std::cout << std::setw(12) << std::setprecision(2) << r.m.seconds * 1000. << " ms"
+              << std::setw(10)
+              << (before ? change(r.m.seconds, before->m.seconds) : "");
+  else
+    std::cout << std::setw(12) << std::setprecision(0) << r.accessesPerSec() << "/s"
+              << std::setw(10)
+              << (before ? change(r.accessesPerSec(), before->accessesPerSec()) : "");
+  std::cout << std::setw(10) << r.m.maxRSS << " KiB"
+            << std::setw(10) << (before ? change(r.m.maxRSS, before->m.maxRSS) : "")
+            << std::endl;
+}
+
+
+static void
+showHelp(const char *progName)
+{
+  std::cerr << progName << " [-p pagetables] [-c corpus] [-o output] [-b baseline] [-r repeat] [-w workloads] [-g]" << std::endl;
+  std::cerr <<
+R"HERE(
+    -p pagetables  Simulator to run (default ./pagetables).
+    -c corpus      Directory of the generated traces (default bench/corpus);
+                   traces are only generated if missing or outdated.
+    -o output      JSON file to write the results to (default
+                   bench/macrobench.json). Unless -b is given, an existing
+                   file is the baseline and is kept as output.prev.
+    -b baseline    JSON file of a previous run to compare against.
+    -r repeat      Run every configuration repeat times and keep the
+                   fastest (default 1).
+    -w workloads   Comma separated workloads to run (default all:
+                   small, medium, large and huge).
+    -g             Only generate the corpus.
+)HERE";
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *progName = argv[0];
+  std::string pagetables = "./pagetables";
+  std::string corpus = "bench/corpus";
+  std::string output = "bench/macrobench.json";
+  std::string baseline;
+  std::string selection;
+  int repeat = 1;
+  bool generateOnly = false;
+
+  int c;
+  while ((c = getopt(argc, argv, "p:c:o:b:r:w:gh")) != -1)
+    {
+      switch (c)
+        {
+          case 'p':
+            pagetables = optarg;
+            break;
+
+          case 'c':
+            corpus = optarg;
+            break;
+
+          case 'o':
+            output = optarg;
+            break;
+
+          case 'b':
+            baseline = optarg;
+            break;
+
+          case 'r':
+            repeat = std::stoi(optarg);
+            break;
+
+          case 'w':
+            selection = std::string(",") + optarg + ",";
+            break;
+
+          case 'g':
+            generateOnly = true;
+            break;
+
+          case 'h':
+          default:
+            showHelp(progName);
+            return -1;
+        }
+    }
+
+  if (optind != argc || repeat < 1)
+    {
+      showHelp(progName);
+      return -1;
+    }
+
+  try
+    {
+      std::filesystem::create_directories(corpus);
+      const std::filesystem::path outputDir = std::filesystem::path(output).parent_path();
+      if (not outputDir.empty())
+        std::filesystem::create_directories(outputDir);
+
+      std::vector<const Workload *> selected;
+      for (auto &workload : workloads)
+        if (selection.empty() ||
+            selection.find(std::string(",") + workload.name + ",") != std::string::npos)
+          selected.push_back(&workload);
+      if (selected.empty())
+        throw std::runtime_error("No such workload: " + selection.substr(1, selection.size() - 2));
+
+      std::map<std::string, uint64_t> nAccesses;
+      for (auto *workload : selected)
+        nAccesses[workload->name] = generateWorkload(corpus, *workload);
+      const std::string startupTrace = generateStartup(corpus);
+      if (generateOnly)
+        return 0;
+
+      /* Without -b, the previous output is the baseline; it is kept
+       * as output.prev once the new results are written.
+       */
+      const bool rotate = baseline.empty() && std::filesystem::exists(output);
+      if (rotate)
+        baseline = output;
+      const std::map<std::string, Result> previous =
+        baseline.empty() ? std::map<std::string, Result>() : readResults(baseline);
+
+      std::cout << std::left << std::setw(24) << "run" << std::right
+                << std::setw(14) << "speed" << std::setw(10) << "change"
+                << std::setw(14) << "peak RSS" << std::setw(10) << "change"
+                << std::endl;
+
+      std::vector<Result> startups;
+      for (auto &config : configs)
+        {
+          Result r;
+          r.config = config.name;
+          std::vector<std::string> args(config.args);
+          args.push_back(startupTrace);
+          r.m = run(pagetables, args, std::max(repeat, 3));
+          report(r, previous);
+          startups.push_back(r);
+        }
+
+      std::vector<Result> runs;
+      for (auto *workload : selected)
+        for (auto &config : configs)
+          {
+            Result r;
+            r.workload = workload->name;
+            r.config = config.name;
+            r.accesses = nAccesses[workload->name];
+            std::vector<std::string> args(config.args);
+            for (auto &arg : traceArguments(corpus, *workload))
+              args.push_back(arg);
+            r.m = run(pagetables, args, repeat);
+            report(r, previous);
+            runs.push_back(r);
+          }
+
+      if (rotate)
+        {
+          baseline = output + ".prev";
+          std::filesystem::rename(output, baseline);
+        }
+      writeResults(output, pagetables, runs, startups);
+      std::cout << "Results written to " << output;
+      if (not previous.empty())
+        std::cout << ", compared against " << baseline;
+      std::cout << "." << std::endl;
+    }
+  catch (std::exception &error)
+    {
+      std::cerr << "Error: " << error.what() << std::endl;
+      return -1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,142 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    pagetables-top.cc - Show the live statistics of a running simulation
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "os/livestats.h"
+
+
+static void
+showHelp(const char *progName)
+{
+  std::cerr << progName << " [-d seconds] [-n count] [-b] filename" << std::endl;
+  std::cerr <<
+R"HERE(
+    -d seconds   Delay between updates (default 1).
+    -n count     Exit after count updates; 0 (default) runs until the
+                 simulation has finished.
+    -b           Batch mode: append updates rather than redrawing.
+
+    filename is the file given to pagetables with --live-stats.
+)HERE";
+}
+
+static const LiveStatsRegion *
+mapRegion(const std::string &filename)
+{
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Could not open " + filename + ": " +
+                             std::strerror(errno));
+
+  void *mem = mmap(nullptr, sizeof(LiveStatsRegion), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+    throw std::runtime_error("Could not map " + filename + ": " +
+                             std::strerror(errno));
+
+  const LiveStatsRegion *region = static_cast<const LiveStatsRegion *>(mem);
+  if (region->magic.load(std::memory_order_acquire) != LiveStatsRegion::magicValue)
+    throw std::runtime_error(filename + " is not a live statistics file.");
+
+  return region;
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *progName = argv[0];
+  double delay = 1.;
+  uint64_t count = 0;
+  bool batch = false;
+
+  int c;
+  while ((c = getopt(argc, argv, "d:n:bh")) != -1)
+    {
+      switch (c)
+        {
+          case 'd':
+            delay = std::stod(optarg);
+            break;
+
+          case 'n':
+            count = std::stoull(optarg);
+            break;
+
+          case 'b':
+            batch = true;
+            break;
+
+          case 'h':
+          default:
+            showHelp(progName);
+            return -1;
+        }
+    }
+
+  if (optind != argc - 1 || delay <= 0.)
+    {
+      showHelp(progName);
+      return -1;
+    }
+
+  const std::string filename(argv[optind]);
+  try
+    {
+      const LiveStatsRegion *region = mapRegion(filename);
+      const uint64_t pid = region->pid.load(std::memory_order_relaxed);
+
+      for (uint64_t update = 0; count == 0 || update < count; ++update)
+        {
+          if (update > 0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+
+          LiveSnapshot snapshot;
+          if (not region->read(snapshot))
+            continue;
+
+          /* Clear the screen and move the cursor home. */
+          if (not batch)
+            std::cout << "\033[H\033[2J";
+          else if (update > 0)
+            std::cout << std::endl;
+
+          std::cout << "pagetables (pid " << pid << "), " << filename << std::endl;
+          snapshot.print(std::cout);
+          std::cout.flush();
+
+          if (snapshot[LiveCounter::Finished])
+            break;
+
+          /* A simulation that was killed never reports it has finished. */
+          if (kill(pid, 0) != 0 && errno == ESRCH)
+            {
+              std::cout << "# simulation has exited" << std::endl;
+              break;
+            }
+        }
+    }
+  catch (std::runtime_error &error)
+    {
+      std::cerr << "Error: " << error.what() << std::endl;
+      return -1;
+    }
+
+  return 0;
+}
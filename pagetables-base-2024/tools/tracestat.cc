@@ -0,0 +1,485 @@
+/* pagetables -- A framework to experiment with memory management
+ *
+ *    tracestat.cc - Trace characterisation: footprint and locality
+ *
+ * Copyright (C) 2024  Leiden University, The Netherlands.
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+
+#include "exceptions.h"
+#include "os/hyperloglog.h"
+#include "os/reusedistance.h"
+#include "os/tracereader.h"
+
+/* Every trace is read by one thread, that hands batches of accesses to
+ * the analyses, which each run in a thread of their own. All state is
+ * bounded: footprints are counted with HyperLogLog sketches and reuse
+ * distances are measured on a spatially hashed sample of the pages.
+ */
+
+static uint64_t WorkingSetWindow = 1000000;  /* accesses */
+static int LocalityPageBits = 14;           /* page size of the locality analyses */
+static size_t ReuseSamples = 8192;           /* pages sampled for reuse distances */
+
+using Batch = std::vector<MemAccess>;
+constexpr static size_t batchSize = 1 << 16;
+
+
+/* Bounded single producer, single consumer queue of batches; nullptr
+ * marks the end of the trace.
+ */
+class BatchQueue
+{
+  protected:
+    constexpr static size_t depth = 4;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::shared_ptr<const Batch>> batches;
+
+  public:
+    BatchQueue()
+      : lock(), changed(), batches()
+    { }
+
+    void push(std::shared_ptr<const Batch> batch)
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, [this]() { return batches.size() < depth; });
+      batches.push_back(std::move(batch));
+      changed.notify_all();
+    }
+
+    std::shared_ptr<const Batch> pop(void)
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, [this]() { return not batches.empty(); });
+      std::shared_ptr<const Batch> batch = batches.front();
+      batches.pop_front();
+      changed.notify_all();
+      return batch;
+    }
+};
+
+/* Histogram over power of two buckets; bucket 0 holds zero, bucket b
+ * values in [2^(b-1), 2^b).
+ */
+class Log2Histogram
+{
+  protected:
+    std::map<int, double> buckets;
+
+  public:
+    Log2Histogram()
+      : buckets()
+    { }
+
+    static int getBucket(uint64_t value)
+    {
+      return value == 0 ? 0 : 64 - __builtin_clzll(value);
+    }
+
+    void add(const uint64_t value, const double weight = 1.)
+    {
+      buckets[getBucket(value)] += weight;
+    }
+
+    void print(std::ostream &os, const char *prefix = "") const
+    {
+      for (const auto &bucket : buckets)
+        {
+          os << "#   " << prefix;
+          if (bucket.first <= 1)
+            os << bucket.first;
+          else
+            os << (1UL << (bucket.first - 1)) << "-"
+               << ((1UL << (bucket.first - 1)) * 2 - 1);
+          os << ": " << (uint64_t)(bucket.second + .5) << std::endl;
+        }
+    }
+};
+
+
+/*
+ * Footprint: distinct pages per page size and the access type mix
+ */
+
+class Footprint
+{
+  public:
+    constexpr static int nPageSizes = 5;
+    constexpr static int pageBits[nPageSizes] = { 12, 14, 16, 21, 25 };
+
+    HyperLogLog pages[nPageSizes];
+    uint64_t nAccesses[4];   /* by MemAccessType */
+    uint64_t nBytes;
+
+    Footprint()
+      : pages(), nAccesses{ 0, 0, 0, 0 }, nBytes(0)
+    { }
+
+    void process(const Batch &batch)
+    {
+      for (const MemAccess &access : batch)
+        {
+          for (int i = 0; i < nPageSizes; ++i)
+            pages[i].add(access.addr >> pageBits[i]);
+          ++nAccesses[(int)access.type];
+          nBytes += access.size;
+        }
+    }
+
+    void print(std::ostream &os) const
+    {
+      static const char *typeNames[4] = { "instruction", "store", "load", "modify" };
+      const uint64_t total = std::accumulate(nAccesses, nAccesses + 4, 0UL);
+
+      os << "# accesses: " << total << " (" << nBytes << " bytes)" << std::endl;
+      for (int type = 0; type < 4; ++type)
+        os << "#   " << typeNames[type] << ": " << nAccesses[type] << " ("
+           << (total ? 100. * nAccesses[type] / total : 0.) << "%)" << std::endl;
+
+      os << "# unique pages (estimated):" << std::endl;
+      for (int i = 0; i < nPageSizes; ++i)
+        os << "#   " << formatSize(1UL << pageBits[i]) << ": "
+           << (uint64_t)(pages[i].estimate() + .5) << std::endl;
+    }
+
+    static std::string formatSize(const uint64_t size)
+    {
+      if (size >= (1UL << 20))
+        return std::to_string(size >> 20) + " MiB";
+      return std::to_string(size >> 10) + " KiB";
+    }
+};
+
+constexpr int Footprint::pageBits[];
+
+
+/*
+ * Reuse distance in distinct pages, over a sample of the pages (see
+ * ReuseDistance) and scaled by the sampling rate.
+ */
+
+class ReuseProfile
+{
+  protected:
+    ReuseDistance distances;
+
+  public:
+    Log2Histogram histogram;
+    double nCold;
+
+    ReuseProfile(const size_t maxSamples)
+      : distances(maxSamples), histogram(), nCold(0.)
+    { }
+
+    void process(const Batch &batch)
+    {
+      for (const MemAccess &access : batch)
+        {
+          const double weight = 1. / distances.getRate();
+          uint64_t distance;
+          if (not distances.access(access.addr >> LocalityPageBits, distance))
+            continue;
+
+          if (distance == ReuseDistance::firstAccess)
+            nCold += weight;
+          else
+            histogram.add(distance * weight, weight);
+        }
+    }
+
+    void print(std::ostream &os) const
+    {
+      os << "# reuse distance in distinct "
+         << Footprint::formatSize(1UL << LocalityPageBits)
+         << " pages (sampling rate " << std::setprecision(3)
+         << distances.getRate() << std::setprecision(6) << "):" << std::endl
+         << "#   first access: " << (uint64_t)(nCold + .5) << std::endl;
+      histogram.print(os);
+    }
+};
+
+
+/*
+ * Strides between successive accesses, for the instruction and data
+ * streams separately, and the working set over time.
+ */
+
+class Locality
+{
+  protected:
+    uint64_t lastAddr[2];
+    bool started[2];
+    uint64_t windowAccesses;
+    HyperLogLog window;
+
+  public:
+    Log2Histogram forward[2];
+    Log2Histogram backward[2];
+    std::vector<uint64_t> workingSet;
+
+    Locality()
+      : lastAddr{ 0, 0 }, started{ false, false }, windowAccesses(0),
+        window(12), forward(), backward(), workingSet()
+    { }
+
+    void process(const Batch &batch)
+    {
+      for (const MemAccess &access : batch)
+        {
+          const int stream = access.type == MemAccessType::Instr ? 0 : 1;
+          if (started[stream])
+            {
+              if (access.addr >= lastAddr[stream])
+                forward[stream].add(access.addr - lastAddr[stream]);
+              else
+                backward[stream].add(lastAddr[stream] - access.addr);
+            }
+          lastAddr[stream] = access.addr;
+          started[stream] = true;
+
+          window.add(access.addr >> LocalityPageBits);
+          if (++windowAccesses == WorkingSetWindow)
+            finishWindow();
+        }
+    }
+
+    void finishWindow(void)
+    {
+      if (windowAccesses == 0)
+        return;
+
+      workingSet.push_back(window.estimate() + .5);
+      window.clear();
+      windowAccesses = 0;
+    }
+
+    void print(std::ostream &os) const
+    {
+      static const char *streamNames[2] = { "instruction", "data" };
+      for (int stream = 0; stream < 2; ++stream)
+        {
+          os << "# " << streamNames[stream] << " strides (bytes):" << std::endl;
+          forward[stream].print(os, "+");
+          backward[stream].print(os, "-");
+        }
+
+      os << "# working set per " << WorkingSetWindow << " accesses ("
+         << Footprint::formatSize(1UL << LocalityPageBits) << " pages):"
+         << std::endl;
+      for (size_t i = 0; i < workingSet.size(); ++i)
+        os << "#   " << i * WorkingSetWindow << ": " << workingSet[i] << std::endl;
+    }
+};
+
+
+/*
+ * Analysis of a single trace
+ */
+
+class TraceStat
+{
+  protected:
+    const std::string filename;
+    std::exception_ptr error;
+
+    BatchQueue queues[3];
+
+    template<typename Analysis>
+    void consume(BatchQueue &queue, Analysis &analysis)
+    {
+      while (std::shared_ptr<const Batch> batch = queue.pop())
+        analysis.process(*batch);
+    }
+
+    void produce(void)
+    {
+      try
+        {
+          std::ifstream file(filename);
+          if (not file)
+            throw std::runtime_error("Could not open file " + filename);
+
+          TraceReader reader(file);
+          while (not reader.eof())
+            {
+              auto batch = std::make_shared<Batch>();
+              batch->reserve(batchSize);
+              while (not reader.eof() && batch->size() < batchSize)
+                {
+                  MemAccess access;
+                  reader >> access;
+                  batch->push_back(access);
+                }
+
+              for (BatchQueue &queue : queues)
+                queue.push(batch);
+            }
+        }
+      catch (...)
+        {
+          error = std::current_exception();
+        }
+
+      for (BatchQueue &queue : queues)
+        queue.push(nullptr);
+    }
+
+  public:
+    Footprint footprint;
+    ReuseProfile reuse;
+    Locality locality;
+
+    TraceStat(const std::string &filename)
+      : filename(filename), error(), queues(), footprint(),
+        reuse(ReuseSamples), locality()
+    { }
+
+    void run(void)
+    {
+      std::thread threads[] =
+        {
+          std::thread(&TraceStat::produce, this),
+          std::thread([this]() { consume(queues[0], footprint); }),
+          std::thread([this]() { consume(queues[1], reuse); }),
+          std::thread([this]() { consume(queues[2], locality); })
+        };
+      for (std::thread &thread : threads)
+        thread.join();
+
+      locality.finishWindow();
+    }
+
+    void print(std::ostream &os)
+    {
+      if (error)
+        std::rethrow_exception(error);
+
+      os << std::endl << "Trace Statistics (" << filename << "):" << std::endl;
+      footprint.print(os);
+      reuse.print(os);
+      locality.print(os);
+    }
+};
+
+
+static void
+showHelp(const char *progName)
+{
+  std::cerr << progName << " [-w window] [-p pagebits] [-n samples] filenames ..." << std::endl;
+  std::cerr <<
+R"HERE(
+    -w window    Accesses per working set measurement (default 1000000).
+    -p pagebits  Page size (log2) for reuse distances and working sets
+                 (default 14, 16 KiB).
+    -n samples   Number of pages sampled for reuse distances (default 8192).
+
+    Every trace is analysed in a single pass, all traces in parallel.
+    Unique page counts of all traces together are given at the end.
+)HERE";
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *progName = argv[0];
+
+  int c;
+  while ((c = getopt(argc, argv, "w:p:n:h")) != -1)
+    {
+      switch (c)
+        {
+          case 'w':
+            WorkingSetWindow = std::stoull(optarg);
+            break;
+
+          case 'p':
+            LocalityPageBits = std::stoi(optarg);
+            break;
+
+          case 'n':
+            ReuseSamples = std::stoull(optarg);
+            break;
+
+          case 'h':
+          default:
+            showHelp(progName);
+            return -1;
+        }
+    }
+
+  argc -= optind;
+  argv += optind;
+
+  if (argc == 0 || WorkingSetWindow == 0 || ReuseSamples == 0 ||
+      LocalityPageBits < 12 || LocalityPageBits > 30)
+    {
+      showHelp(progName);
+      return -1;
+    }
+
+  try
+    {
+      std::list<TraceStat> traces;
+      for (int i = 0; i < argc; ++i)
+        traces.emplace_back(argv[i]);
+
+      std::vector<std::thread> threads;
+      for (TraceStat &trace : traces)
+        threads.emplace_back(&TraceStat::run, &trace);
+      for (std::thread &thread : threads)
+        thread.join();
+
+      Footprint total;
+      for (TraceStat &trace : traces)
+        {
+          trace.print(std::cout);
+          for (int i = 0; i < Footprint::nPageSizes; ++i)
+            total.pages[i].merge(trace.footprint.pages[i]);
+        }
+
+      if (traces.size() > 1)
+        {
+          std::cout << std::endl << "All traces:" << std::endl
+                    << "# unique pages (estimated):" << std::endl;
+          for (int i = 0; i < Footprint::nPageSizes; ++i)
+            std::cout << "#   " << Footprint::formatSize(1UL << Footprint::pageBits[i])
+                      << ": " << (uint64_t)(total.pages[i].estimate() + .5)
+                      << std::endl;
+        }
+    }
+  catch (TraceFileParseError &error)
+    {
+      std::cerr << "Parse error: " << error.what() << std::endl;
+      return -1;
+    }
+  catch (ReadError &error)
+    {
+      std::cerr << "Read error: " << error.what() << std::endl;
+      return -1;
+    }
+  catch (std::runtime_error &error)
+    {
+      std::cerr << "Error: " << error.what() << std::endl;
+      return -1;
+    }
+
+  return 0;
+}